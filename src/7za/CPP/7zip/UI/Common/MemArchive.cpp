@@ -0,0 +1,466 @@
+// MemArchive.cpp
+// one file 7z archives decoded into / encoded from memory, and the
+// independently compressed and encrypted chunks of a document, for cherrytree
+
+#include "StdAfx.h"
+
+#include <string>
+
+#include "../../../../C/7zCrc.h"
+#include "../../../../C/Aes.h"
+#include "../../../../C/Alloc.h"
+#include "../../../../C/Lzma2Dec.h"
+#include "../../../../C/Lzma2Enc.h"
+
+#include "../../../Common/IntToString.h"
+#include "../../../Common/MyCom.h"
+#include "../../../Common/MyString.h"
+#include "../../../Common/StringConvert.h"
+#include "../../../Common/UTFConvert.h"
+
+#include "../../../Windows/PropVariant.h"
+#include "../../../Windows/TimeUtils.h"
+
+#include "../../Common/FileStreams.h"
+#include "../../Common/StreamObjects.h"
+
+#include "../../Archive/IArchive.h"
+#include "../../Archive/7z/7zHandler.h"
+#include "../../Crypto/7zAes.h"
+#include "../../Crypto/RandGen.h"
+#include "../../IPassword.h"
+
+#include "ExitCode.h"
+#include "SetProperties.h"
+
+using namespace NWindows;
+
+static UString PasswordToUnicode(const char *passwd)
+{
+  // the same as the command line of p7za_exec with an UTF-8 locale
+  UString password;
+  if (!ConvertUTF8ToUnicode(AString(passwd), password))
+    password = MultiByteToUnicodeString(AString(passwd));
+  return password;
+}
+
+class CStdStringOutStream:
+  public ISequentialOutStream,
+  public CMyUnknownImp
+{
+  std::string &_data;
+public:
+  CStdStringOutStream(std::string &data): _data(data) {}
+
+  MY_UNKNOWN_IMP1(ISequentialOutStream)
+  STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize);
+};
+
+STDMETHODIMP CStdStringOutStream::Write(const void *data, UInt32 size, UInt32 *processedSize)
+{
+  if (processedSize)
+    *processedSize = 0;
+  try
+  {
+    _data.append((const char *)data, size);
+  }
+  catch(...)
+  {
+    return E_OUTOFMEMORY;
+  }
+  if (processedSize)
+    *processedSize = size;
+  return S_OK;
+}
+
+class CMemOpenCallback:
+  public IArchiveOpenCallback,
+  public ICryptoGetTextPassword,
+  public CMyUnknownImp
+{
+public:
+  UString Password;
+
+  MY_UNKNOWN_IMP1(ICryptoGetTextPassword)
+  INTERFACE_IArchiveOpenCallback(;)
+  STDMETHOD(CryptoGetTextPassword)(BSTR *password);
+};
+
+STDMETHODIMP CMemOpenCallback::SetTotal(const UInt64 * /* files */, const UInt64 * /* bytes */) { return S_OK; }
+STDMETHODIMP CMemOpenCallback::SetCompleted(const UInt64 * /* files */, const UInt64 * /* bytes */) { return S_OK; }
+STDMETHODIMP CMemOpenCallback::CryptoGetTextPassword(BSTR *password) { return StringToBstr(Password, password); }
+
+class CMemExtractCallback:
+  public IArchiveExtractCallback,
+  public ICryptoGetTextPassword,
+  public CMyUnknownImp
+{
+  std::string &_data;
+public:
+  UString Password;
+  Int32 OpResult;
+
+  CMemExtractCallback(std::string &data): _data(data), OpResult(NArchive::NExtract::NOperationResult::kDataError) {}
+
+  MY_UNKNOWN_IMP1(ICryptoGetTextPassword)
+  INTERFACE_IArchiveExtractCallback(;)
+  STDMETHOD(CryptoGetTextPassword)(BSTR *password);
+};
+
+STDMETHODIMP CMemExtractCallback::SetTotal(UInt64 /* total */) { return S_OK; }
+STDMETHODIMP CMemExtractCallback::SetCompleted(const UInt64 * /* completeValue */) { return S_OK; }
+
+STDMETHODIMP CMemExtractCallback::GetStream(UInt32 /* index */, ISequentialOutStream **outStream, Int32 askExtractMode)
+{
+  *outStream = NULL;
+  if (askExtractMode != NArchive::NExtract::NAskMode::kExtract)
+    return S_OK;
+  CMyComPtr<ISequentialOutStream> stream = new CStdStringOutStream(_data);
+  *outStream = stream.Detach();
+  return S_OK;
+}
+
+STDMETHODIMP CMemExtractCallback::PrepareOperation(Int32 /* askExtractMode */) { return S_OK; }
+STDMETHODIMP CMemExtractCallback::SetOperationResult(Int32 opRes) { OpResult = opRes; return S_OK; }
+STDMETHODIMP CMemExtractCallback::CryptoGetTextPassword(BSTR *password) { return StringToBstr(Password, password); }
+
+class CMemUpdateCallback:
+  public IArchiveUpdateCallback,
+  public ICryptoGetTextPassword2,
+  public CMyUnknownImp
+{
+public:
+  const char *Data;
+  size_t Size;
+  UString ItemName;
+  UString Password;
+  FILETIME MTime;
+
+  MY_UNKNOWN_IMP1(ICryptoGetTextPassword2)
+  INTERFACE_IArchiveUpdateCallback(;)
+  STDMETHOD(CryptoGetTextPassword2)(Int32 *passwordIsDefined, BSTR *password);
+};
+
+STDMETHODIMP CMemUpdateCallback::SetTotal(UInt64 /* total */) { return S_OK; }
+STDMETHODIMP CMemUpdateCallback::SetCompleted(const UInt64 * /* completeValue */) { return S_OK; }
+
+STDMETHODIMP CMemUpdateCallback::GetUpdateItemInfo(UInt32 /* index */, Int32 *newData, Int32 *newProps, UInt32 *indexInArchive)
+{
+  if (newData)
+    *newData = 1;
+  if (newProps)
+    *newProps = 1;
+  if (indexInArchive)
+    *indexInArchive = (UInt32)(Int32)-1;
+  return S_OK;
+}
+
+STDMETHODIMP CMemUpdateCallback::GetProperty(UInt32 /* index */, PROPID propID, PROPVARIANT *value)
+{
+  NCOM::CPropVariant prop;
+  switch (propID)
+  {
+    case kpidPath: prop = ItemName; break;
+    case kpidIsDir: prop = false; break;
+    case kpidIsAnti: prop = false; break;
+    case kpidSize: prop = (UInt64)Size; break;
+    case kpidMTime: prop = MTime; break;
+  }
+  prop.Detach(value);
+  return S_OK;
+}
+
+STDMETHODIMP CMemUpdateCallback::GetStream(UInt32 /* index */, ISequentialInStream **inStream)
+{
+  // read in place, the data outlives the update
+  Create_BufInStream_WithReference(Data, Size, NULL, inStream);
+  return S_OK;
+}
+
+STDMETHODIMP CMemUpdateCallback::SetOperationResult(Int32 /* operationResult */) { return S_OK; }
+
+STDMETHODIMP CMemUpdateCallback::CryptoGetTextPassword2(Int32 *passwordIsDefined, BSTR *password)
+{
+  *passwordIsDefined = 1;
+  return StringToBstr(Password, password);
+}
+
+// the only file in the archive at input_path into data
+int p7za_mem_extract(const char *input_path, const char *passwd, std::string &data)
+{
+  data.clear();
+  try
+  {
+    CInFileStream *inStreamSpec = new CInFileStream;
+    CMyComPtr<IInStream> inStream = inStreamSpec;
+    if (!inStreamSpec->Open(us2fs(MultiByteToUnicodeString(AString(input_path)))))
+      return NExitCode::kFatalError;
+
+    CMyComPtr<IInArchive> archive = new NArchive::N7z::CHandler;
+    CMemOpenCallback *openCallbackSpec = new CMemOpenCallback;
+    CMyComPtr<IArchiveOpenCallback> openCallback(openCallbackSpec);
+    openCallbackSpec->Password = PasswordToUnicode(passwd);
+    const UInt64 maxCheckStartPosition = 1 << 23;
+    if (archive->Open(inStream, &maxCheckStartPosition, openCallback) != S_OK)
+      return NExitCode::kFatalError;
+
+    UInt32 numItems = 0;
+    if (archive->GetNumberOfItems(&numItems) != S_OK)
+      return NExitCode::kFatalError;
+    UInt32 fileIndex = 0;
+    UInt32 numFiles = 0;
+    for (UInt32 i = 0; i < numItems; i++)
+    {
+      NCOM::CPropVariant prop;
+      archive->GetProperty(i, kpidIsDir, &prop);
+      if (prop.vt == VT_BOOL && prop.boolVal != VARIANT_FALSE)
+        continue;
+      fileIndex = i;
+      numFiles++;
+    }
+    if (numFiles != 1)
+      return NExitCode::kFatalError;
+    {
+      NCOM::CPropVariant prop;
+      archive->GetProperty(fileIndex, kpidSize, &prop);
+      if (prop.vt == VT_UI8)
+        data.reserve((size_t)prop.uhVal.QuadPart);
+    }
+
+    CMemExtractCallback *extractCallbackSpec = new CMemExtractCallback(data);
+    CMyComPtr<IArchiveExtractCallback> extractCallback(extractCallbackSpec);
+    extractCallbackSpec->Password = openCallbackSpec->Password;
+    const HRESULT res = archive->Extract(&fileIndex, 1, 0 /* testMode */, extractCallback);
+    archive->Close();
+    if (res == S_OK && extractCallbackSpec->OpResult == NArchive::NExtract::NOperationResult::kOK)
+      return NExitCode::kSuccess;
+  }
+  catch(...) {}
+  // nothing is left of a wrong password or a corrupted archive
+  data.clear();
+  data.shrink_to_fit();
+  return NExitCode::kFatalError;
+}
+
+// a new archive at output_path with data as the file item_name,
+// with the same methods of the command line used by cherrytree
+int p7za_mem_archive(const char *data, size_t size, const char *item_name, const char *output_path, const char *passwd, unsigned numThreads)
+{
+  try
+  {
+    COutFileStream *outStreamSpec = new COutFileStream;
+    CMyComPtr<IOutStream> outStream = outStreamSpec;
+    if (!outStreamSpec->Create(us2fs(MultiByteToUnicodeString(AString(output_path))), true /* createAlways */))
+      return NExitCode::kFatalError;
+
+    CMyComPtr<IOutArchive> outArchive = new NArchive::N7z::CHandler;
+    CObjectVector<CProperty> properties;
+    wchar_t numThreadsString[16];
+    ConvertUInt32ToString(numThreads, numThreadsString);
+    const wchar_t * const kProps[][2] = { { L"0", L"LZMA2:d64k:fb32" }, { L"s", L"8m" }, { L"mt", numThreadsString }, { L"x", L"1" } };
+    for (unsigned i = 0; i < sizeof(kProps) / sizeof(kProps[0]); i++)
+    {
+      CProperty &property = properties.AddNew();
+      property.Name = kProps[i][0];
+      property.Value = kProps[i][1];
+    }
+    if (SetProperties(outArchive, properties) != S_OK)
+      return NExitCode::kFatalError;
+
+    CMemUpdateCallback *updateCallbackSpec = new CMemUpdateCallback;
+    CMyComPtr<IArchiveUpdateCallback> updateCallback(updateCallbackSpec);
+    updateCallbackSpec->Data = data;
+    updateCallbackSpec->Size = size;
+    if (!ConvertUTF8ToUnicode(AString(item_name), updateCallbackSpec->ItemName))
+      updateCallbackSpec->ItemName = MultiByteToUnicodeString(AString(item_name));
+    updateCallbackSpec->Password = PasswordToUnicode(passwd);
+    NTime::GetCurUtcFileTime(updateCallbackSpec->MTime);
+
+    if (outArchive->UpdateItems(outStream, 1, updateCallback) != S_OK)
+      return NExitCode::kFatalError;
+    if (outStreamSpec->Close() != S_OK)
+      return NExitCode::kFatalError;
+    return NExitCode::kSuccess;
+  }
+  catch(...) {}
+  return NExitCode::kFatalError;
+}
+
+// ---------- chunks ----------
+// chunk: iv[16] + AES-256-CBC( unpackSize[8] packSize[8] crc[4] prop[1] LZMA2 data, zero padded )
+
+static const unsigned kChunkIvSize = AES_BLOCK_SIZE;
+static const unsigned kChunkHeaderSize = 8 + 8 + 4 + 1;
+
+static struct CChunkTablesInit { CChunkTablesInit() { AesGenTables(); CrcGenerateTable(); } } g_ChunkTablesInit;
+
+static void SetUi64(Byte *p, UInt64 v) { for (unsigned i = 0; i < 8; i++) p[i] = (Byte)(v >> (8 * i)); }
+static void SetUi32(Byte *p, UInt32 v) { for (unsigned i = 0; i < 4; i++) p[i] = (Byte)(v >> (8 * i)); }
+static UInt64 GetUi64(const Byte *p) { UInt64 v = 0; for (unsigned i = 0; i < 8; i++) v |= (UInt64)p[i] << (8 * i); return v; }
+static UInt32 GetUi32(const Byte *p) { UInt32 v = 0; for (unsigned i = 0; i < 4; i++) v |= (UInt32)p[i] << (8 * i); return v; }
+
+struct CBufSeqInStream
+{
+  ISeqInStream vt;
+  const Byte *Data;
+  size_t Rem;
+};
+
+static SRes BufSeqInStream_Read(void *pp, void *buf, size_t *size)
+{
+  CBufSeqInStream *p = (CBufSeqInStream *)pp;
+  size_t cur = *size < p->Rem ? *size : p->Rem;
+  memcpy(buf, p->Data, cur);
+  p->Data += cur;
+  p->Rem -= cur;
+  *size = cur;
+  return SZ_OK;
+}
+
+struct CStdStringSeqOutStream
+{
+  ISeqOutStream vt;
+  std::string *Data;
+};
+
+static size_t StdStringSeqOutStream_Write(void *pp, const void *buf, size_t size)
+{
+  CStdStringSeqOutStream *p = (CStdStringSeqOutStream *)pp;
+  try
+  {
+    p->Data->append((const char *)buf, size);
+  }
+  catch(...)
+  {
+    return 0;
+  }
+  return size;
+}
+
+// random bytes, for salts
+void p7za_random(unsigned char *data, unsigned size)
+{
+  g_RandomGenerator.Generate(data, size);
+}
+
+// the key of a 7z AES-256 archive: SHA-256 of salt + UTF-16LE password, 2^numCyclesPower rounds
+int p7za_chunk_key(const char *passwd, const unsigned char *salt, unsigned saltSize, unsigned numCyclesPower, unsigned char *key)
+{
+  if (saltSize > NCrypto::N7z::kSaltSizeMax || numCyclesPower > 24)
+    return NExitCode::kFatalError;
+  try
+  {
+    const UString password = PasswordToUnicode(passwd);
+    NCrypto::N7z::CKeyInfo keyInfo;
+    keyInfo.NumCyclesPower = numCyclesPower;
+    keyInfo.SaltSize = saltSize;
+    memcpy(keyInfo.Salt, salt, saltSize);
+    keyInfo.Password.Alloc((size_t)password.Len() * 2);
+    for (unsigned i = 0; i < password.Len(); i++)
+    {
+      const wchar_t c = password[i];
+      keyInfo.Password[i * 2] = (Byte)c;
+      keyInfo.Password[i * 2 + 1] = (Byte)(c >> 8);
+    }
+    keyInfo.CalcKey();
+    memcpy(key, keyInfo.Key, NCrypto::N7z::kKeySize);
+    return NExitCode::kSuccess;
+  }
+  catch(...) {}
+  return NExitCode::kFatalError;
+}
+
+// size bytes of data into chunk, compressed with the 7z LZMA2 level 1 and encrypted with key
+int p7za_chunk_encode(const unsigned char *key, const char *data, size_t size, std::string &chunk)
+{
+  chunk.clear();
+  CLzma2EncHandle enc = Lzma2Enc_Create(&g_Alloc, &g_BigAlloc);
+  if (!enc)
+    return NExitCode::kMemoryError;
+  int ret = NExitCode::kFatalError;
+  try
+  {
+    CLzma2EncProps props;
+    Lzma2EncProps_Init(&props);
+    props.lzmaProps.level = 1;
+    props.lzmaProps.dictSize = 1 << 16;
+    props.lzmaProps.fb = 32;
+    props.numTotalThreads = 1;
+    if (Lzma2Enc_SetProps(enc, &props) == SZ_OK)
+    {
+      chunk.reserve(kChunkIvSize + kChunkHeaderSize + size / 2 + AES_BLOCK_SIZE);
+      chunk.resize(kChunkIvSize + kChunkHeaderSize);
+      CBufSeqInStream inStream = { { BufSeqInStream_Read }, (const Byte *)data, size };
+      CStdStringSeqOutStream outStream = { { StdStringSeqOutStream_Write }, &chunk };
+      if (Lzma2Enc_Encode(enc, &outStream.vt, &inStream.vt, NULL) == SZ_OK)
+      {
+        const size_t packSize = chunk.size() - kChunkIvSize - kChunkHeaderSize;
+        chunk.resize(kChunkIvSize + ((chunk.size() - kChunkIvSize + AES_BLOCK_SIZE - 1) & ~(size_t)(AES_BLOCK_SIZE - 1)), '\0');
+        Byte *p = (Byte *)&chunk[0];
+        g_RandomGenerator.Generate(p, kChunkIvSize);
+        Byte *header = p + kChunkIvSize;
+        SetUi64(header, size);
+        SetUi64(header + 8, packSize);
+        SetUi32(header + 16, CrcCalc(data, size));
+        header[20] = Lzma2Enc_WriteProperties(enc);
+
+        UInt32 aesBuf[AES_NUM_IVMRK_WORDS + 3];
+        UInt32 *aes = aesBuf + ((0 - (unsigned)((ptrdiff_t)aesBuf >> 2)) & 3); // 16 bytes aligned
+        Aes_SetKey_Enc(aes + 4, key, NCrypto::N7z::kKeySize);
+        AesCbc_Init(aes, p);
+        g_AesCbc_Encode(aes, header, (chunk.size() - kChunkIvSize) / AES_BLOCK_SIZE);
+        ret = NExitCode::kSuccess;
+      }
+    }
+  }
+  catch(...) {}
+  Lzma2Enc_Destroy(enc);
+  if (ret != NExitCode::kSuccess)
+    chunk.clear();
+  return ret;
+}
+
+// a chunk made by p7za_chunk_encode back into data, fails on a wrong key or a damaged chunk
+int p7za_chunk_decode(const unsigned char *key, const char *chunk, size_t chunkSize, std::string &data)
+{
+  data.clear();
+  if (chunkSize < kChunkIvSize + AES_BLOCK_SIZE * 2 || (chunkSize - kChunkIvSize) % AES_BLOCK_SIZE != 0)
+    return NExitCode::kFatalError;
+  try
+  {
+    std::string plain(chunk + kChunkIvSize, chunkSize - kChunkIvSize);
+    Byte *header = (Byte *)&plain[0];
+    UInt32 aesBuf[AES_NUM_IVMRK_WORDS + 3];
+    UInt32 *aes = aesBuf + ((0 - (unsigned)((ptrdiff_t)aesBuf >> 2)) & 3);
+    Aes_SetKey_Dec(aes + 4, key, NCrypto::N7z::kKeySize);
+    AesCbc_Init(aes, (const Byte *)chunk);
+    g_AesCbc_Decode(aes, header, plain.size() / AES_BLOCK_SIZE);
+
+    const UInt64 unpackSize = GetUi64(header);
+    const UInt64 packSize = GetUi64(header + 8);
+    const UInt32 crc = GetUi32(header + 16);
+    if (packSize > plain.size() - kChunkHeaderSize || header[20] > 40)
+      return NExitCode::kFatalError;
+    // no LZMA2 chunk unpacks more than 2 MiB out of less than 16 bytes
+    if (unpackSize > ((packSize + 1) << 17))
+      return NExitCode::kFatalError;
+
+    CLzma2Dec dec;
+    Lzma2Dec_Construct(&dec);
+    if (Lzma2Dec_Allocate(&dec, header[20], &g_Alloc) != SZ_OK)
+      return NExitCode::kMemoryError;
+    data.resize((size_t)unpackSize);
+    Lzma2Dec_Init(&dec);
+    SizeT destLen = (SizeT)unpackSize;
+    SizeT srcLen = (SizeT)packSize;
+    ELzmaStatus status;
+    const SRes res = Lzma2Dec_DecodeToBuf(&dec, unpackSize ? (Byte *)&data[0] : NULL, &destLen,
+        header + kChunkHeaderSize, &srcLen, LZMA_FINISH_END, &status);
+    Lzma2Dec_Free(&dec, &g_Alloc);
+    if (res == SZ_OK && status == LZMA_STATUS_FINISHED_WITH_MARK && destLen == unpackSize && CrcCalc(data.data(), data.size()) == crc)
+      return NExitCode::kSuccess;
+  }
+  catch(...) {}
+  data.clear();
+  return NExitCode::kFatalError;
+}
@@ -35,7 +35,36 @@
 class CtMainWin;
 class CtImporterInterface;
 struct ct_imported_node;
-struct TocEntry;
+
+struct TocEntry
+{
+    std::string anchor_link;
+    std::string text;
+    bool is_node = false;
+    unsigned int depth = 0;
+    unsigned int h_level = 0;
+    std::list<TocEntry> children;
+    TocEntry(std::string a_link, bool is_n, std::string txt, unsigned int dep, unsigned int h_lvl = 0)
+     : anchor_link(std::move(a_link))
+     , text(std::move(txt))
+     , is_node(is_n)
+     , depth(dep)
+     , h_level(h_lvl)
+    {}
+};
+
+/**
+ * @brief The headers of a node as table of contents entries, read from the storage through pReader if the buffer
+ * is not loaded; otherwise, or if an anchor is missing, from the buffer where the missing anchors are inserted
+ */
+TocEntry find_toc_entries(CtMainWin* pCtMainWin, CtStoredTextReader* pReader, CtTreeIter& node, unsigned depth);
+/**
+ * @brief The headers of a node from its stored content, without creating the text buffer: the lines starting
+ * with a scale h1..h9 text, up to the end of the line or the first widget
+ * @return false if a header is not yet followed by its anchor h<level>-<count>, so the buffer has to be updated
+ */
+bool find_toc_entries_from_stored(const CtDecodedNodeText& decoded_text, TocEntry& entry, const gint64 node_id);
+
 class CtActions
 {
 public:
@@ -120,7 +149,7 @@ public:
                                   bool set_first = false);
 
 private:
-    bool          _need_node_swap(Gtk::TreeIter& leftIter, Gtk::TreeIter& rightIter, bool ascendings);
+    bool          _node_siblings_sort(const Gtk::TreeNodeChildren& children, bool ascending);
     bool          _tree_sort_level_and_sublevels(const Gtk::TreeNodeChildren& children, bool ascending);
 
 public:
@@ -159,6 +188,9 @@ private:
     void                _find_in_all_nodes(bool for_current_node);
     bool                _parse_node_name(CtTreeIter node_iter, Glib::RefPtr<Glib::Regex> re_pattern, bool forward, bool all_matches);
     bool                _parse_given_node_content(CtTreeIter node_iter, Glib::RefPtr<Glib::Regex> re_pattern, bool forward, bool first_fromsel, bool all_matches);
+    bool                _find_all_in_stored_node(CtTreeIter tree_iter, Glib::RefPtr<Glib::Regex> re_pattern, bool forward);
+    void                _add_stored_matches(CtTreeIter tree_iter, std::vector<CtStoredMatch>& matches, bool forward);
+    void                _find_all_matches_in_nodes(Gtk::TreeIter node_iter, bool for_current_node, Glib::RefPtr<Glib::Regex> re_pattern, bool forward);
     bool                _parse_node_content_iter(const CtTreeIter& tree_iter, Glib::RefPtr<Gtk::TextBuffer> text_buffer, Glib::RefPtr<Glib::Regex> re_pattern,
                                                 bool forward, bool first_fromsel, bool all_matches, bool first_node);
     Gtk::TextIter       _get_inner_start_iter(Glib::RefPtr<Gtk::TextBuffer> text_buffer, bool forward, const gint64& node_id);
@@ -413,7 +445,7 @@ private:
 
     fs::path _get_pdf_filepath(const fs::path& proposed_name);
     fs::path _get_txt_filepath(const fs::path& dir_place, const fs::path& proposed_name);
-    fs::path _get_txt_folder(fs::path dir_place, fs::path new_folder, bool export_overwrite);
+    fs::path _get_txt_folder(fs::path dir_place, fs::path new_folder, bool export_overwrite, bool incremental = false);
 
 public:
     // export actions
@@ -425,8 +457,8 @@ public:
     void export_to_ctd();
 
     void export_to_pdf_auto(const std::string& dir, bool overwrite);
-    void export_to_html_auto(const std::string& dir, bool overwrite, bool single_file);
-    void export_to_txt_auto(const std::string& dir, bool overwrite, bool single_file);
+    void export_to_html_auto(const std::string& dir, bool overwrite, bool single_file, bool incremental = false);
+    void export_to_txt_auto(const std::string& dir, bool overwrite, bool single_file, bool incremental = false);
 
 private:
     // helpers for help actions
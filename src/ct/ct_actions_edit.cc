@@ -28,6 +28,7 @@
 #include "ct_logging.h"
 #include "ct_storage_control.h"
 #include <gtkmm/dialog.h>
+#include <limits>
 
 // Step Back for the Current Node, if Possible
 void CtActions::requested_step_back()
@@ -96,9 +97,9 @@ void CtActions::table_handle()
     if (res == CtDialogs::TableHandleResp::Cancel) return;
 
     const int col_width = _pCtMainWin->get_ct_config()->tableColWidthDefault;
-    std::list<std::vector<std::string>> rows;
+    std::vector<std::vector<Glib::ustring>> rows;
     if (res == CtDialogs::TableHandleResp::Ok) {
-        std::vector<std::string> empty_row(_pCtMainWin->get_ct_config()->tableColumns, "");
+        std::vector<Glib::ustring> empty_row(_pCtMainWin->get_ct_config()->tableColumns, "");
         while ((int)rows.size() < _pCtMainWin->get_ct_config()->tableRows) {
             rows.push_back(empty_row);
         }
@@ -118,15 +119,8 @@ void CtActions::table_handle()
     }
 
     if (!pCtTable) {
-        CtTableMatrix tableMatrix;
-        for (auto& row : rows) {
-            tableMatrix.push_back(CtTableRow{});
-            for (auto& cell : row) {
-                tableMatrix.back().push_back(new CtTextCell{_pCtMainWin, cell, CtConst::TABLE_CELL_TEXT_ID});
-            }
-        }
         pCtTable = new CtTable{_pCtMainWin,
-                               tableMatrix,
+                               CtTableMatrix{rows},
                                col_width,
                                _curr_buffer()->get_insert()->get_iter().get_offset(),
                                "",
@@ -239,23 +233,6 @@ void CtActions::anchor_handle()
     _anchor_edit_dialog(nullptr, _curr_buffer()->get_insert()->get_iter(), nullptr);
 }
 
-struct TocEntry
-{
-    std::string anchor_link;
-    std::string text;
-    bool is_node = false;
-    unsigned int depth = 0;
-    unsigned int h_level = 0;
-    std::list<TocEntry> children;
-    TocEntry(std::string a_link, bool is_n, std::string txt, unsigned int dep, unsigned int h_lvl = 0)
-     : anchor_link(std::move(a_link))
-     , text(std::move(txt))
-     , is_node(is_n)
-     , depth(dep)
-     , h_level(h_lvl)
-    {}
-};
-
 std::optional<Glib::ustring> iter_in_tag(const Gtk::TextIter& iter, const Glib::ustring& tag)
 {
     for (const auto& iter_tag : iter.get_tags()) {
@@ -269,10 +246,87 @@ std::optional<Glib::ustring> iter_in_tag(const Gtk::TextIter& iter, const Glib::
     return std::nullopt;
 }
 
-TocEntry find_toc_entries(CtActions& actions, CtTreeIter& node, unsigned depth)
+// the header level of a scale tag property value h1..h9, 0 if not a header
+int toc_header_level(const Glib::ustring& scale)
 {
-    int node_id = node.get_node_id();
+    if (scale.size() == 2 and scale[0] == 'h' and g_unichar_isdigit(scale[1])) {
+        return g_unichar_digit_value(scale[1]);
+    }
+    return 0;
+}
+
+bool find_toc_entries_from_stored(const CtDecodedNodeText& decoded_text, TocEntry& entry, const gint64 node_id)
+{
+    std::unordered_map<int, int> encountered_headers;
+    bool at_line_start{true};
+    int h_lvl{0};
+    Glib::ustring header_text;
+    // returns false if the header is not followed by its anchor
+    auto f_header_end = [&](const CtDecodedNodeText::Widget* pWidget) {
+        const std::string anchor_txt = fmt::format("h{}-{}", h_lvl, encountered_headers[h_lvl]);
+        const bool has_anchor = pWidget and CtAnchWidgType::ImageAnchor == pWidget->type and pWidget->text == anchor_txt;
+        entry.children.emplace_back(fmt::format("node {} {}", node_id, anchor_txt), false, header_text, entry.depth + 1, h_lvl);
+        h_lvl = 0;
+        header_text.clear();
+        return has_anchor;
+    };
+    const std::vector<CtDecodedNodeText::Widget>& widgets = decoded_text.widgets;
+    size_t widget_idx{0};
+    // the widgets up to the character text_pos of the runs, every widget takes one more character in the text buffer
+    auto f_widgets_up_to = [&](const int text_pos) {
+        for (; widget_idx < widgets.size() and widgets[widget_idx].offset - (int)widget_idx <= text_pos; ++widget_idx) {
+            if (h_lvl and not f_header_end(&widgets[widget_idx])) return false;
+            at_line_start = false;
+        }
+        return true;
+    };
+    int text_pos{0};
+    for (const CtDecodedNodeText::TextRun& run : decoded_text.runs) {
+        int scale_lvl{0};
+        for (const auto& tag_prop : run.tag_props) {
+            if (tag_prop.first == CtConst::TAG_SCALE) scale_lvl = toc_header_level(tag_prop.second);
+        }
+        for (const gunichar ch : run.text) {
+            if (not f_widgets_up_to(text_pos++)) return false;
+            if (at_line_start and scale_lvl) {
+                h_lvl = scale_lvl;
+                encountered_headers[h_lvl] += 1;
+            }
+            at_line_start = false;
+            if (ch == '\n') {
+                if (h_lvl and not f_header_end(nullptr)) return false;
+                at_line_start = true;
+            }
+            else if (h_lvl) {
+                header_text += ch;
+            }
+        }
+    }
+    if (not f_widgets_up_to(std::numeric_limits<int>::max())) return false;
+    return not h_lvl or f_header_end(nullptr);
+}
+
+TocEntry find_toc_entries(CtMainWin* pCtMainWin, CtStoredTextReader* pReader, CtTreeIter& node, unsigned depth)
+{
+    const gint64 node_id = node.get_node_id();
     TocEntry entry{fmt::format("node {}", node_id), true, node.get_node_name(), depth};
+    if (not node.get_node_is_rich_text()) {
+        return entry;
+    }
+    if (pReader and not node.get_node_buffer_already_loaded()) {
+        // the headers of the nodes not loaded are read from the storage, they are loaded only to add missing anchors
+        CtDecodedNodeText decoded_text;
+        decoded_text.with_pixbufs = false;
+        if (pReader->get_decoded_node_text(node_id, decoded_text) and
+            find_toc_entries_from_stored(decoded_text, entry, node_id))
+        {
+            return entry;
+        }
+        entry.children.clear();
+    }
+
+    const bool is_curr_node = node_id == pCtMainWin->curr_tree_iter().get_node_id();
+    bool node_modified{false};
     std::string scale_tag{"scale_"};
     std::unordered_map<int, int> encountered_headers;
     auto text_buffer = node.get_node_text_buffer();
@@ -280,60 +334,66 @@ TocEntry find_toc_entries(CtActions& actions, CtTreeIter& node, unsigned depth)
 
     do {
         std::optional<Glib::ustring> tag_name = iter_in_tag(text_iter, scale_tag);
-        if (tag_name and not Glib::str_has_suffix(tag_name.value(), CtConst::TAG_PROP_VAL_SMALL)) {
-            auto h_start = tag_name->find(scale_tag) + scale_tag.length() + 1;
-            auto begin = tag_name->begin();
-            std::advance(begin, h_start);
-            Glib::ustring h_level_str{begin, tag_name->end()};
-            try {
-                int h_lvl = std::stoi(h_level_str);
-                encountered_headers[h_lvl] += 1;
-
-                Gtk::TextIter start_iter{text_iter};
-                Gtk::TextIter end_iter{text_iter};
-                while (not start_iter.starts_line()) {
-                    if (not start_iter.backward_word_start()) break;
-                }
+        const int h_lvl = tag_name ? toc_header_level(tag_name->substr(scale_tag.size())) : 0;
+        if (h_lvl) {
+            encountered_headers[h_lvl] += 1;
+
+            Gtk::TextIter start_iter{text_iter};
+            Gtk::TextIter end_iter{text_iter};
+            while (not start_iter.starts_line()) {
+                if (not start_iter.backward_word_start()) break;
+            }
 
-                while (not end_iter.ends_line() and not end_iter.get_child_anchor()) {
-                    if (not end_iter.forward_char()) break;
-                }
+            while (not end_iter.ends_line() and not end_iter.get_child_anchor()) {
+                if (not end_iter.forward_char()) break;
+            }
 
-                Glib::ustring txt{start_iter, end_iter};
-                //spdlog::debug("{} - {}", txt, txt.size());
-
-                auto mark = text_buffer->create_mark(end_iter, false);
-
-                Glib::RefPtr<Gtk::TextChildAnchor> rChildAnchor = end_iter.get_child_anchor();
-                if (rChildAnchor) {
-                    CtAnchoredWidget* pCtAnchoredWidget = node.get_anchored_widget(rChildAnchor);
-                    if (pCtAnchoredWidget) {
-                        auto pCtImageAnchor = dynamic_cast<CtImageAnchor*>(pCtAnchoredWidget);
-                        static Glib::RefPtr<Glib::Regex> rRegExpAnchorName = Glib::Regex::create("h\\d+-\\d+");
-                        if (pCtImageAnchor and rRegExpAnchorName->match(pCtImageAnchor->get_anchor_name())) {
-                            const int endOffset = end_iter.get_offset();
-                            auto iter_bound = end_iter;
-                            iter_bound.forward_char();
-                            text_buffer->erase(end_iter, iter_bound);
-                            end_iter = text_buffer->get_iter_at_offset(endOffset);
-                        }
+            Glib::ustring txt{start_iter, end_iter};
+            //spdlog::debug("{} - {}", txt, txt.size());
+
+            auto mark = text_buffer->create_mark(end_iter, false);
+
+            const std::string anchor_txt = fmt::format("h{}-{}", h_lvl, encountered_headers[h_lvl]);
+            bool has_anchor{false};
+            Glib::RefPtr<Gtk::TextChildAnchor> rChildAnchor = end_iter.get_child_anchor();
+            if (rChildAnchor) {
+                CtAnchoredWidget* pCtAnchoredWidget = node.get_anchored_widget(rChildAnchor);
+                if (pCtAnchoredWidget) {
+                    auto pCtImageAnchor = dynamic_cast<CtImageAnchor*>(pCtAnchoredWidget);
+                    static Glib::RefPtr<Glib::Regex> rRegExpAnchorName = Glib::Regex::create("h\\d+-\\d+");
+                    if (pCtImageAnchor and pCtImageAnchor->get_anchor_name() == anchor_txt) {
+                        has_anchor = true;
+                    }
+                    // the anchor of a previous table of contents, renumbered since a header was added or removed
+                    // before this one: replaced rather than left next to the new one
+                    else if (pCtImageAnchor and rRegExpAnchorName->match(pCtImageAnchor->get_anchor_name())) {
+                        const int endOffset = end_iter.get_offset();
+                        auto iter_bound = end_iter;
+                        iter_bound.forward_char();
+                        text_buffer->erase(end_iter, iter_bound);
+                        end_iter = text_buffer->get_iter_at_offset(endOffset);
                     }
                 }
-                const std::string anchor_txt = fmt::format("h{}-{}", h_lvl, encountered_headers[h_lvl]);
-                actions.image_insert_anchor(end_iter, anchor_txt, "right");
-
-                text_iter = mark->get_iter();
-                text_buffer->delete_mark(mark);
-                //spdlog::debug("INSERT DONE");
-                entry.children.emplace_back(fmt::format("node {} {}", node_id, anchor_txt), false, txt, depth + 1, h_lvl);
             }
-            catch(std::invalid_argument&) {
-                spdlog::error("Could not convert [{}] to an integer", h_level_str);
+            if (not has_anchor) {
+                // into the buffer of the node, also if not the selected one
+                CtAnchoredWidget* pAnchoredWidget = new CtImageAnchor{pCtMainWin, anchor_txt, end_iter.get_offset(), "right"};
+                pAnchoredWidget->insertInTextBuffer(text_buffer);
+                pCtMainWin->get_tree_store().addAnchoredWidgets(node, {pAnchoredWidget}, is_curr_node ? &pCtMainWin->get_text_view() : nullptr);
+                node_modified = true;
             }
+
+            text_iter = mark->get_iter();
+            text_buffer->delete_mark(mark);
+            //spdlog::debug("INSERT DONE");
+            entry.children.emplace_back(fmt::format("node {} {}", node_id, anchor_txt), false, txt, depth + 1, h_lvl);
         }
 
     } while (text_iter.forward_line());
 
+    if (node_modified) {
+        pCtMainWin->update_window_save_needed(CtSaveNeededUpdType::nbuf, false/*new_machine_state*/, &node);
+    }
     return entry;
 }
 
@@ -372,18 +432,16 @@ void CtActions::_insert_toc_at_pos(Glib::RefPtr<Gtk::TextBuffer> text_buffer, co
 }
 
 void find_toc_entries_and_children(std::list<TocEntry>& entries,
-                                   CtActions& actions,
-                                   CtMainWin& main_win,
+                                   CtMainWin* pCtMainWin,
+                                   CtStoredTextReader* pReader,
                                    CtTreeIter& node,
                                    unsigned depth)
 {
-    main_win.get_tree_view().set_cursor_safe(node);
-    TocEntry entry = find_toc_entries(actions, node, depth);
-    entries.emplace_back(entry);
+    entries.push_back(find_toc_entries(pCtMainWin, pReader, node, depth));
 
     CtTreeIter child = node.first_child();
     while (child) {
-        find_toc_entries_and_children(entries, actions, main_win, child, depth + 1);
+        find_toc_entries_and_children(entries, pCtMainWin, pReader, child, depth + 1);
         ++child;
     }
 }
@@ -397,24 +455,22 @@ void CtActions::toc_insert()
 
     if (toc_type == CtExporting::NONE) return;
 
+    // the nodes are not selected, their headers are read from the storage unless already loaded
+    std::unique_ptr<CtStoredTextReader> pReader = _pCtMainWin->get_ct_storage()->create_stored_text_reader();
     std::list<TocEntry> entries;
     CtTreeIter curr_node = _pCtMainWin->curr_tree_iter();
     if (toc_type == CtExporting::CURRENT_NODE) {
-        auto txt_buff = curr_node.get_node_text_buffer();
-        _pCtMainWin->get_tree_view().set_cursor_safe(curr_node);
-
-        TocEntry entry = find_toc_entries(*this, curr_node, 0);
-        entries.emplace_back(std::move(entry));
+        entries.push_back(find_toc_entries(_pCtMainWin, pReader.get(), curr_node, 0));
     }
     else if (toc_type == CtExporting::CURRENT_NODE_AND_SUBNODES) {
-        find_toc_entries_and_children(entries, *this, *_pCtMainWin, curr_node, 0);
+        find_toc_entries_and_children(entries, _pCtMainWin, pReader.get(), curr_node, 0);
     }
     else if (toc_type == CtExporting::ALL_TREE) {
         CtTreeStore& tree_store = _pCtMainWin->get_tree_store();
         CtTreeIter top_node = tree_store.get_ct_iter_first();
         CtTreeIter sib = top_node;
         while (sib) {
-            find_toc_entries_and_children(entries, *this, *_pCtMainWin, sib, 0);
+            find_toc_entries_and_children(entries, _pCtMainWin, pReader.get(), sib, 0);
             ++sib;
         }
     }
@@ -423,8 +479,6 @@ void CtActions::toc_insert()
     }
 
     _insert_toc_at_pos(curr_node.get_node_text_buffer(), entries);
-
-    _pCtMainWin->get_tree_view().set_cursor_safe(curr_node);
 }
 
 // Insert Timestamp
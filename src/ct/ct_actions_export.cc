@@ -25,6 +25,7 @@
 #include "ct_export2pdf.h"
 #include "ct_export2html.h"
 #include "ct_export2txt.h"
+#include "ct_export_manifest.h"
 #include "ct_storage_control.h"
 #include <glib/gstdio.h>
 #include "ct_logging.h"
@@ -133,19 +134,21 @@ void CtActions::export_to_pdf_auto(const std::string& dir, bool overwrite)
     _export_print(true, dir, overwrite);
 }
 
-void CtActions::export_to_html_auto(const std::string& dir, bool overwrite, bool single_file)
+void CtActions::export_to_html_auto(const std::string& dir, bool overwrite, bool single_file, bool incremental)
 {
     spdlog::debug("html export to: {}", dir);
-    spdlog::debug("overwrite: {} single_file: {}", overwrite, single_file);
+    spdlog::debug("overwrite: {} single_file: {} incremental: {}", overwrite, single_file, incremental);
     _export_options.single_file = single_file;
+    _export_options.incremental = incremental;
     _export_to_html(dir, overwrite);
 }
 
-void CtActions::export_to_txt_auto(const std::string& dir, bool overwrite, bool single_file)
+void CtActions::export_to_txt_auto(const std::string& dir, bool overwrite, bool single_file, bool incremental)
 {
     spdlog::debug("txt export to: {}", dir);
-    spdlog::debug("overwrite: {} single_file: {}", overwrite, single_file);
+    spdlog::debug("overwrite: {} single_file: {} incremental: {}", overwrite, single_file, incremental);
     _export_options.single_file = single_file;
+    _export_options.incremental = incremental;
     _export_to_txt(dir, overwrite);
 }
 
@@ -235,6 +238,29 @@ void CtActions::_export_to_html(const fs::path& auto_path, bool auto_overwrite)
 
     CtExport2Html export2html(_pCtMainWin);
     fs::path ret_html_path;
+    auto f_export_multiple_html = [&](const bool all_tree) {
+        CtStatusBar& ctStatusBar = _pCtMainWin->get_status_bar();
+        ctStatusBar.progressBar.set_fraction(0);
+        ctStatusBar.progressBar.set_text("0");
+        ctStatusBar.progressBar.show();
+        ctStatusBar.stopButton.show();
+        ctStatusBar.set_progress_stop(false);
+        auto on_scope_exit = scope_guard([&](void*) {
+            ctStatusBar.progressBar.hide();
+            ctStatusBar.stopButton.hide();
+            ctStatusBar.set_progress_stop(false);
+        });
+        const bool completed = export2html.nodes_all_export_to_multiple_html(all_tree, _export_options, [&](size_t nodes_done, size_t nodes_total) {
+            ctStatusBar.progressBar.set_fraction(nodes_total > 0 ? double(nodes_done)/double(nodes_total) : 1.0);
+            ctStatusBar.progressBar.set_text(std::to_string(nodes_done) + "/" + std::to_string(nodes_total));
+            while (gtk_events_pending()) gtk_main_iteration();
+            return !ctStatusBar.is_progress_stop();
+        });
+        if (!completed) {
+            spdlog::debug("html export stopped");
+            ret_html_path.clear(); // the folder is incomplete, not to be opened
+        }
+    };
     if (export_type == CtExporting::CURRENT_NODE)
     {
         std::string folder_name = CtMiscUtil::get_node_hierarchical_name(_pCtMainWin->curr_tree_iter());
@@ -248,18 +274,18 @@ void CtActions::_export_to_html(const fs::path& auto_path, bool auto_overwrite)
             if (_export_options.single_file) {
                 export2html.nodes_all_export_to_single_html(false, _export_options);
             } else {
-                export2html.nodes_all_export_to_multiple_html(false, _export_options);
+                f_export_multiple_html(false);
             }
         }
     }
     else if (export_type == CtExporting::ALL_TREE)
     {
         fs::path folder_name = _pCtMainWin->get_ct_storage()->get_file_name();
-        if (export2html.prepare_html_folder(auto_path, folder_name, auto_overwrite, ret_html_path)) {
+        if (export2html.prepare_html_folder(auto_path, folder_name, auto_overwrite, ret_html_path, _export_options.incremental)) {
             if (_export_options.single_file) {
                 export2html.nodes_all_export_to_single_html(true, _export_options);
             } else {
-                export2html.nodes_all_export_to_multiple_html(true, _export_options);
+                f_export_multiple_html(true);
             }
         }
     }
@@ -326,7 +352,7 @@ void CtActions::_export_to_txt(const fs::path& auto_path, bool auto_overwrite)
         }
         else
         {
-            auto folder_path = _get_txt_folder(auto_path, _pCtMainWin->get_ct_storage()->get_file_name(), auto_overwrite);
+            auto folder_path = _get_txt_folder(auto_path, _pCtMainWin->get_ct_storage()->get_file_name(), auto_overwrite, _export_options.incremental);
             if (folder_path.empty()) return;
             CtExport2Txt(_pCtMainWin).nodes_all_export_to_txt(true, folder_path, "", _export_options);
         }
@@ -390,7 +416,7 @@ fs::path CtActions::_get_txt_filepath(const fs::path& dir_place, const fs::path&
     return filename;
 }
 
-fs::path CtActions::_get_txt_folder(fs::path dir_place, fs::path new_folder, bool export_overwrite)
+fs::path CtActions::_get_txt_folder(fs::path dir_place, fs::path new_folder, bool export_overwrite, bool incremental)
 {
     if (dir_place.empty())
     {
@@ -399,7 +425,8 @@ fs::path CtActions::_get_txt_folder(fs::path dir_place, fs::path new_folder, boo
             return "";
     }
     new_folder = CtMiscUtil::clean_from_chars_not_for_filename(new_folder.string()) + "_TXT";
-    new_folder = fs::prepare_export_folder(dir_place, new_folder, export_overwrite);
+    if (!incremental || !CtExportManifest::is_in_folder(dir_place / new_folder))
+        new_folder = fs::prepare_export_folder(dir_place, new_folder, export_overwrite);
     fs::path export_dir = dir_place / new_folder;
     g_mkdir_with_parents(export_dir.c_str(), 0777);
 
@@ -29,6 +29,10 @@
 #include "ct_image.h"
 #include "ct_dialogs.h"
 #include "ct_logging.h"
+#include "ct_storage_control.h"
+#include "ct_thread_pool.h"
+#include <atomic>
+#include <limits>
 
 void CtActions::_find_init()
 {
@@ -177,6 +181,12 @@ void CtActions::_find_in_all_nodes(bool for_current_node)
         _s_state.match_store->saved_path.clear();
     }
 
+    // with a literal pattern the text index tells which nodes cannot match, their buffers are not loaded
+    if (!_s_options.search_replace_dict_reg_exp) {
+        _s_state.candidate_node_ids = _pCtMainWin->get_ct_storage()->get_nodes_maybe_containing(pattern);
+    }
+    auto on_scope_exit = scope_guard([&](void*) { _s_state.candidate_node_ids.reset(); });
+
     std::string tree_expanded_collapsed_string = _pCtMainWin->get_tree_store().treeview_get_tree_expanded_collapsed_string(_pCtMainWin->get_tree_view());
     // searching start
     bool user_active_restore = _pCtMainWin->user_active();
@@ -192,34 +202,39 @@ void CtActions::_find_in_all_nodes(bool for_current_node)
         while (gtk_events_pending()) gtk_main_iteration();
     }
     std::time_t search_start_time = std::time(nullptr);
-    while (node_iter) {
-        _s_state.all_matches_first_in_node = true;
-        CtTreeIter ct_node_iter = _pCtMainWin->get_tree_store().to_ct_tree_iter(node_iter);
-        while (_parse_given_node_content(ct_node_iter, re_pattern, forward, first_fromsel, all_matches)) {
-            _s_state.matches_num += 1;
-            if (!all_matches ||  ctStatusBar.is_progress_stop()) break;
-        }
-        _s_state.processed_nodes += 1;
-        if (_s_state.matches_num == 1 && !all_matches) break;
-        if (for_current_node && !_s_state.from_find_iterated) break;
-        Gtk::TreeIter last_top_node_iter = node_iter; // we need this if we start from a node that is not in top level
-        if (forward) node_iter = ++node_iter;
-        else         node_iter = --node_iter;
-        if (!node_iter || for_current_node) break;
-        // code that, in case we start from a node that is not top level, climbs towards the top
-        while (!node_iter) {
-            node_iter = last_top_node_iter->parent();
-            if (node_iter) {
-                last_top_node_iter = node_iter;
-                // we do not check the parent on purpose, only the uncles in the proper direction
-                if (forward) node_iter = ++node_iter;
-                else         node_iter = --node_iter;
+    if (all_matches && !_s_state.replace_active) {
+        _find_all_matches_in_nodes(node_iter, for_current_node, re_pattern, forward);
+    }
+    else {
+        while (node_iter) {
+            _s_state.all_matches_first_in_node = true;
+            CtTreeIter ct_node_iter = _pCtMainWin->get_tree_store().to_ct_tree_iter(node_iter);
+            while (_parse_given_node_content(ct_node_iter, re_pattern, forward, first_fromsel, all_matches)) {
+                _s_state.matches_num += 1;
+                if (!all_matches ||  ctStatusBar.is_progress_stop()) break;
+            }
+            _s_state.processed_nodes += 1;
+            if (_s_state.matches_num == 1 && !all_matches) break;
+            if (for_current_node && !_s_state.from_find_iterated) break;
+            Gtk::TreeIter last_top_node_iter = node_iter; // we need this if we start from a node that is not in top level
+            if (forward) node_iter = ++node_iter;
+            else         node_iter = --node_iter;
+            if (!node_iter || for_current_node) break;
+            // code that, in case we start from a node that is not top level, climbs towards the top
+            while (!node_iter) {
+                node_iter = last_top_node_iter->parent();
+                if (node_iter) {
+                    last_top_node_iter = node_iter;
+                    // we do not check the parent on purpose, only the uncles in the proper direction
+                    if (forward) node_iter = ++node_iter;
+                    else         node_iter = --node_iter;
+                }
+                else break;
             }
-            else break;
+            if (ctStatusBar.is_progress_stop()) break;
+            if (all_matches)
+                _update_all_matches_progress();
         }
-        if (ctStatusBar.is_progress_stop()) break;
-        if (all_matches)
-            _update_all_matches_progress();
     }
     std::time_t search_end_time = std::time(nullptr);
     spdlog::debug("Search took {} sec", search_end_time - search_start_time);
@@ -458,17 +473,17 @@ bool CtActions::_parse_given_node_content(CtTreeIter node_iter,
                                           bool first_fromsel,
                                           bool all_matches)
 {
-    auto text_buffer = node_iter.get_node_text_buffer();
+    const bool may_match = !_s_state.candidate_node_ids || _s_state.candidate_node_ids->count(node_iter.get_node_id());
     if (!_s_state.first_useful_node) {
         // first_fromsel plus first_node not already parsed
         if (!_pCtMainWin->curr_tree_iter() || node_iter.get_node_id() == _pCtMainWin->curr_tree_iter().get_node_id()) {
             _s_state.first_useful_node = true; // a first_node was parsed
-            if (_parse_node_content_iter(node_iter, text_buffer, re_pattern, forward, first_fromsel, all_matches, true))
+            if (may_match && _parse_node_content_iter(node_iter, node_iter.get_node_text_buffer(), re_pattern, forward, first_fromsel, all_matches, true))
                 return true; // first_node node, first_fromsel
         }
     } else {
         // not first_fromsel or first_fromsel with first_node already parsed
-        if (_parse_node_content_iter(node_iter, text_buffer, re_pattern, forward, first_fromsel, all_matches, false))
+        if (may_match && _parse_node_content_iter(node_iter, node_iter.get_node_text_buffer(), re_pattern, forward, first_fromsel, all_matches, false))
             return true; // not first_node node
     }
     // check for children
@@ -491,6 +506,161 @@ bool CtActions::_parse_given_node_content(CtTreeIter node_iter,
     return false;
 }
 
+// Adds all the matches of a node from its stored content, returns False if the stored content is not available
+bool CtActions::_find_all_in_stored_node(CtTreeIter tree_iter, Glib::RefPtr<Glib::Regex> re_pattern, bool forward)
+{
+    CtStoredNodeText stored_text;
+    if (!_pCtMainWin->get_ct_storage()->get_stored_node_text(tree_iter.get_node_id(), stored_text)) return false;
+    if (!_is_node_within_time_filter(tree_iter)) return true;
+
+    std::vector<CtStoredMatch> matches = CtMiscUtil::find_all_in_stored_text(stored_text, re_pattern);
+    _add_stored_matches(tree_iter, matches, forward);
+    return true;
+}
+
+void CtActions::_add_stored_matches(CtTreeIter tree_iter, std::vector<CtStoredMatch>& matches, bool forward)
+{
+    if (matches.empty()) return;
+    if (!forward) std::reverse(matches.begin(), matches.end());
+    const gint64 node_id = tree_iter.get_node_id();
+    const std::string node_name = tree_iter.get_node_name();
+    const std::string node_hier_name = CtMiscUtil::get_node_hierarchical_name(tree_iter, " << ", false, false);
+    for (const CtStoredMatch& match : matches) {
+        _s_state.match_store->add_row(node_id, node_name, str::xml_escape(node_hier_name), match.start_offset, match.end_offset, match.line_num, match.line_content);
+    }
+    _s_state.matches_num += matches.size();
+}
+
+namespace {
+
+struct CtFindAllNodeResult
+{
+    size_t                     node_idx;
+    bool                       stored_text_read;
+    std::vector<CtStoredMatch> matches;
+};
+
+} // namespace (anonymous)
+
+// All the matches in the nodes, in the order of the tree. The stored content of the nodes whose buffer is not
+// loaded is searched by a pool of threads, each with its own storage reader, while the main thread adds
+// the matches to the store and searches the loaded buffers
+void CtActions::_find_all_matches_in_nodes(Gtk::TreeIter node_iter, bool for_current_node, Glib::RefPtr<Glib::Regex> re_pattern, bool forward)
+{
+    CtStatusBar& ctStatusBar = _pCtMainWin->get_status_bar();
+    CtTreeStore& ctTreeStore = _pCtMainWin->get_tree_store();
+
+    std::vector<CtTreeIter> nodes;          // in the order of the search
+    std::vector<bool> nodes_may_match;
+    std::vector<bool> nodes_to_workers;
+    std::vector<size_t> stored_node_idxs;   // to search by the workers
+    std::vector<gint64> stored_node_ids;    // the workers cannot access the tree store
+    std::function<void(Gtk::TreeIter)> f_add_node_and_children;
+    f_add_node_and_children = [&](Gtk::TreeIter tree_iter) {
+        CtTreeIter ct_tree_iter = ctTreeStore.to_ct_tree_iter(tree_iter);
+        const gint64 node_id = ct_tree_iter.get_node_id();
+        const bool may_match = (!_s_state.candidate_node_ids || _s_state.candidate_node_ids->count(node_id)) &&
+                               _is_node_within_time_filter(ct_tree_iter);
+        const bool to_workers = may_match && !ct_tree_iter.get_node_buffer_already_loaded();
+        if (to_workers) {
+            stored_node_idxs.push_back(nodes.size());
+            stored_node_ids.push_back(node_id);
+        }
+        nodes.push_back(ct_tree_iter);
+        nodes_may_match.push_back(may_match);
+        nodes_to_workers.push_back(to_workers);
+        if (!tree_iter->children().empty()) {
+            Gtk::TreeIter child_iter = forward ? tree_iter->children().begin() : --tree_iter->children().end();
+            while (child_iter) {
+                f_add_node_and_children(child_iter);
+                if (forward) child_iter = ++child_iter;
+                else         child_iter = --child_iter;
+            }
+        }
+    };
+    while (node_iter) {
+        f_add_node_and_children(node_iter);
+        if (for_current_node) break;
+        if (forward) node_iter = ++node_iter;
+        else         node_iter = --node_iter;
+    }
+
+    ThreadSafeDEQueue<CtFindAllNodeResult, std::numeric_limits<size_t>::max()> results_queue;
+    std::atomic<bool> workers_stop{false};
+    std::atomic<size_t> next_stored_idx{0};
+    size_t workers_num{0};
+    // the main thread does not help the pool while it is busy adding the results
+    CtThreadPool::TaskGroup workers_group;
+    auto on_scope_exit = scope_guard([&](void*) { workers_stop = true; }); // then the group waits for the workers
+    const size_t concur_num = std::min(CtThreadPool::get_instance().get_workers_num(), stored_node_idxs.size());
+    for (; workers_num < concur_num; ++workers_num) {
+        std::shared_ptr<CtStoredTextReader> pReader = _pCtMainWin->get_ct_storage()->create_stored_text_reader();
+        if (!pReader) break;
+        workers_group.run([&, pReader]() {
+            while (!workers_stop) {
+                const size_t stored_idx = next_stored_idx++;
+                if (stored_idx >= stored_node_idxs.size()) break;
+                CtFindAllNodeResult result{stored_node_idxs[stored_idx], false, {}};
+                try {
+                    CtStoredNodeText stored_text;
+                    if (pReader->get_stored_node_text(stored_node_ids[stored_idx], stored_text)) {
+                        result.matches = CtMiscUtil::find_all_in_stored_text(stored_text, re_pattern);
+                        result.stored_text_read = true;
+                    }
+                }
+                catch (std::exception& e) {
+                    // the main thread will search the node text buffer
+                    spdlog::error("find in stored node {}: {}", stored_node_ids[stored_idx], e.what());
+                }
+                results_queue.push_back(std::move(result));
+            }
+        });
+    }
+
+    std::map<size_t, CtFindAllNodeResult> results; // received from the workers, not added yet
+    for (size_t node_idx = 0; node_idx < nodes.size(); ++node_idx) {
+        CtTreeIter& tree_iter = nodes[node_idx];
+        bool node_searched{false};
+        if (!nodes_may_match[node_idx]) {
+            node_searched = true;
+        }
+        else if (nodes_to_workers[node_idx] && workers_num > 0) {
+            while (!results.count(node_idx) && !ctStatusBar.is_progress_stop()) {
+                if (std::optional<CtFindAllNodeResult> result = results_queue.pop_front_for(std::chrono::milliseconds{50})) {
+                    const size_t result_idx = result->node_idx;
+                    results.emplace(result_idx, std::move(*result));
+                }
+                else {
+                    while (gtk_events_pending()) gtk_main_iteration();
+                }
+            }
+            if (ctStatusBar.is_progress_stop()) break;
+            CtFindAllNodeResult node_result = std::move(results.extract(node_idx).mapped());
+            if (node_result.stored_text_read) {
+                _add_stored_matches(tree_iter, node_result.matches, forward);
+                node_searched = true;
+            }
+        }
+        else if (!tree_iter.get_node_buffer_already_loaded()) {
+            node_searched = _find_all_in_stored_node(tree_iter, re_pattern, forward);
+        }
+        if (!node_searched) {
+            _s_state.all_matches_first_in_node = true;
+            while (_parse_node_content_iter(tree_iter, tree_iter.get_node_text_buffer(), re_pattern, forward, false/*first_fromsel*/, true/*all_matches*/, false/*first_node*/)) {
+                _s_state.matches_num += 1;
+                if (ctStatusBar.is_progress_stop()) break;
+            }
+            // the matches are by offsets, the buffers searched can be released not to hold all the nodes at once
+            if (ctTreeStore.get_buffers_cache().is_over_budget()) {
+                ctTreeStore.get_buffers_cache().release_over_budget();
+            }
+        }
+        _s_state.processed_nodes += 1;
+        if (ctStatusBar.is_progress_stop()) break;
+        _update_all_matches_progress();
+    }
+}
+
 // Returns True if pattern was find, False otherwise
 bool CtActions::_parse_node_content_iter(const CtTreeIter& tree_iter,
                                          Glib::RefPtr<Gtk::TextBuffer> text_buffer,
@@ -718,9 +888,10 @@ Glib::ustring CtActions::_check_pattern_in_object(Glib::RefPtr<Glib::Regex> patt
         if (pattern->match(image->get_anchor_name())) return image->get_anchor_name();
     }
     else if (CtTable* table = dynamic_cast<CtTable*>(obj)) {
-        for (auto& row: table->get_table_matrix())
-            for (auto& col: row)
-                if (pattern->match(col->get_text_content()))
+        const CtTableMatrix& tableMatrix = table->get_table_matrix();
+        for (size_t row = 0; row < tableMatrix.get_rows_num(); ++row)
+            for (size_t col = 0; col < tableMatrix.get_cols_num(); ++col)
+                if (pattern->match(tableMatrix.get_cell(row, col)))
                     return "<table>";
     }
     else if (CtCodebox* codebox = dynamic_cast<CtCodebox*>(obj)) {
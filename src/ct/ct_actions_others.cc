@@ -647,12 +647,13 @@ void CtActions::table_row_cut()
 void CtActions::table_row_copy()
 {
     auto table_state = std::dynamic_pointer_cast<CtAnchoredWidgetState_Table>(curr_table_anchor->get_state());
-    // remove rows after current
-    while (table_state->rows.size() > curr_table_anchor->current_row() + 1)
-        table_state->rows.pop_back();
-    // remove rows between current and header
-    while (table_state->rows.size() > 2)
-        table_state->rows.erase(table_state->rows.begin() + 1);
+    // keep only the header and the current row
+    const CtTableMatrix& tableMatrix = curr_table_anchor->get_table_matrix();
+    const size_t currRow = curr_table_anchor->current_row();
+    std::vector<std::vector<Glib::ustring>> rows{tableMatrix.get_row(0)};
+    if (currRow > 0)
+        rows.push_back(tableMatrix.get_row(currRow));
+    table_state->tableMatrix = CtTableMatrix{rows};
     auto new_table = dynamic_cast<CtTable*>(table_state->to_widget(_pCtMainWin));
     CtClipboard{_pCtMainWin}.table_row_to_clipboard(new_table);
     delete new_table;
@@ -25,6 +25,8 @@
 #include "ct_image.h"
 #include "ct_dialogs.h"
 #include "ct_clipboard.h"
+#include "ct_storage_xml.h"
+#include "ct_storage_control.h"
 #include <ctime>
 #include <gtkmm/dialog.h>
 #include <gtkmm/stock.h>
@@ -101,33 +103,39 @@ bool CtActions::_node_sel_and_rich_text()
 void CtActions::node_subnodes_duplicate()
 {
     if (!_is_there_selected_node_or_error()) return;
-    Gtk::TreeIter top_iter = _pCtMainWin->curr_tree_iter();
-    // create duplicate of the selected node
-    _node_add(true, false);
-    Gtk::TreeIter new_top_iter = _pCtMainWin->curr_tree_iter();
-
-    // function to duplicate a node
-    auto duplicate_subnode = [&](CtTreeIter old_iter, Gtk::TreeIter new_parent) {
+    CtTreeStore& ctTreeStore = _pCtMainWin->get_tree_store();
+    CtTreeIter top_iter = _pCtMainWin->curr_tree_iter();
+
+    // the content of the nodes not loaded is copied from the storage and their buffers are created only
+    // when requested; the ids come from a counter and the new nodes are registered all at once
+    std::unique_ptr<CtStoredTextReader> pReader = _pCtMainWin->get_ct_storage()->create_stored_text_reader();
+    gint64 next_node_id = ctTreeStore.node_id_get();
+    const time_t timestamp = std::time(nullptr);
+    std::vector<gint64> new_node_ids;
+
+    // function to duplicate a node, after old_iter or as last child of new_parent
+    auto duplicate_node = [&](CtTreeIter old_iter, Gtk::TreeIter new_parent, const bool as_sibling) {
         CtNodeData node_data;
-        std::shared_ptr<CtNodeState> node_state;
-        _pCtMainWin->get_tree_store().get_node_data(old_iter, node_data);
-        if (node_data.syntax != CtConst::RICH_TEXT_ID) {
-            node_data.rTextBuffer = _pCtMainWin->get_new_text_buffer(node_data.rTextBuffer->get_text());
-            node_data.anchoredWidgets.clear();
-        } else {
-            _pCtMainWin->get_state_machine().update_state(old_iter);
-            node_state = _pCtMainWin->get_state_machine().requested_state_current(old_iter.get_node_id());
-            node_data.anchoredWidgets.clear();
-            node_data.rTextBuffer = _pCtMainWin->get_new_text_buffer();
+        ctTreeStore.get_node_data(old_iter, node_data, false/*loadTextBuffer*/);
+        CtDecodedNodeText decoded_text;
+        if (node_data.rTextBuffer or not pReader or not pReader->get_decoded_node_text(node_data.nodeId, decoded_text)) {
+            // the buffer in memory may differ from the storage, or the node is new
+            xmlpp::Document xml_doc;
+            xmlpp::Element* p_node_node = CtStorageXmlHelper{_pCtMainWin}.node_to_xml(&old_iter, xml_doc.create_root_node("root"),
+                                                                                     true/*with_widgets*/, nullptr/*storage_cache*/);
+            decoded_text = CtDecodedNodeText{};
+            CtStorageXmlHelper::get_decoded_text_from_xml(p_node_node, decoded_text);
         }
-        node_data.tsCreation = std::time(nullptr);
-        node_data.tsLastSave = node_data.tsCreation;
-        node_data.nodeId = _pCtMainWin->get_tree_store().node_id_get();
-        auto new_iter = _pCtMainWin->get_tree_store().append_node(&node_data, &new_parent /* as parent */);
-        if (node_state)
-           _pCtMainWin->load_buffer_from_state(node_state, _pCtMainWin->get_tree_store().to_ct_tree_iter(new_iter));
-
-        _pCtMainWin->get_tree_store().to_ct_tree_iter(new_iter).pending_new_db_node();
+        decoded_text.is_sqlite_rows = false; // the images are not rows of the new node
+        node_data.rTextBuffer.reset();
+        node_data.anchoredWidgets.clear();
+        node_data.tsCreation = timestamp;
+        node_data.tsLastSave = timestamp;
+        node_data.nodeId = next_node_id++;
+        Gtk::TreeIter new_iter = as_sibling ? ctTreeStore.insert_node(&node_data, old_iter /* after */) :
+                                              ctTreeStore.append_node(&node_data, &new_parent /* as parent */);
+        ctTreeStore.set_node_cloned_text(node_data.nodeId, std::move(decoded_text));
+        new_node_ids.push_back(node_data.nodeId);
         return new_iter;
     };
 
@@ -135,13 +143,16 @@ void CtActions::node_subnodes_duplicate()
     std::function<void(Gtk::TreeIter, Gtk::TreeIter)> duplicate_subnodes;
     duplicate_subnodes = [&](Gtk::TreeIter old_parent, Gtk::TreeIter new_parent) {
         for (auto child: old_parent->children()) {
-            auto new_child = duplicate_subnode(_pCtMainWin->get_tree_store().to_ct_tree_iter(child), new_parent);
+            auto new_child = duplicate_node(ctTreeStore.to_ct_tree_iter(child), new_parent, false/*as_sibling*/);
             duplicate_subnodes(child, new_child);
         }
     };
+    Gtk::TreeIter new_top_iter = duplicate_node(top_iter, Gtk::TreeIter{}, true/*as_sibling*/);
     duplicate_subnodes(top_iter, new_top_iter);
 
-    _pCtMainWin->get_tree_store().nodes_sequences_fix(new_top_iter->parent(), true);
+    _pCtMainWin->get_ct_storage()->pending_new_db_nodes(new_node_ids);
+    ctTreeStore.nodes_sequences_fix(new_top_iter->parent(), true);
+    _pCtMainWin->update_window_save_needed();
     _pCtMainWin->get_tree_view().set_cursor_safe(top_iter);     // this line fixes glich with text_buffer with widgets caused by the next line
     _pCtMainWin->get_tree_view().set_cursor_safe(new_top_iter);
     _pCtMainWin->get_text_view().grab_focus();
@@ -237,8 +248,9 @@ void CtActions::node_move_after(Gtk::TreeIter iter_to_move, Gtk::TreeIter father
     // we move also all the children
     std::function<void(Gtk::TreeIter&,Gtk::TreeIter&)> node_move_data_and_children;
     node_move_data_and_children = [this, &node_move_data_and_children](Gtk::TreeIter& old_iter,Gtk::TreeIter& new_iter) {
+        // the buffers not loaded stay so, they are read from the storage by node id
         CtNodeData node_data;
-        _pCtMainWin->get_tree_store().get_node_data(old_iter, node_data);
+        _pCtMainWin->get_tree_store().get_node_data(old_iter, node_data, false/*loadTextBuffer*/);
         _pCtMainWin->get_tree_store().update_node_data(new_iter, node_data);
         for (Gtk::TreeIter child: old_iter->children()) {
             Gtk::TreeIter new_child = _pCtMainWin->get_tree_store().get_store()->append(new_iter->children());
@@ -263,24 +275,22 @@ void CtActions::node_move_after(Gtk::TreeIter iter_to_move, Gtk::TreeIter father
     _pCtMainWin->update_window_save_needed();
 }
 
-bool CtActions::_need_node_swap(Gtk::TreeIter& leftIter, Gtk::TreeIter& rightIter, bool ascending)
+bool CtActions::_node_siblings_sort(const Gtk::TreeNodeChildren& children, bool ascending)
 {
-    Glib::ustring left_node_name = _pCtMainWin->get_tree_store().to_ct_tree_iter(leftIter).get_node_name().lowercase();
-    Glib::ustring right_node_name = _pCtMainWin->get_tree_store().to_ct_tree_iter(rightIter).get_node_name().lowercase();
-    //int cmp = left_node_name.compare(right_node_name);
-    int cmp = CtStrUtil::natural_compare(left_node_name, right_node_name);
-
-    return ascending ? cmp > 0 : cmp < 0;
+    // the lowercase names computed once per node, not at every comparison
+    auto get_sort_key = [this](const Gtk::TreeIter& iter) {
+        return _pCtMainWin->get_tree_store().to_ct_tree_iter(iter).get_node_name().lowercase();
+    };
+    return CtMiscUtil::node_siblings_sort(_pCtMainWin->get_tree_store().get_store(), children, get_sort_key, CtStrUtil::natural_compare, ascending);
 }
 
 bool CtActions::_tree_sort_level_and_sublevels(const Gtk::TreeNodeChildren& children, bool ascending)
 {
-    auto need_swap = [this,&ascending](Gtk::TreeIter& l, Gtk::TreeIter& r) { return _need_node_swap(l, r, ascending); };
-    bool swap_excecuted = CtMiscUtil::node_siblings_sort_iteration(_pCtMainWin->get_tree_store().get_store(), children, need_swap);
+    bool order_changed = _node_siblings_sort(children, ascending);
     for (auto& child: children)
         if (_tree_sort_level_and_sublevels(child.children(), ascending))
-            swap_excecuted = true;
-    return swap_excecuted;
+            order_changed = true;
+    return order_changed;
 }
 
 void CtActions::node_edit()
@@ -618,8 +628,7 @@ void CtActions::node_siblings_sort_ascending()
     if (!_is_there_selected_node_or_error()) return;
     Gtk::TreeIter father_iter = _pCtMainWin->curr_tree_iter()->parent();
     const Gtk::TreeNodeChildren& children = father_iter ? father_iter->children() : _pCtMainWin->get_tree_store().get_store()->children();
-    auto need_swap = [this](Gtk::TreeIter& l, Gtk::TreeIter& r) { return _need_node_swap(l, r, true); };
-    if (CtMiscUtil::node_siblings_sort_iteration(_pCtMainWin->get_tree_store().get_store(), children, need_swap)) {
+    if (_node_siblings_sort(children, true)) {
         _pCtMainWin->get_tree_store().nodes_sequences_fix(father_iter, true);
         _pCtMainWin->update_window_save_needed();
     }
@@ -631,8 +640,7 @@ void CtActions::node_siblings_sort_descending()
     if (!_is_there_selected_node_or_error()) return;
     Gtk::TreeIter father_iter = _pCtMainWin->curr_tree_iter()->parent();
     const Gtk::TreeNodeChildren& children = father_iter ? father_iter->children() : _pCtMainWin->get_tree_store().get_store()->children();
-    auto need_swap = [this](Gtk::TreeIter& l, Gtk::TreeIter& r) { return _need_node_swap(l, r, false); };
-    if (CtMiscUtil::node_siblings_sort_iteration(_pCtMainWin->get_tree_store().get_store(), children, need_swap)) {
+    if (_node_siblings_sort(children, false)) {
         _pCtMainWin->get_tree_store().nodes_sequences_fix(father_iter, true);
         _pCtMainWin->update_window_save_needed();
     }
@@ -203,10 +203,10 @@ void CtApp::on_open(const Gio::Application::type_vec_files& files, const Glib::u
             if (pWin->file_open(canonicalPath, "")) {
                 try {
                     if (not _export_to_txt_dir.empty()) {
-                        pWin->get_ct_actions()->export_to_txt_auto(_export_to_txt_dir, _export_overwrite, _export_single_file);
+                        pWin->get_ct_actions()->export_to_txt_auto(_export_to_txt_dir, _export_overwrite, _export_single_file, _export_incremental);
                     }
                     if (not _export_to_html_dir.empty()) {
-                        pWin->get_ct_actions()->export_to_html_auto(_export_to_html_dir, _export_overwrite, _export_single_file);
+                        pWin->get_ct_actions()->export_to_html_auto(_export_to_html_dir, _export_overwrite, _export_single_file, _export_incremental);
                     }
                     if (not _export_to_pdf_dir.empty()) {
                         pWin->get_ct_actions()->export_to_pdf_auto(_export_to_pdf_dir, _export_overwrite);
@@ -328,6 +328,8 @@ bool CtApp::_quit_or_hide_window(CtMainWin* pCtMainWin, const bool from_delete,
             pCtMainWin->force_exit() = false;
             return false;  // stop deleting window
         }
+        pCtMainWin->get_tree_store().get_nodes_prefetcher().reset();
+        pCtMainWin->get_ct_storage()->compact_on_close();
     }
     else {
         // It's too dangerous to try and save the document while being killed
@@ -386,6 +388,7 @@ void CtApp::_add_main_option_entries()
     add_main_option_entry(Gio::Application::OPTION_TYPE_FILENAME, "export_to_pdf_dir",  'p', _("Export to PDF at specified directory path"));
     add_main_option_entry(Gio::Application::OPTION_TYPE_BOOL,     "export_overwrite",   'w', _("Overwrite if export path already exists"));
     add_main_option_entry(Gio::Application::OPTION_TYPE_BOOL,     "export_single_file", 's', _("Export to a single file (for HTML or TXT)"));
+    add_main_option_entry(Gio::Application::OPTION_TYPE_BOOL,     "export_incremental", 'i', _("Update a previous export at the same path, rewriting only the changed nodes (for HTML or TXT multiple files)"));
     add_main_option_entry(Gio::Application::OPTION_TYPE_BOOL,     "new-window",         'N', _("Create a new window"));
 }
 
@@ -417,6 +420,7 @@ int CtApp::_on_handle_local_options(const Glib::RefPtr<Glib::VariantDict>& rOpti
     rOptions->lookup_value("export_to_pdf_dir", _export_to_pdf_dir);
     rOptions->lookup_value("export_overwrite", _export_overwrite);
     rOptions->lookup_value("export_single_file", _export_single_file);
+    rOptions->lookup_value("export_incremental", _export_incremental);
     rOptions->lookup_value("new-window", new_window);
 
     if (new_window) {
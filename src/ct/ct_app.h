@@ -61,6 +61,7 @@ protected:
     std::string   _export_to_pdf_dir;
     bool          _export_overwrite{false};
     bool          _export_single_file{false};
+    bool          _export_incremental{false};
     bool          _new_window{false};
     bool          _initDone{false};
     bool          _no_gui{false};
@@ -593,20 +593,14 @@ void CtClipboard::_on_received_to_table(const Gtk::SelectionData& selection_data
             static_cast<xmlpp::Element*>(parser.get_document()->get_root_node()->get_first_child("table")),
             tableColWidths);
 
-        int col_num = (int)parentTable->get_table_matrix()[0].size();
         int insert_after = parentTable->current_row() - 1;
         if (insert_after < 0) insert_after = 0;
-        for (int row = 1 /*skip header*/; row < (int)tableMatrix.size(); ++row)
+        for (size_t row = 1 /*skip header*/; row < tableMatrix.get_rows_num(); ++row)
         {
-            std::vector<Glib::ustring> new_row;
-            std::transform(tableMatrix[row].begin(), tableMatrix[row].end(), std::back_inserter(new_row), [](CtTextCell* cell) { return cell->get_text_content(); });
-            while ((int)new_row.size() > col_num) new_row.pop_back();
-            while ((int)new_row.size() < col_num) new_row.push_back("");
+            // the cells beyond the columns of the table are dropped, the missing ones are empty
+            const std::vector<Glib::ustring> new_row = tableMatrix.get_row(row);
             parentTable->row_add(insert_after + (row-1), &new_row);
         }
-        for (auto row: tableMatrix)
-            for (auto cell: row)
-                delete cell;
         _pCtMainWin->update_window_save_needed(CtSaveNeededUpdType::nbuf, true /*new_machine_state*/);
     }
     else
@@ -208,33 +208,20 @@ void CtCodebox::to_xml(xmlpp::Element* p_node_parent, const int offset_adjustmen
     p_codebox_node->add_child_text(get_text_content());
 }
 
-bool CtCodebox::to_sqlite(sqlite3* pDb, const gint64 node_id, const int offset_adjustment, CtStorageCache*)
+bool CtCodebox::to_sqlite(CtSqliteStmtCache& stmtCache, const gint64 node_id, const int offset_adjustment, CtStorageCache*)
 {
-    bool retVal{true};
-    sqlite3_stmt *p_stmt;
-    if (sqlite3_prepare_v2(pDb, CtStorageSqlite::TABLE_CODEBOX_INSERT, -1, &p_stmt, nullptr) != SQLITE_OK) {
-        spdlog::error("{}: {}", CtStorageSqlite::ERR_SQLITE_PREPV2, sqlite3_errmsg(pDb));
-        retVal = false;
-    }
-    else {
-        const std::string codebox_txt = get_text_content();
-        sqlite3_bind_int64(p_stmt, 1, node_id);
-        sqlite3_bind_int64(p_stmt, 2, _charOffset+offset_adjustment);
-        sqlite3_bind_text(p_stmt, 3, _justification.c_str(), _justification.size(), SQLITE_STATIC);
-        sqlite3_bind_text(p_stmt, 4, codebox_txt.c_str(), codebox_txt.size(), SQLITE_STATIC);
-        sqlite3_bind_text(p_stmt, 5, _syntaxHighlighting.c_str(), _syntaxHighlighting.size(), SQLITE_STATIC);
-        sqlite3_bind_int64(p_stmt, 6, _frameWidth);
-        sqlite3_bind_int64(p_stmt, 7, _frameHeight);
-        sqlite3_bind_int64(p_stmt, 8, _widthInPixels);
-        sqlite3_bind_int64(p_stmt, 9, _highlightBrackets);
-        sqlite3_bind_int64(p_stmt, 10, _showLineNumbers);
-        if (sqlite3_step(p_stmt) != SQLITE_DONE) {
-            spdlog::error("{}: {}", CtStorageSqlite::ERR_SQLITE_STEP, sqlite3_errmsg(pDb));
-            retVal = false;
-        }
-        sqlite3_finalize(p_stmt);
-    }
-    return retVal;
+    CtDecodedNodeText::Widget widget;
+    widget.type = CtAnchWidgType::CodeBox;
+    widget.offset = _charOffset+offset_adjustment;
+    widget.justification = _justification;
+    widget.text = get_text_content();
+    widget.syntax = _syntaxHighlighting;
+    widget.frame_width = _frameWidth;
+    widget.frame_height = _frameHeight;
+    widget.width_in_pixels = _widthInPixels;
+    widget.highlight_brackets = _highlightBrackets;
+    widget.show_line_numbers = _showLineNumbers;
+    return CtStorageSqlite::write_widget_row(stmtCache, node_id, widget);
 }
 
 std::shared_ptr<CtAnchoredWidgetState> CtCodebox::get_state()
@@ -242,6 +229,12 @@ std::shared_ptr<CtAnchoredWidgetState> CtCodebox::get_state()
     return std::shared_ptr<CtAnchoredWidgetState>(new CtAnchoredWidgetState_Codebox(this));
 }
 
+size_t CtCodebox::get_memory_size()
+{
+    // the source view with its scrolled window and gutter weigh as a few widgets
+    return 4u*CtAnchoredWidget::get_memory_size() + get_text_buffer_memory_size(_rTextBuffer);
+}
+
 void CtCodebox::set_show_line_numbers(const bool showLineNumbers)
 {
     _showLineNumbers = showLineNumbers;
@@ -346,6 +346,10 @@ void CtConfig::_populate_keyfile_from_data()
     _uKeyFile->set_boolean(_currentGroup, "enable_custom_backup_dir", customBackupDirOn);
     _uKeyFile->set_string(_currentGroup, "custom_backup_dir", customBackupDir);
     _uKeyFile->set_integer(_currentGroup, "limit_undoable_steps", limitUndoableSteps);
+    _uKeyFile->set_integer(_currentGroup, "nodes_memory_budget_mb", nodesMemoryBudgetMB);
+    _uKeyFile->set_string(_currentGroup, "sqlite_journal_mode", sqliteJournalMode);
+    _uKeyFile->set_boolean(_currentGroup, "xml_journal_on", xmlJournalOn);
+    _uKeyFile->set_boolean(_currentGroup, "protected_chunked_on", protectedChunkedOn);
 
     // [keyboard]
     _currentGroup = "keyboard";
@@ -645,6 +649,10 @@ void CtConfig::_populate_data_from_keyfile()
     _populate_bool_from_keyfile("enable_custom_backup_dir", &customBackupDirOn);
     _populate_string_from_keyfile("custom_backup_dir", &customBackupDir);
     _populate_int_from_keyfile("limit_undoable_steps", &limitUndoableSteps);
+    _populate_int_from_keyfile("nodes_memory_budget_mb", &nodesMemoryBudgetMB);
+    _populate_string_from_keyfile("sqlite_journal_mode", &sqliteJournalMode);
+    _populate_bool_from_keyfile("xml_journal_on", &xmlJournalOn);
+    _populate_bool_from_keyfile("protected_chunked_on", &protectedChunkedOn);
 
     // [keyboard]
     _currentGroup = "keyboard";
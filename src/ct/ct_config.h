@@ -113,7 +113,7 @@ public:
     bool                                        ptHighlMatchBra{true};
     int                                         spaceAroundLines{0};
     int                                         relativeWrappedSpace{50};
-    Glib::ustring                               hRule{"~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~"};
+    Glib::ustring                               hRule{CtConst::H_RULE_DEFAULT};
     CtStringSplittable                          specialChars{CtConst::SPECIAL_CHARS_DEFAULT};
     Glib::ustring                               lastSpecialChar{};
     CtStringSplittable                          selwordChars{CtConst::SELWORD_CHARS_DEFAULT};
@@ -205,6 +205,7 @@ public:
     bool                                        wordCountOn{false};
     bool                                        reloadDocLast{true};
     bool                                        winTitleShowDocDir{true};
+    int                                         nodesMemoryBudgetMB{1024}; // loaded nodes text beyond which the unmodified ones are released, 0 for no limit
     bool                                        modTimeSentinel{false};
     bool                                        backupCopy{true};
     int                                         backupNum{3};
@@ -212,6 +213,9 @@ public:
     bool                                        customBackupDirOn{false};
     std::string                                 customBackupDir{""};
     int                                         limitUndoableSteps{20};
+    std::string                                 sqliteJournalMode{"DELETE"}; // DELETE, TRUNCATE, PERSIST, MEMORY or WAL
+    bool                                        xmlJournalOn{false};
+    bool                                        protectedChunkedOn{false}; // protected xml documents saved as chunks
     bool                                        usePandoc{true}; // Whether to use Pandoc for exporting
 
     // [keyboard]
@@ -81,6 +81,7 @@ const inline static Glib::ustring CHARS_TOC_DEFAULT          {"▸•◇▪"};
 const inline static Glib::ustring CHARS_TODO_DEFAULT         {"☐☑☒"};
 const inline static Glib::ustring CHARS_SMART_DQUOTE_DEFAULT {"“”"};
 const inline static Glib::ustring CHARS_SMART_SQUOTE_DEFAULT {"‘’"};
+const inline static Glib::ustring H_RULE_DEFAULT             {"~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~"};
 
 const inline static gchar* COLOR_48_LINK_WEBS     {"#00008989ffff"};
 const inline static gchar* COLOR_48_LINK_NODE     {"#071c838e071c"};
@@ -146,21 +146,15 @@ void CtDialogs::bookmarks_handle_dialog(CtMainWin* pCtMainWin)
     });
     button_sort_asc.signal_clicked().connect([&rModel]()
     {
-        auto need_swap = [&rModel](Gtk::TreeIter& l, Gtk::TreeIter& r)
-        {
-            int cmp = l->get_value(rModel->columns.desc).compare(r->get_value(rModel->columns.desc));
-            return (cmp > 0);
-        };
-        CtMiscUtil::node_siblings_sort_iteration(rModel, rModel->children(), need_swap);
+        auto get_sort_key = [&rModel](const Gtk::TreeIter& iter) { return iter->get_value(rModel->columns.desc); };
+        auto compare = [](const Glib::ustring& l, const Glib::ustring& r) { return l.compare(r); };
+        CtMiscUtil::node_siblings_sort(rModel, rModel->children(), get_sort_key, compare, true);
     });
     button_sort_desc.signal_clicked().connect([&rModel]()
     {
-        auto need_swap = [&rModel](Gtk::TreeIter& l, Gtk::TreeIter& r)
-        {
-            int cmp = l->get_value(rModel->columns.desc).compare(r->get_value(rModel->columns.desc));
-            return (cmp < 0);
-        };
-        CtMiscUtil::node_siblings_sort_iteration(rModel, rModel->children(), need_swap);
+        auto get_sort_key = [&rModel](const Gtk::TreeIter& iter) { return iter->get_value(rModel->columns.desc); };
+        auto compare = [](const Glib::ustring& l, const Glib::ustring& r) { return l.compare(r); };
+        CtMiscUtil::node_siblings_sort(rModel, rModel->children(), get_sort_key, compare, false);
     });
 
     if (dialog.run() != Gtk::RESPONSE_ACCEPT)
@@ -511,6 +505,46 @@ void CtDialogs::summary_info_dialog(CtMainWin* pCtMainWin, const CtSummaryInfo&
     grid.attach(label_an_key, 0, 7, 1, 1);
     Gtk::Label label_an_val{std::to_string(summaryInfo.anchors_num)};
     grid.attach(label_an_val, 1, 7, 1, 1);
+    Gtk::Label label_wo_key;
+    label_wo_key.set_markup(Glib::ustring{"<b>"} + _("Number of Words") + "</b>");
+    grid.attach(label_wo_key, 0, 8, 1, 1);
+    Gtk::Label label_wo_val{std::to_string(summaryInfo.text_stats.words)};
+    grid.attach(label_wo_val, 1, 8, 1, 1);
+    Gtk::Label label_ch_key;
+    label_ch_key.set_markup(Glib::ustring{"<b>"} + _("Number of Characters") + "</b>");
+    grid.attach(label_ch_key, 0, 9, 1, 1);
+    Gtk::Label label_ch_val{std::to_string(summaryInfo.text_stats.chars)};
+    grid.attach(label_ch_val, 1, 9, 1, 1);
+    Gtk::Label label_li_key;
+    label_li_key.set_markup(Glib::ustring{"<b>"} + _("Number of Lines") + "</b>");
+    grid.attach(label_li_key, 0, 10, 1, 1);
+    Gtk::Label label_li_val{std::to_string(summaryInfo.text_stats.lines)};
+    grid.attach(label_li_val, 1, 10, 1, 1);
+    auto f_num_n_size = [](const size_t num, const size_t size)->Glib::ustring{
+        g_autofree gchar* pSize = g_format_size(size);
+        return std::to_string(num) + " (" + pSize + ")";
+    };
+    Gtk::Label label_lo_key;
+    label_lo_key.set_markup(Glib::ustring{"<b>"} + _("Loaded Nodes in Memory") + "</b>");
+    grid.attach(label_lo_key, 0, 11, 1, 1);
+    Gtk::Label label_lo_val{f_num_n_size(summaryInfo.loaded_num, summaryInfo.loaded_size)};
+    grid.attach(label_lo_val, 1, 11, 1, 1);
+    Gtk::Label label_rl_key;
+    label_rl_key.set_markup(Glib::ustring{"<b>"} + _("Loaded Nodes Releasable") + "</b>");
+    grid.attach(label_rl_key, 0, 12, 1, 1);
+    Gtk::Label label_rl_val{f_num_n_size(summaryInfo.releasable_num, summaryInfo.releasable_size)};
+    grid.attach(label_rl_val, 1, 12, 1, 1);
+    Gtk::Label label_rd_key;
+    label_rd_key.set_markup(Glib::ustring{"<b>"} + _("Nodes Released") + "</b>");
+    grid.attach(label_rd_key, 0, 13, 1, 1);
+    Gtk::Label label_rd_val{std::to_string(summaryInfo.released_num)};
+    grid.attach(label_rd_val, 1, 13, 1, 1);
+    Gtk::Label label_mb_key;
+    label_mb_key.set_markup(Glib::ustring{"<b>"} + _("Memory for the Loaded Nodes") + "</b>");
+    grid.attach(label_mb_key, 0, 14, 1, 1);
+    g_autofree gchar* pBudgetSize = g_format_size(summaryInfo.memory_budget_size);
+    Gtk::Label label_mb_val{0 == summaryInfo.memory_budget_size ? Glib::ustring{_("No Limit")} : Glib::ustring{pBudgetSize}};
+    grid.attach(label_mb_val, 1, 14, 1, 1);
     Gtk::Box* pContentArea = dialog.get_content_area();
     pContentArea->pack_start(grid);
     pContentArea->show_all();
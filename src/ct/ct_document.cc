@@ -0,0 +1,353 @@
+/*
+ * ct_document.cc
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "ct_document.h"
+#include "ct_storage_xml.h"
+#include "ct_storage_sqlite.h"
+#include "ct_storage_chunked.h"
+#include "ct_p7za_iface.h"
+#include "ct_thread_pool.h"
+#include "ct_misc_utils.h"
+#include "ct_widgets.h" // CtTmp
+#include "ct_logging.h"
+#include <libxml/xmlwriter.h>
+#include <libxml/xmlsave.h>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+/*static*/ std::unique_ptr<CtDocument> CtDocument::load(const fs::path& file_path, const Glib::ustring& password, Glib::ustring& error)
+{
+    std::unique_ptr<CtDocument> pDocument{new CtDocument{}};
+    pDocument->_file_path = file_path;
+    try
+    {
+        if (not fs::is_regular_file(file_path)) throw std::runtime_error("no file");
+
+        const CtDocType doc_type = fs::get_doc_type(file_path);
+        const bool is_encrypted = fs::get_doc_encrypt(file_path) == CtDocEncrypt::True;
+        if (CtDocType::XML == doc_type) {
+            auto storage_xml = std::make_unique<CtStorageXml>(nullptr);
+            bool populated{false};
+            if (is_encrypted and CtChunkedContainer::is_container(file_path)) {
+                if (not storage_xml->open_chunked(file_path, password)) throw std::runtime_error("wrong password");
+                populated = storage_xml->populate_doc_nodes(file_path, pDocument->_doc_nodes, error);
+            }
+            else if (is_encrypted) {
+                // decrypt into memory, no plaintext copy on disk
+                std::string data;
+                if (0 != CtP7zaIface::p7za_extract_to_memory(file_path.c_str(), password.c_str(), data)) throw std::runtime_error("wrong password");
+                populated = storage_xml->populate_doc_nodes_from_memory(std::move(data), pDocument->_doc_nodes, error);
+            }
+            else {
+                populated = storage_xml->populate_doc_nodes(file_path, pDocument->_doc_nodes, error);
+            }
+            if (not populated) throw std::runtime_error(error);
+            pDocument->_storage = std::move(storage_xml);
+        }
+        else if (CtDocType::SQLite == doc_type) {
+            fs::path db_path = file_path;
+            if (is_encrypted) {
+                // the database is read from a temporary copy, as by the main window
+                pDocument->_ct_tmp = std::make_unique<CtTmp>();
+                const fs::path temp_dir = pDocument->_ct_tmp->getHiddenDirPath(file_path);
+                db_path = pDocument->_ct_tmp->getHiddenFilePath(file_path);
+                if (0 != CtP7zaIface::p7za_extract(file_path.c_str(), temp_dir.c_str(), password.c_str(), true/*suppress_error*/) or
+                    not fs::is_regular_file(db_path))
+                {
+                    throw std::runtime_error("wrong password");
+                }
+            }
+            auto storage_sqlite = std::make_unique<CtStorageSqlite>(nullptr);
+            if (not storage_sqlite->populate_doc_nodes(db_path, pDocument->_doc_nodes, error)) throw std::runtime_error(error);
+            pDocument->_storage = std::move(storage_sqlite);
+        }
+        else {
+            throw std::runtime_error("unexpected document type");
+        }
+    }
+    catch (std::exception& e)
+    {
+        error = e.what();
+        spdlog::error("{} {}: {}", __FUNCTION__, file_path, error);
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < pDocument->_doc_nodes.nodes.size(); ++i) {
+        pDocument->_node_indexes.emplace(pDocument->_doc_nodes.nodes[i].node_data.nodeId, i);
+    }
+    spdlog::debug("{} {}: {} nodes", __FUNCTION__, file_path, pDocument->_doc_nodes.nodes.size());
+    return pDocument;
+}
+
+CtDocument::~CtDocument()
+{
+    // the storage goes before the temporary copy it may read
+    _storage.reset();
+    _ct_tmp.reset();
+}
+
+int CtDocument::get_node_index(const gint64 node_id) const
+{
+    auto it = _node_indexes.find(node_id);
+    return it == _node_indexes.end() ? -1 : (int)it->second;
+}
+
+std::string CtDocument::get_node_hierarchical_name(const size_t node_index,
+                                                   const char* separator/*= "--"*/,
+                                                   const bool for_filename/*= true*/,
+                                                   const char* trailer/*= ""*/) const
+{
+    const CtDocNode& doc_node = _doc_nodes.nodes.at(node_index);
+    std::string hierarchical_name = str::trim(doc_node.node_data.name);
+    for (int parent_index = doc_node.parent_index; parent_index >= 0; parent_index = _doc_nodes.nodes[parent_index].parent_index) {
+        hierarchical_name = str::trim(_doc_nodes.nodes[parent_index].node_data.name) + separator + hierarchical_name;
+    }
+    if (trailer)
+        hierarchical_name += trailer;
+    if (for_filename) {
+        hierarchical_name = CtMiscUtil::clean_from_chars_not_for_filename(hierarchical_name);
+        if (hierarchical_name.size() > (size_t)CtConst::MAX_FILE_NAME_LEN)
+            hierarchical_name = hierarchical_name.substr(hierarchical_name.size() - (size_t)CtConst::MAX_FILE_NAME_LEN);
+    }
+    return hierarchical_name;
+}
+
+bool CtDocument::has_children(const size_t node_index) const
+{
+    // the children follow their parent
+    return node_index + 1 < _doc_nodes.nodes.size() and _doc_nodes.nodes[node_index + 1].parent_index == (int)node_index;
+}
+
+std::vector<size_t> CtDocument::get_all_nodes_indexes() const
+{
+    std::vector<size_t> node_indexes(_doc_nodes.nodes.size());
+    for (size_t i = 0; i < node_indexes.size(); ++i) {
+        node_indexes[i] = i;
+    }
+    return node_indexes;
+}
+
+std::unique_ptr<CtStoredTextReader> CtDocument::_create_reader() const
+{
+    std::unique_ptr<CtStoredTextReader> pReader = _storage->create_stored_text_reader();
+    if (not pReader) throw std::runtime_error("cannot read the nodes content");
+    return pReader;
+}
+
+void CtDocument::decode_nodes(const std::vector<size_t>& node_indexes, const bool ordered, const CtDocNodeFunc& on_node) const
+{
+    auto f_decode = [this, &node_indexes](CtStoredTextReader& reader, const size_t i, CtDecodedNodeText& decoded_text) {
+        // the png bytes are enough to export or convert, no pixbuf
+        decoded_text.with_pixbufs = false;
+        const CtNodeData& node_data = _doc_nodes.nodes.at(node_indexes[i]).node_data;
+        if (not reader.get_decoded_node_text(node_data.nodeId, decoded_text)) {
+            throw std::runtime_error("cannot decode the node " + std::to_string(node_data.nodeId));
+        }
+    };
+
+    CtThreadPool& thread_pool = CtThreadPool::get_instance();
+    const size_t workers_num = std::min(thread_pool.get_workers_num(), node_indexes.size());
+    if (0 == workers_num) {
+        // no worker to wait for
+        std::unique_ptr<CtStoredTextReader> pReader = _create_reader();
+        for (size_t i = 0; i < node_indexes.size(); ++i) {
+            CtDecodedNodeText decoded_text;
+            f_decode(*pReader, i, decoded_text);
+            on_node(node_indexes[i], decoded_text);
+        }
+        return;
+    }
+
+    // every worker owns its own reader, created from this thread
+    std::vector<std::unique_ptr<CtStoredTextReader>> readers;
+    for (size_t w = 0; w < workers_num; ++w) {
+        readers.push_back(_create_reader());
+    }
+
+    const size_t max_ahead = workers_num * NODES_IN_FLIGHT_PER_WORKER;
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t next_to_decode{0};
+    size_t next_to_consume{0};
+    bool stop{false};
+    std::map<size_t, CtDecodedNodeText> decoded_nodes; // ordered only, decoded and not consumed yet
+
+    CtThreadPool::TaskGroup task_group{thread_pool};
+    auto on_scope_exit = scope_guard([&](void*) {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stop = true;
+        }
+        cv.notify_all();
+    }); // then the group waits for the workers
+    for (std::unique_ptr<CtStoredTextReader>& pReader : readers) {
+        task_group.run([&, pReader = pReader.get()]() {
+            for (;;) {
+                size_t i{0};
+                {
+                    std::unique_lock<std::mutex> lock{mutex};
+                    cv.wait(lock, [&]() {
+                        return stop or next_to_decode >= node_indexes.size() or not ordered or next_to_decode < next_to_consume + max_ahead;
+                    });
+                    if (stop or next_to_decode >= node_indexes.size()) return;
+                    i = next_to_decode++;
+                }
+                CtDecodedNodeText decoded_text;
+                try {
+                    f_decode(*pReader, i, decoded_text);
+                    if (not ordered) {
+                        on_node(node_indexes[i], decoded_text);
+                        continue;
+                    }
+                }
+                catch (...) {
+                    {
+                        std::lock_guard<std::mutex> lock{mutex};
+                        stop = true;
+                    }
+                    cv.notify_all();
+                    throw; // rethrown by the wait of the group
+                }
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    decoded_nodes.emplace(i, std::move(decoded_text));
+                }
+                cv.notify_all();
+            }
+        });
+    }
+    if (ordered) {
+        for (size_t i = 0; i < node_indexes.size(); ++i) {
+            CtDecodedNodeText decoded_text;
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                cv.wait(lock, [&]() { return stop or decoded_nodes.count(i); });
+                if (stop) break; // a worker failed
+                auto it = decoded_nodes.find(i);
+                decoded_text = std::move(it->second);
+                decoded_nodes.erase(it);
+                next_to_consume = i + 1;
+            }
+            cv.notify_all();
+            on_node(node_indexes[i], decoded_text);
+        }
+    }
+    task_group.wait();
+}
+
+void CtDocument::save_as(const fs::path& file_path) const
+{
+    if (fs::get_doc_encrypt(file_path) != CtDocEncrypt::False) {
+        throw std::runtime_error(file_path.string() + ": only .ctd and .ctb are supported");
+    }
+    // the document is written aside then moved, not to leave a partial document at file_path
+    fs::path tmp_file_path = file_path;
+    tmp_file_path += ".tmp";
+    if (fs::exists(tmp_file_path)) fs::remove(tmp_file_path);
+    auto on_scope_exit = scope_guard([&](void*) {
+        if (fs::exists(tmp_file_path)) fs::remove(tmp_file_path);
+    });
+    if (fs::get_doc_type(file_path) == CtDocType::SQLite) {
+        _save_as_sqlite(tmp_file_path);
+    }
+    else {
+        _save_as_xml(tmp_file_path);
+    }
+    if (fs::is_regular_file(file_path)) {
+        fs::remove(file_path);
+    }
+    if (not fs::move_file(tmp_file_path, file_path)) {
+        throw std::runtime_error(tmp_file_path.string() + " -> " + file_path.string());
+    }
+}
+
+void CtDocument::_save_as_xml(const fs::path& file_path) const
+{
+    std::unique_ptr<xmlTextWriter, decltype(&xmlFreeTextWriter)> pWriter{xmlNewTextWriterFilename(file_path.c_str(), 0/*compression*/),
+                                                                         xmlFreeTextWriter};
+    if (not pWriter) throw std::runtime_error(file_path.string() + ": cannot be written");
+    auto check_rc = [&](const int rc) {
+        if (rc < 0) throw std::runtime_error(file_path.string() + ": write failed");
+    };
+    check_rc(xmlTextWriterStartDocument(pWriter.get(), nullptr, "UTF-8", nullptr));
+    check_rc(xmlTextWriterStartElement(pWriter.get(), BAD_CAST CtConst::APP_NAME));
+    check_rc(xmlTextWriterStartElement(pWriter.get(), BAD_CAST "bookmarks"));
+    check_rc(xmlTextWriterWriteAttribute(pWriter.get(), BAD_CAST "list", BAD_CAST str::join_numbers(_doc_nodes.bookmarks, ",").c_str()));
+    check_rc(xmlTextWriterEndElement(pWriter.get()));
+
+    // the node elements stay open until a node which is not a descendant
+    int open_nodes{0};
+    decode_nodes(get_all_nodes_indexes(), true/*ordered*/, [&](const size_t node_index, CtDecodedNodeText& decoded_text) {
+        const CtDocNode& doc_node = _doc_nodes.nodes[node_index];
+        for (; open_nodes > doc_node.level; --open_nodes) {
+            check_rc(xmlTextWriterEndElement(pWriter.get()));
+        }
+        const CtNodeData& node_data = doc_node.node_data;
+        auto write_attribute = [&](const char* name, const std::string& value) {
+            check_rc(xmlTextWriterWriteAttribute(pWriter.get(), BAD_CAST name, BAD_CAST value.c_str()));
+        };
+        // the same attributes as CtStorageXmlHelper::node_properties_to_xml
+        check_rc(xmlTextWriterStartElement(pWriter.get(), BAD_CAST "node"));
+        write_attribute("name", node_data.name);
+        write_attribute("unique_id", std::to_string(node_data.nodeId));
+        write_attribute("prog_lang", node_data.syntax);
+        write_attribute("tags", node_data.tags);
+        write_attribute("readonly", std::to_string(node_data.isRO));
+        write_attribute("custom_icon_id", std::to_string(node_data.customIconId));
+        write_attribute("is_bold", std::to_string(node_data.isBold));
+        write_attribute("foreground", node_data.foregroundRgb24);
+        write_attribute("ts_creation", std::to_string(node_data.tsCreation));
+        write_attribute("ts_lastsave", std::to_string(node_data.tsLastSave));
+        ++open_nodes;
+
+        // the slots are built in a document of their own, then written as they are
+        xmlpp::Document xml_doc;
+        xmlpp::Element* p_node_node = xml_doc.create_root_node("node");
+        CtStorageXmlHelper::decoded_text_to_xml(p_node_node, decoded_text, true/*with_widgets*/);
+        std::unique_ptr<xmlBuffer, decltype(&xmlBufferFree)> pBuffer{xmlBufferCreate(), xmlBufferFree};
+        xmlSaveCtxtPtr pSaveCtxt = xmlSaveToBuffer(pBuffer.get(), "UTF-8", XML_SAVE_NO_DECL);
+        for (xmlpp::Node* p_slot : p_node_node->get_children()) {
+            xmlSaveTree(pSaveCtxt, p_slot->cobj());
+        }
+        xmlSaveClose(pSaveCtxt);
+        check_rc(xmlTextWriterWriteRawLen(pWriter.get(), xmlBufferContent(pBuffer.get()), xmlBufferLength(pBuffer.get())));
+    });
+    for (; open_nodes > 0; --open_nodes) {
+        check_rc(xmlTextWriterEndElement(pWriter.get()));
+    }
+    check_rc(xmlTextWriterEndDocument(pWriter.get()));
+    check_rc(xmlTextWriterFlush(pWriter.get()));
+}
+
+void CtDocument::_save_as_sqlite(const fs::path& file_path) const
+{
+    CtStorageSqlite storage_sqlite{nullptr};
+    storage_sqlite.create_doc(file_path, _doc_nodes.bookmarks);
+    decode_nodes(get_all_nodes_indexes(), true/*ordered*/, [&](const size_t node_index, CtDecodedNodeText& decoded_text) {
+        const CtDocNode& doc_node = _doc_nodes.nodes[node_index];
+        const gint64 father_id = doc_node.parent_index < 0 ? 0 : _doc_nodes.nodes[doc_node.parent_index].node_data.nodeId;
+        storage_sqlite.write_doc_node(doc_node, father_id, decoded_text);
+    });
+    storage_sqlite.commit_doc();
+}
@@ -0,0 +1,123 @@
+/*
+ * ct_document.h
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include "ct_types.h"
+#include "ct_treestore.h" // CtNodeData
+#include "ct_filesystem.h"
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class CtStorageEntity;
+class CtTmp;
+
+/**
+ * @brief A node of a document read without a tree store, its content is decoded on demand
+ */
+struct CtDocNode
+{
+    CtNodeData node_data;         // properties only, no text buffer nor widgets
+    int        level{0};          // 0 for the top level nodes
+    int        parent_index{-1};  // index of the parent in CtDocNodes::nodes, -1 for the top level nodes
+};
+
+/**
+ * @brief The nodes of a document in the order of a tree traversal, the parents before their children
+ */
+struct CtDocNodes
+{
+    std::vector<CtDocNode> nodes;
+    std::vector<gint64>    bookmarks;
+};
+
+using CtDocNodeFunc = std::function<void(const size_t node_index, CtDecodedNodeText& decoded_text)>;
+
+/**
+ * @brief A document (.ctb, .ctd, .ctx, .ctz) read through its storage without a main window, a tree store,
+ * text buffers or widgets: the nodes content is decoded as text runs and widgets data, so that the document
+ * can be exported or converted headless and without holding all the nodes content in memory
+ */
+class CtDocument
+{
+public:
+    /**
+     * @brief Reads the nodes properties and hierarchy of the document at file_path
+     * @return nullptr with error set if the document cannot be read or the password is wrong
+     */
+    static std::unique_ptr<CtDocument> load(const fs::path& file_path, const Glib::ustring& password, Glib::ustring& error);
+    ~CtDocument();
+
+    const fs::path&               get_file_path() const { return _file_path; }
+    std::string                   get_file_name() const { return _file_path.filename().string(); }
+    const std::vector<CtDocNode>& get_nodes() const { return _doc_nodes.nodes; }
+    const std::vector<gint64>&    get_bookmarks() const { return _doc_nodes.bookmarks; }
+    /**
+     * @brief The index in get_nodes() of the node with node_id, -1 if none
+     */
+    int get_node_index(const gint64 node_id) const;
+    /**
+     * @brief As CtMiscUtil::get_node_hierarchical_name, from the nodes of the document
+     */
+    std::string get_node_hierarchical_name(const size_t node_index,
+                                           const char* separator = "--",
+                                           const bool for_filename = true,
+                                           const char* trailer = "") const;
+    bool has_children(const size_t node_index) const;
+
+    /**
+     * @brief Decodes the content of the nodes on the workers of the thread pool
+     * @param ordered if true, on_node is called from the calling thread in the order of node_indexes, with the
+     * workers never more than NODES_IN_FLIGHT_PER_WORKER nodes ahead of it; otherwise on_node is called from
+     * the workers as soon as a node is decoded
+     * @throw std::runtime_error if a node cannot be decoded, or the first exception thrown by on_node
+     */
+    void decode_nodes(const std::vector<size_t>& node_indexes, const bool ordered, const CtDocNodeFunc& on_node) const;
+    /**
+     * @brief The indexes of all the nodes, in the order of a tree traversal
+     */
+    std::vector<size_t> get_all_nodes_indexes() const;
+
+    /**
+     * @brief Writes the document as a not protected .ctd or .ctb at file_path, one node decoded at a time
+     * @throw std::runtime_error if the document cannot be written
+     */
+    void save_as(const fs::path& file_path) const;
+
+private:
+    CtDocument() = default;
+
+    std::unique_ptr<CtStoredTextReader> _create_reader() const;
+    void _save_as_xml(const fs::path& file_path) const;
+    void _save_as_sqlite(const fs::path& file_path) const;
+
+    static constexpr size_t NODES_IN_FLIGHT_PER_WORKER{4}; // decoded nodes waiting for the consumer, bounding the memory
+
+    fs::path                         _file_path;
+    std::unique_ptr<CtTmp>           _ct_tmp;  // the extracted protected .ctb, removed after the storage is closed
+    std::unique_ptr<CtStorageEntity> _storage;
+    CtDocNodes                       _doc_nodes;
+    std::unordered_map<gint64, size_t> _node_indexes; // node id, index in _doc_nodes.nodes
+};
@@ -0,0 +1,556 @@
+/*
+ * ct_document_export.cc
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "ct_document_export.h"
+#include "ct_export2html.h"
+#include "ct_export_manifest.h"
+#include "ct_misc_utils.h"
+#include "ct_logging.h"
+#include <giomm/file.h>
+#include <glibmm/uriutils.h>
+#include <limits>
+
+namespace {
+
+using TextRun = CtDecodedNodeText::TextRun;
+using Widget = CtDecodedNodeText::Widget;
+
+// the runs split at the widgets, each widget taking one character of the text buffer at its offset
+void for_each_run_and_widget(const CtDecodedNodeText& decoded_text,
+                             const std::function<void(const TextRun& run, const Glib::ustring& text)>& on_text,
+                             const std::function<void(const Widget& widget)>& on_widget)
+{
+    const std::vector<Widget>& widgets = decoded_text.widgets;
+    size_t widget_idx{0};
+    size_t text_chars{0}; // text characters so far, widgets excluded
+    auto next_widget_text_offset = [&]() {
+        if (widget_idx >= widgets.size()) return std::numeric_limits<size_t>::max();
+        return (size_t)std::max(0, widgets[widget_idx].offset - (int)widget_idx);
+    };
+    for (const TextRun& run : decoded_text.runs) {
+        const size_t run_chars = run.text.size();
+        size_t run_pos{0};
+        for (;;) {
+            while (widget_idx < widgets.size() and next_widget_text_offset() <= text_chars) {
+                on_widget(widgets[widget_idx++]);
+            }
+            if (run_pos >= run_chars) break;
+            const size_t take = std::min(run_chars - run_pos, next_widget_text_offset() - text_chars);
+            on_text(run, run_pos == 0 and take == run_chars ? run.text : run.text.substr(run_pos, take));
+            run_pos += take;
+            text_chars += take;
+        }
+    }
+    while (widget_idx < widgets.size()) {
+        on_widget(widgets[widget_idx++]);
+    }
+}
+
+Glib::ustring get_tag_prop(const TextRun& run, const char* tag_property)
+{
+    for (const auto& tag_prop : run.tag_props) {
+        if (tag_prop.first == tag_property) return tag_prop.second;
+    }
+    return "";
+}
+
+Glib::ustring get_text(const CtDecodedNodeText& decoded_text)
+{
+    Glib::ustring text;
+    for (const TextRun& run : decoded_text.runs) {
+        text += run.text;
+    }
+    return text;
+}
+
+// as the codeboxes and the code nodes exported by CtExport2Html, without the syntax highlighting
+Glib::ustring get_code_html(const Glib::ustring& code)
+{
+    Glib::ustring html_text = str::replace(str::xml_escape(code), " ", "&nbsp;");
+    html_text = str::replace(html_text, CtConst::CHAR_NEWLINE, "<br />");
+    return "<div class=\"codebox\">" + html_text + "</div>";
+}
+
+std::string md_escape(const Glib::ustring& text)
+{
+    std::string escaped;
+    for (const char c : text.raw()) {
+        if (c == '\\' or c == '`' or c == '*' or c == '_' or c == '[' or c == ']') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+std::string md_code_fence(const std::string& syntax, const Glib::ustring& code)
+{
+    const std::string info = syntax == CtConst::PLAIN_TEXT_ID ? "" : syntax;
+    std::string fence = "```" + info + CtConst::CHAR_NEWLINE + code.raw();
+    if (not str::endswith(code, CtConst::CHAR_NEWLINE)) fence += CtConst::CHAR_NEWLINE;
+    return fence + "```" + CtConst::CHAR_NEWLINE;
+}
+
+} // namespace (anonymous)
+
+CtDocumentExport::CtDocumentExport(const CtDocument& document, const CtExportOptions& options, const Glib::ustring& hRule)
+ : _document{document}
+ , _options{options}
+ , _hRule{hRule}
+{
+}
+
+fs::path CtDocumentExport::export_to_txt(const fs::path& dir_place, const bool overwrite)
+{
+    auto f_node_export = [this](const size_t node_index, const CtDecodedNodeText& decoded_text, Glib::ustring& node_text, CtExportFiles&) {
+        node_text = _node_to_txt(node_index, decoded_text);
+    };
+    if (_options.single_file) {
+        fs::path txt_filepath = dir_place / (_document.get_file_name() + ".txt");
+        g_mkdir_with_parents(dir_place.c_str(), 0777);
+        _export_single(txt_filepath, "", f_node_export, "");
+        return txt_filepath;
+    }
+    const fs::path export_dir = _prepare_folder(dir_place, "_TXT", overwrite);
+    std::vector<fs::path> filepaths;
+    for (size_t i = 0; i < _document.get_nodes().size(); ++i) {
+        filepaths.push_back(export_dir / (_document.get_node_hierarchical_name(i) + ".txt"));
+    }
+    _export_multiple(export_dir, std::to_string(_options.include_node_name) + "\n", filepaths, f_node_export);
+    return export_dir;
+}
+
+fs::path CtDocumentExport::export_to_html(const fs::path& dir_place, const bool overwrite)
+{
+    // the folder with the styles and the scripts as by the main window, which is not needed here
+    fs::path export_dir;
+    CtExport2Html{nullptr}.prepare_html_folder(dir_place, _document.get_file_name(), overwrite, export_dir, _options.incremental);
+
+    if (_options.single_file) {
+        auto f_node_export = [&](const size_t node_index, const CtDecodedNodeText& decoded_text, Glib::ustring& node_text, CtExportFiles& files) {
+            const CtDocNode& doc_node = _document.get_nodes()[node_index];
+            CtHtmlNodeSnapshot snapshot;
+            snapshot.html_head = "<div class='page'>";
+            snapshot.html_head += "<h1 class='title level-" + std::to_string(doc_node.level + 1) + "'>" + doc_node.node_data.name + "</h1><br/>";
+            _node_body_to_html(node_index, decoded_text, export_dir, snapshot);
+            snapshot.html_tail = "</div>"; // div class='page'
+            node_text = CtExport2Html::serialize_node_body(snapshot);
+            files = std::move(snapshot.files);
+        };
+        _export_single(export_dir / "index.html",
+                       str::format(CtExport2Html::HTML_HEADER, _document.get_file_name()),
+                       f_node_export,
+                       CtExport2Html::HTML_FOOTER);
+        return export_dir;
+    }
+
+    fs::path home_svg = fs::get_cherrytree_datadir() / fs::path("icons") / "ct_home.svg";
+    fs::copy_file(home_svg, export_dir / "images" / "home.svg");
+
+    // the tree links, a node with children opens the list of their links
+    const std::vector<CtDocNode>& nodes = _document.get_nodes();
+    Glib::ustring tree_links_text = CtExport2Html::get_tree_links_head();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        tree_links_text += CtExport2Html::get_tree_link_html(_get_html_filename(i), nodes[i].node_data.name,
+                                                             _document.has_children(i), _options.index_in_page);
+        const int next_level = i + 1 < nodes.size() ? nodes[i + 1].level : 0;
+        for (int level = nodes[i].level; level > next_level; --level) {
+            tree_links_text += "</ul>\n";
+        }
+    }
+    tree_links_text += CtExport2Html::get_tree_links_tail();
+    const Glib::ustring index_html = CtExport2Html::get_index_html(_document.get_file_name(), tree_links_text, _options.index_in_page);
+    _write_file(export_dir / "index.html", index_html.c_str(), index_html.bytes());
+
+    std::vector<fs::path> filepaths;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        filepaths.push_back(export_dir / _get_html_filename(i));
+    }
+    auto f_node_export = [&](const size_t node_index, const CtDecodedNodeText& decoded_text, Glib::ustring& node_text, CtExportFiles& files) {
+        CtHtmlNodeSnapshot snapshot;
+        snapshot.html_head = CtExport2Html::get_node_page_head(nodes[node_index].node_data.name, _options, true/*has_index*/);
+        _node_body_to_html(node_index, decoded_text, export_dir, snapshot);
+        snapshot.html_tail = CtExport2Html::get_node_page_tail(_options, true/*has_index*/);
+        node_text = CtExport2Html::serialize_node_body(snapshot);
+        files = std::move(snapshot.files);
+    };
+    _export_multiple(export_dir,
+                     std::to_string(_options.include_node_name) + std::to_string(_options.index_in_page) + "\n",
+                     filepaths,
+                     f_node_export);
+    return export_dir;
+}
+
+fs::path CtDocumentExport::export_to_md(const fs::path& dir_place, const bool overwrite)
+{
+    const fs::path export_dir = _prepare_folder(dir_place, "_MD", overwrite);
+    g_mkdir_with_parents((export_dir / "images").c_str(), 0777);
+    g_mkdir_with_parents((export_dir / "EmbeddedFiles").c_str(), 0777);
+    auto f_node_export = [&](const size_t node_index, const CtDecodedNodeText& decoded_text, Glib::ustring& node_text, CtExportFiles& files) {
+        node_text = _node_to_md(node_index, decoded_text, export_dir, files);
+    };
+    _md_single_file = _options.single_file;
+    if (_options.single_file) {
+        _export_single(export_dir / (CtMiscUtil::clean_from_chars_not_for_filename(_document.get_file_name()) + ".md"), "", f_node_export, "");
+        return export_dir;
+    }
+    std::vector<fs::path> filepaths;
+    for (size_t i = 0; i < _document.get_nodes().size(); ++i) {
+        filepaths.push_back(export_dir / (_document.get_node_hierarchical_name(i) + ".md"));
+    }
+    _export_multiple(export_dir, std::to_string(_options.include_node_name) + "\n", filepaths, f_node_export);
+    return export_dir;
+}
+
+void CtDocumentExport::_export_multiple(const fs::path& export_dir,
+                                        const std::string& layout_options,
+                                        const std::vector<fs::path>& filepaths,
+                                        const CtNodeExportFunc& f_node_export)
+{
+    const std::vector<CtDocNode>& nodes = _document.get_nodes();
+    std::unique_ptr<CtExportManifest> pManifest;
+    std::vector<size_t> node_indexes;
+    if (_options.incremental) {
+        // a change of the nodes ids, syntaxes or paths may change the links, so all of them have to be checked
+        std::string layout = _document.get_file_path().string() + "\n" + layout_options;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            layout += std::to_string(nodes[i].node_data.nodeId) + "\t" + nodes[i].node_data.syntax + "\t" + filepaths[i].string() + "\n";
+        }
+        pManifest = std::make_unique<CtExportManifest>(export_dir, layout);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (not pManifest->keep_node_if_unchanged(nodes[i].node_data.nodeId, nodes[i].node_data.tsLastSave)) {
+                node_indexes.push_back(i);
+            }
+        }
+    }
+    else {
+        node_indexes = _document.get_all_nodes_indexes();
+    }
+
+    // no order between the files, every node is serialized and written by the worker that decoded it
+    _document.decode_nodes(node_indexes, false/*ordered*/, [&](const size_t node_index, CtDecodedNodeText& decoded_text) {
+        Glib::ustring node_text;
+        CtExportFiles files;
+        f_node_export(node_index, decoded_text, node_text, files);
+        files.emplace_back(filepaths[node_index], node_text.raw());
+        const gint64 node_id = nodes[node_index].node_data.nodeId;
+        for (const auto& file : files) {
+            if (not pManifest or pManifest->add_file(node_id, file.first, CtExportManifest::get_digest(file.second.c_str(), file.second.size()))) {
+                _write_file(file.first, file.second.c_str(), file.second.size());
+            }
+        }
+    });
+    if (pManifest) {
+        pManifest->commit();
+    }
+}
+
+void CtDocumentExport::_export_single(const fs::path& filepath,
+                                      const Glib::ustring& head,
+                                      const CtNodeExportFunc& f_node_export,
+                                      const Glib::ustring& tail)
+{
+    Glib::RefPtr<Gio::File> rFile = Gio::File::create_for_path(filepath.string());
+    Glib::RefPtr<Gio::FileOutputStream> rFileStream = rFile->replace();
+    rFileStream->write(head.c_str(), head.bytes());
+
+    // streamed in the order of the tree, only the nodes in flight are in memory
+    _document.decode_nodes(_document.get_all_nodes_indexes(), true/*ordered*/, [&](const size_t node_index, CtDecodedNodeText& decoded_text) {
+        Glib::ustring node_text;
+        CtExportFiles files;
+        f_node_export(node_index, decoded_text, node_text, files);
+        for (const auto& file : files) {
+            _write_file(file.first, file.second.c_str(), file.second.size());
+        }
+        rFileStream->write(node_text.c_str(), node_text.bytes());
+    });
+
+    rFileStream->write(tail.c_str(), tail.bytes());
+    rFileStream->flush();
+    rFileStream->close();
+}
+
+fs::path CtDocumentExport::_prepare_folder(const fs::path& dir_place, const std::string& suffix, const bool overwrite)
+{
+    fs::path new_folder = CtMiscUtil::clean_from_chars_not_for_filename(_document.get_file_name()) + suffix;
+    if (not _options.incremental or not CtExportManifest::is_in_folder(dir_place / new_folder))
+        new_folder = fs::prepare_export_folder(dir_place, new_folder, overwrite);
+    fs::path export_dir = dir_place / new_folder;
+    g_mkdir_with_parents(export_dir.c_str(), 0777);
+    return export_dir;
+}
+
+/*static*/ void CtDocumentExport::_write_file(const fs::path& filepath, const char* data, const size_t size)
+{
+    GError* pError{nullptr};
+    if (not g_file_set_contents(filepath.c_str(), data, (gssize)size, &pError)) {
+        const std::string error_msg = filepath.string() + ": " + (pError ? pError->message : "?");
+        if (pError) g_error_free(pError);
+        throw std::runtime_error(error_msg);
+    }
+}
+
+Glib::ustring CtDocumentExport::_node_to_txt(const size_t node_index, const CtDecodedNodeText& decoded_text)
+{
+    const CtDocNode& doc_node = _document.get_nodes()[node_index];
+    Glib::ustring plain_text;
+    if (_options.include_node_name) {
+        plain_text += str::repeat("#", doc_node.level + 1);
+        plain_text += CtConst::CHAR_SPACE + doc_node.node_data.name + CtConst::CHAR_NEWLINE;
+    }
+    // as CtExport2Txt, the images are left out
+    for_each_run_and_widget(decoded_text,
+        [&](const TextRun&, const Glib::ustring& text) {
+            plain_text += text;
+        },
+        [&](const Widget& widget) {
+            if (CtAnchWidgType::Table == widget.type) {
+                plain_text += CtConst::CHAR_NEWLINE;
+                for (const std::vector<Glib::ustring>& row : widget.table_rows) {
+                    plain_text += CtConst::CHAR_PIPE;
+                    for (const Glib::ustring& cell : row)
+                        plain_text += CtConst::CHAR_SPACE + cell + CtConst::CHAR_SPACE + CtConst::CHAR_PIPE;
+                    plain_text += CtConst::CHAR_NEWLINE;
+                }
+            }
+            else if (CtAnchWidgType::CodeBox == widget.type) {
+                plain_text += CtConst::CHAR_NEWLINE + _hRule + CtConst::CHAR_NEWLINE;
+                plain_text += widget.text;
+                plain_text += CtConst::CHAR_NEWLINE + _hRule + CtConst::CHAR_NEWLINE;
+            }
+        });
+    plain_text += str::repeat(CtConst::CHAR_NEWLINE, 2);
+    return plain_text;
+}
+
+void CtDocumentExport::_node_body_to_html(const size_t node_index, const CtDecodedNodeText& decoded_text, const fs::path& export_dir,
+                                          CtHtmlNodeSnapshot& snapshot)
+{
+    const CtNodeData& node_data = _document.get_nodes()[node_index].node_data;
+    snapshot.node_id = node_data.nodeId;
+    if (node_data.syntax != CtConst::RICH_TEXT_ID) {
+        snapshot.html_head += get_code_html(get_text(decoded_text));
+        return;
+    }
+    int images_count{0};
+    snapshot.slots.emplace_back();
+    for_each_run_and_widget(decoded_text,
+        [&](const TextRun& run, const Glib::ustring& text) {
+            CtHtmlTextRun html_run{text, {}, ""};
+            for (const std::string_view tag_property : CtConst::TAG_PROPERTIES) {
+                html_run.attributes[tag_property] = get_tag_prop(run, tag_property.data());
+            }
+            const std::string& link = html_run.attributes.at(CtConst::TAG_LINK);
+            if (not link.empty())
+                html_run.href = _get_html_href(link);
+            snapshot.slots.back().push_back(std::move(html_run));
+        },
+        [&](const Widget& widget) {
+            Glib::ustring widget_html;
+            if (CtAnchWidgType::ImageAnchor == widget.type) {
+                widget_html = "<a name=\"" + widget.text + "\"></a>";
+            }
+            else if (CtAnchWidgType::ImageEmbFile == widget.type) {
+                fs::path embfile_name = std::to_string(node_data.nodeId) + "-" + widget.text.raw();
+                fs::path embfile_rel_path = fs::path{"EmbeddedFiles"} / embfile_name;
+                widget_html = "<table style=\"" + CtExport2Html::get_object_alignment_string(widget.justification) + "\"><tr><td><a href=\"" +
+                    embfile_rel_path.string_unix() + "\">Linked file: " + widget.text + " </a></td></tr></table>";
+                snapshot.files.emplace_back(export_dir / embfile_rel_path, widget.raw_blob);
+            }
+            else if (CtAnchWidgType::ImagePng == widget.type) {
+                const Glib::ustring image_name = std::to_string(node_data.nodeId) + "-" + std::to_string(++images_count) + ".png";
+                const Glib::ustring image_rel_path = (fs::path{"images"} / image_name.raw()).string_unix();
+                widget_html = "<a href=\"" + _get_html_href(widget.link) + "\"><img src=\"" + image_rel_path + "\" alt=\"" + image_rel_path + "\" /></a>";
+                snapshot.files.emplace_back(export_dir / "images" / image_name.raw(), widget.raw_blob);
+            }
+            else if (CtAnchWidgType::Table == widget.type) {
+                widget_html = CtExport2Html::get_table_html(CtTableMatrix{widget.table_rows});
+            }
+            else if (CtAnchWidgType::CodeBox == widget.type) {
+                widget_html = get_code_html(widget.text);
+            }
+            snapshot.widgets_html.push_back(widget_html);
+            snapshot.slots.emplace_back();
+        });
+}
+
+std::string CtDocumentExport::_get_html_href(const Glib::ustring& link_prop_val)
+{
+    CtLinkEntry link_entry = CtMiscUtil::get_link_entry(link_prop_val);
+    const std::string doc_dir = _document.get_file_path().parent_path().string();
+    if (link_entry.type == CtConst::LINK_TYPE_WEBS)
+        return link_entry.webs.raw();
+    if (link_entry.type == CtConst::LINK_TYPE_FILE)
+        return "file://" + CtExport2Html::link_process_filepath(link_entry.file.raw(), doc_dir, true/*forHtml*/);
+    if (link_entry.type == CtConst::LINK_TYPE_FOLD)
+        return "file://" + CtExport2Html::link_process_folderpath(link_entry.fold.raw(), doc_dir, true/*forHtml*/);
+    if (link_entry.type == CtConst::LINK_TYPE_NODE) {
+        const int node_index = _document.get_node_index(link_entry.node_id);
+        if (node_index >= 0) {
+            std::string href = _get_html_filename((size_t)node_index);
+            if (not link_entry.anch.empty())
+                href += "#" + link_entry.anch;
+            return href;
+        }
+    }
+    return "";
+}
+
+std::string CtDocumentExport::_get_html_filename(const size_t node_index)
+{
+    // as CtExport2Html
+    return str::replace(_document.get_node_hierarchical_name(node_index, "--", true, ".html"), "#", "~");
+}
+
+Glib::ustring CtDocumentExport::_node_to_md(const size_t node_index, const CtDecodedNodeText& decoded_text, const fs::path& export_dir,
+                                            CtExportFiles& files)
+{
+    const CtDocNode& doc_node = _document.get_nodes()[node_index];
+    const CtNodeData& node_data = doc_node.node_data;
+    std::string md_text;
+    if (_md_single_file) {
+        // the target of the node links
+        md_text += "<a name=\"node-" + std::to_string(node_data.nodeId) + "\"></a>\n\n";
+    }
+    if (_options.include_node_name) {
+        md_text += str::repeat("#", std::min(doc_node.level + 1, 6)).raw() + CtConst::CHAR_SPACE + md_escape(node_data.name) + "\n\n";
+    }
+    if (node_data.syntax != CtConst::RICH_TEXT_ID) {
+        md_text += md_code_fence(node_data.syntax, get_text(decoded_text));
+        md_text += CtConst::CHAR_NEWLINE;
+        return md_text;
+    }
+
+    bool at_line_start{true};
+    int images_count{0};
+    auto append_block = [&](const std::string& block) {
+        if (not at_line_start) md_text += CtConst::CHAR_NEWLINE;
+        md_text += block;
+        at_line_start = true;
+    };
+    for_each_run_and_widget(decoded_text,
+        [&](const TextRun& run, const Glib::ustring& text) {
+            const Glib::ustring scale = get_tag_prop(run, CtConst::TAG_SCALE);
+            const bool is_monospace = get_tag_prop(run, CtConst::TAG_FAMILY) == CtConst::TAG_PROP_VAL_MONOSPACE;
+            std::string heading;
+            for (const gchar* h : {CtConst::TAG_PROP_VAL_H1, CtConst::TAG_PROP_VAL_H2, CtConst::TAG_PROP_VAL_H3,
+                                   CtConst::TAG_PROP_VAL_H4, CtConst::TAG_PROP_VAL_H5, CtConst::TAG_PROP_VAL_H6}) {
+                if (scale == h) heading = std::string(h[1] - '0', '#') + CtConst::CHAR_SPACE;
+            }
+            std::string open_marks, close_marks;
+            if (is_monospace) {
+                open_marks = "`";
+            }
+            else {
+                if (get_tag_prop(run, CtConst::TAG_WEIGHT) == CtConst::TAG_PROP_VAL_HEAVY) open_marks += "**";
+                if (get_tag_prop(run, CtConst::TAG_STYLE) == CtConst::TAG_PROP_VAL_ITALIC) open_marks += "*";
+                if (get_tag_prop(run, CtConst::TAG_STRIKETHROUGH) == CtConst::TAG_PROP_VAL_TRUE) open_marks += "~~";
+            }
+            close_marks.assign(open_marks.rbegin(), open_marks.rend());
+            const Glib::ustring link = get_tag_prop(run, CtConst::TAG_LINK);
+            const std::string href = link.empty() ? "" : _get_md_href(link);
+
+            // the marks cannot span lines nor start or end with a space
+            std::vector<Glib::ustring> lines = str::split(text, CtConst::CHAR_NEWLINE);
+            for (size_t i = 0; i < lines.size(); ++i) {
+                if (i > 0) {
+                    md_text += CtConst::CHAR_NEWLINE;
+                    at_line_start = true;
+                }
+                const std::string line = lines[i];
+                if (line.empty()) continue;
+                const size_t first = line.find_first_not_of(' ');
+                if (first == std::string::npos) {
+                    md_text += line;
+                    at_line_start = false;
+                    continue;
+                }
+                const size_t last = line.find_last_not_of(' ');
+                std::string inner = is_monospace ? line.substr(first, last + 1 - first) : md_escape(line.substr(first, last + 1 - first));
+                inner = open_marks + inner + close_marks;
+                if (not href.empty()) inner = "[" + inner + "](" + href + ")";
+                if (at_line_start and not heading.empty()) md_text += heading;
+                md_text += line.substr(0, first) + inner + line.substr(last + 1);
+                at_line_start = false;
+            }
+        },
+        [&](const Widget& widget) {
+            if (CtAnchWidgType::ImageAnchor == widget.type) {
+                md_text += "<a name=\"" + widget.text.raw() + "\"></a>";
+                at_line_start = false;
+            }
+            else if (CtAnchWidgType::ImageEmbFile == widget.type) {
+                const fs::path embfile_rel_path = fs::path{"EmbeddedFiles"} / (std::to_string(node_data.nodeId) + "-" + widget.text.raw());
+                md_text += "[" + md_escape(widget.text) + "](" + embfile_rel_path.string_unix() + ")";
+                files.emplace_back(export_dir / embfile_rel_path, widget.raw_blob);
+                at_line_start = false;
+            }
+            else if (CtAnchWidgType::ImagePng == widget.type) {
+                const fs::path image_rel_path = fs::path{"images"} / (std::to_string(node_data.nodeId) + "-" + std::to_string(++images_count) + ".png");
+                std::string image_md = "![](" + image_rel_path.string_unix() + ")";
+                const std::string href = widget.link.empty() ? "" : _get_md_href(widget.link);
+                md_text += href.empty() ? image_md : "[" + image_md + "](" + href + ")";
+                files.emplace_back(export_dir / image_rel_path, widget.raw_blob);
+                at_line_start = false;
+            }
+            else if (CtAnchWidgType::Table == widget.type and not widget.table_rows.empty()) {
+                auto cell_md = [](const Glib::ustring& cell) {
+                    return str::replace(str::replace(md_escape(cell), "|", "\\|"), CtConst::CHAR_NEWLINE, "<br>");
+                };
+                std::string table_md;
+                for (size_t row = 0; row < widget.table_rows.size(); ++row) {
+                    table_md += CtConst::CHAR_PIPE;
+                    for (const Glib::ustring& cell : widget.table_rows[row])
+                        table_md += CtConst::CHAR_SPACE + cell_md(cell) + CtConst::CHAR_SPACE + CtConst::CHAR_PIPE;
+                    table_md += CtConst::CHAR_NEWLINE;
+                    if (0 == row) {
+                        // the header row first
+                        table_md += CtConst::CHAR_PIPE;
+                        for (size_t col = 0; col < widget.table_rows[row].size(); ++col)
+                            table_md += " --- |";
+                        table_md += CtConst::CHAR_NEWLINE;
+                    }
+                }
+                append_block(table_md);
+            }
+            else if (CtAnchWidgType::CodeBox == widget.type) {
+                append_block(md_code_fence(widget.syntax, widget.text));
+            }
+        });
+    md_text += "\n\n";
+    return md_text;
+}
+
+std::string CtDocumentExport::_get_md_href(const Glib::ustring& link_prop_val)
+{
+    CtLinkEntry link_entry = CtMiscUtil::get_link_entry(link_prop_val);
+    if (link_entry.type == CtConst::LINK_TYPE_NODE) {
+        const int node_index = _document.get_node_index(link_entry.node_id);
+        if (node_index < 0) return "";
+        if (_md_single_file) return "#node-" + std::to_string(link_entry.node_id);
+        std::string href = Glib::uri_escape_string(_document.get_node_hierarchical_name((size_t)node_index) + ".md");
+        if (not link_entry.anch.empty())
+            href += "#" + link_entry.anch;
+        return href;
+    }
+    // the web, file and folder links as in the html
+    return _get_html_href(link_prop_val);
+}
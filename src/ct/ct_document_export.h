@@ -0,0 +1,97 @@
+/*
+ * ct_document_export.h
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include "ct_document.h"
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct CtHtmlNodeSnapshot;
+
+/**
+ * @brief Exports all the nodes of a CtDocument to TXT, HTML or Markdown without a main window: the nodes
+ * are decoded on the thread pool and every page or node is written as soon as it is ready, so that only
+ * the nodes in flight are in memory; the output mirrors the one of CtExport2Txt and CtExport2Html,
+ * but the codeboxes and the code nodes are not syntax highlighted
+ */
+class CtDocumentExport
+{
+public:
+    CtDocumentExport(const CtDocument& document, const CtExportOptions& options, const Glib::ustring& hRule);
+
+    /**
+     * @brief Exports to the folder <document>_TXT in dir_place, or to the file <document>.txt with options.single_file
+     * @return the folder or the file written
+     * @throw std::runtime_error if a node cannot be decoded or a file cannot be written
+     */
+    fs::path export_to_txt(const fs::path& dir_place, const bool overwrite);
+    /**
+     * @brief Exports to the folder <document>_HTML in dir_place, a page per node or one index.html with options.single_file
+     */
+    fs::path export_to_html(const fs::path& dir_place, const bool overwrite);
+    /**
+     * @brief Exports to the folder <document>_MD in dir_place, a file per node or one <document>.md with options.single_file;
+     * the images and the embedded files go to the subfolders images and EmbeddedFiles
+     */
+    fs::path export_to_md(const fs::path& dir_place, const bool overwrite);
+
+private:
+    using CtExportFiles = std::vector<std::pair<fs::path, std::string>>;
+    using CtNodeExportFunc = std::function<void(const size_t node_index, const CtDecodedNodeText& decoded_text,
+                                                Glib::ustring& node_text, CtExportFiles& files)>;
+
+    /**
+     * @brief A file per node at filepaths, written from the workers; with options.incremental only the nodes
+     * changed since the previous export in export_dir are decoded and only the files with a new content are written
+     */
+    void _export_multiple(const fs::path& export_dir,
+                          const std::string& layout_options,
+                          const std::vector<fs::path>& filepaths,
+                          const CtNodeExportFunc& f_node_export);
+    /**
+     * @brief The nodes written one after the other to filepath, in order
+     */
+    void _export_single(const fs::path& filepath,
+                        const Glib::ustring& head,
+                        const CtNodeExportFunc& f_node_export,
+                        const Glib::ustring& tail);
+    fs::path _prepare_folder(const fs::path& dir_place, const std::string& suffix, const bool overwrite);
+    static void _write_file(const fs::path& filepath, const char* data, const size_t size);
+
+    Glib::ustring _node_to_txt(const size_t node_index, const CtDecodedNodeText& decoded_text);
+    void          _node_body_to_html(const size_t node_index, const CtDecodedNodeText& decoded_text, const fs::path& export_dir,
+                                     CtHtmlNodeSnapshot& snapshot);
+    std::string   _get_html_href(const Glib::ustring& link_prop_val);
+    std::string   _get_html_filename(const size_t node_index);
+    Glib::ustring _node_to_md(const size_t node_index, const CtDecodedNodeText& decoded_text, const fs::path& export_dir,
+                              CtExportFiles& files);
+    std::string   _get_md_href(const Glib::ustring& link_prop_val);
+
+    const CtDocument&     _document;
+    const CtExportOptions _options;
+    const Glib::ustring   _hRule;
+    bool                  _md_single_file{false}; // the node links of the markdown are anchors in the same file
+};
@@ -36,7 +36,7 @@ CtExport2Html::CtExport2Html(CtMainWin* pCtMainWin)
 }
 
 //Prepare the website folder
-bool CtExport2Html::prepare_html_folder(fs::path dir_place, fs::path new_folder, bool export_overwrite, fs::path& export_path)
+bool CtExport2Html::prepare_html_folder(fs::path dir_place, fs::path new_folder, bool export_overwrite, fs::path& export_path, bool incremental)
 {
     if (dir_place.empty())
     {
@@ -45,7 +45,8 @@ bool CtExport2Html::prepare_html_folder(fs::path dir_place, fs::path new_folder,
             return false;
     }
     new_folder = CtMiscUtil::clean_from_chars_not_for_filename(new_folder.string()) + "_HTML";
-    new_folder = fs::prepare_export_folder(dir_place, new_folder, export_overwrite);
+    if (!incremental || !CtExportManifest::is_in_folder(dir_place / new_folder))
+        new_folder = fs::prepare_export_folder(dir_place, new_folder, export_overwrite);
     _export_dir = dir_place / new_folder;
     _images_dir = _export_dir / "images";
     _embed_dir = _export_dir / "EmbeddedFiles";
@@ -80,124 +81,124 @@ bool CtExport2Html::prepare_html_folder(fs::path dir_place, fs::path new_folder,
 // Export a Node To HTML
 void CtExport2Html::node_export_to_html(CtTreeIter tree_iter, const CtExportOptions& options, const Glib::ustring& index, int sel_start, int sel_end)
 {
-    Glib::ustring html_text = str::format(HTML_HEADER, tree_iter.get_node_name());
-    if (index != "" && options.index_in_page)
-    {
-        auto script = R"HTML(
-            <script type='text/javascript'>
-                function in_frame () { try { return window.self !== window.top; } catch (e) { return true; } }
-                if (!in_frame()) {
-                    var page = location.pathname.substring(location.pathname.lastIndexOf("/") + 1);
-                    window.location = 'index.html#' + page;
-                }
-            </script>)HTML";
-        html_text = str::replace(html_text, "<script></script>", script);
-    }
-    html_text += "<div class='page'>";
-    if (options.include_node_name)
-        html_text += "<h1 class='title'>" + tree_iter.get_node_name() + "</h1><br/>";
-
-    std::vector<Glib::ustring> html_slots;
-    std::vector<CtAnchoredWidget*> widgets;
-    if (tree_iter.get_node_is_rich_text())
-    {
-        _html_get_from_treestore_node(tree_iter, sel_start, sel_end, html_slots, widgets);
-        int images_count = 0;
-        for (size_t i = 0; i < html_slots.size(); ++i)
-        {
-            html_text += html_slots[i];
-            if (i < widgets.size())
-            {
-                try
-                {
-                    if (CtImageEmbFile* embfile = dynamic_cast<CtImageEmbFile*>(widgets[i]))
-                        html_text += _get_embfile_html(embfile, tree_iter, _embed_dir);
-                    else if (CtImage* image = dynamic_cast<CtImage*>(widgets[i]))
-                        html_text += _get_image_html(image, _images_dir, images_count, &tree_iter);
-                    else if (CtTable* table = dynamic_cast<CtTable*>(widgets[i]))
-                        html_text += _get_table_html(table);
-                    else if (CtCodebox* codebox = dynamic_cast<CtCodebox*>(widgets[i]))
-                        html_text += _get_codebox_html(codebox);
-                }
-                catch (std::exception& ex)
-                {
-                    spdlog::debug("caught ex: {}", ex.what());
-                }
-                catch (...)
-                {
-                    spdlog::debug("unknown ex");
-                }
-            }
-        }
-    }
-    else
-        html_text += _html_get_from_code_buffer(tree_iter.get_node_text_buffer(), sel_start, sel_end, tree_iter.get_node_syntax_highlighting());
-
-    if (index != "" && !options.index_in_page)
-        html_text += Glib::ustring("<p align=\"center\">") + "<img src=\"" + Glib::build_filename("images", "home.svg") + "\" height=\"22\" width=\"22\">" +
-                CtConst::CHAR_SPACE + CtConst::CHAR_SPACE + "<a href=\"index.html\">" + _("Index") + "</a></p>";
-    html_text += "</div>"; // div class='page'
-    html_text += HTML_FOOTER;
-
-    fs::path node_html_filepath = _export_dir / _get_html_filename(tree_iter);
-    g_file_set_contents(node_html_filepath.c_str(), html_text.c_str(), (gssize)html_text.bytes(), nullptr);
+    CtHtmlNodeSnapshot snapshot;
+    _node_snapshot(tree_iter, options, index, sel_start, sel_end, snapshot);
+    write_node_snapshot(snapshot);
 }
 
 // Export All Nodes To HTML
-void CtExport2Html::nodes_all_export_to_multiple_html(bool all_tree, const CtExportOptions& options)
+bool CtExport2Html::nodes_all_export_to_multiple_html(bool all_tree, const CtExportOptions& options, const CtExportProgressFunc& progress,
+                                                      CtThreadPool& thread_pool)
 {
     fs::path home_svg = fs::get_cherrytree_datadir() / fs::path("icons") / "ct_home.svg";
     fs::copy_file(home_svg, _images_dir / "home.svg");
 
     // create tree links text
-    Glib::ustring tree_links_text = // dont' use R"HTML, it gives unnecessary " "
-          "<div class='tree'>\n"
-          "<p>\n"
-          "<strong>Index</strong></br>\n"
-          "<button onclick='expandAllSubtrees()'>Expand All</button> <button onclick='collapseAllSubtrees()'>Collapse All</button>\n"
-          "</p>\n"
-          "<ul class='outermost'>\n";
+    Glib::ustring tree_links_text = get_tree_links_head();
     CtTreeIter tree_iter = all_tree ? _pCtMainWin->get_tree_store().get_ct_iter_first() : _pCtMainWin->curr_tree_iter();
     for (;tree_iter; ++tree_iter)
     {
         _tree_links_text_iter(tree_iter, tree_links_text, 1, options.index_in_page);
         if (!all_tree) break;
     }
-    tree_links_text += "</ul>\n";
-    tree_links_text += "</div>\n";
+    tree_links_text += get_tree_links_tail();
 
     // create index html page
-    Glib::ustring html_text = str::format(HTML_HEADER, _pCtMainWin->get_ct_storage()->get_file_name());
-    if (options.index_in_page)
-    {
-        html_text += "<div class='two-panels'>\n<div class='tree-panel'>\n";
-        html_text += tree_links_text;
-        html_text += "</div>\n";
-        html_text += "<div class='page-panel'><iframe src='' id='page_frame'></iframe></div>";
-        html_text += "</div>"; // two-panels
-    }
-    else
-        html_text += "<div class='page'>" + tree_links_text + "</div>";
-    html_text += "<script src='res/script3.js'></script>\n";
-    html_text += HTML_FOOTER;
+    Glib::ustring html_text = get_index_html(_pCtMainWin->get_ct_storage()->get_file_name(), tree_links_text, options.index_in_page);
     fs::path node_html_filepath = _export_dir / "index.html";
     g_file_set_contents(node_html_filepath.c_str(), html_text.c_str(), (gssize)html_text.bytes(), nullptr);
 
-    // create html pages
-    // function to iterate nodes
+    // the nodes in export order, the text buffers are only accessed from the main thread
+    std::vector<CtTreeIter> nodes;
     std::function<void(CtTreeIter)> traverseFunc;
-    traverseFunc = [this, &traverseFunc, &options, &tree_links_text](CtTreeIter tree_iter) {
-        node_export_to_html(tree_iter, options, tree_links_text, -1, -1);
+    traverseFunc = [this, &traverseFunc, &nodes](CtTreeIter tree_iter) {
+        nodes.push_back(tree_iter);
         for (auto& child: tree_iter->children())
             traverseFunc(_pCtMainWin->get_tree_store().to_ct_tree_iter(child));
     };
-    // start to iterarte nodes
     tree_iter = all_tree ? _pCtMainWin->get_tree_store().get_ct_iter_first() : _pCtMainWin->curr_tree_iter();
     for (;tree_iter; ++tree_iter)
     {
         traverseFunc(tree_iter);
         if (!all_tree) break;
     }
+
+    std::unique_ptr<CtExportManifest> pManifest;
+    if (options.incremental)
+    {
+        // a change of the nodes ids, syntaxes or paths may change the pages links, so all of them have to be checked
+        std::string layout = _pCtMainWin->get_ct_storage()->get_file_path().string() + "\n" +
+            std::to_string(options.include_node_name) + std::to_string(options.index_in_page) + "\n";
+        for (CtTreeIter& node_iter : nodes)
+            layout += std::to_string(node_iter.get_node_id()) + "\t" + node_iter.get_node_syntax_highlighting() + "\t" +
+                _get_html_filename(node_iter) + "\n";
+        pManifest = std::make_unique<CtExportManifest>(_export_dir, layout);
+    }
+
+    // the main thread takes the snapshots while the workers serialize and write them
+    const size_t max_in_flight = std::max<size_t>(1, thread_pool.get_workers_num()) * NODES_IN_FLIGHT_PER_WORKER;
+    ThreadSafeDEQueue<size_t, std::numeric_limits<size_t>::max()> written_queue;
+    std::atomic<bool> cancelled{false};
+    size_t nodes_submitted{0};
+    size_t nodes_written{0};
+    bool progress_stop{false};
+    auto f_wait_written = [&](const size_t max_pending) {
+        for (;;) {
+            while (written_queue.pop_front_for(std::chrono::milliseconds{0})) ++nodes_written;
+            if (progress && !progress(nodes_written, nodes.size())) {
+                progress_stop = true;
+                return;
+            }
+            if (nodes_submitted - nodes_written <= max_pending) return;
+            if (written_queue.pop_front_for(std::chrono::milliseconds{50})) ++nodes_written;
+        }
+    };
+    CtBuffersCache& buffers_cache = _pCtMainWin->get_tree_store().get_buffers_cache();
+    CtThreadPool::TaskGroup task_group{thread_pool};
+    auto on_scope_exit = scope_guard([&](void*) { cancelled = true; }); // then the group waits for the workers
+    for (CtTreeIter& node_iter : nodes)
+    {
+        if (pManifest && pManifest->keep_node_if_unchanged(node_iter.get_node_id(), node_iter.get_node_modification_time()))
+        {
+            written_queue.push_back(0);
+            ++nodes_submitted;
+            f_wait_written(max_in_flight);
+            if (progress_stop) break;
+            continue;
+        }
+        auto pSnapshot = std::make_shared<CtHtmlNodeSnapshot>();
+        _node_snapshot(node_iter, options, tree_links_text, -1, -1, *pSnapshot);
+        auto f_write = [pSnapshot, pManifest = pManifest.get(), &cancelled, &written_queue]() {
+            if (!cancelled) {
+                write_node_snapshot(*pSnapshot, pManifest);
+            }
+            written_queue.push_back(0);
+        };
+        if (thread_pool.get_workers_num() > 0) task_group.run(f_write);
+        else f_write(); // no worker to wait for
+        ++nodes_submitted;
+        // the pages keep what they need, the buffers loaded for them can be released
+        if (buffers_cache.is_over_budget()) {
+            buffers_cache.release_over_budget();
+        }
+        // not all the nodes content in memory at once, the snapshots not written yet are bounded
+        f_wait_written(max_in_flight);
+        if (progress_stop) break;
+    }
+    if (!progress_stop) {
+        f_wait_written(0);
+    }
+    if (progress_stop) {
+        cancelled = true;
+        task_group.cancel();
+    }
+    else {
+        task_group.wait();
+        if (pManifest) {
+            pManifest->commit();
+        }
+    }
+    return !progress_stop;
 }
 
 // Export All Nodes To Single HTML
@@ -212,44 +213,14 @@ void CtExport2Html::nodes_all_export_to_single_html(bool all_tree, const CtExpor
     Glib::ustring tree_links_text = "";
     std::function<void(CtTreeIter, int)> traverseFunc;
     traverseFunc = [this, &traverseFunc, rFileStream](CtTreeIter tree_iter, int node_level) {
-        Glib::ustring html_text = "<div class='page'>";
-        html_text += "<h1 class='title level-" + std::to_string(node_level) + "'>" + tree_iter.get_node_name() + "</h1><br/>";
-        std::vector<Glib::ustring> html_slots;
-        std::vector<CtAnchoredWidget*> widgets;
-        if (tree_iter.get_node_is_rich_text())
-        {
-            _html_get_from_treestore_node(tree_iter, -1, -1, html_slots, widgets);
-            int images_count = 0;
-            for (size_t i = 0; i < html_slots.size(); ++i)
-            {
-                html_text += html_slots[i];
-                if (i < widgets.size())
-                {
-                    try
-                    {
-                        if (CtImageEmbFile* embfile = dynamic_cast<CtImageEmbFile*>(widgets[i]))
-                            html_text += _get_embfile_html(embfile, tree_iter, _embed_dir);
-                        else if (CtImage* image = dynamic_cast<CtImage*>(widgets[i]))
-                            html_text += _get_image_html(image, _images_dir, images_count, &tree_iter);
-                        else if (CtTable* table = dynamic_cast<CtTable*>(widgets[i]))
-                            html_text += _get_table_html(table);
-                        else if (CtCodebox* codebox = dynamic_cast<CtCodebox*>(widgets[i]))
-                            html_text += _get_codebox_html(codebox);
-                    }
-                    catch (std::exception& ex)
-                    {
-                        spdlog::debug("caught ex: {}", ex.what());
-                    }
-                    catch (...)
-                    {
-                        spdlog::debug("unknown ex");
-                    }
-                }
-            }
-        }
-        else
-            html_text += _html_get_from_code_buffer(tree_iter.get_node_text_buffer(), -1, -1, tree_iter.get_node_syntax_highlighting());
-        html_text += "</div>"; // div class='page'
+        CtHtmlNodeSnapshot snapshot;
+        snapshot.html_head = "<div class='page'>";
+        snapshot.html_head += "<h1 class='title level-" + std::to_string(node_level) + "'>" + tree_iter.get_node_name() + "</h1><br/>";
+        _node_body_snapshot(tree_iter, -1, -1, snapshot);
+        snapshot.html_tail = "</div>"; // div class='page'
+        for (const auto& file : snapshot.files)
+            _write_file(file.first, file.second.c_str(), file.second.size());
+        Glib::ustring html_text = serialize_node_body(snapshot);
         rFileStream->write(html_text.c_str(), html_text.bytes());
         html_text.clear();
 
@@ -273,29 +244,192 @@ void CtExport2Html::nodes_all_export_to_single_html(bool all_tree, const CtExpor
     rFileStream->close();
 }
 
+// Take the content of a node page, to be serialized and written by write_node_snapshot
+void CtExport2Html::_node_snapshot(CtTreeIter tree_iter, const CtExportOptions& options, const Glib::ustring& index,
+                                   int sel_start, int sel_end, CtHtmlNodeSnapshot& snapshot)
+{
+    snapshot.node_id = tree_iter.get_node_id();
+    snapshot.filepath = _export_dir / _get_html_filename(tree_iter);
+    snapshot.html_head = get_node_page_head(tree_iter.get_node_name(), options, index != "");
+
+    _node_body_snapshot(tree_iter, sel_start, sel_end, snapshot);
+
+    snapshot.html_tail += get_node_page_tail(options, index != "");
+}
+
+Glib::ustring CtExport2Html::get_node_page_head(const Glib::ustring& node_name, const CtExportOptions& options, const bool has_index)
+{
+    Glib::ustring html_head = str::format(HTML_HEADER, node_name);
+    if (has_index && options.index_in_page)
+    {
+        auto script = R"HTML(
+            <script type='text/javascript'>
+                function in_frame () { try { return window.self !== window.top; } catch (e) { return true; } }
+                if (!in_frame()) {
+                    var page = location.pathname.substring(location.pathname.lastIndexOf("/") + 1);
+                    window.location = 'index.html#' + page;
+                }
+            </script>)HTML";
+        html_head = str::replace(html_head, "<script></script>", script);
+    }
+    html_head += "<div class='page'>";
+    if (options.include_node_name)
+        html_head += "<h1 class='title'>" + node_name + "</h1><br/>";
+    return html_head;
+}
+
+Glib::ustring CtExport2Html::get_node_page_tail(const CtExportOptions& options, const bool has_index)
+{
+    Glib::ustring html_tail;
+    if (has_index && !options.index_in_page)
+        html_tail += Glib::ustring("<p align=\"center\">") + "<img src=\"" + Glib::build_filename("images", "home.svg") + "\" height=\"22\" width=\"22\">" +
+                CtConst::CHAR_SPACE + CtConst::CHAR_SPACE + "<a href=\"index.html\">" + _("Index") + "</a></p>";
+    html_tail += "</div>"; // div class='page'
+    html_tail += HTML_FOOTER;
+    return html_tail;
+}
+
+// Take the text slots and the widgets of a node, a code node goes to html_head already serialized
+void CtExport2Html::_node_body_snapshot(CtTreeIter tree_iter, int sel_start, int sel_end, CtHtmlNodeSnapshot& snapshot)
+{
+    if (!tree_iter.get_node_is_rich_text())
+    {
+        snapshot.html_head += _html_get_from_code_buffer(tree_iter.get_node_text_buffer(), sel_start, sel_end, tree_iter.get_node_syntax_highlighting());
+        return;
+    }
+    auto curr_buffer = tree_iter.get_node_text_buffer();
+    int start_offset = sel_start == -1 ? 0 : sel_start;
+    int images_count = 0;
+    for (CtAnchoredWidget* widget : tree_iter.get_anchored_widgets(sel_start, sel_end))
+    {
+        int end_offset = widget->getOffset();
+        snapshot.slots.emplace_back();
+        _html_get_slot_runs(start_offset, end_offset, curr_buffer, snapshot.slots.back());
+        start_offset = end_offset;
+
+        Glib::ustring widget_html;
+        try
+        {
+            if (CtImageEmbFile* embfile = dynamic_cast<CtImageEmbFile*>(widget))
+                widget_html = _get_embfile_html(embfile, tree_iter, _embed_dir, snapshot.files);
+            else if (CtImage* image = dynamic_cast<CtImage*>(widget))
+                widget_html = _get_image_html(image, _images_dir, images_count, &tree_iter, snapshot.files);
+            else if (CtTable* table = dynamic_cast<CtTable*>(widget))
+                widget_html = _get_table_html(table);
+            else if (CtCodebox* codebox = dynamic_cast<CtCodebox*>(widget))
+                widget_html = _get_codebox_html(codebox);
+        }
+        catch (std::exception& ex)
+        {
+            spdlog::debug("caught ex: {}", ex.what());
+        }
+        catch (...)
+        {
+            spdlog::debug("unknown ex");
+        }
+        snapshot.widgets_html.push_back(widget_html);
+    }
+    snapshot.slots.emplace_back();
+    _html_get_slot_runs(start_offset, sel_end, curr_buffer, snapshot.slots.back());
+}
+
+void CtExport2Html::write_node_snapshot(const CtHtmlNodeSnapshot& snapshot, CtExportManifest* pManifest)
+{
+    auto f_write_if_changed = [&](const fs::path& filepath, const char* data, const size_t size) {
+        if (!pManifest || pManifest->add_file(snapshot.node_id, filepath, CtExportManifest::get_digest(data, size)))
+            _write_file(filepath, data, size);
+    };
+    for (const auto& file : snapshot.files)
+        f_write_if_changed(file.first, file.second.c_str(), file.second.size());
+    Glib::ustring html_text = serialize_node_body(snapshot);
+    f_write_if_changed(snapshot.filepath, html_text.c_str(), html_text.bytes());
+}
+
+Glib::ustring CtExport2Html::serialize_node_body(const CtHtmlNodeSnapshot& snapshot)
+{
+    Glib::ustring html_text = snapshot.html_head;
+    for (size_t i = 0; i < snapshot.slots.size(); ++i)
+    {
+        html_text += _html_serialize_slot(snapshot.slots[i]);
+        if (i < snapshot.widgets_html.size())
+            html_text += snapshot.widgets_html[i];
+    }
+    html_text += snapshot.html_tail;
+    return html_text;
+}
+
+void CtExport2Html::_write_file(const fs::path& filepath, const char* data, const size_t size)
+{
+    GError* pError{nullptr};
+    if (!g_file_set_contents(filepath.c_str(), data, (gssize)size, &pError)) {
+        spdlog::error("{}: {}", filepath, pError ? pError->message : "?");
+        if (pError) g_error_free(pError);
+    }
+}
+
 // Creating the Tree Links Text - iter
 void CtExport2Html::_tree_links_text_iter(CtTreeIter tree_iter, Glib::ustring& tree_links_text, int tree_count_level, bool index_in_page)
 {
-    Glib::ustring href = _get_html_filename(tree_iter);
-    Glib::ustring node_name = tree_iter.get_node_name();
-    if (tree_iter->children().empty())
+    const bool has_children = !tree_iter->children().empty();
+    tree_links_text += get_tree_link_html(_get_html_filename(tree_iter), tree_iter.get_node_name(), has_children, index_in_page);
+    if (has_children)
+    {
+        for (auto& child: tree_iter->children())
+            _tree_links_text_iter(_pCtMainWin->get_tree_store().to_ct_tree_iter(child), tree_links_text, tree_count_level + 1, index_in_page);
+        tree_links_text += "</ul>\n";
+    }
+}
+
+Glib::ustring CtExport2Html::get_tree_links_head()
+{
+    return // dont' use R"HTML, it gives unnecessary " "
+          "<div class='tree'>\n"
+          "<p>\n"
+          "<strong>Index</strong></br>\n"
+          "<button onclick='expandAllSubtrees()'>Expand All</button> <button onclick='collapseAllSubtrees()'>Collapse All</button>\n"
+          "</p>\n"
+          "<ul class='outermost'>\n";
+}
+
+Glib::ustring CtExport2Html::get_tree_links_tail()
+{
+    return "</ul>\n</div>\n";
+}
+
+// The link of a node in the tree links, a node with children opens the list of their links closed by "</ul>\n"
+Glib::ustring CtExport2Html::get_tree_link_html(const Glib::ustring& href, const Glib::ustring& node_name, const bool has_children, const bool index_in_page)
+{
+    if (!has_children)
     {
         if (index_in_page)
-            tree_links_text += "<li class='leaf'><a href='#' onclick=\"changeFrame('" + href + "')\">" + node_name + "</a></li>\n";
-        else
-            tree_links_text += "<li class='leaf'><a href='" + href + "'>" + node_name + "</a></li>\n";
+            return "<li class='leaf'><a href='#' onclick=\"changeFrame('" + href + "')\">" + node_name + "</a></li>\n";
+        return "<li class='leaf'><a href='" + href + "'>" + node_name + "</a></li>\n";
     }
+    Glib::ustring tree_link_html;
+    if (index_in_page)
+        tree_link_html = "<li><button onclick='toggleSubTree(this)'>-</button> <a href='#' onclick=\"changeFrame('" + href + "')\">" + node_name + "</a></li>";
     else
+        tree_link_html = "<li><button onclick='toggleSubTree(this)'>-</button> <a href='" + href + "'>" + node_name +"</a></li>";
+    tree_link_html += "<ul class='subtree'>\n";
+    return tree_link_html;
+}
+
+Glib::ustring CtExport2Html::get_index_html(const Glib::ustring& title, const Glib::ustring& tree_links_text, const bool index_in_page)
+{
+    Glib::ustring html_text = str::format(HTML_HEADER, title);
+    if (index_in_page)
     {
-        if (index_in_page)
-            tree_links_text += "<li><button onclick='toggleSubTree(this)'>-</button> <a href='#' onclick=\"changeFrame('" + href + "')\">" + node_name + "</a></li>";
-        else
-            tree_links_text += "<li><button onclick='toggleSubTree(this)'>-</button> <a href='" + href + "'>" + node_name +"</a></li>";
-        tree_links_text += "<ul class='subtree'>\n";
-        for (auto& child: tree_iter->children())
-            _tree_links_text_iter(_pCtMainWin->get_tree_store().to_ct_tree_iter(child), tree_links_text, tree_count_level + 1, index_in_page);
-        tree_links_text += "</ul>\n";
+        html_text += "<div class='two-panels'>\n<div class='tree-panel'>\n";
+        html_text += tree_links_text;
+        html_text += "</div>\n";
+        html_text += "<div class='page-panel'><iframe src='' id='page_frame'></iframe></div>";
+        html_text += "</div>"; // two-panels
     }
+    else
+        html_text += "<div class='page'>" + tree_links_text + "</div>";
+    html_text += "<script src='res/script3.js'></script>\n";
+    html_text += HTML_FOOTER;
+    return html_text;
 }
 
 // Returns the HTML given the text buffer and iter bounds
@@ -307,6 +441,7 @@ Glib::ustring CtExport2Html::selection_export_to_html(Glib::RefPtr<Gtk::TextBuff
     {
         int images_count = 0;
         fs::path tempFolder = _pCtMainWin->get_ct_tmp()->getHiddenDirPath("IMAGE_TEMP_FOLDER");
+        std::vector<std::pair<fs::path, std::string>> files;
 
         int start_offset = start_iter.get_offset();
         std::list<CtAnchoredWidget*> widgets = _pCtMainWin->curr_tree_iter().get_anchored_widgets(start_iter.get_offset(), end_iter.get_offset());
@@ -314,12 +449,14 @@ Glib::ustring CtExport2Html::selection_export_to_html(Glib::RefPtr<Gtk::TextBuff
         {
             int end_offset = widget->getOffset();
             html_text +=_html_process_slot(start_offset, end_offset, text_buffer);
-            if (CtImage* image = dynamic_cast<CtImage*>(widget)) html_text += _get_image_html(image, tempFolder, images_count, nullptr);
+            if (CtImage* image = dynamic_cast<CtImage*>(widget)) html_text += _get_image_html(image, tempFolder, images_count, nullptr, files);
             else if (CtTable* table = dynamic_cast<CtTable*>(widget)) html_text += _get_table_html(table);
             else if (CtCodebox* codebox = dynamic_cast<CtCodebox*>(widget)) html_text += _get_codebox_html(codebox);
             start_offset = end_offset;
         }
         html_text += _html_process_slot(start_offset, end_iter.get_offset(), text_buffer);
+        for (const auto& file : files)
+            _write_file(file.first, file.second.c_str(), file.second.size());
     }
     else
     {
@@ -349,21 +486,23 @@ Glib::ustring CtExport2Html::codebox_export_to_html(CtCodebox* codebox)
 }
 
 // Returns the HTML embedded file
-Glib::ustring CtExport2Html::_get_embfile_html(CtImageEmbFile* embfile, CtTreeIter tree_iter, fs::path embed_dir)
+Glib::ustring CtExport2Html::_get_embfile_html(CtImageEmbFile* embfile, CtTreeIter tree_iter, fs::path embed_dir,
+                                               std::vector<std::pair<fs::path, std::string>>& files)
 {
-    Glib::ustring embfile_align_text = _get_object_alignment_string(embfile->getJustification());
+    Glib::ustring embfile_align_text = get_object_alignment_string(embfile->getJustification());
     fs::path embfile_name = std::to_string(tree_iter.get_node_id()) + "-" +  embfile->get_file_name().string();
     fs::path embfile_rel_path = "EmbeddedFiles" / embfile_name;
     Glib::ustring embfile_html = "<table style=\"" + embfile_align_text + "\"><tr><td><a href=\"" +
             embfile_rel_path.string_unix() + "\">Linked file: " + embfile->get_file_name().string() + " </a></td></tr></table>";
 
-    g_file_set_contents((embed_dir / embfile_name).c_str(), embfile->get_raw_blob().c_str(), (gssize)embfile->get_raw_blob().size(), nullptr);
+    files.emplace_back(embed_dir / embfile_name, embfile->get_raw_blob());
 
     return embfile_html;
 }
 
 // Returns the HTML Image
-Glib::ustring CtExport2Html::_get_image_html(CtImage* image, const fs::path& images_dir, int& images_count, CtTreeIter* tree_iter)
+Glib::ustring CtExport2Html::_get_image_html(CtImage* image, const fs::path& images_dir, int& images_count, CtTreeIter* tree_iter,
+                                             std::vector<std::pair<fs::path, std::string>>& files)
 {
     if (CtImageAnchor* imageAnchor = dynamic_cast<CtImageAnchor*>(image))
         return "<a name=\"" + imageAnchor->get_anchor_name() + "\"></a>";
@@ -386,9 +525,10 @@ Glib::ustring CtExport2Html::_get_image_html(CtImage* image, const fs::path& ima
     {
         Glib::ustring href = _get_href_from_link_prop_val(png->get_link());
         image_html = "<a href=\"" + href + "\">" + image_html + "</a>";
+        files.emplace_back(images_dir / image_name, png->get_raw_blob());
     }
-
-    image->save(images_dir / image_name, "png");
+    else
+        image->save(images_dir / image_name, "png");
     return image_html;
 }
 
@@ -403,14 +543,19 @@ Glib::ustring CtExport2Html::_get_codebox_html(CtCodebox* codebox)
 
 // Returns the HTML Table
 Glib::ustring CtExport2Html::_get_table_html(CtTable* table)
+{
+    return get_table_html(table->get_table_matrix());
+}
+
+Glib::ustring CtExport2Html::get_table_html(const CtTableMatrix& tableMatrix)
 {
     Glib::ustring table_html = "<table class=\"table\">";
     bool first = true;
-    for (const auto& row: table->get_table_matrix())
+    for (size_t row = 0; row < tableMatrix.get_rows_num(); ++row)
     {
         table_html += "<tr>";
-        for (auto cell: row) {
-            Glib::ustring content = str::xml_escape(cell->get_text_content());
+        for (size_t col = 0; col < tableMatrix.get_cols_num(); ++col) {
+            Glib::ustring content = str::xml_escape(tableMatrix.get_cell(row, col));
             if (content.empty()) content = " "; // Otherwise the table will render with squashed cells
     
             if (first) {
@@ -498,37 +643,34 @@ Glib::ustring CtExport2Html::_html_get_from_code_buffer(const Glib::RefPtr<Gsv::
     return "<div class=\"codebox\">" + html_text + "</div>";
 }
 
-// Given a treestore iter returns the HTML rich text
-void CtExport2Html::_html_get_from_treestore_node(CtTreeIter node_iter, int sel_start, int sel_end,
-                                                  std::vector<Glib::ustring>& out_slots, std::vector<CtAnchoredWidget*>& out_widgets)
+// Process a Single HTML Slot
+Glib::ustring CtExport2Html::_html_process_slot(int start_offset, int end_offset, Glib::RefPtr<Gtk::TextBuffer> curr_buffer)
 {
-    auto curr_buffer = node_iter.get_node_text_buffer();
-    auto widgets = node_iter.get_anchored_widgets(sel_start, sel_end);
-    out_widgets = std::vector<CtAnchoredWidget*>(widgets.begin(), widgets.end()); // copy from list to vector
-
-    out_slots.clear();
-    int start_offset = sel_start == -1 ? 0 : sel_start;
-    for (auto widget: out_widgets)
-    {
-        int end_offset = widget->getOffset();
-        out_slots.push_back(_html_process_slot(start_offset, end_offset, curr_buffer));
-        start_offset = end_offset;
-    }
-    if (sel_end == -1)
-        out_slots.push_back(_html_process_slot(start_offset, -1, curr_buffer));
-    else
-        out_slots.push_back(_html_process_slot(start_offset, sel_end, curr_buffer));
+    std::vector<CtHtmlTextRun> runs;
+    _html_get_slot_runs(start_offset, end_offset, curr_buffer, runs);
+    return _html_serialize_slot(runs);
 }
 
-
-// Process a Single HTML Slot
-Glib::ustring CtExport2Html::_html_process_slot(int start_offset, int end_offset, Glib::RefPtr<Gtk::TextBuffer> curr_buffer)
+// Take the text runs of a slot with their attributes, the links resolved as they need the tree
+void CtExport2Html::_html_get_slot_runs(int start_offset, int end_offset, Glib::RefPtr<Gtk::TextBuffer> curr_buffer,
+                                        std::vector<CtHtmlTextRun>& runs)
 {
-    Glib::ustring curr_html_text = "";
     CtTextIterUtil::generic_process_slot(start_offset, end_offset, curr_buffer,
                                          [&](Gtk::TextIter& start_iter, Gtk::TextIter& curr_iter, CtCurrAttributesMap& curr_attributes) {
-        curr_html_text += _html_text_serialize(start_iter, curr_iter, curr_attributes);
+        CtHtmlTextRun run{start_iter.get_text(curr_iter), curr_attributes, ""};
+        if (run.text.empty()) return;
+        const auto link_it = curr_attributes.find(CtConst::TAG_LINK);
+        if (link_it != curr_attributes.end() && !link_it->second.empty())
+            run.href = _get_href_from_link_prop_val(link_it->second);
+        runs.push_back(std::move(run));
     });
+}
+
+Glib::ustring CtExport2Html::_html_serialize_slot(const std::vector<CtHtmlTextRun>& runs)
+{
+    Glib::ustring curr_html_text = "";
+    for (const CtHtmlTextRun& run : runs)
+        curr_html_text += _html_text_serialize(run);
 
     curr_html_text = str::replace(curr_html_text, "<br/><p ", "<p ");
     curr_html_text = str::replace(curr_html_text, "</p><br/>", "</p>");
@@ -540,13 +682,12 @@ Glib::ustring CtExport2Html::_html_process_slot(int start_offset, int end_offset
 }
 
 // Adds a slice to the HTML Text
-Glib::ustring CtExport2Html::_html_text_serialize(Gtk::TextIter start_iter,
-                                                  Gtk::TextIter end_iter,
-                                                  const CtCurrAttributesMap& curr_attributes)
+Glib::ustring CtExport2Html::_html_text_serialize(const CtHtmlTextRun& run)
 {
-    Glib::ustring inner_text = str::xml_escape(start_iter.get_text(end_iter));
+    Glib::ustring inner_text = str::xml_escape(run.text);
     if (inner_text.empty()) return inner_text;
     inner_text = str::replace(inner_text, CtConst::CHAR_NEWLINE, "<br />");
+    const CtCurrAttributesMap& curr_attributes = run.attributes;
 
     Glib::ustring html_attrs;
     bool superscript_active{false};
@@ -633,11 +774,10 @@ Glib::ustring CtExport2Html::_html_text_serialize(Gtk::TextIter start_iter,
         }
         else if (tag_property == CtConst::TAG_LINK) {
             // <a href="http://www.example.com/">link-text goes here</a>
-            Glib::ustring href = _get_href_from_link_prop_val(property_value);
-            if (href.empty()) {
+            if (run.href.empty()) {
                 continue;
             }
-            Glib::ustring html_text = "<a href=\"" + href + "\">" + inner_text + "</a>";
+            Glib::ustring html_text = "<a href=\"" + run.href + "\">" + inner_text + "</a>";
             return html_text;
         }
         html_attrs += Glib::ustring{tag_property.data()} + ":" + property_value + ";";
@@ -708,7 +848,7 @@ std::string CtExport2Html::link_process_folderpath(const std::string& folderpath
 }
 
 // Returns the style attribute(s) according to the alignment
-Glib::ustring CtExport2Html::_get_object_alignment_string(Glib::ustring alignment)
+Glib::ustring CtExport2Html::get_object_alignment_string(const Glib::ustring& alignment)
 {
     if (alignment == CtConst::TAG_PROP_VAL_CENTER) return "margin-left:auto;margin-right:auto";
     if (alignment == CtConst::TAG_PROP_VAL_RIGHT) return "margin-left:auto";
@@ -29,11 +29,44 @@
 #include "ct_treestore.h"
 #include "ct_dialogs.h" // CtExportOptions
 #include "ct_misc_utils.h"
+#include "ct_export_manifest.h"
+#include "ct_thread_pool.h"
+
+/**
+ * @brief Called on the main thread with the nodes exported so far and the nodes to export, returns false to cancel
+ */
+using CtExportProgressFunc = std::function<bool(size_t nodes_done, size_t nodes_total)>;
+
+/**
+ * @brief A rich text run taken from a node text buffer, with the href of its link resolved,
+ * serialized to HTML also from a thread other than the main one
+ */
+struct CtHtmlTextRun
+{
+    Glib::ustring       text;
+    CtCurrAttributesMap attributes;
+    std::string         href;
+};
+
+/**
+ * @brief The content of a node page taken on the main thread: the text slots to serialize,
+ * the HTML of the widgets in between and the files (images, embedded files) to write along with the page
+ */
+struct CtHtmlNodeSnapshot
+{
+    gint64                                        node_id{0};
+    fs::path                                      filepath;
+    Glib::ustring                                 html_head;
+    std::vector<std::vector<CtHtmlTextRun>>       slots;        // the widget i is between the slots i and i+1
+    std::vector<Glib::ustring>                    widgets_html;
+    Glib::ustring                                 html_tail;
+    std::vector<std::pair<fs::path, std::string>> files;
+};
 
 class CtExport2Html
 {
-private:
-    const Glib::ustring HTML_HEADER = R"HTML(<!doctype html>
+public:
+    inline static const Glib::ustring HTML_HEADER = R"HTML(<!doctype html>
 <html>
 <head>
   <meta http-equiv="content-type" content="text/html; charset=utf-8">
@@ -43,7 +76,7 @@ private:
 </head>
 <body>
 )HTML"; // after <body> should not be any whitespaces
-    const Glib::ustring HTML_FOOTER = R"HTML(
+    inline static const Glib::ustring HTML_FOOTER = R"HTML(
 </body>
 </html>
 )HTML";
@@ -52,32 +85,71 @@ public:
     CtExport2Html(CtMainWin* pCtMainWin);
 
     void          node_export_to_html(CtTreeIter tree_iter, const CtExportOptions& options, const Glib::ustring& index, int sel_start, int sel_end);
-    void          nodes_all_export_to_multiple_html(bool all_tree, const CtExportOptions& options);
+    /**
+     * @brief Takes the nodes content on the main thread while the pages are serialized and written on the thread pool;
+     * with options.incremental only the pages of the nodes changed since the previous export in the folder are written;
+     * a pool with no workers writes the pages one after the other on the main thread
+     * @return false if cancelled by progress, the pages written so far are left in the folder
+     */
+    bool          nodes_all_export_to_multiple_html(bool all_tree, const CtExportOptions& options, const CtExportProgressFunc& progress = nullptr,
+                                                    CtThreadPool& thread_pool = CtThreadPool::get_instance());
     void          nodes_all_export_to_single_html(bool all_tree, const CtExportOptions& options);
     Glib::ustring selection_export_to_html(Glib::RefPtr<Gtk::TextBuffer> text_buffer, Gtk::TextIter start_iter,
                                            Gtk::TextIter end_iter, const Glib::ustring& syntax_highlighting);
     Glib::ustring table_export_to_html(CtTable* table);
     Glib::ustring codebox_export_to_html(CtCodebox* codebox);
-    bool          prepare_html_folder(fs::path dir_place, fs::path new_folder, bool export_overwrite, fs::path& export_path);
+    /**
+     * @brief With incremental the folder of a previous export with a manifest is kept to be updated
+     */
+    bool          prepare_html_folder(fs::path dir_place, fs::path new_folder, bool export_overwrite, fs::path& export_path, bool incremental = false);
+
+    /**
+     * @brief The pieces of the pages that do not need the tree store, shared with the headless export
+     */
+    static Glib::ustring get_tree_links_head();
+    static Glib::ustring get_tree_links_tail();
+    static Glib::ustring get_tree_link_html(const Glib::ustring& href, const Glib::ustring& node_name, const bool has_children, const bool index_in_page);
+    static Glib::ustring get_index_html(const Glib::ustring& title, const Glib::ustring& tree_links_text, const bool index_in_page);
+    static Glib::ustring get_node_page_head(const Glib::ustring& node_name, const CtExportOptions& options, const bool has_index);
+    static Glib::ustring get_node_page_tail(const CtExportOptions& options, const bool has_index);
+    static Glib::ustring get_table_html(const CtTableMatrix& tableMatrix);
+    static Glib::ustring get_object_alignment_string(const Glib::ustring& alignment);
+    /**
+     * @brief Serializes the snapshot and writes the page and its files, also from a thread other than the main one
+     */
+    static void          write_node_snapshot(const CtHtmlNodeSnapshot& snapshot, CtExportManifest* pManifest = nullptr);
+    static Glib::ustring serialize_node_body(const CtHtmlNodeSnapshot& snapshot);
 
 private:
-    Glib::ustring _get_embfile_html(CtImageEmbFile* embfile, CtTreeIter tree_iter, fs::path embed_dir);
-    Glib::ustring _get_image_html(CtImage* image, const fs::path& images_dir, int& images_count, CtTreeIter* tree_iter);
+    Glib::ustring _get_embfile_html(CtImageEmbFile* embfile, CtTreeIter tree_iter, fs::path embed_dir,
+                                    std::vector<std::pair<fs::path, std::string>>& files);
+    /**
+     * @brief The png bytes go to files as stored in the document, not encoded again from the pixbuf
+     */
+    Glib::ustring _get_image_html(CtImage* image, const fs::path& images_dir, int& images_count, CtTreeIter* tree_iter,
+                                  std::vector<std::pair<fs::path, std::string>>& files);
     Glib::ustring _get_codebox_html(CtCodebox* codebox);
     Glib::ustring _get_table_html(CtTable* table);
 
     Glib::ustring _html_get_from_code_buffer(const Glib::RefPtr<Gsv::Buffer>& code_buffer, int sel_start, int sel_end, const std::string &syntax_highlighting);
-    void          _html_get_from_treestore_node(CtTreeIter node_iter, int sel_start, int sel_end,
-                                       std::vector<Glib::ustring>& out_slots, std::vector<CtAnchoredWidget*>& out_widgets);
+    void          _node_snapshot(CtTreeIter tree_iter, const CtExportOptions& options, const Glib::ustring& index,
+                                 int sel_start, int sel_end, CtHtmlNodeSnapshot& snapshot);
+    void          _node_body_snapshot(CtTreeIter tree_iter, int sel_start, int sel_end, CtHtmlNodeSnapshot& snapshot);
+    static void   _write_file(const fs::path& filepath, const char* data, const size_t size);
+
     Glib::ustring _html_process_slot(int start_offset, int end_offset, Glib::RefPtr<Gtk::TextBuffer> curr_buffer);
-    Glib::ustring _html_text_serialize(Gtk::TextIter start_iter, Gtk::TextIter end_iter, const CtCurrAttributesMap& curr_attributes);
+    void          _html_get_slot_runs(int start_offset, int end_offset, Glib::RefPtr<Gtk::TextBuffer> curr_buffer,
+                                      std::vector<CtHtmlTextRun>& runs);
+    static Glib::ustring _html_serialize_slot(const std::vector<CtHtmlTextRun>& runs);
+    static Glib::ustring _html_text_serialize(const CtHtmlTextRun& run);
     std::string _get_href_from_link_prop_val(Glib::ustring link_prop_val);
-    Glib::ustring _get_object_alignment_string(Glib::ustring alignment);
 
     void          _tree_links_text_iter(CtTreeIter tree_iter, Glib::ustring& tree_links_text, int tree_count_level, bool index_in_page);
 
     Glib::ustring _get_html_filename(CtTreeIter tree_iter);
 
+    static constexpr size_t NODES_IN_FLIGHT_PER_WORKER{4}; // snapshots waiting for the workers, bounding the memory
+
 public:
     static std::string link_process_filepath(const std::string& filepath_raw, const std::string& relative_to, const bool forHtml);
     static std::string link_process_folderpath(const std::string& folderpath_raw, const std::string& relative_to, const bool forHtml);
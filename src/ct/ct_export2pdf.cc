@@ -23,6 +23,7 @@
 
 #include "ct_export2pdf.h"
 #include "ct_dialogs.h"
+#include <algorithm>
 #include <utility>
 
 namespace {
@@ -527,9 +528,10 @@ void CtPrint::_process_pango_text(CtPrintData* print_data, CtPangoText* text_slo
     layout->set_markup(text_slot->text);
 
     int layout_count = layout->get_line_count();
-    for (int i = 0; i < layout_count; ++i)
+    int i = -1;
+    for (Glib::RefPtr<Pango::LayoutLine> layout_line : layout->get_lines())
     {
-        auto layout_line = layout->get_line(i);
+        ++i;
         auto size = _get_width_height_from_layout_line(layout_line);
 
         if (!pages.last_line().test_element_height(size.height, _page_height))
@@ -624,13 +626,21 @@ void CtPrint::_process_pango_codebox(CtPrintData* print_data, CtCodebox* codebox
 
     codebox->apply_syntax_highlighting(false/*forceReApply*/);
     Glib::ustring original_content = CtExport2Pango().pango_get_from_code_buffer(codebox->get_buffer(), -1, -1);
+    // laid out once, the pages are cut by the heights of its lines
+    auto original_layout = _codebox_get_layout(codebox, original_content, context);
+    std::vector<Glib::ustring> lines;
+    std::vector<double> lines_y;
+    _codebox_get_lines(original_content, original_layout, lines, lines_y);
+    const double slip_height = 2 * (CtConst::GRID_SLIP_OFFSET * _page_dpi_scale);
+    size_t first_line = 0;
     while (true)
     {
         // use content if it's ok
-        auto codebox_layout = _codebox_get_layout(codebox, original_content, context);
-        double codebox_height = _get_height_from_layout(codebox_layout);
+        double codebox_height = lines_y.back() - lines_y[first_line] + slip_height;
         if (pages.last_line().test_element_height(codebox_height + (BOX_OFFSET * _page_dpi_scale), _page_height))
         {
+            auto codebox_layout = first_line == 0 ? original_layout :
+                _codebox_get_layout(codebox, str::join(std::vector<Glib::ustring>(lines.begin() + first_line, lines.end()), CtConst::CHAR_NEWLINE), context);
             if (pages.last_line().cur_x == 0)
                 pages.last_line().cur_x = indent;
 
@@ -641,16 +651,17 @@ void CtPrint::_process_pango_codebox(CtPrintData* print_data, CtCodebox* codebox
         }
 
         // if content is too long, split it
-        Glib::ustring first_split, second_split;
-        _codebox_split_content(codebox, original_content, _page_height - pages.last_line().y, context, first_split, second_split);
-        if (first_split.empty()) // need a new page
+        const size_t split_lines_num = _codebox_split_content(lines_y, first_line, _page_height - pages.last_line().y);
+        if (split_lines_num == 0) // need a new page
         {
             pages.new_page();
         }
         else
         {
-            auto first_split_layout = _codebox_get_layout(codebox, first_split, context);
-            double codebox_height = _get_height_from_layout(first_split_layout);
+            const size_t split_line = first_line + split_lines_num;
+            auto first_split_layout = _codebox_get_layout(codebox,
+                str::join(std::vector<Glib::ustring>(lines.begin() + first_line, lines.begin() + split_line), CtConst::CHAR_NEWLINE), context);
+            double codebox_height = lines_y[split_line] - lines_y[first_line] + slip_height;
 
             if (pages.last_line().cur_x == 0)
                 pages.last_line().cur_x = indent;
@@ -660,7 +671,7 @@ void CtPrint::_process_pango_codebox(CtPrintData* print_data, CtCodebox* codebox
             pages.new_page();
 
             // go to to check the second part
-            original_content = second_split;
+            first_line = split_line;
         }
     }
 }
@@ -670,16 +681,32 @@ void CtPrint::_process_pango_table(CtPrintData *print_data, CtTable *table, int
     auto context = print_data->context;
     CtPrintPages& pages = print_data->pages;
 
+    // all the rows laid out once, the pages are cut by the heights of the rows
+    const CtPageTable::TableLayouts all_layouts = _table_get_layouts(table, 1, -1, context);
+    std::vector<double> all_rows_h, all_cols_w;
+    _table_get_grid(all_layouts, table->get_col_width_default(), all_rows_h, all_cols_w);
+    std::vector<double> rows_y(all_rows_h.size() + 1, 0);
+    for (size_t row = 0; row < all_rows_h.size(); ++row)
+        rows_y[row + 1] = rows_y[row] + all_rows_h[row] + (_table_line_thickness * _page_dpi_scale);
+    const double header_height = rows_y[1];
+    // the header row and the rows from first_row to last_row
+    auto get_split_layouts = [&](const int first_row, const int last_row) {
+        CtPageTable::TableLayouts split_layouts{all_layouts.front()};
+        split_layouts.insert(split_layouts.end(), all_layouts.begin() + first_row, all_layouts.begin() + last_row + 1);
+        return split_layouts;
+    };
+
+    const int rows_num = (int)all_layouts.size();
     int first_row = 1;
     while (true)
     {
         // use table is length is ok
-        std::vector<double> rows_h, cols_w;
-        auto table_layouts = _table_get_layouts(table, first_row, -1, context);
-        _table_get_grid(table_layouts, table->get_col_width_default(), rows_h, cols_w);
-        double table_height = _table_get_width_height(rows_h);
+        double table_height = header_height + rows_y[rows_num] - rows_y[std::min(first_row, rows_num)];
         if (pages.last_line().test_element_height(table_height + (BOX_OFFSET * _page_dpi_scale), _page_height))
         {
+            auto table_layouts = first_row == 1 ? all_layouts : get_split_layouts(first_row, rows_num - 1);
+            std::vector<double> rows_h, cols_w;
+            _table_get_grid(table_layouts, table->get_col_width_default(), rows_h, cols_w);
             if (pages.last_line().cur_x == 0)
                 pages.last_line().cur_x = indent;
             pages.last_line().set_height(table_height + (BOX_OFFSET * _page_dpi_scale));
@@ -689,16 +716,15 @@ void CtPrint::_process_pango_table(CtPrintData *print_data, CtTable *table, int
         }
 
         // if table is too long, split it
-        int split_row = _table_split_content(table, first_row, _page_height - pages.last_line().y - (BOX_OFFSET * _page_dpi_scale), context);
+        int split_row = _table_split_content(rows_y, first_row, _page_height - pages.last_line().y - (BOX_OFFSET * _page_dpi_scale));
         if (split_row == -1) // need a new page
         {
             pages.new_page();
         }
         else
         {
-            auto split_layouts = _table_get_layouts(table, first_row, split_row, context);
-            _table_get_grid(split_layouts, table->get_col_width_default(), rows_h, cols_w);
-            double table_height = _table_get_width_height(rows_h);
+            auto split_layouts = get_split_layouts(first_row, split_row);
+            double table_height = header_height + rows_y[split_row + 1] - rows_y[first_row];
             if (pages.last_line().cur_x == 0)
                 pages.last_line().cur_x = indent;
             pages.last_line().set_height(table_height + (BOX_OFFSET * _page_dpi_scale));
@@ -725,15 +751,14 @@ Glib::RefPtr<Pango::Layout> CtPrint::_codebox_get_layout(CtCodebox* codebox, Gli
     return layout;
 }
 
-// Split Long CodeBoxes
-void CtPrint::_codebox_split_content(CtCodebox* codebox, Glib::ustring original_content, const int check_height, const Glib::RefPtr<Gtk::PrintContext>& context,
-                                     Glib::ustring& first_split, Glib::ustring& second_split)
+void CtPrint::_codebox_get_lines(const Glib::ustring& original_content, Glib::RefPtr<Pango::Layout> codebox_layout,
+                                 std::vector<Glib::ustring>& lines, std::vector<double>& lines_y)
 {
-    std::vector<Glib::ustring> original_splitted_pango = str::split(original_content, CtConst::CHAR_NEWLINE);
+    lines = str::split(original_content, CtConst::CHAR_NEWLINE);
     // fix for not-closed span, I suppose
-    for (size_t i = 0; i < original_splitted_pango.size(); ++i)
+    for (size_t i = 0; i + 1 < lines.size(); ++i)
     {
-        auto& element = original_splitted_pango[i];
+        auto& element = lines[i];
         Glib::ustring::size_type last_close = element.rfind("</span");
         Glib::ustring::size_type last_open = element.rfind("<span");
         if (last_close < element.size() and last_open < element.size() and last_close < last_open)
@@ -742,50 +767,63 @@ void CtPrint::_codebox_split_content(CtCodebox* codebox, Glib::ustring original_
             Glib::ustring::size_type end_non_closed_span_idx = non_closed_span.find(">");
             if (end_non_closed_span_idx < non_closed_span.size()) {
                 non_closed_span = non_closed_span.substr(0, end_non_closed_span_idx+1);
-                original_splitted_pango[i] += "</span>";
-                original_splitted_pango[i+1] = non_closed_span + original_splitted_pango[i+1];
+                lines[i] += "</span>";
+                lines[i+1] = non_closed_span + lines[i+1];
             }
         }
     }
+    if (lines.empty())
+        lines.push_back("");
+
+    // each line of the content is a paragraph of the layout, wrapped in one or more layout lines
+    const std::string& layout_text = codebox_layout->get_text().raw();
+    std::vector<int> paragraph_starts{0};
+    for (size_t pos = layout_text.find('\n'); pos != std::string::npos; pos = layout_text.find('\n', pos + 1))
+        paragraph_starts.push_back((int)pos + 1);
+    std::vector<double> lines_h(lines.size(), 0);
+    size_t paragraph_idx = 0;
+    Pango::LayoutIter layout_iter = codebox_layout->get_iter();
+    do
+    {
+        Glib::RefPtr<const Pango::LayoutLine> layout_line = layout_iter.get_line_readonly();
+        while (paragraph_idx + 1 < paragraph_starts.size() && paragraph_starts[paragraph_idx + 1] <= layout_line->get_start_index())
+            ++paragraph_idx;
+        lines_h[std::min(paragraph_idx, lines_h.size() - 1)] += _get_width_height_from_layout_line(layout_line).height;
+    } while (layout_iter.next_line());
 
-    std::vector<Glib::ustring> splitted_pango;
-    while (splitted_pango.size() < original_splitted_pango.size())
+    lines_y.assign(lines.size() + 1, 0);
+    for (size_t i = 0; i < lines.size(); ++i)
+        lines_y[i + 1] = lines_y[i] + lines_h[i];
+}
+
+// Split Long CodeBoxes
+size_t CtPrint::_codebox_split_content(const std::vector<double>& lines_y, const size_t first_line, const int check_height)
+{
+    for (size_t end_line = first_line + 1; end_line < lines_y.size(); ++end_line)
     {
-        splitted_pango.push_back(original_splitted_pango[splitted_pango.size()]);
-        Glib::ustring new_content = str::join(splitted_pango, CtConst::CHAR_NEWLINE);
-        auto codebox_layout = _codebox_get_layout(codebox, new_content, context);
-        double codebox_height = _get_height_from_layout(codebox_layout);
+        double codebox_height = lines_y[end_line] - lines_y[first_line] + 2 * (CtConst::GRID_SLIP_OFFSET * _page_dpi_scale);
         if (codebox_height + BOX_OFFSET > check_height)
         {
-            if (splitted_pango.size() == 1)
-            {
-                // check_height is not enough, so we need a new page
-                first_split = "";
-                second_split = original_content;
-                return;
-            }
-
-            splitted_pango.erase(splitted_pango.end());
-            original_splitted_pango.erase(original_splitted_pango.begin(), original_splitted_pango.begin() + splitted_pango.size());
-            first_split = str::join(splitted_pango, CtConst::CHAR_NEWLINE);
-            second_split = str::join(original_splitted_pango, CtConst::CHAR_NEWLINE);
-            return;
+            // if not even the first line fits, check_height is not enough, so we need a new page
+            return end_line - 1 - first_line;
         }
     }
+    return 0;
 }
 
 CtPageTable::TableLayouts CtPrint::_table_get_layouts(CtTable* table, const int first_row, const int last_row, const Glib::RefPtr<Gtk::PrintContext>& context)
 {
     CtPageTable::TableLayouts table_layouts;
-    for (size_t row = 0; row < table->get_table_matrix().size(); ++row)
+    const CtTableMatrix& tableMatrix = table->get_table_matrix();
+    for (size_t row = 0; row < tableMatrix.get_rows_num(); ++row)
     {
         if (first_row != -1 && row > 0 && (int)row < first_row) continue; // skip row out of range except header
         if (last_row != -1 && (int)row > last_row) break;
 
         std::vector<Glib::RefPtr<Pango::Layout>> layouts;
-        for (size_t col = 0; col < table->get_table_matrix()[0].size(); ++col)
+        for (size_t col = 0; col < tableMatrix.get_cols_num(); ++col)
         {
-            Glib::ustring text = str::xml_escape(table->get_table_matrix()[row][col]->get_text_content());
+            Glib::ustring text = str::xml_escape(tableMatrix.get_cell(row, col));
             if (row == 0) text = "<b>" + text + "</b>";
             auto cell_layout = context->create_pango_layout();
             cell_layout->set_font_description(_rich_font);
@@ -810,9 +848,9 @@ void CtPrint::_table_get_grid(const CtPageTable::TableLayouts& table_layouts, co
         {
             auto cell_layout = table_layouts[row][col];
             double cell_height = 0;
-            for (int layout_line_idx = 0; layout_line_idx < cell_layout->get_line_count(); ++ layout_line_idx)
+            for (Glib::RefPtr<const Pango::LayoutLine> layout_line : cell_layout->get_lines_readonly())
             {
-                auto line_size = _get_width_height_from_layout_line(cell_layout->get_line(layout_line_idx));
+                auto line_size = _get_width_height_from_layout_line(layout_line);
                 cell_height += line_size.height;
                 cols_w[col] = std::max(cols_w[col], line_size.width);
             }
@@ -829,15 +867,12 @@ double CtPrint::_table_get_width_height(std::vector<double>& data)
     return acc;
 }
 
-int CtPrint::_table_split_content(CtTable* table, const int start_row, const int check_height, const Glib::RefPtr<Gtk::PrintContext>& context)
+int CtPrint::_table_split_content(const std::vector<double>& rows_y, const int start_row, const int check_height)
 {
-    int last_row = start_row;
-    for (; last_row < (int)table->get_table_matrix().size(); ++last_row)
+    const double header_height = rows_y[1];
+    for (int last_row = start_row; last_row + 1 < (int)rows_y.size(); ++last_row)
     {
-        std::vector<double> rows_h, cols_w;
-        auto table_layouts = _table_get_layouts(table, start_row, last_row, context);
-        _table_get_grid(table_layouts, table->get_col_width_default(), rows_h, cols_w);
-        double table_height = _table_get_width_height(rows_h);
+        double table_height = header_height + rows_y[last_row + 1] - rows_y[start_row];
         if (table_height > check_height)
         {
             if (start_row == last_row) // not enouth place for 1 row + a header, add a new page
@@ -859,9 +894,8 @@ void CtPrint::_draw_codebox_code(Cairo::RefPtr<Cairo::Context> cairo_context, Gl
 {
     double y = y0;
     cairo_context->set_source_rgb(0, 0, 0);
-    for (int layout_line_idx = 0; layout_line_idx < codebox_layout->get_line_count(); ++layout_line_idx)
+    for (Glib::RefPtr<Pango::LayoutLine> layout_line : codebox_layout->get_lines())
     {
-        auto layout_line = codebox_layout->get_line(layout_line_idx);
         double line_height = _get_width_height_from_layout_line(layout_line).height;
         cairo_context->move_to(x0 + (CtConst::GRID_SLIP_OFFSET * _page_dpi_scale), y + line_height);
         y += line_height;
@@ -911,9 +945,8 @@ void CtPrint::_draw_table_text(Cairo::RefPtr<Cairo::Context> cairo_context, cons
             double col_w = cols_w[j];
             auto layout_cell = table_layouts[i][j];
             double local_y = y;
-            for (int layout_line_id = 0; layout_line_id < layout_cell->get_line_count(); ++layout_line_id)
+            for (Glib::RefPtr<Pango::LayoutLine> layout_line : layout_cell->get_lines())
             {
-                auto layout_line = layout_cell->get_line(layout_line_id);
                 double line_height = _get_width_height_from_layout_line(layout_line).height;
                 cairo_context->move_to(x, local_y + line_height);
                 local_y += line_height;
@@ -939,9 +972,9 @@ Cairo::Rectangle CtPrint::_get_width_height_from_layout_line(Glib::RefPtr<const
 double CtPrint::_get_height_from_layout(Glib::RefPtr<Pango::Layout> layout)
 {
     double height = 0;
-    for (int layout_line_idx = 0; layout_line_idx < layout->get_line_count(); ++layout_line_idx)
+    // not get_line(i), that walks the list of lines from the first
+    for (Glib::RefPtr<const Pango::LayoutLine> layout_line : layout->get_lines_readonly())
     {
-        Glib::RefPtr<const Pango::LayoutLine> layout_line = layout->get_line(layout_line_idx);
         double line_height = _get_width_height_from_layout_line(layout_line).height;
         height += line_height;
     }
@@ -953,9 +986,8 @@ double CtPrint::_get_height_from_layout(Glib::RefPtr<Pango::Layout> layout)
 double CtPrint::_get_width_from_layout(Glib::RefPtr<Pango::Layout> layout)
 {
     double width = 0;
-    for (int layout_line_idx = 0; layout_line_idx < layout->get_line_count(); ++layout_line_idx)
+    for (Glib::RefPtr<const Pango::LayoutLine> layout_line : layout->get_lines_readonly())
     {
-        Glib::RefPtr<const Pango::LayoutLine> layout_line = layout->get_line(layout_line_idx);
         double line_width = _get_width_height_from_layout_line(layout_line).width;
         if (line_width > width)
             width = line_width;
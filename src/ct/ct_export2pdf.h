@@ -211,13 +211,25 @@ private:
     void _process_pango_table(CtPrintData* print_data, CtTable* table, int indent);
 
     Glib::RefPtr<Pango::Layout> _codebox_get_layout(CtCodebox* codebox, Glib::ustring content, Glib::RefPtr<Gtk::PrintContext> context);
-    void                        _codebox_split_content(CtCodebox* codebox, Glib::ustring original_content, const int check_height, const Glib::RefPtr<Gtk::PrintContext>& context,
-                                                       Glib::ustring& first_split, Glib::ustring& second_split);
+    /**
+     * @brief The markup lines of the codebox content, each closing its spans, and the y of each in its layout
+     * (lines_y[i] is the height of the lines before i, lines_y.back() the height of all)
+     */
+    void                        _codebox_get_lines(const Glib::ustring& original_content, Glib::RefPtr<Pango::Layout> codebox_layout,
+                                                   std::vector<Glib::ustring>& lines, std::vector<double>& lines_y);
+    /**
+     * @brief The number of lines from first_line fitting in check_height, 0 if a new page is needed
+     */
+    size_t                      _codebox_split_content(const std::vector<double>& lines_y, const size_t first_line, const int check_height);
 
     CtPageTable::TableLayouts   _table_get_layouts(CtTable* table, const int first_row, const int last_row, const Glib::RefPtr<Gtk::PrintContext>& context);
     void                        _table_get_grid(const CtPageTable::TableLayouts& table_layouts, const int col_min, std::vector<double>& rows_h, std::vector<double>& cols_w);
     double                      _table_get_width_height(std::vector<double>& data);
-    int                         _table_split_content(CtTable* table, const int start_row, const int check_height, const Glib::RefPtr<Gtk::PrintContext>& context);
+    /**
+     * @brief The last row from start_row fitting in check_height along with the header, -1 if a new page is needed
+     * @param rows_y the y of each row in the table with all the rows, see _process_pango_table
+     */
+    int                         _table_split_content(const std::vector<double>& rows_y, const int start_row, const int check_height);
 
     void _draw_codebox_box(Cairo::RefPtr<Cairo::Context> cairo_context, double x0, double y0, double codebox_width, double codebox_height);
     void _draw_codebox_code(Cairo::RefPtr<Cairo::Context> cairo_context, Glib::RefPtr<Pango::Layout> codebox_layout, double x0, double y0);
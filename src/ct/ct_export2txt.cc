@@ -23,6 +23,7 @@
 
 #include "ct_export2txt.h"
 #include "ct_main_win.h"
+#include "ct_export_manifest.h"
 
 CtExport2Txt::CtExport2Txt(CtMainWin* pCtMainWin)
  : _pCtMainWin(pCtMainWin)
@@ -50,16 +51,10 @@ Glib::ustring CtExport2Txt::node_export_to_txt(CtTreeIter tree_iter, fs::path fi
 void CtExport2Txt::nodes_all_export_to_txt(bool all_tree, fs::path export_dir, fs::path single_txt_filepath, CtExportOptions export_options)
 {
     // function to iterate nodes
-    Glib::ustring tree_plain_text;
+    std::vector<CtTreeIter> nodes;
     std::function<void(CtTreeIter)> traverseFunc;
-    traverseFunc = [this, &traverseFunc, &export_options, &tree_plain_text, &export_dir](CtTreeIter tree_iter) {
-        if (export_dir == "")
-            tree_plain_text += node_export_to_txt(tree_iter, "", export_options, -1, -1);
-        else
-        {
-            fs::path filepath = export_dir / (CtMiscUtil::get_node_hierarchical_name(tree_iter) + ".txt");
-            node_export_to_txt(tree_iter, filepath, export_options, -1, -1);
-        }
+    traverseFunc = [this, &traverseFunc, &nodes](CtTreeIter tree_iter) {
+        nodes.push_back(tree_iter);
         for (auto& child: tree_iter->children())
             traverseFunc(_pCtMainWin->get_tree_store().to_ct_tree_iter(child));
     };
@@ -71,8 +66,39 @@ void CtExport2Txt::nodes_all_export_to_txt(bool all_tree, fs::path export_dir, f
         if (!all_tree) break;
     }
 
-    if (single_txt_filepath != "")
-        g_file_set_contents(single_txt_filepath.c_str(), tree_plain_text.c_str(), (gssize)tree_plain_text.bytes(), nullptr);
+    if (export_dir == "")
+    {
+        Glib::ustring tree_plain_text;
+        for (CtTreeIter& node_iter : nodes)
+            tree_plain_text += node_export_to_txt(node_iter, "", export_options, -1, -1);
+        if (single_txt_filepath != "")
+            g_file_set_contents(single_txt_filepath.c_str(), tree_plain_text.c_str(), (gssize)tree_plain_text.bytes(), nullptr);
+        return;
+    }
+
+    std::vector<fs::path> filepaths;
+    for (CtTreeIter& node_iter : nodes)
+        filepaths.push_back(export_dir / (CtMiscUtil::get_node_hierarchical_name(node_iter) + ".txt"));
+    if (!export_options.incremental)
+    {
+        for (size_t i = 0; i < nodes.size(); ++i)
+            node_export_to_txt(nodes[i], filepaths[i], export_options, -1, -1);
+        return;
+    }
+
+    std::string layout = std::to_string(export_options.include_node_name) + "\n";
+    for (size_t i = 0; i < nodes.size(); ++i)
+        layout += std::to_string(nodes[i].get_node_id()) + "\t" + nodes[i].get_node_syntax_highlighting() + "\t" + filepaths[i].string() + "\n";
+    CtExportManifest manifest{export_dir, layout};
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        if (manifest.keep_node_if_unchanged(nodes[i].get_node_id(), nodes[i].get_node_modification_time()))
+            continue;
+        Glib::ustring plain_text = node_export_to_txt(nodes[i], "", export_options, -1, -1);
+        if (manifest.add_file(nodes[i].get_node_id(), filepaths[i], CtExportManifest::get_digest(plain_text.c_str(), plain_text.bytes())))
+            g_file_set_contents(filepaths[i].c_str(), plain_text.c_str(), (gssize)plain_text.bytes(), nullptr);
+    }
+    manifest.commit();
 }
 
 // Export the Buffer To Txt
@@ -99,11 +125,12 @@ Glib::ustring CtExport2Txt::selection_export_to_txt(Glib::RefPtr<Gtk::TextBuffer
 Glib::ustring CtExport2Txt::get_table_plain(CtTable* table_orig)
 {
     Glib::ustring table_plain = CtConst::CHAR_NEWLINE;
-    for (const auto& row: table_orig->get_table_matrix())
+    const CtTableMatrix& tableMatrix = table_orig->get_table_matrix();
+    for (size_t row = 0; row < tableMatrix.get_rows_num(); ++row)
     {
         table_plain += CtConst::CHAR_PIPE;
-        for (const auto& cell: row)
-            table_plain += CtConst::CHAR_SPACE + cell->get_text_content() + CtConst::CHAR_SPACE + CtConst::CHAR_PIPE;
+        for (size_t col = 0; col < tableMatrix.get_cols_num(); ++col)
+            table_plain += CtConst::CHAR_SPACE + tableMatrix.get_cell(row, col) + CtConst::CHAR_SPACE + CtConst::CHAR_PIPE;
         table_plain += CtConst::CHAR_NEWLINE;
     }
     return table_plain;
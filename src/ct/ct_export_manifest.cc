@@ -0,0 +1,164 @@
+/*
+ * ct_export_manifest.cc
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "ct_export_manifest.h"
+#include "ct_misc_utils.h"
+#include "ct_logging.h"
+#include <glibmm/keyfile.h>
+#include <set>
+
+const char CtExportManifest::FILENAME[]{".ct_export_manifest"};
+
+namespace {
+
+const char GROUP_MANIFEST[]{"manifest"};
+const char GROUP_NODE_PREFIX[]{"node_"};
+
+} // namespace (anonymous)
+
+/*static*/std::string CtExportManifest::get_digest(const char* data, const size_t size)
+{
+    g_autofree gchar* pDigest = g_compute_checksum_for_data(G_CHECKSUM_MD5, reinterpret_cast<const guchar*>(data), size);
+    return pDigest;
+}
+
+CtExportManifest::CtExportManifest(const fs::path& export_dir, const std::string& layout)
+ : _export_dir{export_dir}
+ , _layout_digest{get_digest(layout.c_str(), layout.size())}
+ , _export_time{g_get_real_time() / G_USEC_PER_SEC}
+{
+    _load();
+}
+
+void CtExportManifest::_load()
+{
+    if (not is_in_folder(_export_dir)) {
+        return;
+    }
+    try {
+        Glib::KeyFile keyFile;
+        keyFile.load_from_file((_export_dir / FILENAME).string());
+        _prev_export_time = keyFile.get_int64(GROUP_MANIFEST, "export_time");
+        _prev_layout_digest = keyFile.get_string(GROUP_MANIFEST, "layout");
+        const std::string prefix{GROUP_NODE_PREFIX};
+        for (const Glib::ustring& group : keyFile.get_groups()) {
+            if (not str::startswith(group, prefix)) {
+                continue;
+            }
+            NodeFiles& nodeFiles = _prev_nodes[std::stoll(group.substr(prefix.size()))];
+            nodeFiles.ts_lastsave = keyFile.get_int64(group, "ts_lastsave");
+            const std::vector<Glib::ustring> files = keyFile.get_string_list(group, "files");
+            const std::vector<Glib::ustring> digests = keyFile.get_string_list(group, "digests");
+            for (size_t i = 0; i < files.size() and i < digests.size(); ++i) {
+                nodeFiles.files[files[i]] = digests[i];
+            }
+        }
+    }
+    catch (Glib::Error& e) {
+        spdlog::error("CtExportManifest {}: {}", _export_dir / FILENAME, e.what());
+        _prev_layout_digest.clear();
+        _prev_nodes.clear();
+    }
+    catch (std::exception& e) {
+        spdlog::error("CtExportManifest {}: {}", _export_dir / FILENAME, e.what());
+        _prev_layout_digest.clear();
+        _prev_nodes.clear();
+    }
+}
+
+bool CtExportManifest::keep_node_if_unchanged(const gint64 node_id, const gint64 ts_lastsave)
+{
+    std::lock_guard<std::mutex> lock{_mutex};
+    NodeFiles& nodeFiles = _nodes[node_id];
+    nodeFiles.ts_lastsave = ts_lastsave;
+    if (_prev_layout_digest != _layout_digest) {
+        return false;
+    }
+    auto itPrev = _prev_nodes.find(node_id);
+    // a node modified in the same second as the previous export started may have been exported before the change
+    if (itPrev == _prev_nodes.end() or itPrev->second.ts_lastsave != ts_lastsave or ts_lastsave >= _prev_export_time) {
+        return false;
+    }
+    for (const auto& file : itPrev->second.files) {
+        if (not fs::is_regular_file(_export_dir / file.first)) {
+            return false;
+        }
+    }
+    nodeFiles.files = itPrev->second.files;
+    return true;
+}
+
+bool CtExportManifest::add_file(const gint64 node_id, const fs::path& filepath, const std::string& digest)
+{
+    const std::string relPath = fs::relative(filepath, _export_dir).string_unix();
+    bool unchanged{false};
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _nodes[node_id].files[relPath] = digest;
+        auto itPrev = _prev_nodes.find(node_id);
+        if (itPrev != _prev_nodes.end()) {
+            auto itFile = itPrev->second.files.find(relPath);
+            unchanged = itFile != itPrev->second.files.end() and itFile->second == digest;
+        }
+    }
+    return not unchanged or not fs::is_regular_file(filepath);
+}
+
+void CtExportManifest::commit()
+{
+    std::set<std::string> exportedFiles;
+    for (const auto& node : _nodes) {
+        for (const auto& file : node.second.files) {
+            exportedFiles.insert(file.first);
+        }
+    }
+    for (const auto& node : _prev_nodes) {
+        for (const auto& file : node.second.files) {
+            if (not exportedFiles.count(file.first)) {
+                fs::remove(_export_dir / file.first);
+            }
+        }
+    }
+
+    Glib::KeyFile keyFile;
+    keyFile.set_int64(GROUP_MANIFEST, "export_time", _export_time);
+    keyFile.set_string(GROUP_MANIFEST, "layout", _layout_digest);
+    for (const auto& node : _nodes) {
+        const Glib::ustring group = GROUP_NODE_PREFIX + std::to_string(node.first);
+        std::vector<Glib::ustring> files;
+        std::vector<Glib::ustring> digests;
+        for (const auto& file : node.second.files) {
+            files.push_back(file.first);
+            digests.push_back(file.second);
+        }
+        keyFile.set_int64(group, "ts_lastsave", node.second.ts_lastsave);
+        keyFile.set_string_list(group, "files", files);
+        keyFile.set_string_list(group, "digests", digests);
+    }
+    try {
+        keyFile.save_to_file((_export_dir / FILENAME).string());
+    }
+    catch (Glib::Error& e) {
+        spdlog::error("CtExportManifest {}: {}", _export_dir / FILENAME, e.what());
+    }
+}
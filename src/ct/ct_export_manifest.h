@@ -0,0 +1,83 @@
+/*
+ * ct_export_manifest.h
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include "ct_filesystem.h"
+#include <glib.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief The record, in a multiple files export folder, of the files written for each node, so that an export
+ * in the same folder rewrites only the files of the nodes changed since the previous one and removes those of the nodes removed
+ */
+class CtExportManifest
+{
+public:
+    static const char FILENAME[];
+
+    static bool is_in_folder(const fs::path& export_dir) { return fs::is_regular_file(export_dir / FILENAME); }
+    static std::string get_digest(const char* data, const size_t size);
+
+    /**
+     * @brief Reads the manifest of the previous export in export_dir, if any
+     * @param layout the nodes ids, syntaxes and file names and the export options; if it changed since
+     * the previous export all the nodes are exported again but only the files with a different content are written
+     */
+    CtExportManifest(const fs::path& export_dir, const std::string& layout);
+
+    /**
+     * @brief Keeps the files of a node not modified since the previous export
+     * @return false if the node has to be exported
+     */
+    bool keep_node_if_unchanged(const gint64 node_id, const gint64 ts_lastsave);
+    /**
+     * @brief Records a file of a node, also from a thread other than the main one
+     * @return false if the file in the folder has already this content, so it is not to be written
+     */
+    bool add_file(const gint64 node_id, const fs::path& filepath, const std::string& digest);
+    /**
+     * @brief Removes the files of the previous export not written by this one and writes the manifest
+     */
+    void commit();
+
+private:
+    struct NodeFiles
+    {
+        gint64 ts_lastsave{0};
+        std::map<std::string, std::string> files; // path relative to the export folder, digest
+    };
+
+    void _load();
+
+    const fs::path _export_dir;
+    const std::string _layout_digest;
+    const gint64 _export_time;
+    gint64 _prev_export_time{0};
+    std::string _prev_layout_digest;
+    std::map<gint64, NodeFiles> _prev_nodes;
+    std::mutex _mutex;
+    std::map<gint64, NodeFiles> _nodes;
+};
@@ -76,6 +76,26 @@ CtImage::~CtImage()
 {
 }
 
+/*static*/Glib::RefPtr<Gdk::Pixbuf> CtImage::decode_pixbuf(const std::string& rawBlob, const char* mimeType)
+{
+    try {
+        Glib::RefPtr<Gdk::PixbufLoader> rPixbufLoader = Gdk::PixbufLoader::create(mimeType, true);
+        rPixbufLoader->write(reinterpret_cast<const guint8*>(rawBlob.c_str()), rawBlob.size());
+        rPixbufLoader->close();
+        return rPixbufLoader->get_pixbuf();
+    }
+    catch (Glib::Error& e) {
+        spdlog::error("{} {}", __FUNCTION__, e.what());
+        return Glib::RefPtr<Gdk::Pixbuf>{};
+    }
+}
+
+size_t CtImage::get_memory_size()
+{
+    // the pixbuf is decoded, e.g. 4 bytes per pixel
+    return CtAnchoredWidget::get_memory_size() + (_rPixbuf ? _rPixbuf->get_byte_length() : 0u);
+}
+
 void CtImage::save(const fs::path& file_name, const Glib::ustring& type)
 {
     _rPixbuf->save(file_name.string(), type);
@@ -88,7 +108,9 @@ CtImagePng::CtImagePng(CtMainWin* pCtMainWin,
                        const int charOffset,
                        const std::string& justification)
  : CtImage(pCtMainWin, rawBlob, "image/png", charOffset, justification),
-   _link(link)
+   _link(link),
+   _rawBlob(rawBlob),
+   _rawBlobDirty(false)
 {
     signal_button_press_event().connect(sigc::mem_fun(*this, &CtImagePng::_on_button_press_event), false);
     update_label_widget();
@@ -106,13 +128,46 @@ CtImagePng::CtImagePng(CtMainWin* pCtMainWin,
     update_label_widget();
 }
 
-const std::string CtImagePng::get_raw_blob()
+CtImagePng::CtImagePng(CtMainWin* pCtMainWin,
+                       const std::string& rawBlob,
+                       Glib::RefPtr<Gdk::Pixbuf> pixBuf,
+                       const Glib::ustring& link,
+                       const int charOffset,
+                       const std::string& justification)
+ : CtImage(pCtMainWin, pixBuf, charOffset, justification),
+   _link(link),
+   _rawBlob(rawBlob),
+   _rawBlobDirty(false)
+{
+    signal_button_press_event().connect(sigc::mem_fun(*this, &CtImagePng::_on_button_press_event), false);
+    update_label_widget();
+}
+
+const std::string& CtImagePng::get_raw_blob()
+{
+    if (_rawBlobDirty) {
+        g_autofree gchar* pBuffer{NULL};
+        gsize buffer_size;
+        _rPixbuf->save_to_buffer(pBuffer, buffer_size, "png");
+        _rawBlob = std::string(pBuffer, buffer_size);
+        _rawBlobDirty = false;
+    }
+    return _rawBlob;
+}
+
+void CtImagePng::set_sqlite_row_stored(const int offset)
 {
-    g_autofree gchar* pBuffer{NULL};
-    gsize buffer_size;
-    _rPixbuf->save_to_buffer(pBuffer, buffer_size, "png");
-    const std::string rawBlob = std::string(pBuffer, buffer_size);
-    return rawBlob;
+    _sqliteRowOffset = offset;
+    _sqliteRowJustification = _justification;
+    _sqliteRowLink = _link;
+}
+
+bool CtImagePng::is_sqlite_row_stored(const int offset) const
+{
+    return not _rawBlobDirty and
+           _sqliteRowOffset == offset and
+           _sqliteRowJustification == _justification and
+           _sqliteRowLink == _link;
 }
 
 void CtImagePng::to_xml(xmlpp::Element* p_node_parent, const int offset_adjustment, CtStorageCache* storage_cache)
@@ -127,38 +182,15 @@ void CtImagePng::to_xml(xmlpp::Element* p_node_parent, const int offset_adjustme
     p_image_node->add_child_text(encodedBlob);
 }
 
-bool CtImagePng::to_sqlite(sqlite3* pDb, const gint64 node_id, const int offset_adjustment, CtStorageCache* storage_cache)
+bool CtImagePng::to_sqlite(CtSqliteStmtCache& stmtCache, const gint64 node_id, const int offset_adjustment, CtStorageCache*)
 {
-    bool retVal{true};
-    sqlite3_stmt *p_stmt;
-    if (sqlite3_prepare_v2(pDb, CtStorageSqlite::TABLE_IMAGE_INSERT, -1, &p_stmt, nullptr) != SQLITE_OK)
-    {
-        spdlog::error("{}: {}", CtStorageSqlite::ERR_SQLITE_PREPV2, sqlite3_errmsg(pDb));
-        retVal = false;
-    }
-    else
-    {
-        std::string rawBlob;
-        if (!storage_cache || !storage_cache->get_cached_image(this, rawBlob))
-           rawBlob = get_raw_blob();
-        const std::string link = _link;
-
-        sqlite3_bind_int64(p_stmt, 1, node_id);
-        sqlite3_bind_int64(p_stmt, 2, _charOffset+offset_adjustment);
-        sqlite3_bind_text(p_stmt, 3, _justification.c_str(), _justification.size(), SQLITE_STATIC);
-        sqlite3_bind_text(p_stmt, 4, "", -1, SQLITE_STATIC); // anchor name
-        sqlite3_bind_blob(p_stmt, 5, rawBlob.c_str(), rawBlob.size(), SQLITE_STATIC);
-        sqlite3_bind_text(p_stmt, 6, "", -1, SQLITE_STATIC); // filename
-        sqlite3_bind_text(p_stmt, 7, link.c_str(), link.size(), SQLITE_STATIC);
-        sqlite3_bind_int64(p_stmt, 8, 0); // time
-        if (sqlite3_step(p_stmt) != SQLITE_DONE)
-        {
-            spdlog::error("{}: {}", CtStorageSqlite::ERR_SQLITE_STEP, sqlite3_errmsg(pDb));
-            retVal = false;
-        }
-        sqlite3_finalize(p_stmt);
-    }
-    return retVal;
+    CtDecodedNodeText::Widget widget;
+    widget.type = CtAnchWidgType::ImagePng;
+    widget.offset = _charOffset+offset_adjustment;
+    widget.justification = _justification;
+    widget.link = _link;
+    // the png bytes are encoded at most once, the storage cache only holds the base64 for xml
+    return CtStorageSqlite::write_widget_row(stmtCache, node_id, widget, &get_raw_blob());
 }
 
 std::shared_ptr<CtAnchoredWidgetState> CtImagePng::get_state()
@@ -219,34 +251,14 @@ void CtImageAnchor::to_xml(xmlpp::Element* p_node_parent, const int offset_adjus
     p_image_node->set_attribute("anchor", _anchorName);
 }
 
-bool CtImageAnchor::to_sqlite(sqlite3* pDb, const gint64 node_id, const int offset_adjustment, CtStorageCache*)
+bool CtImageAnchor::to_sqlite(CtSqliteStmtCache& stmtCache, const gint64 node_id, const int offset_adjustment, CtStorageCache*)
 {
-    bool retVal{true};
-    sqlite3_stmt *p_stmt;
-    if (sqlite3_prepare_v2(pDb, CtStorageSqlite::TABLE_IMAGE_INSERT, -1, &p_stmt, nullptr) != SQLITE_OK)
-    {
-        spdlog::error("{}: {}", CtStorageSqlite::ERR_SQLITE_PREPV2, sqlite3_errmsg(pDb));
-        retVal = false;
-    }
-    else
-    {
-        const std::string anchor_name = _anchorName;
-        sqlite3_bind_int64(p_stmt, 1, node_id);
-        sqlite3_bind_int64(p_stmt, 2, _charOffset+offset_adjustment);
-        sqlite3_bind_text(p_stmt, 3, _justification.c_str(), _justification.size(), SQLITE_STATIC);
-        sqlite3_bind_text(p_stmt, 4, anchor_name.c_str(), anchor_name.size(), SQLITE_STATIC);
-        sqlite3_bind_blob(p_stmt, 5, nullptr, 0, SQLITE_STATIC);
-        sqlite3_bind_text(p_stmt, 6, "", -1, SQLITE_STATIC); // filename
-        sqlite3_bind_text(p_stmt, 7, "", -1, SQLITE_STATIC); // link
-        sqlite3_bind_int64(p_stmt, 8, 0); // time
-        if (sqlite3_step(p_stmt) != SQLITE_DONE)
-        {
-             spdlog::error("{}: {}", CtStorageSqlite::ERR_SQLITE_STEP, sqlite3_errmsg(pDb));
-            retVal = false;
-        }
-        sqlite3_finalize(p_stmt);
-    }
-    return retVal;
+    CtDecodedNodeText::Widget widget;
+    widget.type = CtAnchWidgType::ImageAnchor;
+    widget.offset = _charOffset+offset_adjustment;
+    widget.justification = _justification;
+    widget.text = _anchorName;
+    return CtStorageSqlite::write_widget_row(stmtCache, node_id, widget);
 }
 
 std::shared_ptr<CtAnchoredWidgetState> CtImageAnchor::get_state()
@@ -285,9 +297,20 @@ CtImageEmbFile::CtImageEmbFile(CtMainWin* pCtMainWin,
                                const int charOffset,
                                const std::string& justification,
                                const size_t uniqueId)
+ : CtImageEmbFile(pCtMainWin, fileName, std::make_shared<const std::string>(rawBlob), timeSeconds, charOffset, justification, uniqueId)
+{
+}
+
+CtImageEmbFile::CtImageEmbFile(CtMainWin* pCtMainWin,
+                               const fs::path& fileName,
+                               std::shared_ptr<const std::string> rRawBlob,
+                               const time_t timeSeconds,
+                               const int charOffset,
+                               const std::string& justification,
+                               const size_t uniqueId)
  : CtImage(pCtMainWin, _get_file_icon(pCtMainWin, fileName), charOffset, justification)
  , _fileName(fileName)
- , _rawBlob(rawBlob)
+ , _rRawBlob(std::move(rRawBlob))
  , _timeSeconds(timeSeconds)
  , _uniqueId(uniqueId)
 {
@@ -303,38 +326,19 @@ void CtImageEmbFile::to_xml(xmlpp::Element* p_node_parent, const int offset_adju
     p_image_node->set_attribute(CtConst::TAG_JUSTIFICATION, _justification);
     p_image_node->set_attribute("filename", _fileName.string());
     p_image_node->set_attribute("time", std::to_string(_timeSeconds));
-    const std::string encodedBlob = Glib::Base64::encode(_rawBlob);
+    const std::string encodedBlob = Glib::Base64::encode(*_rRawBlob);
     p_image_node->add_child_text(encodedBlob);
 }
 
-bool CtImageEmbFile::to_sqlite(sqlite3* pDb, const gint64 node_id, const int offset_adjustment, CtStorageCache*)
+bool CtImageEmbFile::to_sqlite(CtSqliteStmtCache& stmtCache, const gint64 node_id, const int offset_adjustment, CtStorageCache*)
 {
-    bool retVal{true};
-    sqlite3_stmt *p_stmt;
-    if (sqlite3_prepare_v2(pDb, CtStorageSqlite::TABLE_IMAGE_INSERT, -1, &p_stmt, nullptr) != SQLITE_OK)
-    {
-         spdlog::error("{}: {}", CtStorageSqlite::ERR_SQLITE_PREPV2, sqlite3_errmsg(pDb));
-        retVal = false;
-    }
-    else
-    {
-        const std::string file_name = _fileName.string();
-        sqlite3_bind_int64(p_stmt, 1, node_id);
-        sqlite3_bind_int64(p_stmt, 2, _charOffset+offset_adjustment);
-        sqlite3_bind_text(p_stmt, 3, _justification.c_str(), _justification.size(), SQLITE_STATIC);
-        sqlite3_bind_text(p_stmt, 4, "", -1, SQLITE_STATIC); // anchor
-        sqlite3_bind_blob(p_stmt, 5, _rawBlob.c_str(), _rawBlob.size(), SQLITE_STATIC);
-        sqlite3_bind_text(p_stmt, 6, file_name.c_str(), file_name.size(), SQLITE_STATIC);
-        sqlite3_bind_text(p_stmt, 7, "", -1, SQLITE_STATIC); // link
-        sqlite3_bind_int64(p_stmt, 8, _timeSeconds);
-        if (sqlite3_step(p_stmt) != SQLITE_DONE)
-        {
-             spdlog::error("{}: {}", CtStorageSqlite::ERR_SQLITE_STEP, sqlite3_errmsg(pDb));
-            retVal = false;
-        }
-        sqlite3_finalize(p_stmt);
-    }
-    return retVal;
+    CtDecodedNodeText::Widget widget;
+    widget.type = CtAnchWidgType::ImageEmbFile;
+    widget.offset = _charOffset+offset_adjustment;
+    widget.justification = _justification;
+    widget.text = _fileName.string();
+    widget.time = _timeSeconds;
+    return CtStorageSqlite::write_widget_row(stmtCache, node_id, widget, _rRawBlob.get());
 }
 
 std::shared_ptr<CtAnchoredWidgetState> CtImageEmbFile::get_state()
@@ -359,7 +363,7 @@ void CtImageEmbFile::update_label_widget()
 void CtImageEmbFile::update_tooltip()
 {
     char humanReadableSize[16];
-    const size_t embfileBytes{_rawBlob.size()};
+    const size_t embfileBytes{_rRawBlob->size()};
     const double embfileKbytes{static_cast<double>(embfileBytes)/1024};
     const double embfileMbytes{embfileKbytes/1024};
     if (embfileMbytes > 1)
@@ -47,9 +47,16 @@ public:
             const std::string& justification);
     ~CtImage() override;
 
+    /**
+     * @brief Decodes the image bytes, also from a thread other than the main one
+     * @return nullptr if the bytes cannot be decoded
+     */
+    static Glib::RefPtr<Gdk::Pixbuf> decode_pixbuf(const std::string& rawBlob, const char* mimeType);
+
     void apply_width_height(const int /*parentTextWidth*/) override {}
     void apply_syntax_highlighting(const bool /*forceReApply*/) override {}
     void set_modified_false() override {}
+    size_t get_memory_size() override;
 
     void save(const fs::path& file_name, const Glib::ustring& type);
     Glib::RefPtr<Gdk::Pixbuf> get_pixbuf() { return _rPixbuf; }
@@ -72,23 +79,51 @@ public:
                const Glib::ustring& link,
                const int charOffset,
                const std::string& justification);
+    /**
+     * @brief The png bytes already decoded in pixBuf, e.g. by a worker thread
+     */
+    CtImagePng(CtMainWin* pCtMainWin,
+               const std::string& rawBlob,
+               Glib::RefPtr<Gdk::Pixbuf> pixBuf,
+               const Glib::ustring& link,
+               const int charOffset,
+               const std::string& justification);
     ~CtImagePng() override {}
 
     void to_xml(xmlpp::Element* p_node_parent, const int offset_adjustment, CtStorageCache* cache) override;
-    bool to_sqlite(sqlite3* pDb, const gint64 node_id, const int offset_adjustment, CtStorageCache* cache) override;
+    bool to_sqlite(CtSqliteStmtCache& stmtCache, const gint64 node_id, const int offset_adjustment, CtStorageCache* cache) override;
     CtAnchWidgType get_type() override { return CtAnchWidgType::ImagePng; }
     std::shared_ptr<CtAnchoredWidgetState> get_state() override;
+    size_t get_memory_size() override { return CtImage::get_memory_size() + _rawBlob.size(); }
 
-    const std::string get_raw_blob();
+    /**
+     * @brief The png bytes, the ones the image was loaded from or else encoded from the pixbuf once
+     */
+    const std::string& get_raw_blob();
+    bool get_raw_blob_dirty() const { return _rawBlobDirty; }
     void update_label_widget();
     const Glib::ustring& get_link() { return _link; }
     void set_link(const Glib::ustring& link) { _link = link; }
 
+    /**
+     * @brief Record the image row as loaded from or written to the document database, at the given offset
+     */
+    void set_sqlite_row_stored(const int offset);
+    /**
+     * @brief Whether the image row of the document database is up to date, so it can be left untouched
+     */
+    bool is_sqlite_row_stored(const int offset) const;
+
 private:
     bool _on_button_press_event(GdkEventButton* event);
 
 protected:
     Glib::ustring _link;
+    std::string   _rawBlob;            // png bytes, not a string
+    bool          _rawBlobDirty{true}; // _rawBlob not in sync with the pixbuf
+    int           _sqliteRowOffset{-1};
+    std::string   _sqliteRowJustification;
+    Glib::ustring _sqliteRowLink;
 };
 
 class CtImageAnchor : public CtImage
@@ -101,7 +136,7 @@ public:
     ~CtImageAnchor() override {}
 
     void to_xml(xmlpp::Element* p_node_parent, const int offset_adjustment, CtStorageCache* cache) override;
-    bool to_sqlite(sqlite3* pDb, const gint64 node_id, const int offset_adjustment, CtStorageCache* cache) override;
+    bool to_sqlite(CtSqliteStmtCache& stmtCache, const gint64 node_id, const int offset_adjustment, CtStorageCache* cache) override;
     CtAnchWidgType get_type() override { return CtAnchWidgType::ImageAnchor; }
     std::shared_ptr<CtAnchoredWidgetState> get_state() override;
 
@@ -126,17 +161,30 @@ public:
                    const int charOffset,
                    const std::string& justification,
                    const size_t uniqueId);
+    /**
+     * @brief The file bytes shared with other holders, e.g. the undo states
+     */
+    CtImageEmbFile(CtMainWin* pCtMainWin,
+                   const fs::path& fileName,
+                   std::shared_ptr<const std::string> rRawBlob,
+                   const time_t timeSeconds,
+                   const int charOffset,
+                   const std::string& justification,
+                   const size_t uniqueId);
     ~CtImageEmbFile() override {}
 
     void to_xml(xmlpp::Element* p_node_parent, const int offset_adjustment, CtStorageCache* cache) override;
-    bool to_sqlite(sqlite3* pDb, const gint64 node_id, const int offset_adjustment, CtStorageCache* cache) override;
+    bool to_sqlite(CtSqliteStmtCache& stmtCache, const gint64 node_id, const int offset_adjustment, CtStorageCache* cache) override;
     CtAnchWidgType get_type() override { return CtAnchWidgType::ImageEmbFile; }
     std::shared_ptr<CtAnchoredWidgetState> get_state() override;
+    size_t get_memory_size() override { return CtImage::get_memory_size() + _rRawBlob->size(); }
 
     const fs::path&      get_file_name() { return _fileName; }
     void                 set_file_name(const fs::path& path) { _fileName = path; }
-    const std::string&   get_raw_blob() { return _rawBlob; }
-    void                 set_raw_blob(const std::string& buffer) { _rawBlob = buffer; }
+    const std::string&   get_raw_blob() { return *_rRawBlob; }
+    // the same pointer as long as the bytes are not replaced
+    const std::shared_ptr<const std::string>& get_raw_blob_shared() { return _rRawBlob; }
+    void                 set_raw_blob(const std::string& buffer) { _rRawBlob = std::make_shared<const std::string>(buffer); }
     time_t               get_time() { return _timeSeconds; }
     void                 set_time(const time_t time) { _timeSeconds = time; }
     size_t               get_unique_id() { return _uniqueId; }
@@ -154,7 +202,7 @@ private:
 
 protected:
     fs::path      _fileName;
-    std::string   _rawBlob;      // raw data, not a string
+    std::shared_ptr<const std::string> _rRawBlob; // raw data, not a string
     time_t        _timeSeconds;
     const size_t  _uniqueId;
 };
@@ -0,0 +1,162 @@
+/*
+ * ct_main_cli.cc
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+// cherrytree-cli: exports and converts a document without a main window, GTK is never initialised
+
+#include "ct_document.h"
+#include "ct_document_export.h"
+#include "ct_const.h"
+#include "ct_logging.h"
+#include <giomm/init.h>
+#include <glibmm/keyfile.h>
+#include <glibmm/optioncontext.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <cerrno>
+#include <iostream>
+#include <type_traits>
+
+// the horizontal rule of the text exports, read from the config file without the writes of CtConfig
+static Glib::ustring get_config_h_rule()
+{
+    const fs::path config_filepath = fs::get_cherrytree_config_filepath();
+    if (fs::is_regular_file(config_filepath)) {
+        try {
+            Glib::KeyFile key_file;
+            key_file.load_from_file(config_filepath.string());
+            if (key_file.has_group("editor") and key_file.has_key("editor", "h_rule")) {
+                return key_file.get_string("editor", "h_rule");
+            }
+        }
+        catch (Glib::Error& error) {
+            spdlog::warn("{}: {}", config_filepath.string(), error.what().raw());
+        }
+    }
+    return CtConst::H_RULE_DEFAULT;
+}
+
+// the export directory made absolute and created if missing
+static bool prepare_export_dir(const std::string& export_dir, fs::path& export_dirpath)
+{
+    export_dirpath = fs::absolute(export_dir);
+    if (not fs::is_directory(export_dirpath) and 0 != g_mkdir_with_parents(export_dirpath.c_str(), 0777)) {
+        spdlog::error("{}: {}", export_dirpath.string(), g_strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    try {
+        std::locale::global(std::locale("")); // Set the global C++ locale to the user-specified locale
+    }
+    catch (std::exception& e) {
+        g_warning("%s\n", e.what());
+    }
+
+    fs::register_exe_path_detect_if_portable(argv[0]);
+    Gio::init();
+
+    // the logs to stderr only, the output of the exports goes to the files
+    auto cli_logger = std::make_shared<spdlog::logger>("cli", std::make_shared<spdlog::sinks::stderr_color_sink_mt>());
+    spdlog::set_default_logger(cli_logger);
+    spdlog::set_level(spdlog::level::info);
+
+    std::string export_to_html_dir;
+    std::string export_to_txt_dir;
+    std::string export_to_md_dir;
+    std::string convert_to;
+    Glib::ustring password;
+    bool export_overwrite{false};
+    bool export_single_file{false};
+    bool export_incremental{false};
+
+    Glib::OptionGroup option_group{"cherrytree-cli", "cherrytree-cli"};
+    auto add_entry = [&option_group](const char* long_name, const gchar short_name, const char* description, auto& value) {
+        Glib::OptionEntry entry;
+        entry.set_long_name(long_name);
+        entry.set_short_name(short_name);
+        entry.set_description(description);
+        if constexpr (std::is_same_v<std::decay_t<decltype(value)>, std::string>) option_group.add_entry_filename(entry, value);
+        else option_group.add_entry(entry, value);
+    };
+    add_entry("export_to_html_dir", 'x', "Export to HTML at specified directory path", export_to_html_dir);
+    add_entry("export_to_txt_dir",  't', "Export to Text at specified directory path", export_to_txt_dir);
+    add_entry("export_to_md_dir",   'm', "Export to Markdown at specified directory path", export_to_md_dir);
+    add_entry("export_overwrite",   'w', "Overwrite if export path already exists", export_overwrite);
+    add_entry("export_single_file", 's', "Export to a single file (for HTML, TXT or Markdown)", export_single_file);
+    add_entry("export_incremental", 'i', "Update a previous export at the same path, rewriting only the changed nodes (for HTML or TXT multiple files)", export_incremental);
+    add_entry("convert_to",         'c', "Convert to the specified file path (.ctb or .ctd)", convert_to);
+    add_entry("password",           'P', "Password of the protected document", password);
+
+    Glib::OptionContext option_context{"DOCUMENT"};
+    option_context.set_main_group(option_group);
+    try {
+        option_context.parse(argc, argv);
+    }
+    catch (Glib::OptionError& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (argc != 2 or (export_to_html_dir.empty() and export_to_txt_dir.empty() and export_to_md_dir.empty() and convert_to.empty())) {
+        std::cerr << option_context.get_help();
+        return 1;
+    }
+
+    Glib::ustring error;
+    std::unique_ptr<CtDocument> pDocument = CtDocument::load(fs::canonical(argv[1]), password, error);
+    if (not pDocument) {
+        spdlog::error("{}: {}", argv[1], error.raw());
+        return 1;
+    }
+    spdlog::info("{}: {} nodes", argv[1], pDocument->get_nodes().size());
+
+    CtExportOptions export_options;
+    export_options.single_file = export_single_file;
+    export_options.incremental = export_incremental;
+    CtDocumentExport document_export{*pDocument, export_options, get_config_h_rule()};
+    try {
+        fs::path export_dirpath;
+        if (not export_to_html_dir.empty()) {
+            if (not prepare_export_dir(export_to_html_dir, export_dirpath)) return 1;
+            spdlog::info("-> {}", document_export.export_to_html(export_dirpath, export_overwrite).string());
+        }
+        if (not export_to_txt_dir.empty()) {
+            if (not prepare_export_dir(export_to_txt_dir, export_dirpath)) return 1;
+            spdlog::info("-> {}", document_export.export_to_txt(export_dirpath, export_overwrite).string());
+        }
+        if (not export_to_md_dir.empty()) {
+            if (not prepare_export_dir(export_to_md_dir, export_dirpath)) return 1;
+            spdlog::info("-> {}", document_export.export_to_md(export_dirpath, export_overwrite).string());
+        }
+        if (not convert_to.empty()) {
+            pDocument->save_as(convert_to);
+            spdlog::info("-> {}", convert_to);
+        }
+    }
+    catch (std::exception& e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+    return 0;
+}
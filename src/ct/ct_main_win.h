@@ -202,6 +202,7 @@ private:
     bool _on_treeview_key_press_event(GdkEventKey* event);
     bool _on_treeview_popup_menu();
     bool _on_treeview_scroll_event(GdkEventScroll* event);
+    bool _on_treeview_motion_notify_event(GdkEventMotion* event);
     bool _on_treeview_drag_motion(const Glib::RefPtr<Gdk::DragContext>& context,
                                                  int x,
                                                  int y,
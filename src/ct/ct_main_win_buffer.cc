@@ -447,6 +447,7 @@ void CtMainWin::load_buffer_from_state(std::shared_ptr<CtNodeState> state, CtTre
 
     text_buffer->end_not_undoable_action();
     text_buffer->set_modified(false);
+    _ctStateMachine.buffer_loaded_from_state(tree_iter);
 
     _uCtTreestore->text_view_apply_textbuffer(tree_iter, &_ctTextview);
     _ctTextview.grab_focus();
@@ -513,7 +514,7 @@ bool CtMainWin::_try_move_focus_to_anchored_widget_if_on_it()
             return true;
         }
         if (CtTable* pTable = dynamic_cast<CtTable*>(widgets.front())) {
-            pTable->get_table_matrix().at(pTable->current_row()).at(pTable->current_column())->get_text_view().grab_focus();
+            pTable->get_current_cell_text_view().grab_focus();
             return true;
         }
     }
@@ -68,6 +68,8 @@ void CtMainWin::_on_treeview_cursor_changed()
     }
 
     _ctStateMachine.node_selected_changed(nodeId);
+    _uCtTreestore->get_buffers_cache().touch(treeIter);
+    _uCtTreestore->get_nodes_prefetcher().prefetch_around(treeIter);
 
     _prevTreeIter = treeIter;
 }
@@ -282,6 +284,17 @@ bool CtMainWin::_on_treeview_scroll_event(GdkEventScroll* event)
     return true;
 }
 
+bool CtMainWin::_on_treeview_motion_notify_event(GdkEventMotion* event)
+{
+    // the hovered node is likely to be selected next
+    Gtk::TreePath path_at_pointer;
+    if (_uCtTreeview->get_path_at_pos((int)event->x, (int)event->y, path_at_pointer)) {
+        CtTreeIter treeIter = _uCtTreestore->get_iter(path_at_pointer);
+        _uCtTreestore->get_nodes_prefetcher().prefetch_around(treeIter);
+    }
+    return false;
+}
+
 // Extend the Default Right-Click Menu
 void CtMainWin::_on_textview_populate_popup(Gtk::Menu* menu)
 {
@@ -24,6 +24,7 @@
 #include "ct_main_win.h"
 #include "ct_actions.h"
 #include "ct_storage_control.h"
+#include "ct_storage_chunked.h"
 
 void CtMainWin::window_title_update(std::optional<bool> saveNeeded)
 {
@@ -133,6 +134,8 @@ bool CtMainWin::file_open(const fs::path& filepath, const std::string& node_to_f
     if (!file_save_ask_user()) {
         return false;
     }
+    _uCtTreestore->get_nodes_prefetcher().reset();
+    _uCtStorage->compact_on_close();
 
     fs::path prev_path = _uCtStorage->get_file_path();
 
@@ -157,7 +160,10 @@ bool CtMainWin::file_open(const fs::path& filepath, const std::string& node_to_f
 
     window_title_update(false/*saveNeeded*/);
     menu_set_bookmark_menu_items();
-    bool can_vacuum = fs::get_doc_type(_uCtStorage->get_file_path()) == CtDocType::SQLite;
+    // the journal of an xml document is merged into it by vacuum, the replaced chunks dropped
+    bool can_vacuum = fs::get_doc_type(_uCtStorage->get_file_path()) == CtDocType::SQLite or
+                      (_pCtConfig->xmlJournalOn and fs::get_doc_encrypt(_uCtStorage->get_file_path()) == CtDocEncrypt::False) or
+                      CtChunkedContainer::is_container(_uCtStorage->get_file_path());
     _uCtMenu->find_action("ct_vacuum")->signal_set_visible.emit(can_vacuum);
 
     const auto iterDocsRestore{_pCtConfig->recentDocsRestore.find(filepath.string())};
@@ -258,8 +264,13 @@ void CtMainWin::file_save(bool need_vacuum)
     if (!get_tree_store().get_iter_first())
         return;
 
+    // the document is not to be read while rewritten or locked by the save
+    CtNodesPrefetcher& nodesPrefetcher = _uCtTreestore->get_nodes_prefetcher();
+    nodesPrefetcher.reset();
     Glib::ustring error;
-    if (_uCtStorage->save(need_vacuum, error)) {
+    const bool saved = _uCtStorage->save(need_vacuum, error);
+    nodesPrefetcher.reader_recreate();
+    if (saved) {
         update_window_save_not_needed();
         _ctStateMachine.update_state();
     }
@@ -30,6 +30,8 @@
 #include "ct_logging.h"
 #include <ctime>
 #include <regex>
+#include <algorithm>
+#include <numeric>
 #include <glib/gstdio.h> // to get stats
 #include <curl/curl.h>
 #ifndef __APPLE__
@@ -37,8 +39,7 @@
 #else
 #include <uchardet.h>
 #endif // __APPLE__
-#include <thread> // for parallel_for
-#include <future> // parallel_for
+#include "ct_thread_pool.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -187,30 +188,33 @@ void CtMiscUtil::filepath_extension_fix(const CtDocType ctDocType, const CtDocEn
     }
 }
 
-bool CtMiscUtil::node_siblings_sort_iteration(Glib::RefPtr<Gtk::TreeStore> model, const Gtk::TreeNodeChildren& children,
-                                              std::function<bool(Gtk::TreeIter&, Gtk::TreeIter&)> need_swap)
+bool CtMiscUtil::node_siblings_sort(Glib::RefPtr<Gtk::TreeStore> model,
+                                    const Gtk::TreeNodeChildren& children,
+                                    std::function<Glib::ustring(const Gtk::TreeIter&)> get_sort_key,
+                                    std::function<int(const Glib::ustring&, const Glib::ustring&)> compare,
+                                    const bool ascending)
 {
-    if (children.empty()) return false;
-    auto next_iter = [](Gtk::TreeIter iter) { return ++iter; };
-    auto sort_iteration = [&need_swap, &model, &next_iter](Gtk::TreeIter curr_sibling) -> bool {
-        bool swap_executed = false;
-        Gtk::TreeIter next_sibling = next_iter(curr_sibling);
-        while (next_sibling) {
-            if (need_swap(curr_sibling, next_sibling)) {
-                model->iter_swap(curr_sibling, next_sibling);
-                swap_executed = true;
-            } else {
-                curr_sibling = next_sibling;
-            }
-            next_sibling = next_iter(curr_sibling);
-        }
-        return swap_executed;
-    };
-
-    bool swap_executed = false;
-    while (sort_iteration(children.begin()))
-        swap_executed = true;
-    return swap_executed;
+    if (children.size() < 2) return false;
+    std::vector<Glib::ustring> sort_keys;
+    sort_keys.reserve(children.size());
+    for (const auto& child : children) {
+        sort_keys.push_back(get_sort_key(child));
+    }
+    // new_order[new position] = old position, stable so that the equal siblings keep their order
+    std::vector<int> new_order(sort_keys.size());
+    std::iota(new_order.begin(), new_order.end(), 0);
+    std::stable_sort(new_order.begin(), new_order.end(), [&](const int l, const int r) {
+        const int cmp = compare(sort_keys[l], sort_keys[r]);
+        return ascending ? cmp < 0 : cmp > 0;
+    });
+    bool order_changed{false};
+    for (size_t i = 0; i < new_order.size() and not order_changed; ++i) {
+        order_changed = new_order[i] != (int)i;
+    }
+    if (order_changed) {
+        model->reorder(children, new_order);
+    }
+    return order_changed;
 }
 
 //"""Get the Node Hierarchical Name"""
@@ -305,44 +309,125 @@ URI_TYPE get_uri_type(const std::string &uri) {
     else return URI_TYPE::UNKNOWN;
 }
 
+std::vector<CtStoredMatch> find_all_in_stored_text(const CtStoredNodeText& stored_text, Glib::RefPtr<Glib::Regex> re_pattern)
+{
+    std::vector<CtStoredMatch> matches;
+    const auto& widgets = stored_text.widgets;
+    // same as the newline trick on the text buffer, keeps the patterns anchored to the line start working on the first line
+    const bool newline_trick = stored_text.text.empty() or '\n' != stored_text.text.front();
+    const int trick_chars = newline_trick ? 1 : 0;
+    const int line_adj = newline_trick ? 0 : 1;
+    const Glib::ustring text{newline_trick ? CtConst::CHAR_NEWLINE + stored_text.text : stored_text.text};
+    const char* pText = text.c_str();
+    const int text_bytes = static_cast<int>(text.bytes());
+
+    // byte to char offset conversion, only moving forward
+    int conv_byte{0};
+    int conv_char{0};
+    auto char_at_byte = [&](const int byte_offset) {
+        conv_char += static_cast<int>(g_utf8_strlen(pText + conv_byte, byte_offset - conv_byte));
+        conv_byte = byte_offset;
+        return conv_char;
+    };
+    // line number and line start, only moving forward
+    int line_byte{0};
+    int line_char{0};
+    int line_idx{0};
+    int line_start_byte{0};
+    auto move_line_cursor = [&](const int char_offset) {
+        while (line_char < char_offset and line_byte < text_bytes) {
+            if ('\n' == pText[line_byte]) {
+                ++line_idx;
+                line_start_byte = line_byte + 1;
+            }
+            line_byte = static_cast<int>(g_utf8_next_char(pText + line_byte) - pText);
+            ++line_char;
+        }
+    };
+    auto line_content = [&]() {
+        const void* pLineEnd = memchr(pText + line_start_byte, '\n', text_bytes - line_start_byte);
+        return std::string(pText + line_start_byte, pLineEnd ? static_cast<const char*>(pLineEnd) : pText + text_bytes);
+    };
+    auto widget_match_content = [&](const CtStoredNodeText::Widget& widget)->std::string {
+        for (const std::string& widget_text : widget.texts) {
+            if (re_pattern->match(widget_text)) {
+                if (CtAnchWidgType::Table == widget.type) return "<table>";
+                if (CtAnchWidgType::CodeBox == widget.type) return "<codebox>";
+                return widget_text;
+            }
+        }
+        return "";
+    };
+
+    int search_offset{0};    // buffer offset where the search goes on from
+    size_t widget_idx{0};    // first widget not checked yet
+    auto check_widgets_before = [&](const int buffer_offset/*-1 for the end*/) {
+        for (; widget_idx < widgets.size(); ++widget_idx) {
+            const auto& widget = widgets[widget_idx];
+            if (buffer_offset >= 0 and widget.offset >= buffer_offset) break;
+            if (widget.offset < search_offset) continue;
+            const std::string content = widget_match_content(widget);
+            if (content.empty()) continue;
+            // the widgets before this one take no char in the text
+            move_line_cursor(widget.offset - static_cast<int>(widget_idx) + trick_chars);
+            matches.push_back(CtStoredMatch{widget.offset, widget.offset + 1, line_idx + line_adj, content});
+            search_offset = widget.offset + 1;
+        }
+    };
+
+    size_t widgets_before{0}; // widgets before the current text match
+    Glib::MatchInfo match_info;
+    re_pattern->match(text, match_info);
+    while (match_info.matches()) {
+        int start_byte, end_byte;
+        if (match_info.fetch_pos(0, start_byte, end_byte)) {
+            const int start_char = char_at_byte(start_byte);
+            const int end_char = start_char + static_cast<int>(g_utf8_strlen(pText + start_byte, end_byte - start_byte));
+            const int text_start = std::max(0, start_char - trick_chars);
+            const int text_end = std::max(0, end_char - trick_chars);
+            while (widgets_before < widgets.size() and widgets[widgets_before].offset - static_cast<int>(widgets_before) <= text_start) {
+                ++widgets_before;
+            }
+            const int buffer_start = text_start + static_cast<int>(widgets_before);
+            if (buffer_start >= search_offset) {
+                check_widgets_before(buffer_start);
+                move_line_cursor(start_char);
+                matches.push_back(CtStoredMatch{buffer_start, text_end + static_cast<int>(widgets_before), line_idx + line_adj, line_content()});
+                search_offset = text_end + static_cast<int>(widgets_before);
+            }
+        }
+        match_info.next();
+    }
+    check_widgets_before(-1);
+    return matches;
+}
+
 } // namespace CtMiscUtil
 
 // analog to tbb::parallel_for
 void CtMiscUtil::parallel_for(size_t first, size_t last, std::function<void(size_t)> f)
 {
-    size_t concur_num = std::thread::hardware_concurrency();
-    if (concur_num == 0) concur_num = 4;
-    if (first == last) return;
-    if (last < first) return;
-    if (last - first < concur_num) // to make slice calc simpler
-        concur_num = last - first;
-    size_t slice_item_num = (last - first) / concur_num;
-    size_t slice_leftover = (last - first) % concur_num;
-
-    std::list<std::thread> td_tasks;
-    size_t td_first = first;
-    for  (size_t thread_index = 0; thread_index < concur_num; ++thread_index)
-    {
-        std::packaged_task<void(size_t, size_t)> task([f](size_t slice_start, size_t slice_end)
-        {
-            for (size_t index = slice_start; index < slice_end; ++index)
-                f(index);
+    if (last <= first) return;
+    CtThreadPool& thread_pool = CtThreadPool::get_instance();
+    const size_t tasks_num = std::min(thread_pool.get_workers_num() + 1, last - first); // the caller helps while waiting
+    // small chunks taken on demand, so that items of uneven cost do not leave threads idle
+    const size_t chunk_size = std::max<size_t>(1, (last - first) / (tasks_num * 8));
+    std::atomic<size_t> next_first{first};
+    CtThreadPool::TaskGroup task_group{thread_pool};
+    for (size_t task_index = 0; task_index < tasks_num; ++task_index) {
+        task_group.run([&](){
+            for (size_t chunk_first = next_first.fetch_add(chunk_size);
+                 chunk_first < last and not task_group.is_cancelled();
+                 chunk_first = next_first.fetch_add(chunk_size))
+            {
+                const size_t chunk_last = std::min(last, chunk_first + chunk_size);
+                for (size_t index = chunk_first; index < chunk_last; ++index) {
+                    f(index);
+                }
+            }
         });
-
-        size_t td_slice = slice_item_num;
-        if (slice_leftover != 0) {
-            td_slice += 1;
-            slice_leftover -= 1;
-        }
-        if (td_first + td_slice > last)
-            td_slice = last - td_first;
-
-        td_tasks.emplace_back(std::thread(std::move(task), td_first, td_first + td_slice));
-        td_first += td_slice;
     }
-
-    for (auto& task: td_tasks)
-        task.join();
+    task_group.wait();
 }
 
 // Returns True if the characters compose a camel case word
@@ -486,9 +571,13 @@ const gchar* CtTextIterUtil::get_text_iter_alignment(const Gtk::TextIter& textIt
 }
 
 int CtTextIterUtil::get_words_count(const Glib::RefPtr<Gtk::TextBuffer>& text_buffer)
+{
+    return get_words_count(text_buffer->get_text(true));
+}
+
+int CtTextIterUtil::get_words_count(const Glib::ustring& text)
 {
     int words = 0;
-    Glib::ustring text = text_buffer->get_text(true);
     if (!text.empty())
     {
         int text_size = text.size();
@@ -505,6 +594,15 @@ int CtTextIterUtil::get_words_count(const Glib::RefPtr<Gtk::TextBuffer>& text_bu
     return words;
 }
 
+CtTextStats CtTextIterUtil::get_text_stats(const Glib::ustring& text)
+{
+    CtTextStats textStats;
+    textStats.words = get_words_count(text);
+    textStats.chars = text.size();
+    textStats.lines = 1 + std::count(text.raw().begin(), text.raw().end(), '\n');
+    return textStats;
+}
+
 
 bool CtStrUtil::is_str_true(const Glib::ustring& inStr)
 {
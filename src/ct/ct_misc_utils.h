@@ -46,8 +46,16 @@ std::string get_doc_extension(const CtDocType ctDocType, const CtDocEncrypt ctDo
 
 void filepath_extension_fix(const CtDocType ctDocType, const CtDocEncrypt ctDocEncrypt, std::string& filepath);
 
-bool node_siblings_sort_iteration(Glib::RefPtr<Gtk::TreeStore> model, const Gtk::TreeNodeChildren& children,
-                                  std::function<bool(Gtk::TreeIter&, Gtk::TreeIter&)> need_swap);
+/**
+ * @brief Sorts the children with a single reorder of the model, the sort key of every child computed once
+ * @param compare of two sort keys, negative if the first goes first in ascending order
+ * @return false if the children were already in order
+ */
+bool node_siblings_sort(Glib::RefPtr<Gtk::TreeStore> model,
+                        const Gtk::TreeNodeChildren& children,
+                        std::function<Glib::ustring(const Gtk::TreeIter&)> get_sort_key,
+                        std::function<int(const Glib::ustring&, const Glib::ustring&)> compare,
+                        const bool ascending);
 
 std::string get_node_hierarchical_name(CtTreeIter tree_iter, const char* separator="--",
                                        bool for_filename=true, bool root_to_leaf=true, const char* trailer="");
@@ -69,6 +77,12 @@ URI_TYPE get_uri_type(const std::string& uri);
 
 void parallel_for(size_t first, size_t last, std::function<void(size_t)> f);
 
+/**
+ * @brief All the matches in the stored content of a node, in the order the find in nodes reports them
+ * (a widget matching counts once); buffer offsets, widgets adjustments and line numbers in one linear pass
+ */
+std::vector<CtStoredMatch> find_all_in_stored_text(const CtStoredNodeText& stored_text, Glib::RefPtr<Glib::Regex> re_pattern);
+
 } // namespace CtMiscUtil
 
 namespace CtTextIterUtil {
@@ -125,6 +139,11 @@ void generic_process_slot(int start_offset,
 const gchar* get_text_iter_alignment(const Gtk::TextIter& textIter, CtMainWin* pCtMainWin);
 
 int get_words_count(const Glib::RefPtr<Gtk::TextBuffer>& text_buffer);
+int get_words_count(const Glib::ustring& text);
+/**
+ * @brief The words, chars and lines of the text, the lines being one more than the newlines
+ */
+CtTextStats get_text_stats(const Glib::ustring& text);
 
 } // namespace CtTextIterUtil
 
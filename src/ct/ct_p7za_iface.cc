@@ -24,13 +24,21 @@
 #include "ct_p7za_iface.h"
 #include "ct_misc_utils.h"
 #include "ct_filesystem.h"
+#include "ct_logging.h"
 #include <glib/gstdio.h>
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <thread>
+#include <chrono>
 
 extern int p7za_exec(int numArgs, char *args[]);
+extern int p7za_mem_extract(const char *input_path, const char *passwd, std::string &data);
+extern int p7za_mem_archive(const char *data, size_t size, const char *item_name, const char *output_path, const char *passwd, unsigned numThreads);
+extern void p7za_random(unsigned char *data, unsigned size);
+extern int p7za_chunk_key(const char *passwd, const unsigned char *salt, unsigned saltSize, unsigned numCyclesPower, unsigned char *key);
+extern int p7za_chunk_encode(const unsigned char *key, const char *data, size_t size, std::string &chunk);
+extern int p7za_chunk_decode(const unsigned char *key, const char *chunk, size_t chunkSize, std::string &data);
 extern void cherrytree_register_7zaes();
 extern void cherrytree_register_crc32();
 extern void cherrytree_register_crc_table();
@@ -87,10 +95,23 @@ int CtP7zaIface::p7za_extract(const gchar* input_path, const gchar* out_dir, con
     return ret_val;
 }
 
-int CtP7zaIface::p7za_archive(const gchar* input_path, const gchar* output_path, const gchar* passwd)
+static size_t _get_concur_num()
 {
     size_t concur_num = std::thread::hardware_concurrency();
     if (concur_num == 0) concur_num = 4;
+    return concur_num;
+}
+
+static void _log_throughput(const char* what, const size_t bytes_num, const gchar* archive_path, const std::chrono::steady_clock::time_point time_start)
+{
+    const std::chrono::duration<double> elapsed_seconds = std::chrono::steady_clock::now() - time_start;
+    spdlog::debug("{} bytes {} {} in {:.3f} sec ({:.1f} MB/sec)", bytes_num, what, archive_path, elapsed_seconds.count(),
+                  elapsed_seconds.count() > 0 ? bytes_num/elapsed_seconds.count()/(1024*1024) : 0.0);
+}
+
+int CtP7zaIface::p7za_archive(const gchar* input_path, const gchar* output_path, const gchar* passwd)
+{
+    const size_t concur_num = _get_concur_num();
 
     g_autofree gchar* p_workspace_dir = g_path_get_dirname(output_path);
     // https://stackoverflow.com/questions/39914398/7zip-fastest-lzma2-compression
@@ -123,3 +144,53 @@ int CtP7zaIface::p7za_archive(const gchar* input_path, const gchar* output_path,
     g_strfreev(pp_args);
     return ret_val;
 }
+
+int CtP7zaIface::p7za_extract_to_memory(const gchar* input_path, const gchar* passwd, std::string& data)
+{
+    register_codecs();
+    const auto time_start = std::chrono::steady_clock::now();
+    const int ret_val = p7za_mem_extract(input_path, passwd, data);
+    if (0 == ret_val) {
+        _log_throughput("decoded from", data.size(), input_path, time_start);
+    }
+    return ret_val;
+}
+
+int CtP7zaIface::p7za_archive_from_memory(const std::string& data, const gchar* item_name, const gchar* output_path, const gchar* passwd)
+{
+    register_codecs();
+    const auto time_start = std::chrono::steady_clock::now();
+    // the archive at output_path is whole at any time
+    const std::string tmp_path = std::string{output_path} + ".tmp";
+    int ret_val = p7za_mem_archive(data.data(), data.size(), item_name, tmp_path.c_str(), passwd, (unsigned)_get_concur_num());
+    if (0 == ret_val and not fs::move_file(tmp_path, output_path)) {
+        spdlog::error("{} cannot move {} to {}", __FUNCTION__, tmp_path, output_path);
+        ret_val = -1;
+    }
+    if (0 != ret_val) {
+        if (fs::is_regular_file(tmp_path)) fs::remove(tmp_path);
+        return ret_val;
+    }
+    _log_throughput("encoded into", data.size(), output_path, time_start);
+    return ret_val;
+}
+
+void CtP7zaIface::p7za_random(guint8* data, unsigned size)
+{
+    ::p7za_random(data, size);
+}
+
+int CtP7zaIface::p7za_chunk_key(const gchar* passwd, const guint8* salt, unsigned salt_size, unsigned num_cycles_power, guint8* key)
+{
+    return ::p7za_chunk_key(passwd, salt, salt_size, num_cycles_power, key);
+}
+
+int CtP7zaIface::p7za_chunk_encode(const guint8* key, const std::string& data, std::string& chunk)
+{
+    return ::p7za_chunk_encode(key, data.data(), data.size(), chunk);
+}
+
+int CtP7zaIface::p7za_chunk_decode(const guint8* key, const char* chunk, size_t chunk_size, std::string& data)
+{
+    return ::p7za_chunk_decode(key, chunk, chunk_size, data);
+}
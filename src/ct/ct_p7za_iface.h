@@ -22,6 +22,7 @@
 #pragma once
 #include <glib.h>
 #include <glib/gtypes.h>
+#include <string>
 
 namespace CtP7zaIface {
 
@@ -29,5 +30,35 @@ int p7za_extract(const gchar* input_path, const gchar* out_dir, const gchar* pas
 
 int p7za_archive(const gchar* input_path, const gchar* output_path, const gchar* passwd);
 
+/**
+ * @brief Decrypt and decompress the only file of the archive straight into data, nothing is written to disk
+ */
+int p7za_extract_to_memory(const gchar* input_path, const gchar* passwd, std::string& data);
+
+/**
+ * @brief Compress and encrypt data as the file item_name of the archive at output_path, replaced once complete
+ */
+int p7za_archive_from_memory(const std::string& data, const gchar* item_name, const gchar* output_path, const gchar* passwd);
+
+/**
+ * @brief Fill data with random bytes from the generator of the 7z encryption
+ */
+void p7za_random(guint8* data, unsigned size);
+
+/**
+ * @brief The AES-256 key of a 7z archive for the password, salt and 2^num_cycles_power rounds of SHA-256
+ */
+int p7za_chunk_key(const gchar* passwd, const guint8* salt, unsigned salt_size, unsigned num_cycles_power, guint8* key);
+
+/**
+ * @brief Compress with LZMA2 and encrypt with AES-256 one chunk of data, on its own
+ */
+int p7za_chunk_encode(const guint8* key, const std::string& data, std::string& chunk);
+
+/**
+ * @brief Decrypt and decompress a chunk made by p7za_chunk_encode, fails on a wrong key or a damaged chunk
+ */
+int p7za_chunk_decode(const guint8* key, const char* chunk, size_t chunk_size, std::string& data);
+
 } // namespace CtP7zaIface
 
@@ -214,7 +214,7 @@ void CtDocumentBuilder::add_tag_data(std::string_view tag, std::string data)
 
 void CtDocumentBuilder::add_table(const std::vector<std::vector<Glib::ustring>>& table_matrix)
 {
-    CtXmlHelper::table_to_xml(_current_element->get_parent(), table_matrix, 0, CtConst::TAG_PROP_VAL_LEFT, 400, "");
+    CtXmlHelper::table_to_xml(_current_element->get_parent(), CtTableMatrix{table_matrix}, 0, CtConst::TAG_PROP_VAL_LEFT, 400, "");
     close_current_tag();
 }
 
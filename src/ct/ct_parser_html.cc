@@ -689,7 +689,7 @@ void CtHtml2Xml::_insert_table()
             rows.back().push_back(str::trim(cell.text));
     }
 
-    CtXmlHelper::table_to_xml(_slot_root, rows, _char_offset, CtConst::TAG_PROP_VAL_LEFT, _config->tableColWidthDefault, "");
+    CtXmlHelper::table_to_xml(_slot_root, CtTableMatrix{rows}, _char_offset, CtConst::TAG_PROP_VAL_LEFT, _config->tableColWidthDefault, "");
 
     _char_offset += 1;
 }
@@ -49,6 +49,8 @@ Gtk::Widget* CtPrefDlg::build_tab_misc()
     hbox_autosave->pack_start(*label_autosave, false, false);
     Gtk::CheckButton* checkbutton_autosave_on_quit = Gtk::manage(new Gtk::CheckButton{_("Autosave on Quit")});
     Gtk::CheckButton* checkbutton_backup_before_saving = Gtk::manage(new Gtk::CheckButton{_("Create a Backup Copy Before Saving")});
+    Gtk::CheckButton* checkbutton_xml_journal = Gtk::manage(new Gtk::CheckButton{_("Append the Changes to a Journal When Saving XML Documents")});
+    Gtk::CheckButton* checkbutton_protected_chunked = Gtk::manage(new Gtk::CheckButton{_("Save Protected XML Documents as Encrypted Chunks, Only the Changed Ones When Saving")});
     auto hbox_num_backups = Gtk::manage(new Gtk::Box{Gtk::ORIENTATION_HORIZONTAL, 4/*spacing*/});
     Gtk::Label* label_num_backups = Gtk::manage(new Gtk::Label{_("Number of Backups to Keep")});
     Glib::RefPtr<Gtk::Adjustment> adjustment_num_backups = Gtk::Adjustment::create(_pConfig->backupNum, 1, 100, 1);
@@ -71,6 +73,8 @@ Gtk::Widget* CtPrefDlg::build_tab_misc()
     vbox_saving->pack_start(*hbox_num_backups, false, false);
     vbox_saving->pack_start(*checkbutton_custom_backup_dir, false, false);
     vbox_saving->pack_start(*hbox_custom_backup_dir, false, false);
+    vbox_saving->pack_start(*checkbutton_xml_journal, false, false);
+    vbox_saving->pack_start(*checkbutton_protected_chunked, false, false);
 
     checkbutton_autosave->set_active(_pConfig->autosaveOn);
     spinbutton_autosave->set_value(_pConfig->autosaveVal);
@@ -82,6 +86,9 @@ Gtk::Widget* CtPrefDlg::build_tab_misc()
     entry_custom_backup_dir->set_text(_pConfig->customBackupDir);
     entry_custom_backup_dir->set_sensitive(_pConfig->backupCopy && _pConfig->customBackupDirOn);
     button_custom_backup_dir->set_sensitive(_pConfig->backupCopy && _pConfig->customBackupDirOn);
+    checkbutton_xml_journal->set_active(_pConfig->xmlJournalOn);
+    checkbutton_protected_chunked->set_active(_pConfig->protectedChunkedOn);
+    checkbutton_protected_chunked->set_tooltip_text(_("The document cannot be opened by older versions"));
 
     Gtk::Frame* frame_saving = new_managed_frame_with_align(_("Saving"), vbox_saving);
 
@@ -96,12 +103,23 @@ Gtk::Widget* CtPrefDlg::build_tab_misc()
     vbox_misc_misc->pack_start(*checkbutton_reload_doc_last, false, false);
     vbox_misc_misc->pack_start(*checkbutton_mod_time_sentinel, false, false);
     vbox_misc_misc->pack_start(*checkbutton_win_title_doc_dir, false, false);
+    auto hbox_nodes_memory = Gtk::manage(new Gtk::Box{Gtk::ORIENTATION_HORIZONTAL, 4/*spacing*/});
+    Gtk::Label* label_nodes_memory = Gtk::manage(new Gtk::Label{_("Memory for the Loaded Nodes")});
+    Glib::RefPtr<Gtk::Adjustment> adjustment_nodes_memory = Gtk::Adjustment::create(_pConfig->nodesMemoryBudgetMB, 0, 1048576, 64);
+    Gtk::SpinButton* spinbutton_nodes_memory = Gtk::manage(new Gtk::SpinButton{adjustment_nodes_memory});
+    Gtk::Label* label_nodes_memory_unit = Gtk::manage(new Gtk::Label{_("MB (0 for No Limit)")});
+    hbox_nodes_memory->pack_start(*label_nodes_memory, false, false);
+    hbox_nodes_memory->pack_start(*spinbutton_nodes_memory, false, false);
+    hbox_nodes_memory->pack_start(*label_nodes_memory_unit, false, false);
+    hbox_nodes_memory->set_tooltip_text(_("Beyond it, the least recently used nodes that are not modified are released and loaded again when needed"));
+    vbox_misc_misc->pack_start(*hbox_nodes_memory, false, false);
 
     checkbutton_newer_version->set_active(_pConfig->checkVersion);
     checkbutton_word_count->set_active(_pConfig->wordCountOn);
     checkbutton_reload_doc_last->set_active(_pConfig->reloadDocLast);
     checkbutton_mod_time_sentinel->set_active(_pConfig->modTimeSentinel);
     checkbutton_win_title_doc_dir->set_active(_pConfig->winTitleShowDocDir);
+    spinbutton_nodes_memory->set_value(_pConfig->nodesMemoryBudgetMB);
 
     Gtk::Frame* frame_misc_misc = new_managed_frame_with_align(_("Miscellaneous"), vbox_misc_misc);
 
@@ -168,6 +186,12 @@ Gtk::Widget* CtPrefDlg::build_tab_misc()
     checkbutton_autosave_on_quit->signal_toggled().connect([this, checkbutton_autosave_on_quit](){
         _pConfig->autosaveOnQuit = checkbutton_autosave_on_quit->get_active();
     });
+    checkbutton_xml_journal->signal_toggled().connect([this, checkbutton_xml_journal](){
+        _pConfig->xmlJournalOn = checkbutton_xml_journal->get_active();
+    });
+    checkbutton_protected_chunked->signal_toggled().connect([this, checkbutton_protected_chunked](){
+        _pConfig->protectedChunkedOn = checkbutton_protected_chunked->get_active();
+    });
     checkbutton_backup_before_saving->signal_toggled().connect([this, checkbutton_backup_before_saving, spinbutton_num_backups, checkbutton_custom_backup_dir, entry_custom_backup_dir, button_custom_backup_dir](){
         _pConfig->backupCopy = checkbutton_backup_before_saving->get_active();
         spinbutton_num_backups->set_sensitive(_pConfig->backupCopy);
@@ -200,6 +224,10 @@ Gtk::Widget* CtPrefDlg::build_tab_misc()
         _pConfig->winTitleShowDocDir = checkbutton_win_title_doc_dir->get_active();
         _pCtMainWin->window_title_update();
     });
+    spinbutton_nodes_memory->signal_value_changed().connect([this, spinbutton_nodes_memory](){
+        _pConfig->nodesMemoryBudgetMB = spinbutton_nodes_memory->get_value_as_int();
+        apply_for_each_window([](CtMainWin* win) { win->get_tree_store().get_buffers_cache().release_over_budget(); });
+    });
     checkbutton_newer_version->signal_toggled().connect([this, checkbutton_newer_version](){
         _pConfig->checkVersion = checkbutton_newer_version->get_active();
     });
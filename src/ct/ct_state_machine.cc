@@ -29,24 +29,30 @@
 CtAnchoredWidgetState_ImagePng::CtAnchoredWidgetState_ImagePng(CtImagePng* image)
  : CtAnchoredWidgetState{image->getOffset(), image->getJustification()}
  , link{image->get_link()}
- , pixbuf{image->get_pixbuf()->copy()}
+ , pixbuf{image->get_pixbuf()} // the image never alters its pixbuf
 {
 }
 
-bool CtAnchoredWidgetState_ImagePng::equal(std::shared_ptr<CtAnchoredWidgetState> state)
+bool CtAnchoredWidgetState_ImagePng::is_state_of(CtAnchoredWidget* widget)
 {
-    CtAnchoredWidgetState_ImagePng* other_state = dynamic_cast<CtAnchoredWidgetState_ImagePng*>(state.get());
-    return other_state and
-           charOffset == other_state->charOffset and
-           justification == other_state->justification and
-           link == other_state->link and
-           pixbuf->get_byte_length() == other_state->pixbuf->get_byte_length() and
-           0 == memcmp(pixbuf->get_pixels(), other_state->pixbuf->get_pixels(), pixbuf->get_byte_length() * sizeof(guint8));
+    auto image = dynamic_cast<CtImagePng*>(widget);
+    if (not image or justification != image->getJustification() or link != image->get_link()) {
+        return false;
+    }
+    // the pixbuf is shared with the images created from this state, a different one is a different image
+    return pixbuf == image->get_pixbuf();
+}
+
+std::shared_ptr<CtAnchoredWidgetState> CtAnchoredWidgetState_ImagePng::copy_at(int newCharOffset)
+{
+    auto state = std::make_shared<CtAnchoredWidgetState_ImagePng>(*this);
+    state->charOffset = newCharOffset;
+    return state;
 }
 
 CtAnchoredWidget* CtAnchoredWidgetState_ImagePng::to_widget(CtMainWin* pCtMainWin)
 {
-    return new CtImagePng{pCtMainWin, pixbuf->copy(), link, charOffset, justification};
+    return new CtImagePng{pCtMainWin, pixbuf, link, charOffset, justification};
 }
 
 // ImageAnchor
@@ -56,13 +62,19 @@ CtAnchoredWidgetState_Anchor::CtAnchoredWidgetState_Anchor(CtImageAnchor* anchor
 {
 }
 
-bool CtAnchoredWidgetState_Anchor::equal(std::shared_ptr<CtAnchoredWidgetState> state)
+bool CtAnchoredWidgetState_Anchor::is_state_of(CtAnchoredWidget* widget)
+{
+    auto anchor = dynamic_cast<CtImageAnchor*>(widget);
+    return anchor and
+           justification == anchor->getJustification() and
+           name == anchor->get_anchor_name();
+}
+
+std::shared_ptr<CtAnchoredWidgetState> CtAnchoredWidgetState_Anchor::copy_at(int newCharOffset)
 {
-    CtAnchoredWidgetState_Anchor* other_state = dynamic_cast<CtAnchoredWidgetState_Anchor*>(state.get());
-    return other_state and
-           charOffset == other_state->charOffset and
-           justification == other_state->justification and
-           name == other_state->name;
+    auto state = std::make_shared<CtAnchoredWidgetState_Anchor>(*this);
+    state->charOffset = newCharOffset;
+    return state;
 }
 
 CtAnchoredWidget* CtAnchoredWidgetState_Anchor::to_widget(CtMainWin* pCtMainWin)
@@ -74,27 +86,33 @@ CtAnchoredWidget* CtAnchoredWidgetState_Anchor::to_widget(CtMainWin* pCtMainWin)
 CtAnchoredWidgetState_EmbFile::CtAnchoredWidgetState_EmbFile(CtImageEmbFile* embFile)
  : CtAnchoredWidgetState(embFile->getOffset(), embFile->getJustification())
  , fileName(embFile->get_file_name())
- , rawBlob(embFile->get_raw_blob())
+ , rRawBlob(embFile->get_raw_blob_shared())
  , timeSeconds(embFile->get_time())
  , uniqueId(embFile->get_unique_id())
 {
 }
 
-bool CtAnchoredWidgetState_EmbFile::equal(std::shared_ptr<CtAnchoredWidgetState> state)
+bool CtAnchoredWidgetState_EmbFile::is_state_of(CtAnchoredWidget* widget)
+{
+    auto embFile = dynamic_cast<CtImageEmbFile*>(widget);
+    return embFile and
+           justification == embFile->getJustification() and
+           fileName == embFile->get_file_name() and
+           timeSeconds == embFile->get_time() and
+           uniqueId == embFile->get_unique_id() and
+           rRawBlob == embFile->get_raw_blob_shared(); // replaced bytes are a new pointer
+}
+
+std::shared_ptr<CtAnchoredWidgetState> CtAnchoredWidgetState_EmbFile::copy_at(int newCharOffset)
 {
-    CtAnchoredWidgetState_EmbFile* other_state = dynamic_cast<CtAnchoredWidgetState_EmbFile*>(state.get());
-    return other_state and
-           charOffset == other_state->charOffset and
-           justification == other_state->justification and
-           fileName == other_state->fileName and
-           rawBlob == other_state->rawBlob and
-           timeSeconds == other_state->timeSeconds and
-           uniqueId == other_state->uniqueId;
+    auto state = std::make_shared<CtAnchoredWidgetState_EmbFile>(*this);
+    state->charOffset = newCharOffset;
+    return state;
 }
 
 CtAnchoredWidget* CtAnchoredWidgetState_EmbFile::to_widget(CtMainWin* pCtMainWin)
 {
-    return new CtImageEmbFile(pCtMainWin, fileName, rawBlob, timeSeconds, charOffset, justification, uniqueId);
+    return new CtImageEmbFile(pCtMainWin, fileName, rRawBlob, timeSeconds, charOffset, justification, uniqueId);
 }
 
 // Codebox
@@ -110,19 +128,25 @@ CtAnchoredWidgetState_Codebox::CtAnchoredWidgetState_Codebox(CtCodebox* codebox)
 {
 }
 
-bool CtAnchoredWidgetState_Codebox::equal(std::shared_ptr<CtAnchoredWidgetState> state)
+bool CtAnchoredWidgetState_Codebox::is_state_of(CtAnchoredWidget* widget)
+{
+    auto codebox = dynamic_cast<CtCodebox*>(widget);
+    return codebox and
+           justification == codebox->getJustification() and
+           syntax == codebox->get_syntax_highlighting() and
+           width == codebox->get_frame_width() and
+           height == codebox->get_frame_height() and
+           widthInPixels == codebox->get_width_in_pixels() and
+           brackets == codebox->get_highlight_brackets() and
+           showNum == codebox->get_show_line_numbers() and
+           content == codebox->get_text_content();
+}
+
+std::shared_ptr<CtAnchoredWidgetState> CtAnchoredWidgetState_Codebox::copy_at(int newCharOffset)
 {
-    CtAnchoredWidgetState_Codebox* other_state = dynamic_cast<CtAnchoredWidgetState_Codebox*>(state.get());
-    return other_state and
-           charOffset == other_state->charOffset and
-           justification == other_state->justification and
-           syntax == other_state->syntax and
-           width == other_state->width and
-           height == other_state->height and
-           widthInPixels == other_state->widthInPixels and
-           brackets == other_state->brackets and
-           showNum == other_state->showNum and
-           content == other_state->content;
+    auto state = std::make_shared<CtAnchoredWidgetState_Codebox>(*this);
+    state->charOffset = newCharOffset;
+    return state;
 }
 
 CtAnchoredWidget* CtAnchoredWidgetState_Codebox::to_widget(CtMainWin* pCtMainWin)
@@ -144,40 +168,33 @@ CtAnchoredWidgetState_Table::CtAnchoredWidgetState_Table(CtTable* table)
  : CtAnchoredWidgetState{table->getOffset(), table->getJustification()}
  , colWidthDefault{table->get_col_width_default()}
  , colWidths{table->get_col_widths()}
+ , tableMatrix{table->get_table_matrix()}
  , currRow{table->current_row()}
  , currCol{table->current_column()}
 {
-    for (auto& row : table->get_table_matrix()) {
-        rows.push_back(std::vector<Glib::ustring>());
-        for (auto& cell : row) {
-            rows.back().push_back(cell->get_text_content());
-        }
-    }
 }
 
-bool CtAnchoredWidgetState_Table::equal(std::shared_ptr<CtAnchoredWidgetState> state)
+bool CtAnchoredWidgetState_Table::is_state_of(CtAnchoredWidget* widget)
+{
+    auto table = dynamic_cast<CtTable*>(widget);
+    return table and
+           justification == table->getJustification() and
+           colWidthDefault == table->get_col_width_default() and
+           colWidths == table->get_col_widths() and
+           currRow == table->current_row() and
+           currCol == table->current_column() and
+           tableMatrix == table->get_table_matrix();
+}
+
+std::shared_ptr<CtAnchoredWidgetState> CtAnchoredWidgetState_Table::copy_at(int newCharOffset)
 {
-    CtAnchoredWidgetState_Table* other_state = dynamic_cast<CtAnchoredWidgetState_Table*>(state.get());
-    return other_state and
-           charOffset == other_state->charOffset and
-           justification == other_state->justification and
-           colWidthDefault == other_state->colWidthDefault and
-           colWidths == other_state->colWidths and
-           currRow == other_state->currRow and
-           currCol == other_state->currCol and
-           rows == other_state->rows;
+    auto state = std::make_shared<CtAnchoredWidgetState_Table>(*this);
+    state->charOffset = newCharOffset;
+    return state;
 }
 
 CtAnchoredWidget* CtAnchoredWidgetState_Table::to_widget(CtMainWin* pCtMainWin)
 {
-    CtTableMatrix tableMatrix;
-    for (const auto& row : rows)
-    {
-        tableMatrix.push_back(CtTableRow());
-        for (const auto& cell : row) {
-            tableMatrix.back().push_back(new CtTextCell{pCtMainWin, cell, CtConst::TABLE_CELL_TEXT_ID});
-        }
-    }
     return new CtTable{pCtMainWin,
                        tableMatrix,
                        colWidthDefault,
@@ -202,6 +219,9 @@ void CtStateMachine::reset()
 {
     _visited_nodes_list.clear();
     _visited_nodes_idx = -1;
+    for (auto& pairStates : _node_states) {
+        _untrack_buffer(pairStates.second);
+    }
     _node_states.clear();
 }
 
@@ -240,20 +260,7 @@ void CtStateMachine::node_selected_changed(gint64 node_id)
         _visited_nodes_idx = _visited_nodes_list.size() - 1;
     }
     if (!map::exists(_node_states, node_id)) {
-        auto node = _pCtMainWin->curr_tree_iter();
-        auto state = std::shared_ptr<CtNodeState>(new CtNodeState{});
-        CtStorageXmlHelper{_pCtMainWin}.save_buffer_no_widgets_to_xml(state->buffer_xml.get_root_node(),
-                                                                      node.get_node_text_buffer(), 0, -1, 'n');
-        state->buffer_xml_string = state->buffer_xml.write_to_string();
-        for (auto widget : node.get_anchored_widgets()) {
-            state->widgetStates.push_back(widget->get_state());
-        }
-
-        CtNodeStates states;
-        states.states.push_back(state);
-        states.index = 0;     // first state
-        states.indicator = 0; // the current buffer state is saved
-        _node_states.insert(std::make_pair(node_id, states));
+        _push_step(_pCtMainWin->curr_tree_iter(), _node_states[node_id]); // first state
     }
 }
 
@@ -292,9 +299,12 @@ std::shared_ptr<CtNodeState> CtStateMachine::requested_state_previous(gint64 nod
     if (curr_index_is_last_index(node_id)) {
         update_state();
     }
-    if (_node_states[node_id].index > 0) {
-        _node_states[node_id].index -= 1;
-        return _node_states[node_id].get_state();
+    auto& node_states = _node_states[node_id];
+    // the steps before the last checkpoint in the limit are kept only until the next checkpoint
+    const int first_index = std::max(0, (int)node_states.steps.size() - _pCtMainWin->get_ct_config()->limitUndoableSteps);
+    if (node_states.index > first_index) {
+        node_states.index -= 1;
+        return _get_state(node_states);
     }
     return nullptr;
 }
@@ -302,15 +312,20 @@ std::shared_ptr<CtNodeState> CtStateMachine::requested_state_previous(gint64 nod
 // The current state is requested
 std::shared_ptr<CtNodeState> CtStateMachine::requested_state_current(gint64 node_id)
 {
-    return _node_states[node_id].get_state();
+    const auto& node_states = _node_states[node_id];
+    if (node_states.steps.empty()) {
+        return nullptr;
+    }
+    return _get_state(node_states);
 }
 
 // A Subsequent State, if Existing, is Requested
 std::shared_ptr<CtNodeState> CtStateMachine::requested_state_subsequent(gint64 node_id)
 {
-    if (_node_states[node_id].index < (int)_node_states[node_id].states.size()-1) {
-        _node_states[node_id].index += 1;
-        return _node_states[node_id].get_state();
+    auto& node_states = _node_states[node_id];
+    if (node_states.index < (int)node_states.steps.size()-1) {
+        node_states.index += 1;
+        return _get_state(node_states);
     }
     return nullptr;
 }
@@ -318,7 +333,11 @@ std::shared_ptr<CtNodeState> CtStateMachine::requested_state_subsequent(gint64 n
 // Delete the states for the given node_id
 void CtStateMachine::delete_states(gint64 node_id)
 {
-    _node_states.erase(node_id);
+    const auto iterStates = _node_states.find(node_id);
+    if (iterStates != _node_states.end()) {
+        _untrack_buffer(iterStates->second);
+        _node_states.erase(iterStates);
+    }
     if (vec::exists(_visited_nodes_list, node_id)) {
         vec::remove(_visited_nodes_list, node_id);
         _visited_nodes_idx = _visited_nodes_list.size()-1;
@@ -329,7 +348,7 @@ void CtStateMachine::delete_states(gint64 node_id)
 bool CtStateMachine::curr_index_is_last_index(gint64 node_id)
 {
     int curr_index = _node_states[node_id].index;
-    int last_index = _node_states[node_id].states.size() - 1;
+    int last_index = _node_states[node_id].steps.size() - 1;
     return curr_index == last_index;
 }
 
@@ -356,40 +375,27 @@ void CtStateMachine::update_state(CtTreeIter tree_iter)
     if (not tree_iter) return;
     if (not tree_iter.get_node_is_rich_text()) return;
 
-    gint64 node_id = tree_iter.get_node_id();
-    auto& node_states = _node_states[node_id];
-    if (!node_states.states.empty() and !curr_index_is_last_index(node_id)) {
-        node_states.states.erase(node_states.states.begin() + node_states.index + 1, node_states.states.end());
-    }
-
-    auto new_state = std::shared_ptr<CtNodeState>(new CtNodeState());
-    CtStorageXmlHelper(_pCtMainWin).save_buffer_no_widgets_to_xml(new_state->buffer_xml.get_root_node(), tree_iter.get_node_text_buffer(), 0, -1, 'n');
-    new_state->buffer_xml_string = new_state->buffer_xml.write_to_string();
-    for (auto widget : tree_iter.get_anchored_widgets()) {
-        new_state->widgetStates.push_back(widget->get_state());
+    auto& node_states = _node_states[tree_iter.get_node_id()];
+    if (not node_states.steps.empty() and node_states.index < (int)node_states.steps.size() - 1) {
+        node_states.steps.erase(node_states.steps.begin() + node_states.index + 1, node_states.steps.end());
     }
-
-    if (node_states.states.size() > 0) {
-        auto compare_widgets = [](const std::list<std::shared_ptr<CtAnchoredWidgetState>> lhs,
-                                  const std::list<std::shared_ptr<CtAnchoredWidgetState>> rhs){
-            return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](std::shared_ptr<CtAnchoredWidgetState> lhs, std::shared_ptr<CtAnchoredWidgetState> rhs) {
-                return lhs->equal(rhs);
-            });
+    if (not node_states.steps.empty() and
+        not node_states.varied and
+        node_states.pTrackedBuffer == tree_iter.get_node_text_buffer().get())
+    {
+        const std::vector<CtAnchoredWidget*> widgets = _get_widgets(tree_iter);
+        const auto& step_widgets = node_states.steps[node_states.index].widgets;
+        auto is_widget_unchanged = [&](CtAnchoredWidget* pWidget){
+            const auto iterState = node_states.stepWidgetStates.find(pWidget);
+            return iterState != node_states.stepWidgetStates.end() and iterState->second->is_state_of(pWidget);
         };
-        auto last_state = node_states.states.back();
-        if (new_state->buffer_xml_string == last_state->buffer_xml_string and
-            compare_widgets(new_state->widgetStates, last_state->widgetStates))
+        if (widgets.size() == step_widgets.size() and
+            std::all_of(widgets.begin(), widgets.end(), is_widget_unchanged))
         {
             return; // #print "update_state not needed"
         }
     }
-
-    node_states.states.push_back(new_state);
-    while ((int)node_states.states.size() > _pCtMainWin->get_ct_config()->limitUndoableSteps) {
-        node_states.states.erase(node_states.states.begin());
-    }
-    node_states.index = node_states.states.size() - 1;
-    node_states.indicator = 0; // the current buffer state is saved
+    _push_step(tree_iter, node_states);
 }
 
 void CtStateMachine::update_curr_state_cursor_pos(gint64 node_id)
@@ -398,9 +404,9 @@ void CtStateMachine::update_curr_state_cursor_pos(gint64 node_id)
     if (not _pCtMainWin->user_active()) return;
     const auto iterStates = _node_states.find(node_id);
     if (iterStates == _node_states.end()) return;
-    if (0 == iterStates->second.indicator) {
+    if (0 == iterStates->second.indicator and not iterStates->second.steps.empty()) {
         const int cursor_pos = _pCtMainWin->curr_buffer()->property_cursor_position();
-        iterStates->second.get_state()->cursor_pos = cursor_pos;
+        iterStates->second.steps[iterStates->second.index].cursor_pos = cursor_pos;
     }
 }
 
@@ -410,8 +416,233 @@ void CtStateMachine::update_curr_state_v_adj_val(gint64 node_id)
     if (not _pCtMainWin->user_active()) return;
     const auto iterStates = _node_states.find(node_id);
     if (iterStates == _node_states.end()) return;
-    if (0 == iterStates->second.indicator) {
+    if (0 == iterStates->second.indicator and not iterStates->second.steps.empty()) {
         const int v_adj_val = round(_pCtMainWin->getScrolledwindowText().get_vadjustment()->get_value());
-        iterStates->second.get_state()->v_adj_val = v_adj_val;
+        iterStates->second.steps[iterStates->second.index].v_adj_val = v_adj_val;
+    }
+}
+
+// The buffer was just loaded from the state at index
+void CtStateMachine::buffer_loaded_from_state(CtTreeIter tree_iter)
+{
+    const auto iterStates = _node_states.find(tree_iter.get_node_id());
+    if (iterStates == _node_states.end() or iterStates->second.steps.empty()) return;
+    CtNodeStates& node_states = iterStates->second;
+    Glib::RefPtr<Gsv::Buffer> rBuffer = tree_iter.get_node_text_buffer();
+    if (node_states.pTrackedBuffer != rBuffer.get()) return; // the next step will be a checkpoint
+
+    node_states.varied = false;
+    node_states.stepCharCount = rBuffer->get_char_count();
+    node_states.stepWidgetStates.clear();
+    const std::vector<CtAnchoredWidget*> widgets = _get_widgets(tree_iter);
+    const auto& step_widgets = node_states.steps[node_states.index].widgets;
+    if (widgets.size() == step_widgets.size()) {
+        // the widgets were created in the order of the step widgets
+        for (size_t i = 0; i < widgets.size(); ++i) {
+            node_states.stepWidgetStates[widgets[i]] = step_widgets[i].state;
+        }
+    }
+}
+
+// The buffer of the node was released, the first step of the buffer created again is a checkpoint
+void CtStateMachine::buffer_released(gint64 node_id)
+{
+    const auto iterStates = _node_states.find(node_id);
+    if (iterStates != _node_states.end()) {
+        _untrack_buffer(iterStates->second);
+        iterStates->second.stepWidgetStates.clear();
+    }
+}
+
+void CtStateMachine::_push_step(CtTreeIter tree_iter, CtNodeStates& node_states)
+{
+    Glib::RefPtr<Gsv::Buffer> rBuffer = tree_iter.get_node_text_buffer();
+    const int char_count = rBuffer->get_char_count();
+    const bool new_buffer = node_states.steps.empty() or node_states.pTrackedBuffer != rBuffer.get();
+    if (new_buffer) {
+        _track_buffer(tree_iter.get_node_id(), node_states, rBuffer);
+    }
+
+    CtNodeStep step;
+    std::map<CtAnchoredWidget*, std::shared_ptr<CtAnchoredWidgetState>> step_widget_states;
+    for (CtAnchoredWidget* pWidget : _get_widgets(tree_iter)) {
+        const auto iterState = node_states.stepWidgetStates.find(pWidget);
+        std::shared_ptr<CtAnchoredWidgetState> widget_state = iterState != node_states.stepWidgetStates.end() and iterState->second->is_state_of(pWidget) ?
+            iterState->second : pWidget->get_state();
+        step.widgets.push_back(CtNodeStep::Widget{pWidget->getOffset(), widget_state});
+        step_widget_states[pWidget] = widget_state;
+    }
+
+    // range varied in the buffer of the previous step, the same chars at head and tail
+    const int prev_char_count = node_states.stepCharCount;
+    const int head = node_states.varied ? std::min(node_states.unvariedHead, std::min(char_count, prev_char_count)) : char_count;
+    const int tail = node_states.varied ? std::min(node_states.unvariedTail, std::min(char_count, prev_char_count) - head) : 0;
+
+    bool checkpoint = new_buffer;
+    if (not checkpoint) {
+        int last_checkpoint = node_states.index;
+        while (not node_states.steps[last_checkpoint].is_checkpoint()) --last_checkpoint;
+        // a variation of most of the node is not worth a delta
+        checkpoint = node_states.index + 1 - last_checkpoint >= _checkpoint_interval() or
+                     2 * (char_count - tail - head) > char_count;
+    }
+    if (checkpoint) {
+        xmlpp::Document xml_doc;
+        CtStorageXmlHelper::save_buffer_no_widgets_to_xml(xml_doc.create_root_node("buffer"), rBuffer, 0, -1, 'n');
+        step.checkpoint_xml = xml_doc.write_to_string();
+    }
+    else {
+        auto widgets_before = [](const std::vector<CtNodeStep::Widget>& widgets, const int char_offset){
+            return (int)std::count_if(widgets.begin(), widgets.end(), [char_offset](const CtNodeStep::Widget& widget){
+                return widget.charOffset < char_offset;
+            });
+        };
+        step.text_start = head - widgets_before(step.widgets, head);
+        const int prev_end = prev_char_count - tail;
+        step.text_removed = prev_end - widgets_before(node_states.steps[node_states.index].widgets, prev_end) - step.text_start;
+        if (head < char_count - tail) {
+            xmlpp::Document xml_doc;
+            CtStorageXmlHelper::save_buffer_no_widgets_to_xml(xml_doc.create_root_node("buffer"), rBuffer, head, char_count - tail, 'n');
+            step.inserted_xml = xml_doc.write_to_string();
+        }
+    }
+
+    node_states.steps.push_back(std::move(step));
+    node_states.index = node_states.steps.size() - 1;
+    node_states.indicator = 0; // the current buffer state is saved
+    node_states.varied = false;
+    node_states.stepCharCount = char_count;
+    node_states.stepWidgetStates = std::move(step_widget_states);
+
+    // drop the oldest steps up to the next checkpoint, once there are enough steps after it
+    const int limit = _pCtMainWin->get_ct_config()->limitUndoableSteps;
+    while ((int)node_states.steps.size() > limit) {
+        int next_checkpoint = 1;
+        while (next_checkpoint < (int)node_states.steps.size() and not node_states.steps[next_checkpoint].is_checkpoint()) ++next_checkpoint;
+        if ((int)node_states.steps.size() - next_checkpoint < limit) {
+            break;
+        }
+        node_states.steps.erase(node_states.steps.begin(), node_states.steps.begin() + next_checkpoint);
+        node_states.index -= next_checkpoint;
+    }
+}
+
+// Rebuild the node state at index from the previous checkpoint and the following steps
+std::shared_ptr<CtNodeState> CtStateMachine::_get_state(const CtNodeStates& node_states)
+{
+    int first_index = node_states.index;
+    while (not node_states.steps[first_index].is_checkpoint()) --first_index;
+
+    Glib::RefPtr<Gsv::Buffer> rBuffer = _pCtMainWin->get_new_text_buffer();
+    _insert_slots_from_xml(rBuffer, node_states.steps[first_index].checkpoint_xml, 0);
+    for (int i = first_index + 1; i <= node_states.index; ++i) {
+        const CtNodeStep& step = node_states.steps[i];
+        if (step.text_removed > 0) {
+            rBuffer->erase(rBuffer->get_iter_at_offset(step.text_start), rBuffer->get_iter_at_offset(step.text_start + step.text_removed));
+        }
+        _insert_slots_from_xml(rBuffer, step.inserted_xml, step.text_start);
+    }
+
+    const CtNodeStep& step = node_states.steps[node_states.index];
+    auto state = std::make_shared<CtNodeState>();
+    CtStorageXmlHelper::save_buffer_no_widgets_to_xml(state->buffer_xml.get_root_node(), rBuffer, 0, -1, 'n');
+    for (const CtNodeStep::Widget& widget : step.widgets) {
+        state->widgetStates.push_back(widget.charOffset == widget.state->charOffset ? widget.state : widget.state->copy_at(widget.charOffset));
     }
+    state->cursor_pos = step.cursor_pos;
+    state->v_adj_val = step.v_adj_val;
+    return state;
+}
+
+void CtStateMachine::_insert_slots_from_xml(Glib::RefPtr<Gsv::Buffer> rBuffer, const Glib::ustring& xml_string, const int text_offset)
+{
+    if (xml_string.empty()) return;
+    xmlpp::DomParser parser;
+    if (not CtXmlHelper::safe_parse_memory(parser, xml_string)) {
+        spdlog::error("{} unexpected undo step xml", __FUNCTION__);
+        return;
+    }
+    const int chars_after = rBuffer->get_char_count() - text_offset;
+    std::list<CtAnchoredWidget*> widgets;
+    for (xmlpp::Node* slot_node : parser.get_document()->get_root_node()->get_children()) {
+        Gtk::TextIter insert_iter = rBuffer->get_iter_at_offset(rBuffer->get_char_count() - chars_after);
+        CtStorageXmlHelper{_pCtMainWin}.get_text_buffer_one_slot_from_xml(rBuffer, slot_node, widgets, &insert_iter, insert_iter.get_offset());
+    }
+}
+
+// The node widgets sorted by position, with the position and justification updated
+std::vector<CtAnchoredWidget*> CtStateMachine::_get_widgets(CtTreeIter tree_iter)
+{
+    std::vector<CtAnchoredWidget*> widgets;
+    Glib::RefPtr<Gsv::Buffer> rBuffer = tree_iter.get_node_text_buffer();
+    for (CtAnchoredWidget* pWidget : tree_iter.get_anchored_widgets_fast('n')) {
+        const Gtk::TextIter anchor_iter = rBuffer->get_iter_at_child_anchor(pWidget->getTextChildAnchor());
+        pWidget->updateOffset(anchor_iter.get_offset());
+        pWidget->updateJustification(anchor_iter);
+        widgets.push_back(pWidget);
+    }
+    std::sort(widgets.begin(), widgets.end(), [](CtAnchoredWidget* pWidget1, CtAnchoredWidget* pWidget2){
+        return pWidget1->getOffset() < pWidget2->getOffset();
+    });
+    return widgets;
+}
+
+void CtStateMachine::_track_buffer(const gint64 node_id, CtNodeStates& node_states, Glib::RefPtr<Gtk::TextBuffer> rBuffer)
+{
+    _untrack_buffer(node_states);
+    Gtk::TextBuffer* pBuffer = rBuffer.get();
+    node_states.pTrackedBuffer = pBuffer;
+    node_states.trackedConnections.push_back(rBuffer->signal_insert().connect(
+        [this, node_id, pBuffer](const Gtk::TextIter& pos, const Glib::ustring& /*text*/, int /*bytes*/){
+            _on_buffer_variation(node_id, pBuffer, pos.get_offset(), pos.get_offset());
+        }, false/*after*/));
+    node_states.trackedConnections.push_back(rBuffer->signal_insert_child_anchor().connect(
+        [this, node_id, pBuffer](const Gtk::TextIter& pos, const Glib::RefPtr<Gtk::TextChildAnchor>& /*anchor*/){
+            _on_buffer_variation(node_id, pBuffer, pos.get_offset(), pos.get_offset());
+        }, false/*after*/));
+    node_states.trackedConnections.push_back(rBuffer->signal_erase().connect(
+        [this, node_id, pBuffer](const Gtk::TextIter& range_start, const Gtk::TextIter& range_end){
+            _on_buffer_variation(node_id, pBuffer, range_start.get_offset(), range_end.get_offset());
+        }, false/*after*/));
+    auto on_tag_toggle = [this, node_id, pBuffer](const Glib::RefPtr<Gtk::TextTag>& rTag, const Gtk::TextIter& range_start, const Gtk::TextIter& range_end){
+        const Glib::ustring tag_name = rTag->property_name();
+        if (not tag_name.empty() and CtConst::GTKSPELLCHECK_TAG_NAME != tag_name) {
+            _on_buffer_variation(node_id, pBuffer, range_start.get_offset(), range_end.get_offset());
+        }
+    };
+    node_states.trackedConnections.push_back(rBuffer->signal_apply_tag().connect(on_tag_toggle, false/*after*/));
+    node_states.trackedConnections.push_back(rBuffer->signal_remove_tag().connect(on_tag_toggle, false/*after*/));
+}
+
+void CtStateMachine::_untrack_buffer(CtNodeStates& node_states)
+{
+    for (sigc::connection& connection : node_states.trackedConnections) {
+        connection.disconnect();
+    }
+    node_states.trackedConnections.clear();
+    node_states.pTrackedBuffer = nullptr;
+}
+
+// The range [start_offset, end_offset) of the buffer is about to vary
+void CtStateMachine::_on_buffer_variation(const gint64 node_id, Gtk::TextBuffer* pBuffer, const int start_offset, const int end_offset)
+{
+    const auto iterStates = _node_states.find(node_id);
+    if (iterStates == _node_states.end() or iterStates->second.pTrackedBuffer != pBuffer) return;
+    CtNodeStates& node_states = iterStates->second;
+    const int unvaried_tail = pBuffer->get_char_count() - end_offset;
+    if (node_states.varied) {
+        node_states.unvariedHead = std::min(node_states.unvariedHead, start_offset);
+        node_states.unvariedTail = std::min(node_states.unvariedTail, unvaried_tail);
+    }
+    else {
+        node_states.unvariedHead = start_offset;
+        node_states.unvariedTail = unvaried_tail;
+        node_states.varied = true;
+    }
+}
+
+// Steps between checkpoints; the history holds up to two checkpoints while the oldest steps are due to drop
+int CtStateMachine::_checkpoint_interval()
+{
+    return std::max(10, _pCtMainWin->get_ct_config()->limitUndoableSteps);
 }
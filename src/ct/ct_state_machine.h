@@ -43,7 +43,9 @@ public:
     {}
     virtual ~CtAnchoredWidgetState() {}
 
-    virtual bool equal(std::shared_ptr<CtAnchoredWidgetState> state) = 0;
+    // the widget still holds this state, wherever it is in the buffer
+    virtual bool is_state_of(CtAnchoredWidget* widget) = 0;
+    virtual std::shared_ptr<CtAnchoredWidgetState> copy_at(int newCharOffset) = 0;
     virtual CtAnchoredWidget* to_widget(CtMainWin* pCtMainWin) = 0;
 
 public:
@@ -56,12 +58,13 @@ class CtAnchoredWidgetState_ImagePng : public CtAnchoredWidgetState
 public:
     CtAnchoredWidgetState_ImagePng(CtImagePng* image);
 
-    bool equal(std::shared_ptr<CtAnchoredWidgetState> state) override;
+    bool is_state_of(CtAnchoredWidget* widget) override;
+    std::shared_ptr<CtAnchoredWidgetState> copy_at(int newCharOffset) override;
     CtAnchoredWidget* to_widget(CtMainWin* pCtMainWin) override;
 
 public:
     Glib::ustring link;
-    Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+    Glib::RefPtr<Gdk::Pixbuf> pixbuf; // shared with the widget, never altered
 };
 
 class CtAnchoredWidgetState_Anchor : public CtAnchoredWidgetState
@@ -69,7 +72,8 @@ class CtAnchoredWidgetState_Anchor : public CtAnchoredWidgetState
 public:
     CtAnchoredWidgetState_Anchor(CtImageAnchor* anchor);
 
-    bool equal(std::shared_ptr<CtAnchoredWidgetState> state) override;
+    bool is_state_of(CtAnchoredWidget* widget) override;
+    std::shared_ptr<CtAnchoredWidgetState> copy_at(int newCharOffset) override;
     CtAnchoredWidget* to_widget(CtMainWin* pCtMainWin) override;
 
 public:
@@ -81,12 +85,13 @@ class CtAnchoredWidgetState_EmbFile : public CtAnchoredWidgetState
 public:
     CtAnchoredWidgetState_EmbFile(CtImageEmbFile* embFile);
 
-    bool equal(std::shared_ptr<CtAnchoredWidgetState> state) override;
+    bool is_state_of(CtAnchoredWidget* widget) override;
+    std::shared_ptr<CtAnchoredWidgetState> copy_at(int newCharOffset) override;
     CtAnchoredWidget* to_widget(CtMainWin* pCtMainWin) override;
 
 public:
     fs::path      fileName;
-    std::string   rawBlob;      // raw data, not a string
+    std::shared_ptr<const std::string> rRawBlob; // shared with the widget, raw data
     time_t        timeSeconds;
     const size_t  uniqueId;
 };
@@ -96,7 +101,8 @@ class CtAnchoredWidgetState_Codebox : public CtAnchoredWidgetState
 public:
     CtAnchoredWidgetState_Codebox(CtCodebox* codebox);
 
-    bool equal(std::shared_ptr<CtAnchoredWidgetState> state) override;
+    bool is_state_of(CtAnchoredWidget* widget) override;
+    std::shared_ptr<CtAnchoredWidgetState> copy_at(int newCharOffset) override;
     CtAnchoredWidget* to_widget(CtMainWin* pCtMainWin) override;
 
 public:
@@ -110,13 +116,14 @@ class CtAnchoredWidgetState_Table : public CtAnchoredWidgetState
 public:
     CtAnchoredWidgetState_Table(CtTable* table);
 
-    bool equal(std::shared_ptr<CtAnchoredWidgetState> state) override;
+    bool is_state_of(CtAnchoredWidget* widget) override;
+    std::shared_ptr<CtAnchoredWidgetState> copy_at(int newCharOffset) override;
     CtAnchoredWidget* to_widget(CtMainWin* pCtMainWin) override;
 
 public:
     int colWidthDefault;
     CtTableColWidths colWidths;
-    std::vector<std::vector<Glib::ustring>> rows;
+    CtTableMatrix tableMatrix;
     size_t currRow;
     size_t currCol;
 };
@@ -127,18 +134,46 @@ struct CtNodeState
 
     std::list<std::shared_ptr<CtAnchoredWidgetState>> widgetStates;
     xmlpp::Document buffer_xml;
-    Glib::ustring   buffer_xml_string;
     int             cursor_pos{0};
     int             v_adj_val{0};
 };
 
-struct CtNodeStates
+// a step of the undo history is the text of the previous step with the range
+// [text_start, text_start+text_removed) replaced, or the whole text at the checkpoints;
+// text offsets do not count the widgets, which are states shared with the previous step unless changed
+struct CtNodeStep
 {
-    std::vector<std::shared_ptr<CtNodeState>> states;
-    int index;
-    int indicator;
+    struct Widget
+    {
+        int charOffset;
+        std::shared_ptr<CtAnchoredWidgetState> state;
+    };
+
+    bool is_checkpoint() const { return not checkpoint_xml.empty(); }
+
+    Glib::ustring       checkpoint_xml;
+    int                 text_start{0};
+    int                 text_removed{0};
+    Glib::ustring       inserted_xml;
+    std::vector<Widget> widgets;
+    int                 cursor_pos{0};
+    int                 v_adj_val{0};
+};
 
-    std::shared_ptr<CtNodeState> get_state() { return states[index]; }
+struct CtNodeStates
+{
+    std::vector<CtNodeStep> steps;
+    int index{0};
+    int indicator{0};
+
+    // the buffer range varied since the step at index, from the buffer signals
+    Gtk::TextBuffer*              pTrackedBuffer{nullptr};
+    std::vector<sigc::connection> trackedConnections;
+    bool                          varied{false};
+    int                           unvariedHead{0};
+    int                           unvariedTail{0};
+    int                           stepCharCount{0};
+    std::map<CtAnchoredWidget*, std::shared_ptr<CtAnchoredWidgetState>> stepWidgetStates;
 };
 
 class CtStateMachine
@@ -162,15 +197,33 @@ public:
     void update_state(CtTreeIter tree_iter);
     void update_curr_state_cursor_pos(gint64 node_id);
     void update_curr_state_v_adj_val(gint64 node_id);
+    void buffer_loaded_from_state(CtTreeIter tree_iter);
+    void buffer_released(gint64 node_id);
 
     void set_go_bk_fw_click(bool val) { _go_bk_fw_click = val; }
 
+    // the steps kept in the undo history of the node, checkpoints included
+    size_t get_node_steps_num(const gint64 node_id) const {
+        const auto iterStates = _node_states.find(node_id);
+        return iterStates != _node_states.end() ? iterStates->second.steps.size() : 0u;
+    }
+
     const std::vector<gint64>& get_visited_nodes_list() { return _visited_nodes_list; }
     void set_visited_nodes_list(const std::vector<gint64>& list) {
         _visited_nodes_list = list;
         _visited_nodes_idx = _visited_nodes_list.size() - 1;
     }
 
+private:
+    void _push_step(CtTreeIter tree_iter, CtNodeStates& node_states);
+    std::shared_ptr<CtNodeState> _get_state(const CtNodeStates& node_states);
+    void _insert_slots_from_xml(Glib::RefPtr<Gsv::Buffer> rBuffer, const Glib::ustring& xml_string, const int text_offset);
+    std::vector<CtAnchoredWidget*> _get_widgets(CtTreeIter tree_iter);
+    void _track_buffer(const gint64 node_id, CtNodeStates& node_states, Glib::RefPtr<Gtk::TextBuffer> rBuffer);
+    void _untrack_buffer(CtNodeStates& node_states);
+    void _on_buffer_variation(const gint64 node_id, Gtk::TextBuffer* pBuffer, const int start_offset, const int end_offset);
+    int _checkpoint_interval();
+
 private:
     CtMainWin*                  _pCtMainWin;
     Glib::RefPtr<Glib::Regex>   _word_regex;
@@ -0,0 +1,476 @@
+/*
+ * ct_storage_chunked.cc
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "ct_storage_chunked.h"
+#include "ct_p7za_iface.h"
+#include "ct_misc_utils.h"
+#include "ct_logging.h"
+#include <glib/gstdio.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+// header: magic, version, key cycles power, salt, key check
+// chunks: iv + encrypted LZMA2 data, see p7za_chunk_encode
+// index record: a chunk of is_full, previous record offset and size, entries number, entries (id, offset, size)
+// footer: index record offset and size, footer magic
+const char CtChunkedContainer::MAGIC[]{"CTCHUNKS"};
+
+namespace {
+
+constexpr guint32 CONTAINER_VERSION{1};
+constexpr size_t  MAGIC_SIZE{8};
+constexpr size_t  HEADER_SIZE{64};
+constexpr char    FOOTER_MAGIC[]{"CTCHUNKF"};
+constexpr size_t  FOOTER_SIZE{24};
+constexpr size_t  INDEX_RECORD_HEADER_SIZE{25};
+constexpr size_t  INDEX_ENTRY_SIZE{24};
+// a full index is written after so many index changes, else the chain would grow unbounded
+constexpr unsigned INDEX_CHAIN_MAX{32};
+
+void append_u32(std::string& s, const guint32 v)
+{
+    for (unsigned i = 0; i < 4; ++i) s.push_back((char)(guint8)(v >> (8*i)));
+}
+
+void append_u64(std::string& s, const guint64 v)
+{
+    for (unsigned i = 0; i < 8; ++i) s.push_back((char)(guint8)(v >> (8*i)));
+}
+
+guint32 read_u32(const char* p)
+{
+    guint32 v{0};
+    for (unsigned i = 0; i < 4; ++i) v |= (guint32)(guint8)p[i] << (8*i);
+    return v;
+}
+
+guint64 read_u64(const char* p)
+{
+    guint64 v{0};
+    for (unsigned i = 0; i < 8; ++i) v |= (guint64)(guint8)p[i] << (8*i);
+    return v;
+}
+
+// a hash of the key tells a wrong password without decoding anything
+std::array<guint8, 32> get_key_check(const std::array<guint8, 32>& key)
+{
+    std::array<guint8, 32> digest{};
+    gsize digest_len = digest.size();
+    GChecksum* pChecksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(pChecksum, key.data(), key.size());
+    g_checksum_get_digest(pChecksum, digest.data(), &digest_len);
+    g_checksum_free(pChecksum);
+    return digest;
+}
+
+std::shared_ptr<GMappedFile> map_file(const fs::path& file_path)
+{
+    GError* pError{nullptr};
+    GMappedFile* pMappedFile = g_mapped_file_new(file_path.c_str(), FALSE/*writable*/, &pError);
+    if (not pMappedFile) {
+        const std::string error_msg = pError ? pError->message : "cannot map file";
+        if (pError) g_error_free(pError);
+        throw std::runtime_error(error_msg);
+    }
+    return std::shared_ptr<GMappedFile>(pMappedFile, g_mapped_file_unref);
+}
+
+void write_to_file(FILE* pFile, const char* data, const size_t size, const fs::path& file_path)
+{
+    if (size > 0 and 1 != fwrite(data, size, 1, pFile)) {
+        throw std::runtime_error(fmt::format("failed to write {}", file_path.string()));
+    }
+}
+
+void sync_file(FILE* pFile, const fs::path& file_path)
+{
+    if (0 != fflush(pFile) or 0 != g_fsync(fileno(pFile))) {
+        throw std::runtime_error(fmt::format("failed to write {}", file_path.string()));
+    }
+}
+
+std::string get_footer(const guint64 index_offset, const guint64 index_size)
+{
+    std::string footer;
+    append_u64(footer, index_offset);
+    append_u64(footer, index_size);
+    footer.append(FOOTER_MAGIC, MAGIC_SIZE);
+    return footer;
+}
+
+} // namespace
+
+/*static*/ bool CtChunkedContainer::is_container(const fs::path& file_path)
+{
+    FILE* pFile = g_fopen(file_path.c_str(), "rb");
+    if (not pFile) {
+        return false;
+    }
+    char magic[MAGIC_SIZE];
+    const bool is_chunked = 1 == fread(magic, MAGIC_SIZE, 1, pFile) and 0 == memcmp(magic, MAGIC, MAGIC_SIZE);
+    fclose(pFile);
+    return is_chunked;
+}
+
+bool CtChunkedContainer::open(const fs::path& file_path, const Glib::ustring& password)
+{
+    std::shared_ptr<GMappedFile> pMappedFile = map_file(file_path);
+    const char* const data = g_mapped_file_get_contents(pMappedFile.get());
+    const size_t size = g_mapped_file_get_length(pMappedFile.get());
+    if (size < HEADER_SIZE + FOOTER_SIZE or 0 != memcmp(data, MAGIC, MAGIC_SIZE)) {
+        throw std::runtime_error(fmt::format("{} is not a chunked document", file_path.string()));
+    }
+    if (read_u32(data + 8) > CONTAINER_VERSION) {
+        throw std::runtime_error(fmt::format("{} is of a newer version", file_path.string()));
+    }
+    _num_cycles_power = read_u32(data + 12);
+    memcpy(_salt.data(), data + 16, _salt.size());
+    if (0 != CtP7zaIface::p7za_chunk_key(password.c_str(), _salt.data(), _salt.size(), _num_cycles_power, _key.data())) {
+        throw std::runtime_error(fmt::format("{} has an invalid key", file_path.string()));
+    }
+    if (0 != memcmp(get_key_check(_key).data(), data + 32, 32)) {
+        return false;
+    }
+
+    // the last footer pointing right before itself at an index that decodes, past it a save was torn
+    _file_size = size;
+    for (size_t pos = size - FOOTER_SIZE; pos >= HEADER_SIZE; --pos) {
+        if (0 != memcmp(data + pos + 16, FOOTER_MAGIC, MAGIC_SIZE)) {
+            continue;
+        }
+        const guint64 index_offset = read_u64(data + pos);
+        const guint64 index_size = read_u64(data + pos + 8);
+        if ( index_offset >= HEADER_SIZE and
+             index_size <= pos - index_offset and
+             index_offset + index_size == pos and
+             _read_index_chain(data, size, index_offset, index_size) )
+        {
+            if (pos + FOOTER_SIZE < size) {
+                spdlog::warn("{} {} discarded from byte {}", __FUNCTION__, file_path.string(), pos + FOOTER_SIZE);
+            }
+            _file_path = file_path;
+            return true;
+        }
+    }
+    throw std::runtime_error(fmt::format("{} has no complete index", file_path.string()));
+}
+
+void CtChunkedContainer::create(const Glib::ustring& password)
+{
+    CtP7zaIface::p7za_random(_salt.data(), _salt.size());
+    if (0 != CtP7zaIface::p7za_chunk_key(password.c_str(), _salt.data(), _salt.size(), _num_cycles_power, _key.data())) {
+        throw std::runtime_error("failed to create the key");
+    }
+    _file_path.clear();
+    _index.clear();
+}
+
+std::vector<gint64> CtChunkedContainer::get_ids() const
+{
+    std::vector<gint64> ids;
+    ids.reserve(_index.size());
+    for (const auto& id_entry : _index) {
+        ids.push_back(id_entry.first);
+    }
+    return ids;
+}
+
+std::vector<std::string> CtChunkedContainer::read_chunks(const std::vector<gint64>& ids) const
+{
+    std::shared_ptr<GMappedFile> pMappedFile = map_file(_file_path);
+    const char* const data = g_mapped_file_get_contents(pMappedFile.get());
+    const size_t size = g_mapped_file_get_length(pMappedFile.get());
+    std::vector<std::string> chunks(ids.size());
+    std::atomic<bool> decodeOk{true};
+    CtMiscUtil::parallel_for(0, ids.size(), [&](size_t i) {
+        auto it = _index.find(ids[i]);
+        if (it == _index.end()) {
+            return;
+        }
+        const IndexEntry& entry = it->second;
+        if ( entry.offset + entry.size > size or
+             0 != CtP7zaIface::p7za_chunk_decode(_key.data(), data + entry.offset, entry.size, chunks[i]) )
+        {
+            decodeOk = false;
+        }
+    });
+    if (not decodeOk) {
+        throw std::runtime_error(fmt::format("{} has damaged chunks", _file_path.string()));
+    }
+    return chunks;
+}
+
+void CtChunkedContainer::append(const std::map<gint64, std::string>& chunks, const std::vector<gint64>& removed_ids)
+{
+    if (not is_open()) {
+        throw std::runtime_error("no chunked document to append to");
+    }
+    const auto time_start = std::chrono::steady_clock::now();
+    const std::vector<std::string> encoded_chunks = _encode_chunks(chunks);
+
+    FILE* pFile = g_fopen(_file_path.c_str(), "ab");
+    if (not pFile) {
+        throw std::runtime_error(fmt::format("failed to open {}", _file_path.string()));
+    }
+    auto on_scope_exit = scope_guard([&](void*) { fclose(pFile); });
+    // past a torn save if any, that stays dead until compact
+    guint64 offset = fs::file_size(_file_path);
+
+    std::map<gint64, IndexEntry> index = _index;
+    std::map<gint64, IndexEntry> index_changes;
+    size_t chunks_size{0};
+    auto chunk_it = chunks.begin();
+    for (const std::string& encoded_chunk : encoded_chunks) {
+        write_to_file(pFile, encoded_chunk.data(), encoded_chunk.size(), _file_path);
+        index[chunk_it->first] = index_changes[chunk_it->first] = IndexEntry{offset, encoded_chunk.size()};
+        offset += encoded_chunk.size();
+        chunks_size += encoded_chunk.size();
+        ++chunk_it;
+    }
+    for (const gint64 id : removed_ids) {
+        if (index.erase(id)) {
+            index_changes[id] = IndexEntry{0, 0};
+        }
+    }
+
+    const bool is_full = _index_chain_len >= INDEX_CHAIN_MAX;
+    const std::string index_record = _encode_index(is_full ? index : index_changes, is_full);
+    const guint64 index_offset = offset;
+    write_to_file(pFile, index_record.data(), index_record.size(), _file_path);
+    const std::string footer = get_footer(index_offset, index_record.size());
+    write_to_file(pFile, footer.data(), footer.size(), _file_path);
+    sync_file(pFile, _file_path);
+
+    // only now the container takes the new index, a failure above leaves the previous one
+    _live_size = HEADER_SIZE + FOOTER_SIZE;
+    for (const auto& id_entry : index) {
+        _live_size += id_entry.second.size;
+    }
+    _index = std::move(index);
+    _index_chain_len = is_full ? 1 : _index_chain_len + 1;
+    _index_chain_size = (is_full ? 0 : _index_chain_size) + index_record.size();
+    _live_size += _index_chain_size;
+    _index_offset = index_offset;
+    _index_size = index_record.size();
+    _file_size = index_offset + index_record.size() + footer.size();
+
+    const double time_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+    spdlog::debug("{} chunks, {} bytes appended to {} in {:.3f} sec", encoded_chunks.size(), chunks_size + index_record.size() + footer.size(),
+                  _file_path.string(), time_elapsed);
+}
+
+void CtChunkedContainer::write_all(const fs::path& file_path, const std::map<gint64, std::string>& chunks)
+{
+    const std::vector<std::string> encoded_chunks = _encode_chunks(chunks);
+    std::vector<RawChunk> raw_chunks;
+    raw_chunks.reserve(encoded_chunks.size());
+    auto chunk_it = chunks.begin();
+    for (const std::string& encoded_chunk : encoded_chunks) {
+        raw_chunks.push_back(RawChunk{chunk_it->first, encoded_chunk.data(), encoded_chunk.size()});
+        ++chunk_it;
+    }
+    _write_new_file(file_path, raw_chunks, nullptr);
+}
+
+void CtChunkedContainer::compact()
+{
+    if (not is_open()) {
+        return;
+    }
+    std::shared_ptr<GMappedFile> pMappedFile = map_file(_file_path);
+    const char* const data = g_mapped_file_get_contents(pMappedFile.get());
+    std::vector<RawChunk> raw_chunks;
+    raw_chunks.reserve(_index.size());
+    for (const auto& id_entry : _index) {
+        raw_chunks.push_back(RawChunk{id_entry.first, data + id_entry.second.offset, id_entry.second.size});
+    }
+    const size_t dead_size = get_dead_size();
+    _write_new_file(_file_path, raw_chunks, std::move(pMappedFile));
+    spdlog::debug("{} bytes dropped from {}", dead_size, _file_path.string());
+}
+
+std::vector<std::string> CtChunkedContainer::_encode_chunks(const std::map<gint64, std::string>& chunks) const
+{
+    std::vector<const std::string*> plain_chunks;
+    plain_chunks.reserve(chunks.size());
+    for (const auto& id_chunk : chunks) {
+        plain_chunks.push_back(&id_chunk.second);
+    }
+    std::vector<std::string> encoded_chunks(plain_chunks.size());
+    std::atomic<bool> encodeOk{true};
+    CtMiscUtil::parallel_for(0, plain_chunks.size(), [&](size_t i) {
+        if (0 != CtP7zaIface::p7za_chunk_encode(_key.data(), *plain_chunks[i], encoded_chunks[i])) {
+            encodeOk = false;
+        }
+    });
+    if (not encodeOk) {
+        throw std::runtime_error("failed to encode the chunks");
+    }
+    return encoded_chunks;
+}
+
+std::string CtChunkedContainer::_encode_index(const std::map<gint64, IndexEntry>& entries, const bool is_full) const
+{
+    std::string index_record;
+    index_record.reserve(INDEX_RECORD_HEADER_SIZE + entries.size()*INDEX_ENTRY_SIZE);
+    index_record.push_back(is_full ? 1 : 0);
+    append_u64(index_record, is_full ? 0 : _index_offset);
+    append_u64(index_record, is_full ? 0 : _index_size);
+    append_u64(index_record, entries.size());
+    for (const auto& id_entry : entries) {
+        append_u64(index_record, (guint64)id_entry.first);
+        append_u64(index_record, id_entry.second.offset);
+        append_u64(index_record, id_entry.second.size);
+    }
+    std::string encoded_index;
+    if (0 != CtP7zaIface::p7za_chunk_encode(_key.data(), index_record, encoded_index)) {
+        throw std::runtime_error("failed to encode the index");
+    }
+    return encoded_index;
+}
+
+bool CtChunkedContainer::_read_index_chain(const char* data, const size_t size, const guint64 index_offset, const guint64 index_size)
+{
+    // from the last index record back to the last full one
+    std::vector<std::string> index_records;
+    size_t index_chain_size{0};
+    guint64 record_offset = index_offset;
+    guint64 record_size = index_size;
+    while (true) {
+        if (record_offset < HEADER_SIZE or record_offset + record_size > size) {
+            return false;
+        }
+        std::string index_record;
+        if ( 0 != CtP7zaIface::p7za_chunk_decode(_key.data(), data + record_offset, record_size, index_record) or
+             index_record.size() < INDEX_RECORD_HEADER_SIZE )
+        {
+            return false;
+        }
+        index_chain_size += record_size;
+        const bool is_full = 0 != index_record[0];
+        const guint64 prev_offset = read_u64(index_record.data() + 1);
+        const guint64 prev_size = read_u64(index_record.data() + 9);
+        index_records.push_back(std::move(index_record));
+        if (is_full) {
+            break;
+        }
+        if (prev_offset >= record_offset) {
+            return false;
+        }
+        record_offset = prev_offset;
+        record_size = prev_size;
+    }
+
+    std::map<gint64, IndexEntry> index;
+    for (auto it = index_records.rbegin(); it != index_records.rend(); ++it) {
+        const std::string& index_record = *it;
+        const guint64 entries_num = read_u64(index_record.data() + 17);
+        if (index_record.size() != INDEX_RECORD_HEADER_SIZE + entries_num*INDEX_ENTRY_SIZE) {
+            return false;
+        }
+        for (guint64 i = 0; i < entries_num; ++i) {
+            const char* pEntry = index_record.data() + INDEX_RECORD_HEADER_SIZE + i*INDEX_ENTRY_SIZE;
+            const gint64 id = (gint64)read_u64(pEntry);
+            const IndexEntry entry{read_u64(pEntry + 8), read_u64(pEntry + 16)};
+            if (0 == entry.size) {
+                index.erase(id);
+            }
+            else if (entry.offset < HEADER_SIZE or entry.offset + entry.size > index_offset) {
+                return false;
+            }
+            else {
+                index[id] = entry;
+            }
+        }
+    }
+
+    _index = std::move(index);
+    _index_offset = index_offset;
+    _index_size = index_size;
+    _index_chain_len = index_records.size();
+    _index_chain_size = index_chain_size;
+    _live_size = HEADER_SIZE + index_chain_size + FOOTER_SIZE;
+    for (const auto& id_entry : _index) {
+        _live_size += id_entry.second.size;
+    }
+    return true;
+}
+
+std::string CtChunkedContainer::_header() const
+{
+    std::string header{MAGIC, MAGIC_SIZE};
+    append_u32(header, CONTAINER_VERSION);
+    append_u32(header, _num_cycles_power);
+    header.append((const char*)_salt.data(), _salt.size());
+    const std::array<guint8, 32> key_check = get_key_check(_key);
+    header.append((const char*)key_check.data(), key_check.size());
+    return header;
+}
+
+void CtChunkedContainer::_write_new_file(const fs::path& file_path,
+                                         const std::vector<RawChunk>& raw_chunks,
+                                         std::shared_ptr<GMappedFile> pChunksMappedFile)
+{
+    // the container at file_path is whole at any time
+    fs::path tmp_file_path = file_path;
+    tmp_file_path += ".tmp";
+    std::map<gint64, IndexEntry> index;
+    std::string index_record;
+    guint64 offset{0};
+    {
+        FILE* pFile = g_fopen(tmp_file_path.c_str(), "wb");
+        if (not pFile) {
+            throw std::runtime_error(fmt::format("failed to open {}", tmp_file_path.string()));
+        }
+        auto on_scope_exit = scope_guard([&](void*) { fclose(pFile); });
+        const std::string header = _header();
+        write_to_file(pFile, header.data(), header.size(), tmp_file_path);
+        offset = header.size();
+        for (const RawChunk& raw_chunk : raw_chunks) {
+            write_to_file(pFile, raw_chunk.data, raw_chunk.size, tmp_file_path);
+            index[raw_chunk.id] = IndexEntry{offset, raw_chunk.size};
+            offset += raw_chunk.size;
+        }
+        index_record = _encode_index(index, true/*is_full*/);
+        write_to_file(pFile, index_record.data(), index_record.size(), tmp_file_path);
+        const std::string footer = get_footer(offset, index_record.size());
+        write_to_file(pFile, footer.data(), footer.size(), tmp_file_path);
+        sync_file(pFile, tmp_file_path);
+    }
+    // a mapped file cannot be replaced on windows
+    pChunksMappedFile.reset();
+    if (not fs::move_file(tmp_file_path, file_path)) {
+        fs::remove(tmp_file_path);
+        throw std::runtime_error(fmt::format("failed to replace {}", file_path.string()));
+    }
+
+    _file_path = file_path;
+    _index = std::move(index);
+    _index_offset = offset;
+    _index_size = index_record.size();
+    _index_chain_len = 1;
+    _index_chain_size = index_record.size();
+    _file_size = offset + index_record.size() + FOOTER_SIZE;
+    _live_size = _file_size;
+}
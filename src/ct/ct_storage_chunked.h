@@ -0,0 +1,122 @@
+/*
+ * ct_storage_chunked.h
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include "ct_filesystem.h"
+#include <glibmm/ustring.h>
+#include <glib.h>
+#include <array>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A password protected file of chunks, each compressed and encrypted on its own, and of an index of them.
+ * A save appends the changed chunks and the index changes, so that it costs as much as the changes
+ * and not as the whole document; a torn append is ignored as the last complete index is looked for from the end
+ */
+class CtChunkedContainer
+{
+public:
+    static const char MAGIC[];
+    static bool is_container(const fs::path& file_path);
+
+    /**
+     * @brief Opens the container at file_path with the chunks of its last complete index
+     * @return false if the password is wrong
+     * @throw std::runtime_error if the file cannot be read or is damaged
+     */
+    bool open(const fs::path& file_path, const Glib::ustring& password);
+    /**
+     * @brief Prepares the key of a new container, written by write_all
+     */
+    void create(const Glib::ustring& password);
+
+    bool is_open() const { return not _file_path.empty(); }
+    const fs::path& get_file_path() const { return _file_path; }
+    std::vector<gint64> get_ids() const;
+    /**
+     * @brief The bytes no longer referenced by the index, that compact drops
+     */
+    size_t get_dead_size() const { return _file_size - _live_size; }
+    size_t get_live_size() const { return _live_size; }
+
+    /**
+     * @brief Decrypts and decompresses the chunks in parallel, missing ids give empty chunks
+     * @throw std::runtime_error if a chunk is damaged
+     */
+    std::vector<std::string> read_chunks(const std::vector<gint64>& ids) const;
+    /**
+     * @brief Appends the new content of the chunks and the index changes, then syncs the file
+     * @throw std::runtime_error if the file cannot be written, the container is left as it was
+     */
+    void append(const std::map<gint64, std::string>& chunks, const std::vector<gint64>& removed_ids);
+    /**
+     * @brief A new container at file_path with these chunks only, it replaces the file once complete
+     */
+    void write_all(const fs::path& file_path, const std::map<gint64, std::string>& chunks);
+    /**
+     * @brief Copies the live chunks as they are to a new file replacing the container, nothing is encoded again
+     */
+    void compact();
+
+private:
+    struct IndexEntry
+    {
+        guint64 offset;
+        guint64 size;
+    };
+    struct RawChunk
+    {
+        gint64      id;
+        const char* data;
+        size_t      size;
+    };
+
+    std::vector<std::string> _encode_chunks(const std::map<gint64, std::string>& chunks) const;
+    std::string _encode_index(const std::map<gint64, IndexEntry>& entries, const bool is_full) const;
+    bool        _read_index_chain(const char* data, const size_t size, const guint64 index_offset, const guint64 index_size);
+    std::string _header() const;
+    /**
+     * @brief Writes the header, the chunks and a full index to a temporary file moved to file_path,
+     * the mapping of the raw chunks if any is released before the move
+     */
+    void        _write_new_file(const fs::path& file_path,
+                                const std::vector<RawChunk>& raw_chunks,
+                                std::shared_ptr<GMappedFile> pChunksMappedFile);
+
+private:
+    fs::path                      _file_path;
+    unsigned                      _num_cycles_power{19};
+    std::array<guint8, 16>        _salt{};
+    std::array<guint8, 32>        _key{};
+    std::map<gint64, IndexEntry>  _index;
+    guint64                       _index_offset{0};    // the last index record
+    guint64                       _index_size{0};
+    unsigned                      _index_chain_len{0}; // index records since the last full one
+    size_t                        _index_chain_size{0};
+    size_t                        _file_size{0};
+    size_t                        _live_size{0};       // header, chunks in the index, index records in the chain and footer
+};
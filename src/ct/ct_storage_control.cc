@@ -25,17 +25,27 @@
 #include "ct_storage_control.h"
 #include "ct_storage_xml.h"
 #include "ct_storage_sqlite.h"
+#include "ct_storage_chunked.h"
 #include "ct_p7za_iface.h"
 #include "ct_main_win.h"
 #include "ct_logging.h"
 #include <glib/gstdio.h>
 
-std::unique_ptr<CtStorageEntity> get_entity_by_type(CtMainWin* pCtMainWin, CtDocType file_type)
+std::unique_ptr<CtStorageEntity> get_entity_by_type(CtMainWin* pCtMainWin, const fs::path& file_path)
 {
-    if (file_type == CtDocType::SQLite) {
+    if (fs::get_doc_type(file_path) == CtDocType::SQLite) {
         return std::make_unique<CtStorageSqlite>(pCtMainWin);
     }
-    return std::make_unique<CtStorageXml>(pCtMainWin);
+    // an encrypted document is packaged whole at every save, it cannot have a journal aside
+    return std::make_unique<CtStorageXml>(pCtMainWin, fs::get_doc_encrypt(file_path) == CtDocEncrypt::False/*journal_allowed*/);
+}
+
+// a protected xml document saved as chunks rather than as a 7z archive
+static bool is_chunked_doc(const fs::path& file_path)
+{
+    return fs::get_doc_type(file_path) == CtDocType::XML and
+           fs::get_doc_encrypt(file_path) == CtDocEncrypt::True and
+           CtChunkedContainer::is_container(file_path);
 }
 
 /*static*/ CtStorageControl* CtStorageControl::create_dummy_storage(CtMainWin* pCtMainWin)
@@ -56,20 +66,45 @@ std::unique_ptr<CtStorageEntity> get_entity_by_type(CtMainWin* pCtMainWin, CtDoc
     {
         if (!fs::is_regular_file(file_path)) throw std::runtime_error("no file");
 
-        // unpack file if need
-        if (fs::get_doc_encrypt(file_path) == CtDocEncrypt::True) {
-            extracted_file_path = _extract_file(pCtMainWin, file_path, password);
-            if (extracted_file_path.empty()) {
+        // choose storage type
+        storage = get_entity_by_type(pCtMainWin, file_path);
+
+        if (is_chunked_doc(file_path)) {
+            // the chunks are decrypted in memory and the saves are appended to the document itself
+            auto storage_xml = std::make_unique<CtStorageXml>(pCtMainWin);
+            if (not _ask_password_until(pCtMainWin, file_path, password, [&](const Glib::ustring& password) {
+                    return storage_xml->open_chunked(file_path, password);
+                }))
+            {
                 // user canceled operation
                 return nullptr;
             }
+            storage = std::move(storage_xml);
+            if (!storage->populate_treestore(file_path, error)) throw std::runtime_error(error);
         }
+        else if (fs::get_doc_encrypt(file_path) == CtDocEncrypt::True and storage->can_work_in_memory()) {
+            // decrypt into memory, no plaintext copy on disk
+            std::string data;
+            if (not _extract_to_memory(pCtMainWin, file_path, password, data)) {
+                // user canceled operation
+                return nullptr;
+            }
+            extracted_file_path.clear();
+            if (!storage->populate_treestore_from_memory(std::move(data), error)) throw std::runtime_error(error);
+        }
+        else {
+            // unpack file if need
+            if (fs::get_doc_encrypt(file_path) == CtDocEncrypt::True) {
+                extracted_file_path = _extract_file(pCtMainWin, file_path, password);
+                if (extracted_file_path.empty()) {
+                    // user canceled operation
+                    return nullptr;
+                }
+            }
 
-        // choose storage type
-        storage = get_entity_by_type(pCtMainWin, fs::get_doc_type(file_path));
-
-        // load from file
-        if (!storage->populate_treestore(extracted_file_path, error)) throw std::runtime_error(error);
+            // load from file
+            if (!storage->populate_treestore(extracted_file_path, error)) throw std::runtime_error(error);
+        }
 
         // it's ready
         CtStorageControl* doc = new CtStorageControl();
@@ -109,8 +144,20 @@ std::unique_ptr<CtStorageEntity> get_entity_by_type(CtMainWin* pCtMainWin, CtDoc
     fs::path extracted_file_path = file_path;
     try
     {
-        if (fs::get_doc_encrypt(file_path) == CtDocEncrypt::True) {
-            extracted_file_path = pCtMainWin->get_ct_tmp()->getHiddenFilePath(file_path);
+        storage = get_entity_by_type(pCtMainWin, file_path);
+        if ( CtExporting::NONE == exporting and
+             fs::get_doc_type(file_path) == CtDocType::XML and
+             fs::get_doc_encrypt(file_path) == CtDocEncrypt::True and
+             pCtMainWin->get_ct_config()->protectedChunkedOn )
+        {
+            // written in place as chunks, no archive to package
+            auto storage_xml = std::make_unique<CtStorageXml>(pCtMainWin);
+            storage_xml->create_chunked(password);
+            storage = std::move(storage_xml);
+        }
+        else if (fs::get_doc_encrypt(file_path) == CtDocEncrypt::True) {
+            // an empty path keeps the document in memory
+            extracted_file_path = storage->can_work_in_memory() ? fs::path{} : pCtMainWin->get_ct_tmp()->getHiddenFilePath(file_path);
         }
         if (fs::is_regular_file(file_path)) {
             fs::remove(file_path);
@@ -119,14 +166,18 @@ std::unique_ptr<CtStorageEntity> get_entity_by_type(CtMainWin* pCtMainWin, CtDoc
             fs::remove(extracted_file_path);
         }
 
-        storage = get_entity_by_type(pCtMainWin, fs::get_doc_type(file_path));
         // will save all data because it's the first time
         CtStorageSyncPending fakePending;
         if (not storage->save_treestore(extracted_file_path, fakePending, error, exporting, start_offset, end_offset)) {
             throw std::runtime_error(error);
         }
         // encrypt the file
-        if (file_path != extracted_file_path)
+        if (extracted_file_path.empty())
+        {
+            if (!_package_memory(storage.get(), file_path, password, error))
+                throw std::runtime_error(error);
+        }
+        else if (file_path != extracted_file_path)
         {
             storage->close_connect(); // temporary, because of sqlite keepig the file
             if (!_package_file(extracted_file_path, file_path, password))
@@ -181,6 +232,10 @@ bool CtStorageControl::save(bool need_vacuum, Glib::ustring &error)
         // sqlite could lost connection
         _storage->test_connection();
 
+        // appending to the journal leaves the file untouched, a partially written record is discarded on load
+        if (_storage->is_journal_save(_extracted_file_path, _syncPending))
+            need_backup = false;
+
         if (need_backup)
         {
             // move is faster but the file is used by sqlite without encrypt
@@ -204,7 +259,12 @@ bool CtStorageControl::save(bool need_vacuum, Glib::ustring &error)
             _storage->vacuum();
 
         // encrypt the file
-        if (_file_path != _extracted_file_path)
+        if (_extracted_file_path.empty())
+        {
+            if (!_package_memory(_storage.get(), _file_path, _password, error))
+                throw std::runtime_error(error);
+        }
+        else if (_file_path != _extracted_file_path)
         {
             _storage->close_connect(); // temporary, because of sqlite keepig the file
             if (!_package_file(_extracted_file_path, _file_path, _password))
@@ -237,6 +297,14 @@ bool CtStorageControl::save(bool need_vacuum, Glib::ustring &error)
     }
 }
 
+void CtStorageControl::compact_on_close()
+{
+    // with changes not saved the document in memory differs from the one on disk
+    if (not _storage or _pCtMainWin->get_file_save_needed() or fs::get_doc_type(_file_path) != CtDocType::XML)
+        return;
+    _storage->vacuum();
+}
+
 Glib::RefPtr<Gsv::Buffer> CtStorageControl::get_delayed_text_buffer(const gint64& node_id,
                                                                     const std::string& syntax,
                                                                     std::list<CtAnchoredWidget*>& widgets) const
@@ -248,24 +316,71 @@ Glib::RefPtr<Gsv::Buffer> CtStorageControl::get_delayed_text_buffer(const gint64
     return _storage->get_delayed_text_buffer(node_id, syntax, widgets);
 }
 
-/*static*/ fs::path CtStorageControl::_extract_file(CtMainWin* pCtMainWin, const fs::path& file_path, Glib::ustring& password)
+bool CtStorageControl::can_reload_text_buffer(const gint64& node_id) const
+{
+    const auto iterNode = _syncPending.nodes_to_write_dict.find(node_id);
+    if (iterNode != _syncPending.nodes_to_write_dict.end() and iterNode->second.buff) {
+        return false;
+    }
+    return _storage and _storage->can_reload_text_buffer(node_id);
+}
+
+bool CtStorageControl::get_stored_node_text(const gint64& node_id, CtStoredNodeText& stored_text) const
+{
+    return _storage and _storage->get_stored_node_text(node_id, stored_text);
+}
+
+std::unique_ptr<CtStoredTextReader> CtStorageControl::create_stored_text_reader() const
+{
+    return _storage ? _storage->create_stored_text_reader() : nullptr;
+}
+
+std::optional<std::unordered_set<gint64>> CtStorageControl::get_nodes_maybe_containing(const Glib::ustring& text) const
+{
+    if (!_storage) {
+        return std::nullopt;
+    }
+    std::optional<std::unordered_set<gint64>> node_ids = _storage->get_nodes_maybe_containing(text);
+    if (node_ids) {
+        // the stored text of these is outdated or missing
+        for (const auto& node_pair : _syncPending.nodes_to_write_dict) {
+            node_ids->insert(node_pair.first);
+        }
+    }
+    return node_ids;
+}
+
+/*static*/ bool CtStorageControl::_ask_password_until(CtMainWin* pCtMainWin,
+                                                     const fs::path& file_path,
+                                                     Glib::ustring& password,
+                                                     const std::function<bool(const Glib::ustring&)>& try_password)
 {
-    fs::path temp_dir = pCtMainWin->get_ct_tmp()->getHiddenDirPath(file_path);
-    fs::path temp_file_path = pCtMainWin->get_ct_tmp()->getHiddenFilePath(file_path);
     Glib::ustring title = str::format(_("Enter Password for %s"), file_path.filename().string());
     while (true)
     {
         if (password.empty()) {
             CtDialogTextEntry dialogTextEntry(title, true/*forPassword*/, pCtMainWin);
             if (Gtk::RESPONSE_OK != dialogTextEntry.run()) {
-                // no password, user cancels operation, return empty path
-                return fs::path{};
+                // no password, user cancels operation
+                return false;
             }
             password = dialogTextEntry.get_entry_text();
         }
+        if (try_password(password)) {
+            return true;
+        }
+        password.clear();
+    }
+}
+
+/*static*/ fs::path CtStorageControl::_extract_file(CtMainWin* pCtMainWin, const fs::path& file_path, Glib::ustring& password)
+{
+    fs::path temp_dir = pCtMainWin->get_ct_tmp()->getHiddenDirPath(file_path);
+    fs::path temp_file_path = pCtMainWin->get_ct_tmp()->getHiddenFilePath(file_path);
+    auto try_password = [&](const Glib::ustring& password) {
         if (0 == CtP7zaIface::p7za_extract(file_path.c_str(), temp_dir.c_str(), password.c_str(), false)) {
             if (fs::is_regular_file(temp_file_path)) {
-                return temp_file_path;
+                return true;
             }
             const std::list<fs::path> filesInTmpDir = fs::get_dir_entries(temp_file_path.parent_path());
             if (filesInTmpDir.size() == 1 and
@@ -273,11 +388,23 @@ Glib::RefPtr<Gsv::Buffer> CtStorageControl::get_delayed_text_buffer(const gint64
                 fs::move_file(filesInTmpDir.front(), temp_file_path))
             {
                 spdlog::debug("encrypt doc renamed {} -> {}", filesInTmpDir.front().filename(), temp_file_path.filename());
-                return temp_file_path;
+                return true;
             }
         }
-        password.clear();
+        return false;
+    };
+    if (not _ask_password_until(pCtMainWin, file_path, password, try_password)) {
+        // user cancels operation, return empty path
+        return fs::path{};
     }
+    return temp_file_path;
+}
+
+/*static*/ bool CtStorageControl::_extract_to_memory(CtMainWin* pCtMainWin, const fs::path& file_path, Glib::ustring& password, std::string& data)
+{
+    return _ask_password_until(pCtMainWin, file_path, password, [&](const Glib::ustring& password) {
+        return 0 == CtP7zaIface::p7za_extract_to_memory(file_path.c_str(), password.c_str(), data);
+    });
 }
 
 /*static*/ bool CtStorageControl::_package_file(const fs::path& file_from, const fs::path& file_to, const Glib::ustring& password)
@@ -286,6 +413,20 @@ Glib::RefPtr<Gsv::Buffer> CtStorageControl::get_delayed_text_buffer(const gint64
             && fs::is_regular_file(file_to);
 }
 
+/*static*/ bool CtStorageControl::_package_memory(CtStorageEntity* pStorage, const fs::path& file_to, const Glib::ustring& password, Glib::ustring& error)
+{
+    std::string data;
+    if (not pStorage->get_memory_data(data, error)) {
+        return false;
+    }
+    const std::string item_name = CtTmp::getHiddenFileName(file_to).string();
+    if (0 != CtP7zaIface::p7za_archive_from_memory(data, item_name.c_str(), file_to.c_str(), password.c_str())) {
+        error = "couldn't encrypt the file";
+        return false;
+    }
+    return true;
+}
+
 void CtStorageControl::_put_in_backup(const fs::path& main_backup)
 {
     // backups with tildas can be either in the same directory where the db places or in a custom backup dir
@@ -384,6 +525,20 @@ void CtStorageControl::pending_edit_db_node_hier(gint64 node_id)
     }
 }
 
+void CtStorageControl::pending_edit_db_nodes_hier(const std::vector<gint64>& node_ids)
+{
+    _syncPending.nodes_to_write_dict.reserve(_syncPending.nodes_to_write_dict.size() + node_ids.size());
+    for (const gint64 node_id : node_ids)
+    {
+        auto inserted = _syncPending.nodes_to_write_dict.try_emplace(node_id);
+        if (inserted.second)
+        {
+            inserted.first->second.upd = true;
+        }
+        inserted.first->second.hier = true;
+    }
+}
+
 void CtStorageControl::pending_new_db_node(gint64 node_id)
 {
     CtStorageNodeState node_state;
@@ -394,6 +549,20 @@ void CtStorageControl::pending_new_db_node(gint64 node_id)
     _syncPending.nodes_to_write_dict[node_id] = node_state;
 }
 
+void CtStorageControl::pending_new_db_nodes(const std::vector<gint64>& node_ids)
+{
+    CtStorageNodeState node_state;
+    node_state.upd = false;
+    node_state.prop = true;
+    node_state.buff = true;
+    node_state.hier = true;
+    _syncPending.nodes_to_write_dict.reserve(_syncPending.nodes_to_write_dict.size() + node_ids.size());
+    for (const gint64 node_id : node_ids)
+    {
+        _syncPending.nodes_to_write_dict[node_id] = node_state;
+    }
+}
+
 void CtStorageControl::pending_rm_db_nodes(const std::vector<gint64>& node_ids)
 {
     for (const gint64 node_id : node_ids)
@@ -420,7 +589,19 @@ void CtStorageControl::add_nodes_from_storage(const fs::path& path, Gtk::TreeIte
 
     Glib::ustring password;
     fs::path extracted_file_path = path;
-    if (fs::get_doc_encrypt(path) == CtDocEncrypt::True) {
+    std::unique_ptr<CtStorageEntity> storage = get_entity_by_type(_pCtMainWin, path);
+    if (is_chunked_doc(path)) {
+        auto storage_xml = std::make_unique<CtStorageXml>(_pCtMainWin);
+        if (not _ask_password_until(_pCtMainWin, path, password, [&](const Glib::ustring& password) {
+                return storage_xml->open_chunked(path, password);
+            }))
+        {
+            // user canceled operation
+            return;
+        }
+        storage = std::move(storage_xml);
+    }
+    else if (fs::get_doc_encrypt(path) == CtDocEncrypt::True) {
         extracted_file_path = _extract_file(_pCtMainWin, path, password);
         if (extracted_file_path.empty()) {
             // user canceled operation
@@ -428,7 +609,6 @@ void CtStorageControl::add_nodes_from_storage(const fs::path& path, Gtk::TreeIte
         }
     }
 
-    std::unique_ptr<CtStorageEntity> storage = get_entity_by_type(_pCtMainWin, fs::get_doc_type(extracted_file_path));
     storage->import_nodes(extracted_file_path, parent_iter);
 
     _pCtMainWin->get_tree_store().nodes_sequences_fix(parent_iter, false);
@@ -475,16 +655,23 @@ void CtStorageCache::parallel_fetch_pixbufers(const std::vector<CtImagePng*>& im
 
     // auto start = std::chrono::steady_clock::now();
 
-    std::vector<std::pair<CtImagePng*, std::string>> image_pair(image_widgets.size());
-    for (size_t i = 0; i < image_widgets.size(); ++i)
-        image_pair[i].first = image_widgets[i];
+    // the images keep their png bytes, only the ones never encoded need the pixbuf saved to png
+    std::vector<CtImagePng*> images_to_encode;
+    for (CtImagePng* image : image_widgets)
+        if (xml || image->get_raw_blob_dirty())
+            images_to_encode.push_back(image);
+
+    std::vector<std::pair<CtImagePng*, std::string>> image_pair(images_to_encode.size());
+    for (size_t i = 0; i < images_to_encode.size(); ++i)
+        image_pair[i].first = images_to_encode[i];
 
     // replacement for tbb::parallel_for
     CtMiscUtil::parallel_for(0, image_pair.size(), [&](size_t index) {
         auto& pair = image_pair[index];
-        pair.second = pair.first->get_raw_blob();
-        if (xml) pair.second = Glib::Base64::encode(pair.second);
+        const std::string& rawBlob = pair.first->get_raw_blob();
+        if (xml) pair.second = Glib::Base64::encode(rawBlob);
     });
+    if (!xml) return; // the png bytes are taken from the images
 
     for (auto& pair: image_pair)
         _cached_images.emplace(pair);
@@ -25,6 +25,7 @@
 
 #include "ct_types.h"
 #include <glibmm/miscutils.h>
+#include <functional>
 
 class CtMainWin;
 class CtStorageControl
@@ -45,12 +46,26 @@ public:
 
 public:
     bool save(bool need_vacuum, Glib::ustring& error);
+    /**
+     * @brief Merges the journal of an XML document into the file, if nothing is left to save
+     */
+    void compact_on_close();
 
 private:
     CtStorageControl() = default;
 
+    /**
+     * @brief Asks for the password until try_password succeeds
+     * @return false if the user cancels
+     */
+    static bool     _ask_password_until(CtMainWin* pCtMainWin,
+                                        const fs::path& file_path,
+                                        Glib::ustring& password,
+                                        const std::function<bool(const Glib::ustring&)>& try_password);
     static fs::path _extract_file(CtMainWin* pCtMainWin, const fs::path& file_path, Glib::ustring& password);
+    static bool     _extract_to_memory(CtMainWin* pCtMainWin, const fs::path& file_path, Glib::ustring& password, std::string& data);
     static bool     _package_file(const fs::path& file_from, const fs::path& file_to, const Glib::ustring& password);
+    static bool     _package_memory(CtStorageEntity* pStorage, const fs::path& file_to, const Glib::ustring& password, Glib::ustring& error);
 
     void _put_in_backup(const fs::path& main_backup);
 
@@ -58,6 +73,17 @@ public:
     Glib::RefPtr<Gsv::Buffer> get_delayed_text_buffer(const gint64& node_id,
                                                       const std::string& syntax,
                                                       std::list<CtAnchoredWidget*>& widgets) const;
+    /**
+     * @brief Whether the node buffer can be released, to be created again as it is since not modified after saved
+     */
+    bool can_reload_text_buffer(const gint64& node_id) const;
+    /**
+     * @brief Ids of the nodes that may contain the given literal text, including the not yet saved ones
+     * @return std::nullopt if unknown, i.e. all nodes must be searched
+     */
+    std::optional<std::unordered_set<gint64>> get_nodes_maybe_containing(const Glib::ustring& text) const;
+    bool get_stored_node_text(const gint64& node_id, CtStoredNodeText& stored_text) const;
+    std::unique_ptr<CtStoredTextReader> create_stored_text_reader() const;
 
     const fs::path& get_file_path() { return _file_path; }
     time_t get_mod_time() { return _mod_time; }
@@ -65,11 +91,14 @@ public:
     fs::path get_file_dir()  { return _file_path.empty() ? "" : _file_path.parent_path(); }
 
     std::set<gint64> get_nodes_pending_rm() { return _syncPending.nodes_to_rm_set; }
+    const std::unordered_map<gint64, CtStorageNodeState>& get_nodes_pending_write() const { return _syncPending.nodes_to_write_dict; }
 
     void pending_edit_db_node_prop(gint64 node_id);
     void pending_edit_db_node_buff(gint64 node_id);
     void pending_edit_db_node_hier(gint64 node_id);
+    void pending_edit_db_nodes_hier(const std::vector<gint64>& node_ids);
     void pending_new_db_node(gint64 node_id);
+    void pending_new_db_nodes(const std::vector<gint64>& node_ids);
     void pending_rm_db_nodes(const std::vector<gint64>& node_ids);
     void pending_edit_db_bookmarks();
 
@@ -86,7 +115,7 @@ private:
     fs::path                         _file_path;
     time_t                           _mod_time{0};
     Glib::ustring                    _password;
-    fs::path                         _extracted_file_path;
+    fs::path                         _extracted_file_path; // empty if the encrypted document is kept in memory
     std::unique_ptr<CtStorageEntity> _storage;
     CtStorageSyncPending             _syncPending;
 };
@@ -26,8 +26,19 @@
 #include "ct_storage_control.h"
 #include "ct_main_win.h"
 #include "ct_logging.h"
+#include "ct_document.h"
 #include <unistd.h>
 #include <optional>
+#include <chrono>
+#include <cstring>
+
+// sqlite3_serialize/sqlite3_deserialize, built in by default since 3.36
+#if SQLITE_VERSION_NUMBER >= 3036000
+#define CT_SQLITE_SERIALIZE
+#endif // SQLITE_VERSION_NUMBER
+
+// 0: no user_version recorded, 1: indexes on father_id/sequence and node_id/offset, 2: node_fts text index
+const int CtStorageSqlite::SCHEMA_VERSION{2};
 
 const char CtStorageSqlite::TABLE_NODE_CREATE[]{"CREATE TABLE node ("
 "node_id INTEGER UNIQUE,"
@@ -47,6 +58,17 @@ const char CtStorageSqlite::TABLE_NODE_CREATE[]{"CREATE TABLE node ("
 };
 const char CtStorageSqlite::TABLE_NODE_INSERT[]{"INSERT INTO node VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?)"};
 const char CtStorageSqlite::TABLE_NODE_DELETE[]{"DELETE FROM node WHERE node_id=?"};
+const char CtStorageSqlite::TABLE_NODE_UPDATE_PROP[]{"UPDATE node SET name=?, syntax=?, tags=?, is_ro=?, is_richtxt=? WHERE node_id=?"};
+const char CtStorageSqlite::TABLE_NODE_UPDATE_BUFF[]{"UPDATE node SET txt=?, syntax=?, is_richtxt=?, has_codebox=?, has_table=?, has_image=?, ts_lastsave=? WHERE node_id=?"};
+
+const char CtStorageSqlite::TABLE_NODE_FTS_CREATE[]{"CREATE VIRTUAL TABLE IF NOT EXISTS node_fts USING fts5("
+"txt,"
+"ts_lastsave UNINDEXED,"
+"tokenize='trigram'"
+")"
+};
+const char CtStorageSqlite::TABLE_NODE_FTS_INSERT[]{"INSERT INTO node_fts (rowid, txt, ts_lastsave) VALUES(?,?,?)"};
+const char CtStorageSqlite::TABLE_NODE_FTS_DELETE[]{"DELETE FROM node_fts WHERE rowid=?"};
 
 const char CtStorageSqlite::TABLE_CODEBOX_CREATE[]{"CREATE TABLE codebox ("
 "node_id INTEGER,"
@@ -63,6 +85,7 @@ const char CtStorageSqlite::TABLE_CODEBOX_CREATE[]{"CREATE TABLE codebox ("
 };
 const char CtStorageSqlite::TABLE_CODEBOX_INSERT[]{"INSERT INTO codebox VALUES(?,?,?,?,?,?,?,?,?,?)"};
 const char CtStorageSqlite::TABLE_CODEBOX_DELETE[]{"DELETE FROM codebox WHERE node_id=?"};
+const char CtStorageSqlite::TABLE_CODEBOX_INDEX_CREATE[]{"CREATE INDEX IF NOT EXISTS codebox_node_id_offset ON codebox (node_id, offset)"};
 
 const char CtStorageSqlite::TABLE_TABLE_CREATE[]{"CREATE TABLE grid ("
 "node_id INTEGER,"
@@ -75,6 +98,7 @@ const char CtStorageSqlite::TABLE_TABLE_CREATE[]{"CREATE TABLE grid ("
 };
 const char CtStorageSqlite::TABLE_TABLE_INSERT[]{"INSERT INTO grid VALUES(?,?,?,?,?,?)"};
 const char CtStorageSqlite::TABLE_TABLE_DELETE[]{"DELETE FROM grid WHERE node_id=?"};
+const char CtStorageSqlite::TABLE_TABLE_INDEX_CREATE[]{"CREATE INDEX IF NOT EXISTS grid_node_id_offset ON grid (node_id, offset)"};
 
 const char CtStorageSqlite::TABLE_IMAGE_CREATE[]{"CREATE TABLE image ("
 "node_id INTEGER,"
@@ -89,6 +113,8 @@ const char CtStorageSqlite::TABLE_IMAGE_CREATE[]{"CREATE TABLE image ("
 };
 const char CtStorageSqlite::TABLE_IMAGE_INSERT[]{"INSERT INTO image VALUES(?,?,?,?,?,?,?,?)"};
 const char CtStorageSqlite::TABLE_IMAGE_DELETE[]{"DELETE FROM image WHERE node_id=?"};
+const char CtStorageSqlite::TABLE_IMAGE_DELETE_AT_OFFSET[]{"DELETE FROM image WHERE node_id=? AND offset=?"};
+const char CtStorageSqlite::TABLE_IMAGE_INDEX_CREATE[]{"CREATE INDEX IF NOT EXISTS image_node_id_offset ON image (node_id, offset)"};
 
 const char CtStorageSqlite::TABLE_CHILDREN_CREATE[]{"CREATE TABLE children ("
 "node_id INTEGER UNIQUE,"
@@ -98,6 +124,7 @@ const char CtStorageSqlite::TABLE_CHILDREN_CREATE[]{"CREATE TABLE children ("
 };
 const char CtStorageSqlite::TABLE_CHILDREN_INSERT[]{"INSERT INTO children (node_id, father_id, sequence) VALUES(?,?,?)"};
 const char CtStorageSqlite::TABLE_CHILDREN_DELETE[]{"DELETE FROM children WHERE node_id=?"};
+const char CtStorageSqlite::TABLE_CHILDREN_INDEX_CREATE[]{"CREATE INDEX IF NOT EXISTS children_father_id_sequence ON children (father_id, sequence)"};
 
 const char CtStorageSqlite::TABLE_BOOKMARK_CREATE[]{"CREATE TABLE bookmark ("
 "node_id INTEGER UNIQUE,"
@@ -109,6 +136,7 @@ const char CtStorageSqlite::TABLE_BOOKMARK_DELETE[]{"DELETE FROM bookmark"};
 
 const Glib::ustring CtStorageSqlite::ERR_SQLITE_PREPV2{"!! sqlite3_prepare_v2: "};
 const Glib::ustring CtStorageSqlite::ERR_SQLITE_STEP{"!! sqlite3_step: "};
+const std::array<const gchar*, 5> CtStorageSqlite::JOURNAL_MODES{"DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL"};
 
 class Sqlite3StmtAuto
 {
@@ -125,6 +153,31 @@ private:
     sqlite3_stmt* _pStmt{nullptr};
 };
 
+sqlite3_stmt* CtSqliteStmtCache::get(const char* sqlCmd)
+{
+    auto it = _stmts.find(sqlCmd);
+    if (it != _stmts.end()) {
+        sqlite3_reset(it->second);
+        sqlite3_clear_bindings(it->second);
+        return it->second;
+    }
+    sqlite3_stmt* pStmt{nullptr};
+    if (sqlite3_prepare_v2(_pDb, sqlCmd, -1, &pStmt, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(pStmt);
+        return nullptr;
+    }
+    _stmts[sqlCmd] = pStmt;
+    return pStmt;
+}
+
+void CtSqliteStmtCache::finalize_all()
+{
+    for (auto& stmt_pair : _stmts) {
+        sqlite3_finalize(stmt_pair.second);
+    }
+    _stmts.clear();
+}
+
 std::optional<std::vector<std::string>> get_quick_check_issues(sqlite3* db)
 {
     if (!db) throw std::logic_error("get_quick_check_issues passed invalid database object");
@@ -172,11 +225,14 @@ CtStorageSqlite::~CtStorageSqlite()
 
 void CtStorageSqlite::close_connect()
 {
+    // closing would drop a database in memory
+    if (_in_memory) return;
     _close_db();
 }
 
 void CtStorageSqlite::reopen_connect()
 {
+    if (_in_memory) return;
     _open_db(_file_path.c_str());
 }
 
@@ -219,30 +275,163 @@ bool CtStorageSqlite::populate_treestore(const fs::path& file_path, Glib::ustrin
         // open db
         _open_db(file_path);
         _file_path = file_path;
+        _in_memory = false;
 
-        if (!_check_database_integrity()) return false;
+        // keep db open for lazy node buffer loading
+        return _load_from_db();
+    }
+    catch (std::exception& e)
+    {
+        _close_db();
+        error = e.what();
+        return false;
+    }
+}
 
+bool CtStorageSqlite::populate_treestore_from_memory(std::string&& data, Glib::ustring& error)
+{
+#ifdef CT_SQLITE_SERIALIZE
+    _close_db();
+    try
+    {
+        // no file path, there is nothing to reconnect to
+        _open_db(":memory:", false/*apply_journal_mode*/);
+        _file_path.clear();
+        _in_memory = true;
+
+        // sqlite owns its copy, grown by the writes of the next saves
+        const sqlite3_int64 data_size = data.size();
+        auto pData = static_cast<unsigned char*>(sqlite3_malloc64(data_size));
+        if (not pData) {
+            throw std::bad_alloc{};
+        }
+        memcpy(pData, data.data(), data_size);
+        data.clear();
+        data.shrink_to_fit();
+        if (SQLITE_OK != sqlite3_deserialize(_pDb, "main", pData, data_size, data_size,
+                                             SQLITE_DESERIALIZE_FREEONCLOSE | SQLITE_DESERIALIZE_RESIZEABLE)) {
+            throw std::runtime_error(std::string("sqlite3_deserialize: ") + sqlite3_errmsg(_pDb));
+        }
+        // the in-memory database is capped at 1 GiB by default (SQLITE_FULL past it),
+        // raised to the largest block sqlite3_realloc can grow it to
+        sqlite3_int64 size_limit{0x7ffffeff};
+        if (SQLITE_OK != sqlite3_file_control(_pDb, "main", SQLITE_FCNTL_SIZE_LIMIT, &size_limit)) {
+            spdlog::warn("{} sqlite3_file_control SQLITE_FCNTL_SIZE_LIMIT: {}", __FUNCTION__, sqlite3_errmsg(_pDb));
+        }
 
-        // load bookmarks
-        Sqlite3StmtAuto stmt{_pDb, "SELECT node_id FROM bookmark ORDER BY sequence ASC"};
-        if (stmt.is_bad())
-            throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
-        while (sqlite3_step(stmt) == SQLITE_ROW)
-               _pCtMainWin->get_tree_store().bookmarks_add(sqlite3_column_int64(stmt, 0));
-
-        // load node tree
-        std::function<void(guint node_id, const gint64, Gtk::TreeIter)> nodes_from_db;
-        nodes_from_db = [&](guint node_id, const gint64 sequence, Gtk::TreeIter parent_iter) {
-            Gtk::TreeIter new_iter = _node_from_db(node_id, sequence, parent_iter, -1);
-            gint64 child_sequence = 0;
-            for (gint64 child_node_id : _get_children_node_ids_from_db(node_id))
-                nodes_from_db(child_node_id, ++child_sequence, new_iter);
-        };
-        gint64 sequence = 0;
-        for (gint64 &top_node_id: _get_children_node_ids_from_db(0))
-            nodes_from_db(top_node_id, ++sequence, Gtk::TreeIter());
+        return _load_from_db();
+    }
+    catch (std::exception& e)
+    {
+        _close_db();
+        error = e.what();
+        return false;
+    }
+#else
+    (void)data;
+    error = "sqlite3_deserialize is not available";
+    return false;
+#endif // CT_SQLITE_SERIALIZE
+}
 
-        // keep db open for lazy node buffer loading
+bool CtStorageSqlite::can_work_in_memory() const
+{
+#ifdef CT_SQLITE_SERIALIZE
+    return true;
+#else
+    return false;
+#endif // CT_SQLITE_SERIALIZE
+}
+
+bool CtStorageSqlite::get_memory_data(std::string& data, Glib::ustring& error)
+{
+#ifdef CT_SQLITE_SERIALIZE
+    if (not _pDb or not _in_memory) {
+        error = "no database in memory";
+        return false;
+    }
+    // a deserialized database is read in place, one created in memory is copied first
+    sqlite3_int64 data_size{0};
+    if (const unsigned char* pData = sqlite3_serialize(_pDb, "main", &data_size, SQLITE_SERIALIZE_NOCOPY)) {
+        data.assign(reinterpret_cast<const char*>(pData), data_size);
+        return true;
+    }
+    unsigned char* pData = sqlite3_serialize(_pDb, "main", &data_size, 0);
+    if (not pData) {
+        error = std::string("sqlite3_serialize: ") + sqlite3_errmsg(_pDb);
+        return false;
+    }
+    data.assign(reinterpret_cast<const char*>(pData), data_size);
+    sqlite3_free(pData);
+    return true;
+#else
+    (void)data;
+    error = "sqlite3_serialize is not available";
+    return false;
+#endif // CT_SQLITE_SERIALIZE
+}
+
+bool CtStorageSqlite::_load_from_db()
+{
+    if (!_check_database_integrity()) return false;
+
+    // load bookmarks
+    Sqlite3StmtAuto stmt{_pDb, "SELECT node_id FROM bookmark ORDER BY sequence ASC"};
+    if (stmt.is_bad())
+        throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+           _pCtMainWin->get_tree_store().bookmarks_add(sqlite3_column_int64(stmt, 0));
+
+    // load node tree
+    _nodes_from_db(Gtk::TreeIter{}, false/*is_import*/);
+    return true;
+}
+
+bool CtStorageSqlite::populate_doc_nodes(const fs::path& file_path, CtDocNodes& doc_nodes, Glib::ustring& error)
+{
+    _close_db();
+    try
+    {
+        // only read, the document is neither checked nor upgraded
+        _open_db(file_path, false/*apply_journal_mode*/);
+        _file_path = file_path;
+        _in_memory = false;
+
+        doc_nodes.nodes.clear();
+        doc_nodes.bookmarks.clear();
+        {
+            Sqlite3StmtAuto stmt{_pDb, "SELECT node_id FROM bookmark ORDER BY sequence ASC"};
+            if (stmt.is_bad())
+                throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+                doc_nodes.bookmarks.push_back(sqlite3_column_int64(stmt, 0));
+        }
+
+        std::unordered_map<gint64, std::vector<gint64>> children_dict;
+        std::unordered_map<gint64, CtNodeData> nodes_data_dict;
+        _read_nodes_from_db(children_dict, nodes_data_dict);
+
+        std::function<void(const gint64, const int, const int)> children_from_dict;
+        children_from_dict = [&](const gint64 father_id, const int level, const int parent_index) {
+            auto it_children = children_dict.find(father_id);
+            if (it_children == children_dict.end()) return;
+            // taken out of the dict so that a corrupted hierarchy cannot loop forever
+            const std::vector<gint64> children_ids = std::move(it_children->second);
+            children_dict.erase(it_children);
+
+            gint64 sequence{0};
+            for (const gint64 node_id : children_ids) {
+                auto it_data = nodes_data_dict.find(node_id);
+                if (it_data == nodes_data_dict.end()) {
+                    throw std::runtime_error(std::string("CtDocSqliteStorage: missing node properties for id ") + std::to_string(node_id));
+                }
+                it_data->second.sequence = ++sequence;
+                doc_nodes.nodes.push_back(CtDocNode{std::move(it_data->second), level, parent_index});
+                nodes_data_dict.erase(it_data);
+                children_from_dict(node_id, level + 1, (int)doc_nodes.nodes.size() - 1);
+            }
+        };
+        children_from_dict(0, 0, -1);
         return true;
     }
     catch (std::exception& e)
@@ -253,6 +442,136 @@ bool CtStorageSqlite::populate_treestore(const fs::path& file_path, Glib::ustrin
     }
 }
 
+void CtStorageSqlite::create_doc(const fs::path& file_path, const std::vector<gint64>& bookmarks)
+{
+    _close_db();
+    _open_db(file_path, false/*apply_journal_mode*/);
+    _file_path = file_path;
+    _in_memory = false;
+
+    // all the nodes go into a single transaction, a document not committed is rolled back on close
+    _exec_no_callback("BEGIN");
+    _create_all_tables_in_db();
+    _write_bookmarks_to_db(std::list<gint64>{bookmarks.begin(), bookmarks.end()});
+}
+
+void CtStorageSqlite::write_doc_node(const CtDocNode& doc_node, const gint64 node_father_id, const CtDecodedNodeText& decoded_text)
+{
+    const CtNodeData& node_data = doc_node.node_data;
+    // is_ro and is_richtxt are packed with additional bitfield data, as by _write_node_to_db
+    gint64 is_ro = node_data.isRO ? 0x01 : 0x00;
+    is_ro |= node_data.customIconId << 1;
+    const bool is_rich_text = node_data.syntax == CtConst::RICH_TEXT_ID;
+    gint64 is_richtxt = is_rich_text ? 0x01 : 0x00;
+    if (node_data.isBold)
+    {
+        is_richtxt |= 0x02;
+    }
+    if (!node_data.foregroundRgb24.empty())
+    {
+        is_richtxt |= 0x04;
+        is_richtxt |= CtRgbUtil::get_rgb24int_from_str_any(node_data.foregroundRgb24.c_str()+1) << 3;
+    }
+
+    auto step_or_throw = [&](sqlite3_stmt* pStmt) {
+        if (sqlite3_step(pStmt) != SQLITE_DONE)
+            throw std::runtime_error(ERR_SQLITE_STEP + sqlite3_errmsg(_pDb));
+    };
+    auto get_stmt_or_throw = [&](const char* sqlCmd) {
+        sqlite3_stmt* pStmt = _stmtCache.get(sqlCmd);
+        if (!pStmt)
+            throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
+        return pStmt;
+    };
+
+    // write hier
+    {
+        sqlite3_stmt* pStmt = get_stmt_or_throw(TABLE_CHILDREN_INSERT);
+        sqlite3_bind_int64(pStmt, 1, node_data.nodeId);
+        sqlite3_bind_int64(pStmt, 2, node_father_id);
+        sqlite3_bind_int64(pStmt, 3, node_data.sequence);
+        step_or_throw(pStmt);
+    }
+
+    // write widgets, by the same writer as the widgets to_sqlite
+    bool has_codebox{false};
+    bool has_table{false};
+    bool has_image{false};
+    std::string fts_widgets_txt;
+    for (const CtDecodedNodeText::Widget& widget : decoded_text.widgets)
+    {
+        if (!is_rich_text) break;
+        fts_widgets_txt += CtConst::CHAR_NEWLINE;
+        if (!write_widget_row(_stmtCache, node_data.nodeId, widget))
+            throw std::runtime_error(ERR_SQLITE_STEP + sqlite3_errmsg(_pDb));
+        if (CtAnchWidgType::CodeBox == widget.type)
+        {
+            has_codebox = true;
+            fts_widgets_txt += widget.text;
+        }
+        else if (CtAnchWidgType::Table == widget.type)
+        {
+            has_table = true;
+            // the cells in the order of the rows written, the header last
+            for (size_t rowIdx = 1; rowIdx <= widget.table_rows.size(); ++rowIdx)
+                for (const Glib::ustring& cell : widget.table_rows[rowIdx % widget.table_rows.size()])
+                    fts_widgets_txt += cell;
+        }
+        else
+        {
+            has_image = true;
+            if (CtAnchWidgType::ImagePng != widget.type)
+                fts_widgets_txt += widget.text; // anchor or embedded file name
+        }
+    }
+
+    // write node buffer and node prop
+    std::string node_txt;
+    std::string fts_txt;
+    for (const CtDecodedNodeText::TextRun& run : decoded_text.runs)
+        fts_txt += run.text;
+    if (is_rich_text)
+    {
+        xmlpp::Document xml_doc;
+        xml_doc.create_root_node("node");
+        CtStorageXmlHelper::decoded_text_to_xml(xml_doc.get_root_node(), decoded_text, false/*with_widgets*/);
+        node_txt = xml_doc.write_to_string();
+    }
+    else
+    {
+        node_txt = fts_txt;
+    }
+    fts_txt += fts_widgets_txt;
+
+    sqlite3_stmt* pStmt = get_stmt_or_throw(TABLE_NODE_INSERT);
+    const std::string node_name = node_data.name;
+    const std::string node_tags = node_data.tags;
+    sqlite3_bind_int64(pStmt, 1, node_data.nodeId);
+    sqlite3_bind_text(pStmt, 2, node_name.c_str(), node_name.size(), SQLITE_STATIC);
+    sqlite3_bind_text(pStmt, 3, node_txt.c_str(), node_txt.size(), SQLITE_STATIC);
+    sqlite3_bind_text(pStmt, 4, node_data.syntax.c_str(), node_data.syntax.size(), SQLITE_STATIC);
+    sqlite3_bind_text(pStmt, 5, node_tags.c_str(), node_tags.size(), SQLITE_STATIC);
+    sqlite3_bind_int64(pStmt, 6, is_ro);
+    sqlite3_bind_int64(pStmt, 7, is_richtxt);
+    sqlite3_bind_int64(pStmt, 8, has_codebox);
+    sqlite3_bind_int64(pStmt, 9, has_table);
+    sqlite3_bind_int64(pStmt, 10, has_image);
+    sqlite3_bind_int64(pStmt, 11, 0); // todo: get rid of unused column 'level'
+    sqlite3_bind_int64(pStmt, 12, node_data.tsCreation);
+    sqlite3_bind_int64(pStmt, 13, node_data.tsLastSave);
+    step_or_throw(pStmt);
+
+    if (_fts_table_exists()) {
+        _write_node_fts_to_db(node_data.nodeId, fts_txt, node_data.tsLastSave);
+    }
+}
+
+void CtStorageSqlite::commit_doc()
+{
+    _exec_no_callback("COMMIT");
+    _close_db();
+}
+
 bool CtStorageSqlite::save_treestore(const fs::path& file_path,
                                      const CtStorageSyncPending& syncPending,
                                      Glib::ustring& error,
@@ -263,11 +582,31 @@ bool CtStorageSqlite::save_treestore(const fs::path& file_path,
     try
     {
         // it's the first time (or an export), a new file will be created
-        if (_pDb == nullptr)
+        const bool is_new_db{nullptr == _pDb};
+        if (is_new_db)
         {
-            _open_db(file_path);
-            _file_path = file_path;
+            if (file_path.empty()) {
+                // to be read by get_memory_data
+                _open_db(":memory:", false/*apply_journal_mode*/);
+                _in_memory = true;
+            }
+            else {
+                _open_db(file_path);
+                _file_path = file_path;
+            }
+        }
+
+        // all the writes of a save go into a single transaction
+        const auto time_start = std::chrono::steady_clock::now();
+        const int total_changes_start = sqlite3_total_changes(_pDb);
+        _exec_no_callback("BEGIN");
+        bool committed{false};
+        auto on_scope_exit = scope_guard([&](void*) {
+            if (not committed) sqlite3_exec(_pDb, "ROLLBACK", nullptr, nullptr, nullptr);
+        });
 
+        if (is_new_db)
+        {
             _create_all_tables_in_db();
             if ( CtExporting::NONE == exporting or
                  CtExporting::ALL_TREE == exporting ) {
@@ -285,7 +624,7 @@ bool CtStorageSqlite::save_treestore(const fs::path& file_path,
             // function to iterate through the tree
             std::function<void(CtTreeIter, const gint64, const gint64)> save_node_fun;
             save_node_fun = [&](CtTreeIter ct_tree_iter, const gint64 sequence, const gint64 father_id) {
-                _write_node_to_db(&ct_tree_iter, sequence, father_id, node_state, start_offset, end_offset, &storage_cache);
+                _write_node_to_db(&ct_tree_iter, sequence, father_id, node_state, start_offset, end_offset, exporting, &storage_cache);
                 if ( CtExporting::CURRENT_NODE != exporting and
                      CtExporting::SELECTED_TEXT != exporting ) {
                     gint64 child_sequence{0};
@@ -320,9 +659,10 @@ bool CtStorageSqlite::save_treestore(const fs::path& file_path,
             CtStorageCache storage_cache;
             storage_cache.generate_cache(_pCtMainWin, &syncPending, false);
 
-            // check db tables columns (for document created with old version)
+            // check db schema (for document created with old version)
             if (syncPending.fix_db_tables) {
-                _fix_db_tables();
+                _upgrade_db_schema();
+                _fts_index_stale_nodes();
             }
             // update bookmarks
             if (syncPending.bookmarks_to_write) {
@@ -334,13 +674,20 @@ bool CtStorageSqlite::save_treestore(const fs::path& file_path,
                 CtTreeIter ct_tree_iter = _pCtMainWin->get_tree_store().get_node_from_node_id(node_pair.first);
                 CtTreeIter ct_tree_iter_parent = ct_tree_iter.parent();
                 _write_node_to_db(&ct_tree_iter, ct_tree_iter.get_node_sequence(),
-                                  ct_tree_iter_parent ? ct_tree_iter_parent.get_node_id() : 0, node_pair.second, 0, -1, &storage_cache);
+                                  ct_tree_iter_parent ? ct_tree_iter_parent.get_node_id() : 0, node_pair.second, 0, -1, exporting, &storage_cache);
             }
             // remove nodes and their sub nodes
             for (const auto node_id : syncPending.nodes_to_rm_set)
                 _remove_db_node_with_children(node_id);
         }
 
+        _exec_no_callback("COMMIT");
+        committed = true;
+
+        const int rows_num = sqlite3_total_changes(_pDb) - total_changes_start;
+        const std::chrono::duration<double> elapsed_seconds = std::chrono::steady_clock::now() - time_start;
+        spdlog::debug("{} rows written to db in {:.3f} sec ({:.0f} rows/sec)",
+                      rows_num, elapsed_seconds.count(), elapsed_seconds.count() > 0 ? rows_num/elapsed_seconds.count() : 0.0);
         return true;
     }
     catch (std::exception& e)
@@ -357,7 +704,13 @@ void CtStorageSqlite::vacuum()
     _exec_no_callback("REINDEX");
 }
 
-void CtStorageSqlite::_open_db(const fs::path& path)
+bool CtStorageSqlite::is_journal_save(const fs::path&/*file_path*/, const CtStorageSyncPending&/*syncPending*/) const
+{
+    // the changes are written in place by a transaction
+    return false;
+}
+
+void CtStorageSqlite::_open_db(const fs::path& path, const bool apply_journal_mode/*= true*/)
 {
     if (_pDb) return;
     if (sqlite3_open(path.c_str(), &_pDb) != SQLITE_OK)
@@ -367,57 +720,129 @@ void CtStorageSqlite::_open_db(const fs::path& path)
         _pDb = nullptr;
         throw std::runtime_error(std::string("sqlite3_open: ") + error);
     }
+    _stmtCache.set_db(_pDb);
+    _ftsTableExists.reset();
+
+    if (apply_journal_mode)
+    {
+        const std::string& journal_mode = _pCtMainWin->get_ct_config()->sqliteJournalMode;
+        if (CtStrUtil::contains(JOURNAL_MODES, journal_mode.c_str())) {
+            _exec_no_callback(("PRAGMA journal_mode=" + journal_mode).c_str());
+        }
+        else {
+            spdlog::warn("!! unexpected sqlite journal mode '{}'", journal_mode);
+        }
+    }
 }
 
 void CtStorageSqlite::_close_db()
 {
     if (!_pDb) return;
+    _stmtCache.set_db(nullptr); // statements must be finalized before closing
+    _ftsTableExists.reset();
     sqlite3_close(_pDb);
     _pDb = nullptr;
     //_file_path = ""; we need file_path for reconnection
 }
 
-Gtk::TreeIter CtStorageSqlite::_node_from_db(gint64 node_id, gint64 sequence, Gtk::TreeIter parent_iter, gint64 new_id)
+void CtStorageSqlite::_read_nodes_from_db(std::unordered_map<gint64, std::vector<gint64>>& children_dict,
+                                          std::unordered_map<gint64, CtNodeData>& nodes_data_dict)
 {
-    auto uStmt = std::make_unique<Sqlite3StmtAuto>(_pDb, "SELECT name, syntax, tags, is_ro, is_richtxt, ts_creation, ts_lastsave FROM node WHERE node_id=?");
-    if (uStmt->is_bad()) {
-        // an older version of the SQLite db didn't have ts_creation, ts_lastsave
-        uStmt.reset(new Sqlite3StmtAuto{_pDb, "SELECT name, syntax, tags, is_ro, is_richtxt FROM node WHERE node_id=?"});
-        if (uStmt->is_bad()) {
+    // hierarchy, for every father the list of children already sorted by sequence
+    {
+        Sqlite3StmtAuto stmt{_pDb, "SELECT node_id, father_id FROM children ORDER BY father_id ASC, sequence ASC"};
+        if (stmt.is_bad())
             throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
-        }
-    }
-
-    sqlite3_bind_int64(*uStmt, 1, node_id);
-    if (sqlite3_step(*uStmt) != SQLITE_ROW) {
-        throw std::runtime_error(std::string("CtDocSqliteStorage: missing node properties for id ") + std::to_string(node_id));
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            children_dict[sqlite3_column_int64(stmt, 1)].push_back(sqlite3_column_int64(stmt, 0));
     }
 
-    CtNodeData nodeData;
-    nodeData.nodeId = new_id == -1 ? node_id : new_id;
-    nodeData.name = safe_sqlite3_column_text(*uStmt, 0);
-    nodeData.syntax = safe_sqlite3_column_text(*uStmt, 1);
-    nodeData.tags = safe_sqlite3_column_text(*uStmt, 2);
-    gint64 readonly_n_custom_icon_id = sqlite3_column_int64(*uStmt, 3);
-    nodeData.isRO = static_cast<bool>(readonly_n_custom_icon_id & 0x01);
-    nodeData.customIconId = readonly_n_custom_icon_id >> 1;
-    gint64 richtxt_bold_foreground = sqlite3_column_int64(*uStmt, 4);
-    nodeData.isBold = static_cast<bool>((richtxt_bold_foreground >> 1) & 0x01);
-    nodeData.sequence = sequence;
-    if (static_cast<bool>((richtxt_bold_foreground >> 2) & 0x01)) {
-        char foregroundRgb24[8];
-        CtRgbUtil::set_rgb24str_from_rgb24int((richtxt_bold_foreground >> 3) & 0xffffff, foregroundRgb24);
-        nodeData.foregroundRgb24 = foregroundRgb24;
+    // node properties
+    {
+        bool has_timestamps{true};
+        auto uStmt = std::make_unique<Sqlite3StmtAuto>(_pDb, "SELECT node_id, name, syntax, tags, is_ro, is_richtxt, ts_creation, ts_lastsave FROM node");
+        if (uStmt->is_bad()) {
+            // an older version of the SQLite db didn't have ts_creation, ts_lastsave
+            has_timestamps = false;
+            uStmt.reset(new Sqlite3StmtAuto{_pDb, "SELECT node_id, name, syntax, tags, is_ro, is_richtxt FROM node"});
+            if (uStmt->is_bad()) {
+                throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
+            }
+        }
+        while (sqlite3_step(*uStmt) == SQLITE_ROW) {
+            const gint64 node_id = sqlite3_column_int64(*uStmt, 0);
+            CtNodeData& nodeData = nodes_data_dict[node_id];
+            nodeData.nodeId = node_id;
+            nodeData.name = safe_sqlite3_column_text(*uStmt, 1);
+            nodeData.syntax = safe_sqlite3_column_text(*uStmt, 2);
+            nodeData.tags = safe_sqlite3_column_text(*uStmt, 3);
+            gint64 readonly_n_custom_icon_id = sqlite3_column_int64(*uStmt, 4);
+            nodeData.isRO = static_cast<bool>(readonly_n_custom_icon_id & 0x01);
+            nodeData.customIconId = readonly_n_custom_icon_id >> 1;
+            gint64 richtxt_bold_foreground = sqlite3_column_int64(*uStmt, 5);
+            nodeData.isBold = static_cast<bool>((richtxt_bold_foreground >> 1) & 0x01);
+            if (static_cast<bool>((richtxt_bold_foreground >> 2) & 0x01)) {
+                char foregroundRgb24[8];
+                CtRgbUtil::set_rgb24str_from_rgb24int((richtxt_bold_foreground >> 3) & 0xffffff, foregroundRgb24);
+                nodeData.foregroundRgb24 = foregroundRgb24;
+            }
+            if (has_timestamps) {
+                nodeData.tsCreation = sqlite3_column_int64(*uStmt, 6);
+                nodeData.tsLastSave = sqlite3_column_int64(*uStmt, 7);
+            }
+        }
     }
-    nodeData.tsCreation = sqlite3_column_int64(*uStmt, 5);
-    nodeData.tsLastSave = sqlite3_column_int64(*uStmt, 6);
+}
 
-    // buffer for imported node should be loaded now because file will be closed
-    if (new_id != -1) {
-        nodeData.rTextBuffer = get_delayed_text_buffer(node_id, nodeData.syntax, nodeData.anchoredWidgets);
-    }
+void CtStorageSqlite::_nodes_from_db(const Gtk::TreeIter& parent_iter, const bool is_import)
+{
+    const auto time_start = std::chrono::steady_clock::now();
+
+    std::unordered_map<gint64, std::vector<gint64>> children_dict;
+    std::unordered_map<gint64, CtNodeData> nodes_data_dict;
+    _read_nodes_from_db(children_dict, nodes_data_dict);
+
+    // fill the tree store
+    CtTreeStore& tree_store = _pCtMainWin->get_tree_store();
+    size_t nodes_num{0};
+    std::function<void(const gint64, const Gtk::TreeIter&)> children_from_dict;
+    children_from_dict = [&](const gint64 father_id, const Gtk::TreeIter& father_iter) {
+        auto it_children = children_dict.find(father_id);
+        if (it_children == children_dict.end()) return;
+        // taken out of the dict so that a corrupted hierarchy cannot loop forever
+        const std::vector<gint64> children_ids = std::move(it_children->second);
+        children_dict.erase(it_children);
+
+        gint64 sequence{0};
+        Gtk::TreeIter prev_sibling_iter;
+        for (const gint64 node_id : children_ids) {
+            auto it_data = nodes_data_dict.find(node_id);
+            if (it_data == nodes_data_dict.end()) {
+                throw std::runtime_error(std::string("CtDocSqliteStorage: missing node properties for id ") + std::to_string(node_id));
+            }
+            CtNodeData& nodeData = it_data->second;
+            nodeData.sequence = ++sequence;
+            if (is_import) {
+                nodeData.nodeId = tree_store.node_id_get();
+                // buffer for imported node should be loaded now because file will be closed
+                nodeData.rTextBuffer = get_delayed_text_buffer(node_id, nodeData.syntax, nodeData.anchoredWidgets);
+            }
+            // inserting after the previous sibling avoids walking the list of siblings on every append
+            Gtk::TreeIter new_iter = prev_sibling_iter ? tree_store.insert_node(&nodeData, prev_sibling_iter)
+                                                       : tree_store.append_node(&nodeData, &father_iter);
+            if (is_import) {
+                tree_store.to_ct_tree_iter(new_iter).pending_new_db_node();
+            }
+            nodes_data_dict.erase(it_data);
+            prev_sibling_iter = new_iter;
+            ++nodes_num;
+            children_from_dict(node_id, new_iter);
+        }
+    };
+    children_from_dict(0, parent_iter);
 
-    return _pCtMainWin->get_tree_store().append_node(&nodeData, &parent_iter);
+    const std::chrono::duration<double> elapsed_seconds = std::chrono::steady_clock::now() - time_start;
+    spdlog::debug("{} nodes loaded from db in {:.3f} sec", nodes_num, elapsed_seconds.count());
 }
 
 Glib::RefPtr<Gsv::Buffer> CtStorageSqlite::get_delayed_text_buffer(const gint64& node_id,
@@ -502,7 +927,9 @@ void CtStorageSqlite::_image_from_db(const gint64& nodeId, std::list<CtAnchoredW
             else
             {
                 const Glib::ustring link = safe_sqlite3_column_text(stmt, 6);
-                anchoredWidgets.push_back(new CtImagePng(_pCtMainWin, rawBlob, link, charOffset, justification));
+                auto pImagePng = new CtImagePng(_pCtMainWin, rawBlob, link, charOffset, justification);
+                pImagePng->set_sqlite_row_stored(charOffset);
+                anchoredWidgets.push_back(pImagePng);
             }
         }
     }
@@ -585,25 +1012,36 @@ void CtStorageSqlite::_create_all_tables_in_db()
     _exec_no_callback(TABLE_IMAGE_CREATE);
     _exec_no_callback(TABLE_CHILDREN_CREATE);
     _exec_no_callback(TABLE_BOOKMARK_CREATE);
+    _create_all_indexes_in_db();
+    // without the text index the document stays at version 1, the next load tries again
+    _set_schema_version(_create_fts_table_in_db() ? SCHEMA_VERSION : 1);
+}
+
+void CtStorageSqlite::_create_all_indexes_in_db()
+{
+    _exec_no_callback(TABLE_CODEBOX_INDEX_CREATE);
+    _exec_no_callback(TABLE_TABLE_INDEX_CREATE);
+    _exec_no_callback(TABLE_IMAGE_INDEX_CREATE);
+    _exec_no_callback(TABLE_CHILDREN_INDEX_CREATE);
 }
 
 void CtStorageSqlite::_write_bookmarks_to_db(const std::list<gint64>& bookmarks)
 {
     _exec_no_callback(TABLE_BOOKMARK_DELETE);
 
-    Sqlite3StmtAuto stmt{_pDb, TABLE_BOOKMARK_INSERT};
-    if (stmt.is_bad())
+    sqlite3_stmt* pStmt = _stmtCache.get(TABLE_BOOKMARK_INSERT);
+    if (!pStmt)
         throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
 
     gint64 sequence{0};
     for (gint64 bookmark : bookmarks)
     {
         ++sequence;
-        sqlite3_bind_int64(stmt, 1, bookmark);
-        sqlite3_bind_int64(stmt, 2, sequence);
-        if (sqlite3_step(stmt) != SQLITE_DONE)
+        sqlite3_bind_int64(pStmt, 1, bookmark);
+        sqlite3_bind_int64(pStmt, 2, sequence);
+        if (sqlite3_step(pStmt) != SQLITE_DONE)
             throw std::runtime_error(ERR_SQLITE_STEP + sqlite3_errmsg(_pDb));
-        sqlite3_reset(stmt);
+        sqlite3_reset(pStmt);
     }
 }
 
@@ -613,6 +1051,7 @@ void CtStorageSqlite::_write_node_to_db(CtTreeIter* ct_tree_iter,
                                         const CtStorageNodeState& node_state,
                                         const int start_offset,
                                         const int end_offset,
+                                        const CtExporting exporting,
                                         CtStorageCache* storage_cache)
 {
     const gint64 node_id = ct_tree_iter->get_node_id();
@@ -635,12 +1074,38 @@ void CtStorageSqlite::_write_node_to_db(CtTreeIter* ct_tree_iter,
     bool remove_prev_node = node_state.upd && node_state.buff && node_state.prop;
     bool remove_prev_hier = node_state.upd && node_state.hier;
 
+    // the widgets with offset and justification updated from the text buffer
+    std::list<CtAnchoredWidget*> anchored_widgets;
+    if (node_state.buff && (is_richtxt & 0x01))
+        anchored_widgets = ct_tree_iter->get_anchored_widgets(start_offset, end_offset);
+
+    // the rows of the images unchanged since loaded or last written are left untouched
+    const int offset_adjustment = start_offset >= 0 ? -start_offset : 0;
+    std::unordered_set<CtAnchoredWidget*> images_row_kept;
+    std::unordered_set<int> images_row_kept_offsets;
+    if (remove_prev_widgets)
+    {
+        for (CtAnchoredWidget* pAnchoredWidget : anchored_widgets)
+        {
+            if (CtAnchWidgType::ImagePng != pAnchoredWidget->get_type()) continue;
+            auto pImagePng = dynamic_cast<CtImagePng*>(pAnchoredWidget);
+            if (pImagePng && pImagePng->is_sqlite_row_stored(pImagePng->getOffset() + offset_adjustment))
+            {
+                images_row_kept.insert(pAnchoredWidget);
+                images_row_kept_offsets.insert(pImagePng->getOffset() + offset_adjustment);
+            }
+        }
+    }
+
     // remove previous data in case full update (skip when add new or partial update
     if (remove_prev_widgets)
     {
         _exec_bind_int64(TABLE_CODEBOX_DELETE, node_id);
         _exec_bind_int64(TABLE_TABLE_DELETE, node_id);
-        _exec_bind_int64(TABLE_IMAGE_DELETE, node_id);
+        if (images_row_kept.empty())
+            _exec_bind_int64(TABLE_IMAGE_DELETE, node_id);
+        else
+            _remove_db_images_not_at(node_id, images_row_kept_offsets);
     }
     if (remove_prev_node)
         _exec_bind_int64(TABLE_NODE_DELETE, node_id);
@@ -654,8 +1119,8 @@ void CtStorageSqlite::_write_node_to_db(CtTreeIter* ct_tree_iter,
     // write hier
     if (node_state.hier)
     {
-        Sqlite3StmtAuto stmt{_pDb, TABLE_CHILDREN_INSERT};
-        if (stmt.is_bad())
+        sqlite3_stmt* stmt = _stmtCache.get(TABLE_CHILDREN_INSERT);
+        if (!stmt)
             throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
         sqlite3_bind_int64(stmt, 1, node_id);
         sqlite3_bind_int64(stmt, 2, node_father_id);
@@ -667,10 +1132,17 @@ void CtStorageSqlite::_write_node_to_db(CtTreeIter* ct_tree_iter,
     // write widgets
     if (node_state.buff && (is_richtxt & 0x01))
     {
-        for (CtAnchoredWidget* pAnchoredWidget : ct_tree_iter->get_anchored_widgets(start_offset, end_offset))
+        for (CtAnchoredWidget* pAnchoredWidget : anchored_widgets)
         {
-            if (!pAnchoredWidget->to_sqlite(_pDb, node_id, start_offset >= 0 ? -start_offset : 0, storage_cache))
-                throw std::runtime_error("couldn't save widget");
+            if (!images_row_kept.count(pAnchoredWidget))
+            {
+                if (!pAnchoredWidget->to_sqlite(_stmtCache, node_id, offset_adjustment, storage_cache))
+                    throw std::runtime_error("couldn't save widget");
+                // an export does not write the document database
+                if (CtExporting::NONE == exporting && CtAnchWidgType::ImagePng == pAnchoredWidget->get_type())
+                    if (auto pImagePng = dynamic_cast<CtImagePng*>(pAnchoredWidget))
+                        pImagePng->set_sqlite_row_stored(pImagePng->getOffset() + offset_adjustment);
+            }
             switch (pAnchoredWidget->get_type())
             {
                 case CtAnchWidgType::CodeBox: has_codebox = true; break;
@@ -683,8 +1155,8 @@ void CtStorageSqlite::_write_node_to_db(CtTreeIter* ct_tree_iter,
     // if only node prop to write
     if (node_state.prop && !node_state.buff)
     {
-        Sqlite3StmtAuto stmt{_pDb, "UPDATE node SET name=?, syntax=?, tags=?, is_ro=?, is_richtxt=? WHERE node_id=?"};
-        if (stmt.is_bad())
+        sqlite3_stmt* stmt = _stmtCache.get(TABLE_NODE_UPDATE_PROP);
+        if (!stmt)
             throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
 
         const std::string node_name = ct_tree_iter->get_node_name();
@@ -725,8 +1197,8 @@ void CtStorageSqlite::_write_node_to_db(CtTreeIter* ct_tree_iter,
         // full node rewrite (buf + prop)
         if (node_state.prop)
         {
-            Sqlite3StmtAuto stmt{_pDb, TABLE_NODE_INSERT};
-            if (stmt.is_bad())
+            sqlite3_stmt* stmt = _stmtCache.get(TABLE_NODE_INSERT);
+            if (!stmt)
                 throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
 
             const std::string node_name = ct_tree_iter->get_node_name();
@@ -751,8 +1223,8 @@ void CtStorageSqlite::_write_node_to_db(CtTreeIter* ct_tree_iter,
         // only node buff rewrite
         else
         {
-            Sqlite3StmtAuto stmt{_pDb, "UPDATE node SET txt=?, syntax=?, is_richtxt=?, has_codebox=?, has_table=?, has_image=?, ts_lastsave=? WHERE node_id=?"};
-            if (stmt.is_bad())
+            sqlite3_stmt* stmt = _stmtCache.get(TABLE_NODE_UPDATE_BUFF);
+            if (!stmt)
                 throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
 
             const std::string node_syntax = ct_tree_iter->get_node_syntax_highlighting();
@@ -767,6 +1239,12 @@ void CtStorageSqlite::_write_node_to_db(CtTreeIter* ct_tree_iter,
             if (sqlite3_step(stmt) != SQLITE_DONE)
                 throw std::runtime_error(ERR_SQLITE_STEP + sqlite3_errmsg(_pDb));
         }
+
+        if (_fts_table_exists()) {
+            _write_node_fts_to_db(node_id,
+                                  _get_node_fts_text(ct_tree_iter, start_offset, end_offset),
+                                  ct_tree_iter->get_node_modification_time());
+        }
     }
 }
 
@@ -791,6 +1269,9 @@ void CtStorageSqlite::_remove_db_node_with_children(const gint64 node_id)
     _exec_bind_int64(TABLE_IMAGE_DELETE, node_id);
     _exec_bind_int64(TABLE_NODE_DELETE, node_id);
     _exec_bind_int64(TABLE_CHILDREN_DELETE, node_id);
+    if (_fts_table_exists()) {
+        _exec_bind_int64(TABLE_NODE_FTS_DELETE, node_id);
+    }
 
     for (const gint64 child_node_id: _get_children_node_ids_from_db(node_id))
         _remove_db_node_with_children(child_node_id);
@@ -807,34 +1288,49 @@ void CtStorageSqlite::_exec_no_callback(const char* sqlCmd)
     }
 }
 
+void CtStorageSqlite::_remove_db_images_not_at(const gint64 node_id, const std::unordered_set<int>& kept_offsets)
+{
+    std::vector<int> offsets_to_remove;
+    {
+        Sqlite3StmtAuto stmt{_pDb, "SELECT offset FROM image WHERE node_id=?"};
+        if (stmt.is_bad())
+            throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
+        sqlite3_bind_int64(stmt, 1, node_id);
+        while (SQLITE_ROW == sqlite3_step(stmt))
+        {
+            const int offset = sqlite3_column_int(stmt, 0);
+            if (!kept_offsets.count(offset))
+                offsets_to_remove.push_back(offset);
+        }
+    }
+    for (const int offset : offsets_to_remove)
+    {
+        sqlite3_stmt* pStmt = _stmtCache.get(TABLE_IMAGE_DELETE_AT_OFFSET);
+        if (!pStmt)
+            throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
+        sqlite3_bind_int64(pStmt, 1, node_id);
+        sqlite3_bind_int64(pStmt, 2, offset);
+        if (sqlite3_step(pStmt) != SQLITE_DONE)
+            throw std::runtime_error(ERR_SQLITE_STEP + sqlite3_errmsg(_pDb));
+    }
+}
+
 void CtStorageSqlite::_exec_bind_int64(const char* sqlCmd, const gint64 bind_int64)
 {
-    Sqlite3StmtAuto stmt{_pDb, sqlCmd};
-    if (stmt.is_bad())
+    sqlite3_stmt* pStmt = _stmtCache.get(sqlCmd);
+    if (!pStmt)
         throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
-    sqlite3_bind_int64(stmt, 1, bind_int64);
-    if (sqlite3_step(stmt) != SQLITE_DONE)
+    sqlite3_bind_int64(pStmt, 1, bind_int64);
+    if (sqlite3_step(pStmt) != SQLITE_DONE)
         throw std::runtime_error(ERR_SQLITE_STEP + sqlite3_errmsg(_pDb));
 }
 
 void CtStorageSqlite::import_nodes(const fs::path& path, const Gtk::TreeIter& parent_iter)
 {
-    _open_db(path); // storage is temp so can just open db
+    _open_db(path, false/*apply_journal_mode*/); // storage is temp so can just open db
     if (!_check_database_integrity()) return;
 
-    std::function<void(gint64, const gint64, Gtk::TreeIter)> add_node_func;
-    add_node_func = [this, &add_node_func](gint64 nodeId, const gint64 sequence, Gtk::TreeIter parent_iter) {
-        auto node_iter = _pCtMainWin->get_tree_store().to_ct_tree_iter(_node_from_db(nodeId, sequence, parent_iter, _pCtMainWin->get_tree_store().node_id_get()));
-        node_iter.pending_new_db_node();
-        gint64 child_sequence = 0;
-        for (auto child_id : _get_children_node_ids_from_db(nodeId)) {
-            add_node_func(child_id, ++child_sequence, node_iter);
-        }
-    };
-    gint64 sequence{0};
-    for (auto node_id : _get_children_node_ids_from_db(0)) {
-        add_node_func(node_id, ++sequence, parent_iter);
-    }
+    _nodes_from_db(parent_iter, true/*is_import*/);
     _close_db();
 }
 
@@ -879,6 +1375,468 @@ void CtStorageSqlite::_fix_db_tables()
     }
 }
 
+int CtStorageSqlite::_get_schema_version()
+{
+    Sqlite3StmtAuto stmt{_pDb, "PRAGMA user_version"};
+    if (stmt.is_bad())
+        throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
+    if (sqlite3_step(stmt) != SQLITE_ROW)
+        throw std::runtime_error(ERR_SQLITE_STEP + sqlite3_errmsg(_pDb));
+    return sqlite3_column_int(stmt, 0);
+}
+
+void CtStorageSqlite::_set_schema_version(const int version)
+{
+    _exec_no_callback(fmt::format("PRAGMA user_version={}", version).c_str());
+}
+
+void CtStorageSqlite::_upgrade_db_schema()
+{
+    // the step at index N upgrades from version N to version N+1, false if it could not be completed
+    const std::vector<std::function<bool()>> upgrade_steps{
+        [this](){
+            _fix_db_tables();
+            _create_all_indexes_in_db();
+            return true;
+        },
+        [this](){
+            return _create_fts_table_in_db();
+        },
+    };
+    const int db_version = _get_schema_version();
+    if (db_version > SCHEMA_VERSION) {
+        // created by a newer version, we only use what we know of
+        spdlog::debug("db schema version {} newer than {}", db_version, SCHEMA_VERSION);
+        return;
+    }
+    int version = db_version;
+    for (; version < SCHEMA_VERSION; ++version) {
+        spdlog::debug("db schema upgrade {} -> {}", version, version+1);
+        if (not upgrade_steps.at(version)()) {
+            // stop at the last completed version, the next load tries again
+            spdlog::debug("db schema upgrade {} -> {} not completed", version, version+1);
+            break;
+        }
+    }
+    if (db_version != version) {
+        _set_schema_version(version);
+    }
+}
+
+bool CtStorageSqlite::_create_fts_table_in_db()
+{
+    try {
+        _exec_no_callback(TABLE_NODE_FTS_CREATE);
+        _ftsTableExists = true;
+    }
+    catch (std::runtime_error& e) {
+        // sqlite built without fts5 or older than 3.34 (trigram tokenizer), searches just won't be prefiltered
+        spdlog::warn("{}", e.what());
+        _ftsTableExists = false;
+    }
+    return _ftsTableExists.value();
+}
+
+bool CtStorageSqlite::_fts_table_exists()
+{
+    if (not _ftsTableExists.has_value()) {
+        Sqlite3StmtAuto stmt{_pDb, "SELECT 1 FROM sqlite_master WHERE type='table' AND name='node_fts'"};
+        _ftsTableExists = not stmt.is_bad() and SQLITE_ROW == sqlite3_step(stmt);
+    }
+    return _ftsTableExists.value();
+}
+
+void CtStorageSqlite::_write_node_fts_to_db(const gint64 node_id, const std::string& fts_txt, const gint64 ts_lastsave)
+{
+    _exec_bind_int64(TABLE_NODE_FTS_DELETE, node_id);
+    sqlite3_stmt* pStmt = _stmtCache.get(TABLE_NODE_FTS_INSERT);
+    if (!pStmt)
+        throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
+    sqlite3_bind_int64(pStmt, 1, node_id);
+    sqlite3_bind_text(pStmt, 2, fts_txt.c_str(), fts_txt.size(), SQLITE_STATIC);
+    sqlite3_bind_int64(pStmt, 3, ts_lastsave);
+    if (sqlite3_step(pStmt) != SQLITE_DONE)
+        throw std::runtime_error(ERR_SQLITE_STEP + sqlite3_errmsg(_pDb));
+}
+
+void CtStorageSqlite::_fts_index_stale_nodes()
+{
+    if (not _fts_table_exists()) return;
+
+    // nodes never indexed (document upgraded) or written by a version not updating the index
+    std::vector<std::pair<gint64, gint64>> stale_node_ids; // node_id, ts_lastsave
+    {
+        Sqlite3StmtAuto stmt{_pDb, "SELECT node.node_id, node.ts_lastsave FROM node LEFT JOIN node_fts ON node_fts.rowid=node.node_id "
+                                   "WHERE node_fts.rowid IS NULL OR node_fts.ts_lastsave IS NOT node.ts_lastsave"};
+        if (stmt.is_bad())
+            throw std::runtime_error(ERR_SQLITE_PREPV2 + sqlite3_errmsg(_pDb));
+        while (SQLITE_ROW == sqlite3_step(stmt)) {
+            stale_node_ids.push_back(std::make_pair(sqlite3_column_int64(stmt, 0), sqlite3_column_int64(stmt, 1)));
+        }
+    }
+    for (const auto& node_pair : stale_node_ids) {
+        CtStoredNodeText stored_text;
+        if (get_stored_node_text(node_pair.first, stored_text)) {
+            std::string fts_txt = stored_text.text;
+            for (const auto& widget : stored_text.widgets) {
+                for (const auto& widget_text : widget.texts) {
+                    fts_txt += CtConst::CHAR_NEWLINE;
+                    fts_txt += widget_text;
+                }
+            }
+            _write_node_fts_to_db(node_pair.first, fts_txt, node_pair.second);
+        }
+    }
+    if (not stale_node_ids.empty()) {
+        spdlog::debug("{} nodes added to the text index", stale_node_ids.size());
+    }
+}
+
+bool CtStorageSqlite::get_stored_node_text(const gint64& node_id, CtStoredNodeText& stored_text) const
+{
+    return get_stored_node_text_from_db(_pDb, node_id, stored_text);
+}
+
+/*static*/bool CtStorageSqlite::get_stored_node_text_from_db(sqlite3* pDb, const gint64& node_id, CtStoredNodeText& stored_text)
+{
+    bool has_codebox{false}, has_table{false}, has_image{false};
+    {
+        Sqlite3StmtAuto stmt{pDb, "SELECT txt, is_richtxt, has_codebox, has_table, has_image FROM node WHERE node_id=?"};
+        if (stmt.is_bad()) {
+            spdlog::error("{}: {}", ERR_SQLITE_PREPV2, sqlite3_errmsg(pDb));
+            return false;
+        }
+        sqlite3_bind_int64(stmt, 1, node_id);
+        if (sqlite3_step(stmt) != SQLITE_ROW) {
+            return false;
+        }
+        const char* textContent = safe_sqlite3_column_text(stmt, 0);
+        if (0 == (sqlite3_column_int64(stmt, 1) & 0x01)) {
+            stored_text.text = textContent;
+            return true;
+        }
+        xmlpp::DomParser parser;
+        if (not CtXmlHelper::safe_parse_memory(parser, textContent)) {
+            return false;
+        }
+        CtStorageXmlHelper::get_stored_text_from_xml(parser.get_document()->get_root_node(), stored_text);
+        has_codebox = sqlite3_column_int64(stmt, 2);
+        has_table = sqlite3_column_int64(stmt, 3);
+        has_image = sqlite3_column_int64(stmt, 4);
+    }
+    if (has_codebox) {
+        Sqlite3StmtAuto stmt{pDb, "SELECT offset, txt FROM codebox WHERE node_id=?"};
+        sqlite3_bind_int64(stmt, 1, node_id);
+        while (SQLITE_ROW == sqlite3_step(stmt)) {
+            stored_text.widgets.push_back(CtStoredNodeText::Widget{sqlite3_column_int(stmt, 0), CtAnchWidgType::CodeBox, {safe_sqlite3_column_text(stmt, 1)}});
+        }
+    }
+    if (has_table) {
+        Sqlite3StmtAuto stmt{pDb, "SELECT offset, txt FROM grid WHERE node_id=?"};
+        sqlite3_bind_int64(stmt, 1, node_id);
+        while (SQLITE_ROW == sqlite3_step(stmt)) {
+            xmlpp::DomParser parser;
+            if (CtXmlHelper::safe_parse_memory(parser, safe_sqlite3_column_text(stmt, 1))) {
+                stored_text.widgets.push_back(CtStoredNodeText::Widget{sqlite3_column_int(stmt, 0), CtAnchWidgType::Table,
+                    CtStorageXmlHelper::get_table_cells_text_from_xml(parser.get_document()->get_root_node())});
+            }
+        }
+    }
+    if (has_image) {
+        Sqlite3StmtAuto stmt{pDb, "SELECT offset, anchor, filename FROM image WHERE node_id=?"};
+        sqlite3_bind_int64(stmt, 1, node_id);
+        while (SQLITE_ROW == sqlite3_step(stmt)) {
+            const std::string anchorName = safe_sqlite3_column_text(stmt, 1);
+            const std::string fileName = safe_sqlite3_column_text(stmt, 2);
+            if (not anchorName.empty()) {
+                stored_text.widgets.push_back(CtStoredNodeText::Widget{sqlite3_column_int(stmt, 0), CtAnchWidgType::ImageAnchor, {anchorName}});
+            }
+            else if (not fileName.empty()) {
+                stored_text.widgets.push_back(CtStoredNodeText::Widget{sqlite3_column_int(stmt, 0), CtAnchWidgType::ImageEmbFile, {fileName}});
+            }
+            else {
+                stored_text.widgets.push_back(CtStoredNodeText::Widget{sqlite3_column_int(stmt, 0), CtAnchWidgType::ImagePng, {}});
+            }
+        }
+    }
+    std::stable_sort(stored_text.widgets.begin(), stored_text.widgets.end(), [](const auto& w1, const auto& w2){
+        return w1.offset < w2.offset;
+    });
+    return true;
+}
+
+/*static*/bool CtStorageSqlite::get_decoded_node_text_from_db(sqlite3* pDb, const gint64& node_id, CtDecodedNodeText& decoded_text)
+{
+    decoded_text.is_sqlite_rows = true;
+    bool has_codebox{false}, has_table{false}, has_image{false};
+    {
+        Sqlite3StmtAuto stmt{pDb, "SELECT txt, is_richtxt, has_codebox, has_table, has_image FROM node WHERE node_id=?"};
+        if (stmt.is_bad()) {
+            spdlog::error("{}: {}", ERR_SQLITE_PREPV2, sqlite3_errmsg(pDb));
+            return false;
+        }
+        sqlite3_bind_int64(stmt, 1, node_id);
+        if (sqlite3_step(stmt) != SQLITE_ROW) {
+            return false;
+        }
+        const char* textContent = safe_sqlite3_column_text(stmt, 0);
+        if (0 == (sqlite3_column_int64(stmt, 1) & 0x01)) {
+            decoded_text.runs.push_back(CtDecodedNodeText::TextRun{textContent, {}});
+            return true;
+        }
+        xmlpp::DomParser parser;
+        if (not CtXmlHelper::safe_parse_memory(parser, textContent)) {
+            return false;
+        }
+        CtStorageXmlHelper::get_decoded_text_from_xml(parser.get_document()->get_root_node(), decoded_text);
+        has_codebox = sqlite3_column_int64(stmt, 2);
+        has_table = sqlite3_column_int64(stmt, 3);
+        has_image = sqlite3_column_int64(stmt, 4);
+    }
+    auto column_justification = [](sqlite3_stmt* stmt, int iCol) {
+        const std::string justification = safe_sqlite3_column_text(stmt, iCol);
+        return justification.empty() ? std::string{CtConst::TAG_PROP_VAL_LEFT} : justification;
+    };
+    if (has_codebox) {
+        Sqlite3StmtAuto stmt{pDb, "SELECT * FROM codebox WHERE node_id=?"};
+        sqlite3_bind_int64(stmt, 1, node_id);
+        while (SQLITE_ROW == sqlite3_step(stmt)) {
+            CtDecodedNodeText::Widget widget;
+            widget.type = CtAnchWidgType::CodeBox;
+            widget.offset = sqlite3_column_int(stmt, 1);
+            widget.justification = column_justification(stmt, 2);
+            widget.text = safe_sqlite3_column_text(stmt, 3);
+            widget.syntax = safe_sqlite3_column_text(stmt, 4);
+            widget.frame_width = sqlite3_column_int(stmt, 5);
+            widget.frame_height = sqlite3_column_int(stmt, 6);
+            widget.width_in_pixels = sqlite3_column_int64(stmt, 7);
+            widget.highlight_brackets = sqlite3_column_int64(stmt, 8);
+            widget.show_line_numbers = sqlite3_column_int64(stmt, 9);
+            decoded_text.widgets.push_back(std::move(widget));
+        }
+    }
+    if (has_table) {
+        Sqlite3StmtAuto stmt{pDb, "SELECT * FROM grid WHERE node_id=?"};
+        sqlite3_bind_int64(stmt, 1, node_id);
+        while (SQLITE_ROW == sqlite3_step(stmt)) {
+            xmlpp::DomParser parser;
+            if (not CtXmlHelper::safe_parse_memory(parser, safe_sqlite3_column_text(stmt, 3))) {
+                spdlog::error("!! table xml read: {}", safe_sqlite3_column_text(stmt, 3));
+                continue;
+            }
+            CtDecodedNodeText::Widget widget;
+            widget.type = CtAnchWidgType::Table;
+            widget.offset = sqlite3_column_int(stmt, 1);
+            widget.justification = column_justification(stmt, 2);
+            widget.col_width_default = sqlite3_column_int(stmt, 5);
+            CtStorageXmlHelper::get_decoded_table_from_xml(parser.get_document()->get_root_node(), widget);
+            decoded_text.widgets.push_back(std::move(widget));
+        }
+    }
+    if (has_image) {
+        Sqlite3StmtAuto stmt{pDb, "SELECT * FROM image WHERE node_id=?"};
+        sqlite3_bind_int64(stmt, 1, node_id);
+        while (SQLITE_ROW == sqlite3_step(stmt)) {
+            CtDecodedNodeText::Widget widget;
+            widget.offset = sqlite3_column_int(stmt, 1);
+            widget.justification = column_justification(stmt, 2);
+            const Glib::ustring anchorName = safe_sqlite3_column_text(stmt, 3);
+            if (not anchorName.empty()) {
+                widget.type = CtAnchWidgType::ImageAnchor;
+                widget.text = anchorName;
+            }
+            else {
+                widget.raw_blob.assign(reinterpret_cast<const char*>(sqlite3_column_blob(stmt, 4)), static_cast<size_t>(sqlite3_column_bytes(stmt, 4)));
+                widget.text = safe_sqlite3_column_text(stmt, 5);
+                if (not widget.text.empty()) {
+                    widget.type = CtAnchWidgType::ImageEmbFile;
+                    widget.time = sqlite3_column_int64(stmt, 7);
+                }
+                else {
+                    widget.type = CtAnchWidgType::ImagePng;
+                    widget.link = safe_sqlite3_column_text(stmt, 6);
+                    if (decoded_text.with_pixbufs) {
+                        widget.pixbuf = CtImage::decode_pixbuf(widget.raw_blob, "image/png");
+                    }
+                }
+            }
+            decoded_text.widgets.push_back(std::move(widget));
+        }
+    }
+    std::stable_sort(decoded_text.widgets.begin(), decoded_text.widgets.end(), [](const auto& w1, const auto& w2){
+        return w1.offset < w2.offset;
+    });
+    return true;
+}
+
+/*static*/bool CtStorageSqlite::write_widget_row(CtSqliteStmtCache& stmtCache, const gint64 node_id, const CtDecodedNodeText::Widget& widget, const std::string* pRawBlob)
+{
+    const char* sqlCmd = CtAnchWidgType::CodeBox == widget.type ? TABLE_CODEBOX_INSERT :
+                         CtAnchWidgType::Table == widget.type ? TABLE_TABLE_INSERT : TABLE_IMAGE_INSERT;
+    sqlite3_stmt* p_stmt = stmtCache.get(sqlCmd);
+    if (!p_stmt) {
+        spdlog::error("{}: {}", ERR_SQLITE_PREPV2, sqlite3_errmsg(stmtCache.get_db()));
+        return false;
+    }
+    auto bind_text_if = [&](const int iCol, const bool condition, const Glib::ustring& text) {
+        sqlite3_bind_text(p_stmt, iCol, condition ? text.c_str() : "", condition ? text.bytes() : 0, SQLITE_STATIC);
+    };
+    std::string table_txt; // bound as static, must live until the step
+    sqlite3_bind_int64(p_stmt, 1, node_id);
+    sqlite3_bind_int64(p_stmt, 2, widget.offset);
+    sqlite3_bind_text(p_stmt, 3, widget.justification.c_str(), widget.justification.size(), SQLITE_STATIC);
+    if (CtAnchWidgType::CodeBox == widget.type) {
+        bind_text_if(4, true, widget.text);
+        bind_text_if(5, true, widget.syntax);
+        sqlite3_bind_int64(p_stmt, 6, widget.frame_width);
+        sqlite3_bind_int64(p_stmt, 7, widget.frame_height);
+        sqlite3_bind_int64(p_stmt, 8, widget.width_in_pixels);
+        sqlite3_bind_int64(p_stmt, 9, widget.highlight_brackets);
+        sqlite3_bind_int64(p_stmt, 10, widget.show_line_numbers);
+    }
+    else if (CtAnchWidgType::Table == widget.type) {
+        xmlpp::Document xml_doc;
+        xml_doc.create_root_node("table");
+        xml_doc.get_root_node()->set_attribute("col_widths", str::join_numbers(widget.col_widths, ","));
+        auto row_to_xml = [&](const std::vector<Glib::ustring>& row) {
+            xmlpp::Element* p_row_node = xml_doc.get_root_node()->add_child("row");
+            for (const Glib::ustring& cell : row) {
+                p_row_node->add_child("cell")->add_child_text(cell);
+            }
+        };
+        // put header at the end
+        for (size_t rowIdx = 1; rowIdx < widget.table_rows.size(); ++rowIdx) {
+            row_to_xml(widget.table_rows[rowIdx]);
+        }
+        if (not widget.table_rows.empty()) {
+            row_to_xml(widget.table_rows.front());
+        }
+        table_txt = xml_doc.write_to_string();
+        sqlite3_bind_text(p_stmt, 4, table_txt.c_str(), table_txt.size(), SQLITE_STATIC);
+        sqlite3_bind_int64(p_stmt, 5, widget.col_width_default); // todo get rid of column min
+        sqlite3_bind_int64(p_stmt, 6, widget.col_width_default);
+    }
+    else {
+        const std::string& raw_blob = pRawBlob ? *pRawBlob : widget.raw_blob;
+        bind_text_if(4, CtAnchWidgType::ImageAnchor == widget.type, widget.text);
+        sqlite3_bind_blob(p_stmt, 5, raw_blob.empty() ? nullptr : raw_blob.c_str(), raw_blob.size(), SQLITE_STATIC);
+        bind_text_if(6, CtAnchWidgType::ImageEmbFile == widget.type, widget.text);
+        bind_text_if(7, CtAnchWidgType::ImagePng == widget.type, widget.link);
+        sqlite3_bind_int64(p_stmt, 8, CtAnchWidgType::ImageEmbFile == widget.type ? widget.time : 0);
+    }
+    if (sqlite3_step(p_stmt) != SQLITE_DONE) {
+        spdlog::error("{}: {}", ERR_SQLITE_STEP, sqlite3_errmsg(stmtCache.get_db()));
+        return false;
+    }
+    return true;
+}
+
+// the reader has its own read only connection, the content is the one of the latest save
+class CtStoredTextReaderSqlite : public CtStoredTextReader
+{
+public:
+    CtStoredTextReaderSqlite(sqlite3* pDb)
+     : _pDb{pDb}
+    {}
+    ~CtStoredTextReaderSqlite() override { sqlite3_close(_pDb); }
+
+    bool get_stored_node_text(const gint64& node_id, CtStoredNodeText& stored_text) override
+    {
+        return CtStorageSqlite::get_stored_node_text_from_db(_pDb, node_id, stored_text);
+    }
+
+    bool get_decoded_node_text(const gint64& node_id, CtDecodedNodeText& decoded_text) override
+    {
+        return CtStorageSqlite::get_decoded_node_text_from_db(_pDb, node_id, decoded_text);
+    }
+
+private:
+    sqlite3* _pDb;
+};
+
+std::unique_ptr<CtStoredTextReader> CtStorageSqlite::create_stored_text_reader() const
+{
+    if (not _pDb or _file_path.empty()) {
+        return nullptr;
+    }
+    sqlite3* pDb{nullptr};
+    if (SQLITE_OK != sqlite3_open_v2(_file_path.c_str(), &pDb, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr)) {
+        spdlog::error("sqlite3_open_v2 {}: {}", _file_path.string(), sqlite3_errmsg(pDb));
+        sqlite3_close(pDb);
+        return nullptr;
+    }
+    return std::make_unique<CtStoredTextReaderSqlite>(pDb);
+}
+
+/*static*/std::string CtStorageSqlite::_get_node_fts_text(CtTreeIter* ct_tree_iter, const int start_offset, const int end_offset)
+{
+    // the text searched by the find in nodes: buffer text, codeboxes, tables cells, anchors and embedded files names
+    const auto text_buffer = ct_tree_iter->get_node_text_buffer();
+    std::string fts_txt = end_offset < 0 ? text_buffer->get_text() :
+        text_buffer->get_iter_at_offset(start_offset).get_text(text_buffer->get_iter_at_offset(end_offset));
+    for (CtAnchoredWidget* pAnchoredWidget : ct_tree_iter->get_anchored_widgets(start_offset, end_offset)) {
+        if (auto pCodebox = dynamic_cast<CtCodebox*>(pAnchoredWidget)) {
+            fts_txt += CtConst::CHAR_NEWLINE;
+            fts_txt += pCodebox->get_text_content();
+        }
+        else if (auto pTable = dynamic_cast<CtTable*>(pAnchoredWidget)) {
+            fts_txt += CtConst::CHAR_NEWLINE;
+            const CtTableMatrix& tableMatrix = pTable->get_table_matrix();
+            for (size_t row = 0; row < tableMatrix.get_rows_num(); ++row) {
+                for (size_t col = 0; col < tableMatrix.get_cols_num(); ++col) {
+                    // one cell per line, no match across adjacent cells
+                    fts_txt += tableMatrix.get_cell(row, col);
+                    fts_txt += CtConst::CHAR_NEWLINE;
+                }
+            }
+        }
+        else if (auto pImageAnchor = dynamic_cast<CtImageAnchor*>(pAnchoredWidget)) {
+            fts_txt += CtConst::CHAR_NEWLINE;
+            fts_txt += pImageAnchor->get_anchor_name();
+        }
+        else if (auto pImageEmbFile = dynamic_cast<CtImageEmbFile*>(pAnchoredWidget)) {
+            fts_txt += CtConst::CHAR_NEWLINE;
+            fts_txt += pImageEmbFile->get_file_name().string();
+        }
+    }
+    return fts_txt;
+}
+
+std::optional<std::unordered_set<gint64>> CtStorageSqlite::get_nodes_maybe_containing(const Glib::ustring& text) const
+{
+    // the trigram tokenizer cannot look up less than 3 characters
+    if (text.size() < 3 or not _pDb) {
+        return std::nullopt;
+    }
+    {
+        Sqlite3StmtAuto stmt{_pDb, "SELECT 1 FROM sqlite_master WHERE type='table' AND name='node_fts'"};
+        if (stmt.is_bad() or SQLITE_ROW != sqlite3_step(stmt)) {
+            return std::nullopt;
+        }
+    }
+    // the matches plus the nodes not (or not up to date) in the index
+    Sqlite3StmtAuto stmt{_pDb, "SELECT rowid FROM node_fts WHERE node_fts MATCH ? "
+                               "UNION SELECT node.node_id FROM node LEFT JOIN node_fts ON node_fts.rowid=node.node_id "
+                               "WHERE node_fts.rowid IS NULL OR node_fts.ts_lastsave IS NOT node.ts_lastsave"};
+    if (stmt.is_bad()) {
+        spdlog::error("{}: {}", ERR_SQLITE_PREPV2, sqlite3_errmsg(_pDb));
+        return std::nullopt;
+    }
+    // the text as a single fts5 string, double quotes escaped by doubling
+    const std::string fts_query = "\"" + str::replace(std::string{text.raw()}, "\"", "\"\"") + "\"";
+    sqlite3_bind_text(stmt, 1, fts_query.c_str(), fts_query.size(), SQLITE_STATIC);
+    std::unordered_set<gint64> node_ids;
+    int ret_code;
+    while (SQLITE_ROW == (ret_code = sqlite3_step(stmt))) {
+        node_ids.insert(sqlite3_column_int64(stmt, 0));
+    }
+    if (SQLITE_DONE != ret_code) {
+        spdlog::error("{}: {}", ERR_SQLITE_STEP, sqlite3_errmsg(_pDb));
+        return std::nullopt;
+    }
+    return node_ids;
+}
+
 const char* CtStorageSqlite::safe_sqlite3_column_text(sqlite3_stmt* stmt, int iCol)
 {
     const char* pStr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, iCol));
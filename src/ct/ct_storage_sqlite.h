@@ -30,11 +30,39 @@
 #include <gtksourceviewmm/buffer.h>
 #include <gtkmm/treeiter.h>
 #include <unordered_set>
+#include <unordered_map>
+#include <array>
 
 class CtMainWin;
 class CtAnchoredWidget;
 class CtTreeIter;
 class CtStorageCache;
+struct CtNodeData;
+struct CtDocNode;
+struct CtDocNodes;
+
+/**
+ * @brief Prepared statements of one connection, kept until the connection is closed
+ * @warning Only static sql strings (such as TABLE_*_INSERT/DELETE) can be passed, the pointer is the key
+ */
+class CtSqliteStmtCache
+{
+public:
+    ~CtSqliteStmtCache() { finalize_all(); }
+
+    void          set_db(sqlite3* pDb) { finalize_all(); _pDb = pDb; }
+    sqlite3*      get_db() { return _pDb; }
+    /**
+     * @brief Get the statement reset and with cleared bindings, ready to be bound and stepped
+     * @return nullptr if the statement could not be prepared
+     */
+    sqlite3_stmt* get(const char* sqlCmd);
+    void          finalize_all();
+
+private:
+    sqlite3*                                       _pDb{nullptr};
+    std::unordered_map<const char*, sqlite3_stmt*> _stmts;
+};
 
 class CtStorageSqlite : public CtStorageEntity
 {
@@ -47,6 +75,21 @@ public:
     void test_connection() override;
 
     bool populate_treestore(const fs::path& file_path, Glib::ustring& error) override;
+    bool populate_treestore_from_memory(std::string&& data, Glib::ustring& error) override;
+    /**
+     * @brief Reads the nodes properties and hierarchy without a tree store, the content of the nodes
+     * is then read by the stored text readers (headless export and conversion)
+     */
+    bool populate_doc_nodes(const fs::path& file_path, CtDocNodes& doc_nodes, Glib::ustring& error);
+    /**
+     * @brief Starts a new document at file_path, the nodes written by write_doc_node in the order of a tree
+     * traversal are committed by commit_doc
+     */
+    void create_doc(const fs::path& file_path, const std::vector<gint64>& bookmarks);
+    void write_doc_node(const CtDocNode& doc_node, const gint64 node_father_id, const CtDecodedNodeText& decoded_text);
+    void commit_doc();
+    bool can_work_in_memory() const override;
+    bool get_memory_data(std::string& data, Glib::ustring& error) override;
     bool save_treestore(const fs::path& file_path,
                         const CtStorageSyncPending& syncPending,
                         Glib::ustring& error,
@@ -54,17 +97,31 @@ public:
                         const int start_offset = 0,
                         const int end_offset = -1) override;
     void vacuum() override;
+    bool is_journal_save(const fs::path& file_path, const CtStorageSyncPending& syncPending) const override;
     void import_nodes(const fs::path& path, const Gtk::TreeIter& parent_iter) override;
 
     Glib::RefPtr<Gsv::Buffer> get_delayed_text_buffer(const gint64& node_id,
                                                       const std::string& syntax,
                                                       std::list<CtAnchoredWidget*>& widgets) const override;
+    bool can_reload_text_buffer(const gint64& /*node_id*/) const override { return _pDb != nullptr; }
+    std::optional<std::unordered_set<gint64>> get_nodes_maybe_containing(const Glib::ustring& text) const override;
+    bool get_stored_node_text(const gint64& node_id, CtStoredNodeText& stored_text) const override;
+    std::unique_ptr<CtStoredTextReader> create_stored_text_reader() const override;
 private:
-    void _open_db(const fs::path& path);
+    void _open_db(const fs::path& path, const bool apply_journal_mode = true);
     void _close_db();
     bool _check_database_integrity();
+    bool _load_from_db();
 
-    Gtk::TreeIter       _node_from_db(gint64 node_id, gint64 sequence, Gtk::TreeIter parent_iter, gint64 new_id);
+    /**
+     * @brief Load all the nodes reading the children and node tables with one ordered scan each,
+     * the hierarchy is then built in memory and the tree store filled in one go
+     * @param parent_iter: the nodes are appended under this iter (invalid iter for top level)
+     * @param is_import: the nodes get new ids and their buffers are loaded straight away
+     */
+    void                _nodes_from_db(const Gtk::TreeIter& parent_iter, const bool is_import);
+    void                _read_nodes_from_db(std::unordered_map<gint64, std::vector<gint64>>& children_dict,
+                                            std::unordered_map<gint64, CtNodeData>& nodes_data_dict);
 
     /**
      * @brief Check that the database contains the required tables
@@ -79,6 +136,27 @@ private:
      * @return std::unordered_set<std::string>
      */
     std::unordered_set<std::string> _get_table_field_names(std::string_view table_name);
+    /**
+     * @brief Bring a document created with an older version up to SCHEMA_VERSION,
+     * running in order the upgrade steps from the version recorded in PRAGMA user_version
+     * @note The upgrades only add columns and indexes so the document stays readable by older versions
+     */
+    void                _upgrade_db_schema();
+    int                 _get_schema_version();
+    void                _set_schema_version(const int version);
+    void                _create_all_indexes_in_db();
+
+    /**
+     * @brief The node_fts table (FTS5, trigram tokenizer) holds the plain text of node, codeboxes,
+     * tables and images names of each node, with the node ts_lastsave to detect the rows left
+     * stale by versions not updating it
+     * @return false if the sqlite library lacks FTS5 or the trigram tokenizer
+     */
+    bool                _create_fts_table_in_db();
+    bool                _fts_table_exists();
+    void                _write_node_fts_to_db(const gint64 node_id, const std::string& fts_txt, const gint64 ts_lastsave);
+    void                _fts_index_stale_nodes();
+    static std::string  _get_node_fts_text(CtTreeIter* ct_tree_iter, const int start_offset, const int end_offset);
 
     void                _image_from_db(const gint64& nodeId, std::list<CtAnchoredWidget*>& anchoredWidgets) const;
     void                _codebox_from_db(const gint64& nodeId, std::list<CtAnchoredWidget*>& anchoredWidgets) const;
@@ -91,7 +169,9 @@ private:
                                           const gint64 node_father_id,
                                           const CtStorageNodeState& write_dict,
                                           const int start_offset, const int end_offset,
+                                          const CtExporting exporting,
                                           CtStorageCache* storage_cache);
+    void                _remove_db_images_not_at(const gint64 node_id, const std::unordered_set<int>& kept_offsets);
 
     std::list<gint64>   _get_children_node_ids_from_db(gint64 father_id);
     void                _remove_db_node_with_children(const gint64 node_id);
@@ -100,30 +180,49 @@ private:
     void                _exec_bind_int64(const char* sqlCmd, const gint64 bind_int64);
 
 public:
+    static const int SCHEMA_VERSION;
     static const char TABLE_NODE_CREATE[];
     static const char TABLE_NODE_INSERT[];
     static const char TABLE_NODE_DELETE[];
+    static const char TABLE_NODE_UPDATE_PROP[];
+    static const char TABLE_NODE_UPDATE_BUFF[];
+    static const char TABLE_NODE_FTS_CREATE[];
+    static const char TABLE_NODE_FTS_INSERT[];
+    static const char TABLE_NODE_FTS_DELETE[];
     static const char TABLE_CODEBOX_CREATE[];
     static const char TABLE_CODEBOX_INSERT[];
     static const char TABLE_CODEBOX_DELETE[];
+    static const char TABLE_CODEBOX_INDEX_CREATE[];
     static const char TABLE_TABLE_CREATE[];
     static const char TABLE_TABLE_INSERT[];
     static const char TABLE_TABLE_DELETE[];
+    static const char TABLE_TABLE_INDEX_CREATE[];
     static const char TABLE_IMAGE_CREATE[];
     static const char TABLE_IMAGE_INSERT[];
     static const char TABLE_IMAGE_DELETE[];
+    static const char TABLE_IMAGE_DELETE_AT_OFFSET[];
+    static const char TABLE_IMAGE_INDEX_CREATE[];
     static const char TABLE_CHILDREN_CREATE[];
     static const char TABLE_CHILDREN_INSERT[];
     static const char TABLE_CHILDREN_DELETE[];
+    static const char TABLE_CHILDREN_INDEX_CREATE[];
     static const char TABLE_BOOKMARK_CREATE[];
     static const char TABLE_BOOKMARK_INSERT[];
     static const char TABLE_BOOKMARK_DELETE[];
     static const Glib::ustring ERR_SQLITE_PREPV2;
     static const Glib::ustring ERR_SQLITE_STEP;
+    static const std::array<const gchar*, 5> JOURNAL_MODES;
     static const char* safe_sqlite3_column_text(sqlite3_stmt* stmt, int iCol);
+    static bool get_stored_node_text_from_db(sqlite3* pDb, const gint64& node_id, CtStoredNodeText& stored_text);
+    static bool get_decoded_node_text_from_db(sqlite3* pDb, const gint64& node_id, CtDecodedNodeText& decoded_text);
+    // the codebox, table or image row of a widget, pRawBlob if the png or file bytes are not in widget.raw_blob
+    static bool write_widget_row(CtSqliteStmtCache& stmtCache, const gint64 node_id, const CtDecodedNodeText::Widget& widget, const std::string* pRawBlob = nullptr);
 
 private:
     CtMainWin*    _pCtMainWin;
     sqlite3*      _pDb{nullptr};
     fs::path      _file_path;
+    bool          _in_memory{false}; // the database lives in the connection only
+    CtSqliteStmtCache _stmtCache;
+    std::optional<bool> _ftsTableExists;
 };
@@ -26,15 +26,54 @@
 #include "ct_misc_utils.h"
 #include <libxml++/libxml++.h>
 #include <libxml2/libxml/parser.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <glib/gstdio.h>
 #include "ct_image.h"
 #include "ct_codebox.h"
 #include "ct_table.h"
 #include "ct_main_win.h"
 #include "ct_storage_control.h"
+#include "ct_storage_chunked.h"
+#include "ct_document.h"
 #include "ct_logging.h"
 
-CtStorageXml::CtStorageXml(CtMainWin* pCtMainWin) : _pCtMainWin(pCtMainWin)
+const char CtStorageXml::JOURNAL_EXT[]{".journal"};
+const char CtStorageXml::JOURNAL_RECORD_TAG[]{"CTJOURNAL"};
+
+CtStorageXml::CtStorageXml(CtMainWin* pCtMainWin, const bool journal_allowed/*= false*/)
+ : _pCtMainWin{pCtMainWin}
+ , _journal_allowed{journal_allowed}
+{
+}
+
+CtStorageXml::~CtStorageXml() = default;
+
+/*static*/ fs::path CtStorageXml::get_journal_path(const fs::path& file_path)
+{
+    fs::path journal_path = file_path;
+    journal_path += JOURNAL_EXT;
+    return journal_path;
+}
+
+bool CtStorageXml::open_chunked(const fs::path& file_path, const Glib::ustring& password)
 {
+    auto chunked_container = std::make_unique<CtChunkedContainer>();
+    if (not chunked_container->open(file_path, password)) {
+        return false;
+    }
+    _chunked_container = std::move(chunked_container);
+    return true;
+}
+
+void CtStorageXml::create_chunked(const Glib::ustring& password)
+{
+    _chunked_container = std::make_unique<CtChunkedContainer>();
+    _chunked_container->create(password);
+    _journal_usable = false;
 }
 
 void CtStorageXml::close_connect()
@@ -49,43 +88,429 @@ void CtStorageXml::test_connection()
 {
 }
 
+/**
+ * @brief The bytes of a .ctd document, memory mapped or converted to UTF-8 if read with another encoding
+ * @class CtXmlSource
+ */
+class CtXmlSource
+{
+public:
+    explicit CtXmlSource(GMappedFile* pMappedFile) : _pMappedFile{pMappedFile} {}
+    explicit CtXmlSource(std::string buffer) : _buffer{std::move(buffer)} {}
+    ~CtXmlSource() { if (_pMappedFile) g_mapped_file_unref(_pMappedFile); }
+    CtXmlSource(const CtXmlSource&) = delete;
+    CtXmlSource& operator=(const CtXmlSource&) = delete;
+
+    const char* data() const { return _pMappedFile ? g_mapped_file_get_contents(_pMappedFile) : _buffer.data(); }
+    size_t size() const { return _pMappedFile ? g_mapped_file_get_length(_pMappedFile) : _buffer.size(); }
+
+private:
+    GMappedFile* _pMappedFile{nullptr};
+    std::string  _buffer;
+};
+
+namespace {
+
+// the value of an integer attribute, default_value if missing or malformed instead of the std::stoi exceptions
+int get_attribute_int(const xmlpp::Element* element, const char* attribute_name, const int default_value)
+{
+    const Glib::ustring value = element->get_attribute_value(attribute_name);
+    const char* p_start = value.c_str();
+    char* p_end{nullptr};
+    errno = 0;
+    const gint64 parsed = g_ascii_strtoll(p_start, &p_end, 10);
+    if (p_end == p_start or 0 != errno or parsed < std::numeric_limits<int>::min() or parsed > std::numeric_limits<int>::max()) {
+        return default_value;
+    }
+    return static_cast<int>(parsed);
+}
+
+// the digest of the whole file, empty if it cannot be read
+std::string get_file_md5(const fs::path& file_path)
+{
+    GMappedFile* pMappedFile = g_mapped_file_new(file_path.c_str(), FALSE/*writable*/, nullptr);
+    if (not pMappedFile) {
+        return "";
+    }
+    g_autofree gchar* pMd5 = g_compute_checksum_for_data(G_CHECKSUM_MD5,
+                                                         reinterpret_cast<const guchar*>(g_mapped_file_get_contents(pMappedFile)),
+                                                         g_mapped_file_get_length(pMappedFile));
+    g_mapped_file_unref(pMappedFile);
+    return pMd5;
+}
+
+// the journal is merged into the document when bigger than half of it, or than this
+constexpr size_t JOURNAL_COMPACT_MIN_SIZE{1024*1024};
+// the chunks of the bookmarks, of the properties and position of a node (id) and of its content (-id)
+constexpr gint64 CHUNK_ID_BOOKMARKS{0};
+
+// the SAX callbacks of one pass over a document
+struct CtXmlStreamState
+{
+    struct OpenNode
+    {
+        size_t record_index;
+        size_t range_start;
+        size_t range_end;
+    };
+
+    xmlParserCtxtPtr ctxt{nullptr};
+    const char* data{nullptr};
+    size_t size{0};
+    std::function<size_t(const xmlChar**, int)> on_node_start; // returns the record index
+    std::function<void(size_t, size_t, size_t)> on_node_range;  // record index, start, end
+    std::function<void(const xmlChar*, const xmlChar**, int)> on_top_element; // the top level elements but the nodes
+    std::vector<bool> open_elements_is_node;
+    std::vector<OpenNode> open_nodes;
+    std::string error;
+};
+
+// the attributes of SAX2 come as localname/prefix/URI/value/end
+Glib::ustring xml_attribute_value(const xmlChar** attributes, const int nb_attributes, const char* name)
+{
+    for (int i = 0; i < nb_attributes; ++i) {
+        const xmlChar** attribute = attributes + 5*i;
+        if (0 == xmlStrcmp(attribute[0], BAD_CAST name)) {
+            std::string value{(const char*)attribute[3], (size_t)(attribute[4] - attribute[3])};
+            // without entities substitution the parser leaves an ampersand as a character reference
+            return str::replace(value, "&#38;", "&");
+        }
+    }
+    return "";
+}
+
+void node_data_from_xml_attributes(CtNodeData& node_data, const xmlChar** attributes, const int nb_attributes)
+{
+    auto attribute_value = [&](const char* name){ return xml_attribute_value(attributes, nb_attributes, name); };
+    node_data.nodeId = CtStrUtil::gint64_from_gstring(attribute_value("unique_id").c_str());
+    node_data.name = attribute_value("name");
+    node_data.syntax = attribute_value("prog_lang");
+    node_data.tags = attribute_value("tags");
+    node_data.isRO = CtStrUtil::is_str_true(attribute_value("readonly"));
+    node_data.customIconId = (guint32)CtStrUtil::gint64_from_gstring(attribute_value("custom_icon_id").c_str());
+    node_data.isBold = CtStrUtil::is_str_true(attribute_value("is_bold"));
+    node_data.foregroundRgb24 = attribute_value("foreground");
+    node_data.tsCreation = CtStrUtil::gint64_from_gstring(attribute_value("ts_creation").c_str());
+    node_data.tsLastSave = CtStrUtil::gint64_from_gstring(attribute_value("ts_lastsave").c_str());
+}
+
+// depending on the libxml2 version the start element callback comes on or past the closing '>'
+size_t xml_start_tag_end(const CtXmlStreamState& state)
+{
+    size_t pos = std::min((size_t)xmlByteConsumed(state.ctxt), state.size);
+    if (pos > 0 and '>' == state.data[pos-1]) {
+        return pos;
+    }
+    while (pos < state.size and '>' != state.data[pos]) {
+        ++pos;
+    }
+    return std::min(pos + 1, state.size);
+}
+
+void xml_on_start_element(void* user_data,
+                          const xmlChar* localname,
+                          const xmlChar*/*prefix*/,
+                          const xmlChar*/*URI*/,
+                          int/*nb_namespaces*/,
+                          const xmlChar**/*namespaces*/,
+                          int nb_attributes,
+                          int/*nb_defaulted*/,
+                          const xmlChar** attributes)
+{
+    auto& state = *static_cast<CtXmlStreamState*>(user_data);
+    const bool is_root = state.open_elements_is_node.empty();
+    const bool in_node = not is_root and state.open_elements_is_node.back();
+    const bool is_top_level = 1 == state.open_elements_is_node.size();
+    bool is_node{false};
+    if (is_root) {
+        if (0 != xmlStrcmp(localname, BAD_CAST CtConst::APP_NAME)) {
+            state.error = "document contains the wrong node root";
+            xmlStopParser(state.ctxt);
+        }
+    }
+    else if ((in_node or is_top_level) and 0 == xmlStrcmp(localname, BAD_CAST "node")) {
+        is_node = true;
+        const size_t tag_end = xml_start_tag_end(state);
+        if (in_node) {
+            // the slots of the parent before this child
+            CtXmlStreamState::OpenNode& parent_node = state.open_nodes.back();
+            if (parent_node.range_end > parent_node.range_start) {
+                state.on_node_range(parent_node.record_index, parent_node.range_start, parent_node.range_end);
+            }
+        }
+        const size_t record_index = state.on_node_start(attributes, nb_attributes);
+        state.open_nodes.push_back(CtXmlStreamState::OpenNode{record_index, tag_end, tag_end});
+    }
+    else if (is_top_level and state.on_top_element) {
+        state.on_top_element(localname, attributes, nb_attributes);
+    }
+    state.open_elements_is_node.push_back(is_node);
+}
+
+void xml_on_end_element(void* user_data,
+                        const xmlChar*/*localname*/,
+                        const xmlChar*/*prefix*/,
+                        const xmlChar*/*URI*/)
+{
+    auto& state = *static_cast<CtXmlStreamState*>(user_data);
+    // the end element callback comes past the closing '>'
+    const size_t pos = std::min((size_t)xmlByteConsumed(state.ctxt), state.size);
+    const bool is_node = state.open_elements_is_node.back();
+    state.open_elements_is_node.pop_back();
+    const bool in_node = not state.open_elements_is_node.empty() and state.open_elements_is_node.back();
+    if (is_node) {
+        const CtXmlStreamState::OpenNode open_node = state.open_nodes.back();
+        state.open_nodes.pop_back();
+        if (open_node.range_end > open_node.range_start) {
+            state.on_node_range(open_node.record_index, open_node.range_start, open_node.range_end);
+        }
+        if (in_node) {
+            // the slots of the parent after this child
+            state.open_nodes.back().range_start = pos;
+            state.open_nodes.back().range_end = pos;
+        }
+    }
+    else if (in_node) {
+        state.open_nodes.back().range_end = pos;
+    }
+}
+
+template<class XmlError>
+void xml_on_error(void* user_data, XmlError pError)
+{
+    auto& state = *static_cast<CtXmlStreamState*>(user_data);
+    if (state.error.empty() and pError and pError->message) {
+        state.error = pError->message;
+    }
+}
+
+// one pass of a SAX parser over the document, without building it
+bool xml_stream_parse(CtXmlStreamState& state)
+{
+    xmlSAXHandler sax_handler;
+    memset(&sax_handler, 0, sizeof(sax_handler));
+    sax_handler.initialized = XML_SAX2_MAGIC;
+    sax_handler.startElementNs = xml_on_start_element;
+    sax_handler.endElementNs = xml_on_end_element;
+    sax_handler.serror = xml_on_error;
+
+    state.ctxt = xmlCreatePushParserCtxt(&sax_handler, &state, nullptr, 0, nullptr);
+    if (not state.ctxt) {
+        state.error = "xml parser creation fail";
+        return false;
+    }
+    auto ctxt_guard = scope_guard([&state](void*){
+        xmlFreeParserCtxt(state.ctxt);
+        state.ctxt = nullptr;
+    });
+    // the data is UTF-8, the byte ranges must not be shifted by a conversion
+    xmlCtxtUseOptions(state.ctxt, XML_PARSE_HUGE | XML_PARSE_NONET | XML_PARSE_IGNORE_ENC);
+
+    constexpr size_t chunk_size{1024*1024};
+    size_t offset{0};
+    bool parseOk{true};
+    do {
+        const size_t len = std::min(chunk_size, state.size - offset);
+        const bool is_last = offset + len == state.size;
+        parseOk = 0 == xmlParseChunk(state.ctxt, state.data + offset, (int)len, is_last ? 1 : 0);
+        offset += len;
+    } while (parseOk and offset < state.size and state.error.empty());
+
+    parseOk = parseOk and state.ctxt->wellFormed and state.error.empty();
+    if (not parseOk and state.error.empty()) {
+        state.error = "xml parse fail";
+    }
+    return parseOk;
+}
+
+// the encoding in the xml declaration, if any
+std::string xml_declared_encoding(const char* data, const size_t size)
+{
+    const std::string prolog{data, std::min(size, (size_t)200)};
+    if (not str::startswith(prolog, "<?xml")) {
+        return "";
+    }
+    const size_t decl_end = prolog.find("?>");
+    const size_t enc_pos = prolog.find("encoding=");
+    if (std::string::npos == decl_end or std::string::npos == enc_pos or enc_pos > decl_end) {
+        return "";
+    }
+    const size_t value_start = enc_pos + 10;
+    const size_t value_end = prolog.find_first_of("\"'", value_start);
+    return std::string::npos == value_end ? "" : prolog.substr(value_start, value_end - value_start);
+}
+
+bool get_stored_text_from_ranges(const CtXmlNodeRanges& node_ranges, CtStoredNodeText& stored_text);
+bool get_decoded_text_from_ranges(const CtXmlNodeRanges& node_ranges, CtDecodedNodeText& decoded_text);
+
+} // namespace
+
+struct CtStorageXml::NodeRecord
+{
+    CtNodeData      node_data;
+    int             parent_index{-1}; // -1 for the top level nodes
+    CtXmlNodeRanges node_ranges;
+    bool            removed{false};   // by the journal
+};
+
 bool CtStorageXml::populate_treestore(const fs::path& file_path, Glib::ustring& error)
 {
     try
     {
-        // open file
-        auto parser = _get_parser(file_path);
-
-        // read bookmarks
-        for (xmlpp::Node* xml_node :  parser->get_document()->get_root_node()->get_children("bookmarks"))
-        {
-            Glib::ustring bookmarks_csv = static_cast<xmlpp::Element*>(xml_node)->get_attribute_value("list");
-            for (gint64& nodeId : CtStrUtil::gstring_split_to_int64(bookmarks_csv.c_str(), ","))
-                _pCtMainWin->get_tree_store().bookmarks_add(nodeId);
+        std::vector<NodeRecord> node_records;
+        std::vector<gint64> bookmarks;
+        if (_chunked_container) {
+            _read_chunked_records(node_records, &bookmarks);
+            _populate_from_records(node_records, bookmarks);
+            _file_path = file_path;
+            _journal_usable = true;
+            return true;
         }
+        const bool read_as_is = _read_node_records(file_path, node_records, &bookmarks);
+        const bool journal_replayed = _replay_journal(file_path, node_records, bookmarks);
+        const bool ids_unique = _populate_from_records(node_records, bookmarks);
+
+        // the next save can be appended to the journal only if the document on disk matches the tree
+        _file_path = file_path;
+        _journal_usable = read_as_is and journal_replayed and ids_unique;
+
+        return true;
+    }
+    catch (std::exception& e)
+    {
+        error = std::string("CtDocXmlStorage got exception: ") + e.what();
+        return false;
+    }
+}
+
+bool CtStorageXml::populate_treestore_from_memory(std::string&& data, Glib::ustring& error)
+{
+    try
+    {
+        // the nodes keep the data until their buffers are created
+        std::vector<NodeRecord> node_records;
+        std::vector<gint64> bookmarks;
+        _read_node_records(std::make_shared<const CtXmlSource>(std::move(data)), "memory", node_records, &bookmarks);
+        _populate_from_records(node_records, bookmarks);
+        return true;
+    }
+    catch (std::exception& e)
+    {
+        error = std::string("CtDocXmlStorage got exception: ") + e.what();
+        return false;
+    }
+}
+
+bool CtStorageXml::get_memory_data(std::string& data, Glib::ustring& error)
+{
+    if (_memory_data.empty()) {
+        error = "no document in memory";
+        return false;
+    }
+    data = std::move(_memory_data);
+    _memory_data.clear();
+    return true;
+}
+
+bool CtStorageXml::_populate_from_records(std::vector<NodeRecord>& node_records, const std::vector<gint64>& bookmarks)
+{
+    for (const gint64 nodeId : bookmarks)
+        _pCtMainWin->get_tree_store().bookmarks_add(nodeId);
 
-        // read nodes
-        std::list<CtTreeIter> nodes_with_duplicated_id;
-        std::function<void(xmlpp::Element*, const gint64, Gtk::TreeIter)> nodes_from_xml;
-        nodes_from_xml = [&](xmlpp::Element* xml_element, const gint64 sequence, Gtk::TreeIter parent_iter) {
+    std::vector<size_t> top_indexes;
+    std::vector<std::vector<size_t>> children_indexes;
+    _records_by_sequence(node_records, top_indexes, children_indexes);
+
+    std::list<CtTreeIter> nodes_with_duplicated_id;
+    std::function<void(const std::vector<size_t>&, const Gtk::TreeIter*)> append_nodes;
+    append_nodes = [&](const std::vector<size_t>& indexes, const Gtk::TreeIter* pParentIter) {
+        gint64 sequence = 0;
+        for (const size_t i : indexes) {
+            NodeRecord& node_record = node_records[i];
+            CtNodeData& node_data = node_record.node_data;
+            node_data.sequence = ++sequence;
             bool has_duplicated_id = false;
-            Gtk::TreeIter new_iter = _node_from_xml(xml_element, sequence, parent_iter, -1, &has_duplicated_id);
+            if (_delayed_text_buffers.count(node_data.nodeId) != 0) {
+                spdlog::debug("node has duplicated id {}, will be fixed", node_data.nodeId);
+                has_duplicated_id = true;
+                // create buffer now because we cannot put a duplicate id in _delayed_text_buffers
+                // the id will be fixed below
+                node_data.rTextBuffer = _create_buffer_from_ranges(node_record.node_ranges, node_data.syntax, node_data.anchoredWidgets);
+            }
+            else {
+                // because of widgets which are slow to insert for now, delay creating buffers
+                _delayed_text_buffers[node_data.nodeId] = std::move(node_record.node_ranges);
+            }
+            const Gtk::TreeIter node_iter = _pCtMainWin->get_tree_store().append_node(&node_data, pParentIter);
             if (has_duplicated_id) {
-                nodes_with_duplicated_id.push_back(_pCtMainWin->get_tree_store().to_ct_tree_iter(new_iter));
+                nodes_with_duplicated_id.push_back(_pCtMainWin->get_tree_store().to_ct_tree_iter(node_iter));
             }
-            gint64 child_sequence = 0;
-            for (xmlpp::Node* xml_node : xml_element->get_children("node"))
-                nodes_from_xml(static_cast<xmlpp::Element*>(xml_node), ++child_sequence, new_iter);
-        };
-        gint64 sequence = 0;
-        for (xmlpp::Node* xml_node: parser->get_document()->get_root_node()->get_children("node"))
-            nodes_from_xml(static_cast<xmlpp::Element*>(xml_node), ++sequence, Gtk::TreeIter());
+            append_nodes(children_indexes[i], &node_iter);
+        }
+    };
+    append_nodes(top_indexes, nullptr);
+
+    // fixes duplicated ids by setting new ids
+    for (auto& node: nodes_with_duplicated_id) {
+        node.set_node_id(_pCtMainWin->get_tree_store().node_id_get());
+    }
+
+    return nodes_with_duplicated_id.empty();
+}
 
-        // fixes duplicated ids by setting new ids
-        for (auto& node: nodes_with_duplicated_id) {
-            node.set_node_id(_pCtMainWin->get_tree_store().node_id_get());
+/*static*/void CtStorageXml::_records_by_sequence(const std::vector<NodeRecord>& node_records,
+                                                 std::vector<size_t>& top_indexes,
+                                                 std::vector<std::vector<size_t>>& children_indexes)
+{
+    // the journal may have moved the nodes anywhere, the children go by their sequence
+    children_indexes.assign(node_records.size(), std::vector<size_t>{});
+    top_indexes.clear();
+    for (size_t i = 0; i < node_records.size(); ++i) {
+        if (node_records[i].removed) continue;
+        const int parent_index = node_records[i].parent_index;
+        (parent_index < 0 ? top_indexes : children_indexes[parent_index]).push_back(i);
+    }
+    auto by_sequence = [&](const size_t lhs, const size_t rhs){
+        return node_records[lhs].node_data.sequence < node_records[rhs].node_data.sequence;
+    };
+    std::stable_sort(top_indexes.begin(), top_indexes.end(), by_sequence);
+    for (std::vector<size_t>& indexes : children_indexes) {
+        std::stable_sort(indexes.begin(), indexes.end(), by_sequence);
+    }
+}
+
+bool CtStorageXml::populate_doc_nodes(const fs::path& file_path, CtDocNodes& doc_nodes, Glib::ustring& error)
+{
+    try
+    {
+        std::vector<NodeRecord> node_records;
+        std::vector<gint64> bookmarks;
+        if (_chunked_container) {
+            _read_chunked_records(node_records, &bookmarks);
+        }
+        else {
+            _read_node_records(file_path, node_records, &bookmarks);
+            _replay_journal(file_path, node_records, bookmarks);
         }
+        _doc_nodes_from_records(node_records, bookmarks, doc_nodes);
+        _file_path = file_path;
+        return true;
+    }
+    catch (std::exception& e)
+    {
+        error = std::string("CtDocXmlStorage got exception: ") + e.what();
+        return false;
+    }
+}
 
+bool CtStorageXml::populate_doc_nodes_from_memory(std::string&& data, CtDocNodes& doc_nodes, Glib::ustring& error)
+{
+    try
+    {
+        std::vector<NodeRecord> node_records;
+        std::vector<gint64> bookmarks;
+        _read_node_records(std::make_shared<const CtXmlSource>(std::move(data)), "memory", node_records, &bookmarks);
+        _doc_nodes_from_records(node_records, bookmarks, doc_nodes);
         return true;
     }
     catch (std::exception& e)
@@ -93,10 +518,35 @@ bool CtStorageXml::populate_treestore(const fs::path& file_path, Glib::ustring&
         error = std::string("CtDocXmlStorage got exception: ") + e.what();
         return false;
     }
- }
+}
+
+void CtStorageXml::_doc_nodes_from_records(std::vector<NodeRecord>& node_records, const std::vector<gint64>& bookmarks, CtDocNodes& doc_nodes)
+{
+    doc_nodes.nodes.clear();
+    doc_nodes.bookmarks = bookmarks;
+    std::vector<size_t> top_indexes;
+    std::vector<std::vector<size_t>> children_indexes;
+    _records_by_sequence(node_records, top_indexes, children_indexes);
+
+    std::function<void(const std::vector<size_t>&, const int, const int)> append_nodes;
+    append_nodes = [&](const std::vector<size_t>& indexes, const int level, const int parent_index) {
+        gint64 sequence = 0;
+        for (const size_t i : indexes) {
+            NodeRecord& node_record = node_records[i];
+            node_record.node_data.sequence = ++sequence;
+            if (not _delayed_text_buffers.emplace(node_record.node_data.nodeId, std::move(node_record.node_ranges)).second) {
+                // without a tree store there is no new id to give, the content read is the one of the first node
+                spdlog::warn("node has duplicated id {}", node_record.node_data.nodeId);
+            }
+            doc_nodes.nodes.push_back(CtDocNode{std::move(node_record.node_data), level, parent_index});
+            append_nodes(children_indexes[i], level + 1, (int)doc_nodes.nodes.size() - 1);
+        }
+    };
+    append_nodes(top_indexes, 0, -1);
+}
 
 bool CtStorageXml::save_treestore(const fs::path& file_path,
-                                  const CtStorageSyncPending&,
+                                  const CtStorageSyncPending& syncPending,
                                   Glib::ustring& error,
                                   const CtExporting exporting/*= CtExporting::NONE*/,
                                   const int start_offset/*= 0*/,
@@ -104,41 +554,52 @@ bool CtStorageXml::save_treestore(const fs::path& file_path,
 {
     try
     {
-        xmlpp::Document xml_doc;
-        xml_doc.create_root_node(CtConst::APP_NAME);
-
-        if ( CtExporting::NONE == exporting or
-             CtExporting::ALL_TREE == exporting ) {
-            // save bookmarks
-            xmlpp::Element* p_bookmarks_node = xml_doc.get_root_node()->add_child("bookmarks");
-            p_bookmarks_node->set_attribute("list", str::join_numbers(_pCtMainWin->get_tree_store().bookmarks_get(), ","));
-        }
-
-        CtStorageCache storage_cache;
-        storage_cache.generate_cache(_pCtMainWin, nullptr, true);
-
-        // save nodes
-        if ( CtExporting::NONE == exporting or
-             CtExporting::ALL_TREE == exporting ) {
-            auto ct_tree_iter = _pCtMainWin->get_tree_store().get_ct_iter_first();
-            while (ct_tree_iter)
-            {
-                _nodes_to_xml(&ct_tree_iter, xml_doc.get_root_node(), &storage_cache, exporting, start_offset, end_offset);
-                ct_tree_iter++;
+        if (_chunked_container and CtExporting::NONE == exporting) {
+            if (is_journal_save(file_path, syncPending)) {
+                _write_chunked(file_path, &syncPending);
+                // the chunks replaced by the saves are dropped once they outweigh the live ones
+                if (_chunked_container->get_dead_size() > std::max(JOURNAL_COMPACT_MIN_SIZE, _chunked_container->get_live_size())) {
+                    _chunked_container->compact();
+                }
+            }
+            else {
+                _write_chunked(file_path, nullptr);
+                _file_path = file_path;
             }
+            _drop_outdated_ranges(syncPending);
+            _journal_usable = true;
+            return true;
         }
-        else {
-            CtTreeIter ct_tree_iter = _pCtMainWin->curr_tree_iter();
-            _nodes_to_xml(&ct_tree_iter, xml_doc.get_root_node(), &storage_cache, exporting, start_offset, end_offset);
+        if (CtExporting::NONE == exporting and is_journal_save(file_path, syncPending)) {
+            _append_journal(syncPending);
+            _drop_outdated_ranges(syncPending);
+            return true;
         }
 
-        // write file
-        xml_doc.write_to_file_formatted(file_path.string());
+        _write_document(file_path, exporting, start_offset, end_offset);
 
+        if (CtExporting::NONE == exporting and file_path.empty()) {
+            _drop_outdated_ranges(syncPending);
+        }
+        if (CtExporting::NONE == exporting and not file_path.empty()) {
+            // the document replaced, the ranges are of the one mapped before
+            _delayed_text_buffers.clear();
+            // the journal is merged into the document now, left behind by a crash it would replay the same changes
+            const fs::path journal_path = get_journal_path(file_path);
+            if (fs::is_regular_file(journal_path) and not fs::remove(journal_path)) {
+                throw std::runtime_error(fmt::format("failed to remove {}", journal_path.string()));
+            }
+            _file_path = file_path;
+            _file_size = fs::file_size(file_path);
+            _file_md5.clear();
+            _journal_usable = true;
+        }
         return true;
     }
     catch (std::exception& e)
     {
+        // a partially appended record is discarded on load but the next save rewrites the document
+        _journal_usable = false;
         error = e.what();
         return false;
     }
@@ -146,26 +607,494 @@ bool CtStorageXml::save_treestore(const fs::path& file_path,
 
 void CtStorageXml::vacuum()
 {
+    if (_chunked_container) {
+        try
+        {
+            if (_journal_usable and _chunked_container->get_dead_size() > 0) {
+                _chunked_container->compact();
+            }
+        }
+        catch (std::exception& e)
+        {
+            _journal_usable = false;
+            spdlog::error("{} {}", __FUNCTION__, e.what());
+        }
+        return;
+    }
+    const fs::path journal_path = get_journal_path(_file_path);
+    if (_file_path.empty() or not fs::is_regular_file(journal_path)) {
+        return;
+    }
+    try
+    {
+        // a crash leaves either the old document with its journal or the new one
+        _write_document(_file_path, CtExporting::NONE, 0, -1);
+        if (not fs::remove(journal_path)) {
+            throw std::runtime_error(fmt::format("failed to remove {}", journal_path.string()));
+        }
+        _file_size = fs::file_size(_file_path);
+        _file_md5.clear();
+        _journal_usable = true;
+    }
+    catch (std::exception& e)
+    {
+        _journal_usable = false;
+        spdlog::error("{} {}", __FUNCTION__, e.what());
+    }
 }
 
-void CtStorageXml::import_nodes(const fs::path& path, const Gtk::TreeIter& parent_iter)
+bool CtStorageXml::is_journal_save(const fs::path& file_path, const CtStorageSyncPending&/*syncPending*/) const
+{
+    if (_chunked_container) {
+        // the changed chunks are appended to the document itself
+        return _journal_usable and _chunked_container->is_open() and file_path == _file_path;
+    }
+    if ( not _journal_allowed or
+         not _journal_usable or
+         not _pCtMainWin->get_ct_config()->xmlJournalOn or
+         file_path != _file_path )
+    {
+        return false;
+    }
+    // past the threshold the journal is merged into the document
+    const fs::path journal_path = get_journal_path(file_path);
+    const size_t journal_size = fs::is_regular_file(journal_path) ? fs::file_size(journal_path) : 0;
+    return journal_size < std::max(JOURNAL_COMPACT_MIN_SIZE, _file_size/2);
+}
+
+void CtStorageXml::_write_document(const fs::path& file_path,
+                                   const CtExporting exporting,
+                                   const int start_offset,
+                                   const int end_offset)
+{
+    xmlpp::Document xml_doc;
+    xml_doc.create_root_node(CtConst::APP_NAME);
+
+    if ( CtExporting::NONE == exporting or
+         CtExporting::ALL_TREE == exporting ) {
+        // save bookmarks
+        xmlpp::Element* p_bookmarks_node = xml_doc.get_root_node()->add_child("bookmarks");
+        p_bookmarks_node->set_attribute("list", str::join_numbers(_pCtMainWin->get_tree_store().bookmarks_get(), ","));
+    }
+
+    CtStorageCache storage_cache;
+    storage_cache.generate_cache(_pCtMainWin, nullptr, true);
+
+    // save nodes
+    if ( CtExporting::NONE == exporting or
+         CtExporting::ALL_TREE == exporting ) {
+        auto ct_tree_iter = _pCtMainWin->get_tree_store().get_ct_iter_first();
+        while (ct_tree_iter)
+        {
+            _nodes_to_xml(&ct_tree_iter, xml_doc.get_root_node(), &storage_cache, exporting, start_offset, end_offset);
+            ct_tree_iter++;
+        }
+    }
+    else {
+        CtTreeIter ct_tree_iter = _pCtMainWin->curr_tree_iter();
+        _nodes_to_xml(&ct_tree_iter, xml_doc.get_root_node(), &storage_cache, exporting, start_offset, end_offset);
+    }
+
+    // write file, or keep it for get_memory_data
+    if (file_path.empty()) {
+        _memory_data = xml_doc.write_to_string_formatted();
+    }
+    else {
+        // the document is replaced at once: the nodes not loaded are still read from the mapping of the
+        // one in place, and a crash leaves either the old document or the new one
+        fs::path tmp_file_path = file_path;
+        tmp_file_path += ".tmp";
+        xml_doc.write_to_file_formatted(tmp_file_path.string());
+        if (not fs::move_file(tmp_file_path, file_path)) {
+            throw std::runtime_error(fmt::format("failed to replace {}", file_path.string()));
+        }
+    }
+}
+
+void CtStorageXml::_append_journal(const CtStorageSyncPending& syncPending)
+{
+    CtTreeStore& tree_store = _pCtMainWin->get_tree_store();
+    xmlpp::Document xml_doc;
+    xmlpp::Element* p_root = xml_doc.create_root_node(CtConst::APP_NAME);
+    // the document the journal applies to, the digest for an outside edit keeping the size
+    if (_file_md5.empty()) {
+        _file_md5 = get_file_md5(_file_path);
+    }
+    xmlpp::Element* p_journal_node = p_root->add_child("journal");
+    p_journal_node->set_attribute("doc_size", std::to_string(_file_size));
+    p_journal_node->set_attribute("doc_md5", _file_md5);
+
+    if (syncPending.bookmarks_to_write) {
+        p_root->add_child("bookmarks")->set_attribute("list", str::join_numbers(tree_store.bookmarks_get(), ","));
+    }
+
+    CtStorageCache storage_cache;
+    storage_cache.generate_cache(_pCtMainWin, &syncPending, true);
+
+    // the properties and the position of a changed node, its content only if changed
+    for (const auto& node_pair : syncPending.nodes_to_write_dict) {
+        CtTreeIter ct_tree_iter = tree_store.get_node_from_node_id(node_pair.first);
+        if (not ct_tree_iter) {
+            continue;
+        }
+        const bool with_buffer = node_pair.second.buff;
+        xmlpp::Element* p_node_node{nullptr};
+        if (with_buffer) {
+            p_node_node = CtStorageXmlHelper(_pCtMainWin).node_to_xml(&ct_tree_iter, p_root, true, &storage_cache);
+        }
+        else {
+            p_node_node = p_root->add_child("node");
+            CtStorageXmlHelper::node_properties_to_xml(&ct_tree_iter, p_node_node);
+        }
+        CtTreeIter ct_tree_iter_parent = ct_tree_iter.parent();
+        p_node_node->set_attribute("journal_parent_id", std::to_string(ct_tree_iter_parent ? ct_tree_iter_parent.get_node_id() : 0));
+        p_node_node->set_attribute("journal_sequence", std::to_string(ct_tree_iter.get_node_sequence()));
+        p_node_node->set_attribute("journal_buffer", std::to_string(with_buffer));
+    }
+
+    if (not syncPending.nodes_to_rm_set.empty()) {
+        p_root->add_child("removed")->set_attribute("list", str::join_numbers(syncPending.nodes_to_rm_set, ","));
+    }
+
+    // a header line "CTJOURNAL <payload size> <payload md5>", the payload and a newline
+    const std::string payload = xml_doc.write_to_string().raw();
+    gchar* pPayloadMd5 = g_compute_checksum_for_string(G_CHECKSUM_MD5, payload.c_str(), payload.size());
+    const std::string header = fmt::format("{} {} {}\n", JOURNAL_RECORD_TAG, payload.size(), pPayloadMd5);
+    g_free(pPayloadMd5);
+
+    const fs::path journal_path = get_journal_path(_file_path);
+    FILE* pFile = g_fopen(journal_path.c_str(), "ab");
+    if (not pFile) {
+        throw std::runtime_error(fmt::format("failed to open {}", journal_path.string()));
+    }
+    auto on_scope_exit = scope_guard([&](void*) { fclose(pFile); });
+    const bool writeOk = 1 == fwrite(header.c_str(), header.size(), 1, pFile) and
+                         1 == fwrite(payload.c_str(), payload.size(), 1, pFile) and
+                         1 == fwrite("\n", 1, 1, pFile) and
+                         0 == fflush(pFile) and
+                         0 == g_fsync(fileno(pFile));
+    if (not writeOk) {
+        throw std::runtime_error(fmt::format("failed to append to {}", journal_path.string()));
+    }
+    spdlog::debug("{} nodes, {} bytes appended to {}", syncPending.nodes_to_write_dict.size(), header.size() + payload.size() + 1, journal_path.string());
+}
+
+bool CtStorageXml::_replay_journal(const fs::path& file_path, std::vector<NodeRecord>& node_records, std::vector<gint64>& bookmarks)
+{
+    _file_size = fs::file_size(file_path);
+    _file_md5.clear();
+    const fs::path journal_path = get_journal_path(file_path);
+    if (not fs::is_regular_file(journal_path)) {
+        return true;
+    }
+    GError* pError{nullptr};
+    GMappedFile* pMappedFile = g_mapped_file_new(journal_path.c_str(), FALSE/*writable*/, &pError);
+    if (not pMappedFile) {
+        spdlog::error("{} {} {}", __FUNCTION__, journal_path.string(), pError ? pError->message : "");
+        if (pError) g_error_free(pError);
+        return false;
+    }
+    // the journal stays mapped for the nodes whose content is in there
+    auto source = std::make_shared<const CtXmlSource>(pMappedFile);
+    const char* const data = source->data();
+    const size_t size = source->size();
+
+    std::unordered_map<gint64, size_t> nodes_indexes;
+    for (size_t i = 0; i < node_records.size(); ++i) {
+        nodes_indexes.emplace(node_records[i].node_data.nodeId, i);
+    }
+    std::unordered_map<size_t, gint64> nodes_parent_ids; // of the nodes written in the journal
+
+    size_t pos{0};
+    size_t saves_num{0};
+    while (pos < size) {
+        const char* pLineEnd = static_cast<const char*>(memchr(data + pos, '\n', size - pos));
+        if (not pLineEnd) {
+            break;
+        }
+        std::istringstream header{std::string{data + pos, pLineEnd}};
+        std::string tag, payload_md5;
+        size_t payload_size{0};
+        header >> tag >> payload_size >> payload_md5;
+        const size_t payload_start = pLineEnd - data + 1;
+        if (tag != JOURNAL_RECORD_TAG or payload_start + payload_size + 1 > size) {
+            break;
+        }
+        gchar* pMd5 = g_compute_checksum_for_data(G_CHECKSUM_MD5, reinterpret_cast<const guchar*>(data + payload_start), payload_size);
+        const bool md5Ok = payload_md5 == pMd5;
+        g_free(pMd5);
+        if (not md5Ok) {
+            break;
+        }
+
+        std::vector<NodeRecord> saved_nodes;
+        std::vector<std::pair<gint64, bool>> saved_nodes_parent_id_with_buffer;
+        std::optional<std::vector<gint64>> saved_bookmarks;
+        std::vector<gint64> removed_ids;
+        size_t doc_size{0};
+        std::string doc_md5;
+        CtXmlStreamState state;
+        state.data = data + payload_start;
+        state.size = payload_size;
+        state.on_node_start = [&](const xmlChar** attributes, const int nb_attributes){
+            saved_nodes.emplace_back();
+            NodeRecord& node_record = saved_nodes.back();
+            node_record.node_ranges.source = source;
+            node_data_from_xml_attributes(node_record.node_data, attributes, nb_attributes);
+            node_record.node_data.sequence = CtStrUtil::gint64_from_gstring(xml_attribute_value(attributes, nb_attributes, "journal_sequence").c_str());
+            saved_nodes_parent_id_with_buffer.emplace_back(
+                CtStrUtil::gint64_from_gstring(xml_attribute_value(attributes, nb_attributes, "journal_parent_id").c_str()),
+                CtStrUtil::is_str_true(xml_attribute_value(attributes, nb_attributes, "journal_buffer")));
+            return saved_nodes.size() - 1;
+        };
+        state.on_node_range = [&](const size_t record_index, const size_t start, const size_t end){
+            saved_nodes[record_index].node_ranges.ranges.emplace_back(payload_start + start, payload_start + end);
+        };
+        state.on_top_element = [&](const xmlChar* localname, const xmlChar** attributes, const int nb_attributes){
+            const Glib::ustring list_csv = xml_attribute_value(attributes, nb_attributes, "list");
+            if (0 == xmlStrcmp(localname, BAD_CAST "journal")) {
+                doc_size = CtStrUtil::gint64_from_gstring(xml_attribute_value(attributes, nb_attributes, "doc_size").c_str());
+                doc_md5 = xml_attribute_value(attributes, nb_attributes, "doc_md5");
+            }
+            else if (0 == xmlStrcmp(localname, BAD_CAST "bookmarks")) {
+                saved_bookmarks = CtStrUtil::gstring_split_to_int64(list_csv.c_str(), ",");
+            }
+            else if (0 == xmlStrcmp(localname, BAD_CAST "removed")) {
+                removed_ids = CtStrUtil::gstring_split_to_int64(list_csv.c_str(), ",");
+            }
+        };
+        if (not xml_stream_parse(state)) {
+            spdlog::error("{} {}", __FUNCTION__, state.error);
+            break;
+        }
+        if (doc_size == _file_size and _file_md5.empty()) {
+            _file_md5 = get_file_md5(file_path);
+        }
+        if (doc_size != _file_size or doc_md5 != _file_md5) {
+            // the document was rewritten by someone not aware of the journal
+            spdlog::warn("{} {} does not match the document", __FUNCTION__, journal_path.string());
+            break;
+        }
+
+        // the same as the in place update of a node in a database
+        for (size_t i = 0; i < saved_nodes.size(); ++i) {
+            const gint64 parent_id = saved_nodes_parent_id_with_buffer[i].first;
+            const bool with_buffer = saved_nodes_parent_id_with_buffer[i].second;
+            auto it = nodes_indexes.find(saved_nodes[i].node_data.nodeId);
+            size_t index;
+            if (it == nodes_indexes.end()) {
+                index = node_records.size();
+                node_records.push_back(std::move(saved_nodes[i]));
+                nodes_indexes.emplace(node_records.back().node_data.nodeId, index);
+            }
+            else {
+                index = it->second;
+                CtXmlNodeRanges node_ranges = std::move(node_records[index].node_ranges);
+                node_records[index] = std::move(saved_nodes[i]);
+                if (not with_buffer) {
+                    node_records[index].node_ranges = std::move(node_ranges);
+                }
+            }
+            nodes_parent_ids[index] = parent_id;
+        }
+        for (const gint64 node_id : removed_ids) {
+            auto it = nodes_indexes.find(node_id);
+            if (it != nodes_indexes.end()) {
+                node_records[it->second].removed = true;
+                nodes_indexes.erase(it);
+            }
+        }
+        if (saved_bookmarks) {
+            bookmarks = std::move(*saved_bookmarks);
+        }
+        pos = payload_start + payload_size + 1;
+        ++saves_num;
+    }
+
+    // the parents may come after their children now
+    for (const auto& index_parent_id : nodes_parent_ids) {
+        auto it = nodes_indexes.find(index_parent_id.second);
+        node_records[index_parent_id.first].parent_index = it == nodes_indexes.end() ? -1 : (int)it->second;
+    }
+
+    spdlog::debug("{} saves replayed from {}", saves_num, journal_path.string());
+    if (pos < size) {
+        spdlog::warn("{} {} discarded from byte {}", __FUNCTION__, journal_path.string(), pos);
+        return false;
+    }
+    return true;
+}
+
+void CtStorageXml::_write_chunked(const fs::path& file_path, const CtStorageSyncPending* pSyncPending)
+{
+    CtTreeStore& tree_store = _pCtMainWin->get_tree_store();
+    std::map<gint64, std::string> chunks;
+    std::vector<gint64> removed_ids;
+
+    if (not pSyncPending or pSyncPending->bookmarks_to_write) {
+        xmlpp::Document xml_doc;
+        xmlpp::Element* p_bookmarks_node = xml_doc.create_root_node(CtConst::APP_NAME)->add_child("bookmarks");
+        p_bookmarks_node->set_attribute("list", str::join_numbers(tree_store.bookmarks_get(), ","));
+        chunks[CHUNK_ID_BOOKMARKS] = xml_doc.write_to_string().raw();
+    }
+
+    CtStorageCache storage_cache;
+    storage_cache.generate_cache(_pCtMainWin, pSyncPending, true);
+
+    // the properties and the position of the node, its content only if changed
+    auto add_node_chunks = [&](CtTreeIter& ct_tree_iter, const bool with_buffer) {
+        const gint64 node_id = ct_tree_iter.get_node_id();
+        {
+            xmlpp::Document xml_doc;
+            xmlpp::Element* p_node_node = xml_doc.create_root_node(CtConst::APP_NAME)->add_child("node");
+            CtStorageXmlHelper::node_properties_to_xml(&ct_tree_iter, p_node_node);
+            CtTreeIter ct_tree_iter_parent = ct_tree_iter.parent();
+            p_node_node->set_attribute("journal_parent_id", std::to_string(ct_tree_iter_parent ? ct_tree_iter_parent.get_node_id() : 0));
+            p_node_node->set_attribute("journal_sequence", std::to_string(ct_tree_iter.get_node_sequence()));
+            chunks[node_id] = xml_doc.write_to_string().raw();
+        }
+        if (with_buffer) {
+            xmlpp::Document xml_doc;
+            CtStorageXmlHelper(_pCtMainWin).node_to_xml(&ct_tree_iter, xml_doc.create_root_node(CtConst::APP_NAME), true, &storage_cache);
+            chunks[-node_id] = xml_doc.write_to_string().raw();
+        }
+    };
+
+    if (pSyncPending) {
+        for (const auto& node_pair : pSyncPending->nodes_to_write_dict) {
+            CtTreeIter ct_tree_iter = tree_store.get_node_from_node_id(node_pair.first);
+            if (ct_tree_iter) {
+                add_node_chunks(ct_tree_iter, node_pair.second.buff);
+            }
+        }
+        for (const gint64 node_id : pSyncPending->nodes_to_rm_set) {
+            removed_ids.push_back(node_id);
+            removed_ids.push_back(-node_id);
+        }
+        _chunked_container->append(chunks, removed_ids);
+    }
+    else {
+        std::function<void(CtTreeIter)> add_nodes_chunks;
+        add_nodes_chunks = [&](CtTreeIter ct_tree_iter) {
+            while (ct_tree_iter) {
+                add_node_chunks(ct_tree_iter, true/*with_buffer*/);
+                add_nodes_chunks(ct_tree_iter.first_child());
+                ct_tree_iter++;
+            }
+        };
+        add_nodes_chunks(tree_store.get_ct_iter_first());
+        _chunked_container->write_all(file_path, chunks);
+    }
+}
+
+void CtStorageXml::_read_chunked_records(std::vector<NodeRecord>& node_records, std::vector<gint64>* bookmarks)
 {
-    auto parser = _get_parser(path);
+    const std::vector<gint64> ids = _chunked_container->get_ids();
+    std::vector<std::string> chunks = _chunked_container->read_chunks(ids);
 
-    std::function<void(xmlpp::Element*, const gint64 sequence, Gtk::TreeIter)> recursive_import_func;
-    recursive_import_func = [this, &recursive_import_func](xmlpp::Element* xml_element, const gint64 sequence, Gtk::TreeIter parent_iter) {
-        auto new_iter = _pCtMainWin->get_tree_store().to_ct_tree_iter(_node_from_xml(xml_element, sequence, parent_iter, _pCtMainWin->get_tree_store().node_id_get(), nullptr));
-        new_iter.pending_new_db_node();
+    // the chunks of the properties first, then of the contents
+    std::vector<NodeRecord> chunked_records;
+    std::vector<gint64> parent_ids;
+    std::unordered_map<gint64, size_t> nodes_indexes;
+    for (const bool read_contents : {false, true}) {
+        for (size_t i = 0; i < ids.size(); ++i) {
+            const gint64 chunk_id = ids[i];
+            if ((chunk_id < 0) != read_contents) {
+                continue;
+            }
+            size_t record_index{0};
+            if (read_contents) {
+                auto it = nodes_indexes.find(-chunk_id);
+                if (it == nodes_indexes.end()) {
+                    continue;
+                }
+                record_index = it->second;
+            }
+            // the nodes keep their chunk until their buffers are created
+            auto source = std::make_shared<const CtXmlSource>(std::move(chunks[i]));
+            CtXmlStreamState state;
+            state.data = source->data();
+            state.size = source->size();
+            state.on_node_start = [&](const xmlChar** attributes, const int nb_attributes){
+                if (not read_contents) {
+                    chunked_records.emplace_back();
+                    NodeRecord& node_record = chunked_records.back();
+                    node_data_from_xml_attributes(node_record.node_data, attributes, nb_attributes);
+                    node_record.node_data.sequence = CtStrUtil::gint64_from_gstring(xml_attribute_value(attributes, nb_attributes, "journal_sequence").c_str());
+                    parent_ids.push_back(CtStrUtil::gint64_from_gstring(xml_attribute_value(attributes, nb_attributes, "journal_parent_id").c_str()));
+                    record_index = chunked_records.size() - 1;
+                    nodes_indexes[node_record.node_data.nodeId] = record_index;
+                }
+                return record_index;
+            };
+            state.on_node_range = [&](const size_t record_index, const size_t start, const size_t end){
+                if (read_contents) {
+                    chunked_records[record_index].node_ranges.source = source;
+                    chunked_records[record_index].node_ranges.ranges.emplace_back(start, end);
+                }
+            };
+            state.on_top_element = [&](const xmlChar* localname, const xmlChar** attributes, const int nb_attributes){
+                if (bookmarks and 0 == xmlStrcmp(localname, BAD_CAST "bookmarks")) {
+                    const Glib::ustring bookmarks_csv = xml_attribute_value(attributes, nb_attributes, "list");
+                    *bookmarks = CtStrUtil::gstring_split_to_int64(bookmarks_csv.c_str(), ",");
+                }
+            };
+            if (not xml_stream_parse(state)) {
+                throw std::runtime_error(fmt::format("chunk {}: {}", chunk_id, state.error));
+            }
+        }
+    }
 
-        gint64 child_sequence = 0;
-        for (xmlpp::Node* xml_node : xml_element->get_children("node")) {
-            recursive_import_func(static_cast<xmlpp::Element*>(xml_node), ++child_sequence, new_iter);
+    // the parents before their children, a node whose parent is missing goes to the top level
+    std::vector<std::vector<size_t>> children_indexes(chunked_records.size());
+    std::vector<size_t> top_indexes;
+    for (size_t i = 0; i < chunked_records.size(); ++i) {
+        auto it = nodes_indexes.find(parent_ids[i]);
+        (it == nodes_indexes.end() ? top_indexes : children_indexes[it->second]).push_back(i);
+    }
+    std::vector<bool> visited(chunked_records.size(), false);
+    std::function<void(const std::vector<size_t>&, const int)> add_records;
+    add_records = [&](const std::vector<size_t>& indexes, const int parent_index) {
+        for (const size_t i : indexes) {
+            if (visited[i]) continue;
+            visited[i] = true;
+            node_records.push_back(std::move(chunked_records[i]));
+            node_records.back().parent_index = parent_index;
+            add_records(children_indexes[i], (int)node_records.size() - 1);
         }
     };
+    node_records.clear();
+    node_records.reserve(chunked_records.size());
+    add_records(top_indexes, -1);
+    // nodes in a loop of parents, not to be lost
+    for (size_t i = 0; i < chunked_records.size(); ++i) {
+        if (not visited[i]) {
+            add_records({i}, -1);
+        }
+    }
+}
+
+void CtStorageXml::import_nodes(const fs::path& path, const Gtk::TreeIter& parent_iter)
+{
+    std::vector<NodeRecord> node_records;
+    if (_chunked_container) {
+        _read_chunked_records(node_records, nullptr/*bookmarks*/);
+    }
+    else {
+        _read_node_records(path, node_records, nullptr/*bookmarks*/);
+    }
 
-    gint64 sequence = 0;
-    for (xmlpp::Node* xml_node : parser->get_document()->get_root_node()->get_children("node")) {
-        recursive_import_func(static_cast<xmlpp::Element*>(xml_node), ++sequence, _pCtMainWin->get_tree_store().to_ct_tree_iter(parent_iter));
+    // the parents come before their children, so their rows are already there
+    std::vector<Gtk::TreeIter> nodes_iters(node_records.size());
+    for (size_t i = 0; i < node_records.size(); ++i) {
+        NodeRecord& node_record = node_records[i];
+        CtNodeData& node_data = node_record.node_data;
+        const int parent_index = node_record.parent_index;
+        node_data.nodeId = _pCtMainWin->get_tree_store().node_id_get();
+        // create buffer now because imported document will be closed
+        node_data.rTextBuffer = _create_buffer_from_ranges(node_record.node_ranges, node_data.syntax, node_data.anchoredWidgets);
+        nodes_iters[i] = _pCtMainWin->get_tree_store().append_node(&node_data, parent_index < 0 ? &parent_iter : &nodes_iters[parent_index]);
+        _pCtMainWin->get_tree_store().to_ct_tree_iter(nodes_iters[i]).pending_new_db_node();
     }
 }
 
@@ -173,60 +1102,229 @@ Glib::RefPtr<Gsv::Buffer> CtStorageXml::get_delayed_text_buffer(const gint64& no
                                                                 const std::string& syntax,
                                                                 std::list<CtAnchoredWidget*>& widgets) const
 {
-    if (_delayed_text_buffers.count(node_id) == 0) {
+    auto it = _delayed_text_buffers.find(node_id);
+    if (it == _delayed_text_buffers.end()) {
         spdlog::error(" ! cannot found xml buffer in CtStorageXml::get_delayed_text_buffer, node_id: {}", node_id);
         return Glib::RefPtr<Gsv::Buffer>();
     }
+    // the ranges are kept until the node content is saved, to create the buffer again if released
+    return _create_buffer_from_ranges(it->second, syntax, widgets);
+}
 
-    auto node_buffer = _delayed_text_buffers[node_id];
-    _delayed_text_buffers.erase(node_id);
-    auto xml_element = dynamic_cast<xmlpp::Element*>(node_buffer->get_root_node()->get_first_child());
-    return  CtStorageXmlHelper(_pCtMainWin).create_buffer_and_widgets_from_xml(xml_element, syntax, widgets, nullptr, -1);
+bool CtStorageXml::can_reload_text_buffer(const gint64& node_id) const
+{
+    return _delayed_text_buffers.count(node_id) != 0;
+}
+
+void CtStorageXml::_drop_outdated_ranges(const CtStorageSyncPending& syncPending)
+{
+    for (const auto& node_pair : syncPending.nodes_to_write_dict) {
+        if (node_pair.second.buff) {
+            _delayed_text_buffers.erase(node_pair.first);
+        }
+    }
+    for (const gint64 node_id : syncPending.nodes_to_rm_set) {
+        _delayed_text_buffers.erase(node_id);
+    }
 }
 
-Gtk::TreeIter CtStorageXml::_node_from_xml(xmlpp::Element* xml_element, gint64 sequence, Gtk::TreeIter parent_iter, gint64 new_id, bool* has_duplicated_id)
+bool CtStorageXml::get_stored_node_text(const gint64& node_id, CtStoredNodeText& stored_text) const
 {
-    if (has_duplicated_id) *has_duplicated_id = false;
+    auto it = _delayed_text_buffers.find(node_id);
+    if (it == _delayed_text_buffers.end()) {
+        return false;
+    }
+    return get_stored_text_from_ranges(it->second, stored_text);
+}
 
-    CtNodeData node_data;
-    if (new_id == -1)
-        node_data.nodeId = CtStrUtil::gint64_from_gstring(xml_element->get_attribute_value("unique_id").c_str());
-    else
-        node_data.nodeId = new_id;
-    node_data.name = xml_element->get_attribute_value("name");
-    node_data.syntax = xml_element->get_attribute_value("prog_lang");
-    node_data.tags = xml_element->get_attribute_value("tags");
-    node_data.isRO = CtStrUtil::is_str_true(xml_element->get_attribute_value("readonly"));
-    node_data.customIconId = (guint32)CtStrUtil::gint64_from_gstring(xml_element->get_attribute_value("custom_icon_id").c_str());
-    node_data.isBold = CtStrUtil::is_str_true(xml_element->get_attribute_value("is_bold"));
-    node_data.foregroundRgb24 = xml_element->get_attribute_value("foreground");
-    node_data.tsCreation = CtStrUtil::gint64_from_gstring(xml_element->get_attribute_value("ts_creation").c_str());
-    node_data.tsLastSave = CtStrUtil::gint64_from_gstring(xml_element->get_attribute_value("ts_lastsave").c_str());
-    node_data.sequence = sequence;
-    if (new_id == -1)
+// the reader keeps the document mapped even if the main thread creates the node buffers meanwhile
+class CtStoredTextReaderXml : public CtStoredTextReader
+{
+public:
+    CtStoredTextReaderXml(const std::map<gint64, CtXmlNodeRanges>& nodes_ranges)
+     : _nodes_ranges{nodes_ranges}
+    {}
+
+    bool get_stored_node_text(const gint64& node_id, CtStoredNodeText& stored_text) override
     {
-        if (_delayed_text_buffers.count(node_data.nodeId) != 0) {
-            spdlog::debug("node has duplicated id {}, will be fixed", node_data.nodeId);
-            if (has_duplicated_id) *has_duplicated_id = true;
-            // create buffer now because we cannot put a duplicate id in _delayed_text_buffers
-            // the id will be fixed on top level code
-            node_data.rTextBuffer = CtStorageXmlHelper(_pCtMainWin).create_buffer_and_widgets_from_xml(xml_element, node_data.syntax, node_data.anchoredWidgets, nullptr, -1);
+        auto it = _nodes_ranges.find(node_id);
+        if (it == _nodes_ranges.end()) {
+            return false;
         }
-        else
-        {
-            // because of widgets which are slow to insert for now, delay creating buffers
-            // save node data in a separate document
-            auto node_buffer = std::make_shared<xmlpp::Document>();
-            node_buffer->create_root_node("root")->import_node(xml_element);
-            _delayed_text_buffers[node_data.nodeId] = node_buffer;
+        return get_stored_text_from_ranges(it->second, stored_text);
+    }
+
+    bool get_decoded_node_text(const gint64& node_id, CtDecodedNodeText& decoded_text) override
+    {
+        auto it = _nodes_ranges.find(node_id);
+        if (it == _nodes_ranges.end()) {
+            return false;
         }
+        return get_decoded_text_from_ranges(it->second, decoded_text);
     }
-    else {
-        // create buffer now because imported document will be closed
-        node_data.rTextBuffer = CtStorageXmlHelper(_pCtMainWin).create_buffer_and_widgets_from_xml(xml_element, node_data.syntax, node_data.anchoredWidgets, nullptr, -1);
+
+private:
+    const std::map<gint64, CtXmlNodeRanges> _nodes_ranges;
+};
+
+std::unique_ptr<CtStoredTextReader> CtStorageXml::create_stored_text_reader() const
+{
+    return std::make_unique<CtStoredTextReaderXml>(_delayed_text_buffers);
+}
+
+std::optional<std::unordered_set<gint64>> CtStorageXml::get_nodes_maybe_containing(const Glib::ustring&/*text*/) const
+{
+    // no text index in xml documents
+    return std::nullopt;
+}
+
+bool CtStorageXml::_read_node_records(const fs::path& file_path, std::vector<NodeRecord>& node_records, std::vector<gint64>* bookmarks)
+{
+    // the nodes keep the document mapped until their buffers are created
+    GError* pError{nullptr};
+    GMappedFile* pMappedFile = g_mapped_file_new(file_path.c_str(), FALSE/*writable*/, &pError);
+    if (not pMappedFile) {
+        const std::string error_msg = pError ? pError->message : "cannot map file";
+        if (pError) g_error_free(pError);
+        throw std::runtime_error(error_msg);
+    }
+    return _read_node_records(std::make_shared<const CtXmlSource>(pMappedFile), file_path.string(), node_records, bookmarks);
+}
+
+bool CtStorageXml::_read_node_records(std::shared_ptr<const CtXmlSource> source,
+                                      const std::string& source_name,
+                                      std::vector<NodeRecord>& node_records,
+                                      std::vector<gint64>* bookmarks)
+{
+    auto read_from_source = [&](std::shared_ptr<const CtXmlSource> source, std::string& error){
+        node_records.clear();
+        if (bookmarks) bookmarks->clear();
+        CtXmlStreamState state;
+        state.data = source->data();
+        state.size = source->size();
+        state.on_node_start = [&](const xmlChar** attributes, const int nb_attributes){
+            node_records.emplace_back();
+            NodeRecord& node_record = node_records.back();
+            node_record.parent_index = state.open_nodes.empty() ? -1 : (int)state.open_nodes.back().record_index;
+            node_record.node_ranges.source = source;
+            node_data_from_xml_attributes(node_record.node_data, attributes, nb_attributes);
+            return node_records.size() - 1;
+        };
+        state.on_node_range = [&](const size_t record_index, const size_t start, const size_t end){
+            node_records[record_index].node_ranges.ranges.emplace_back(start, end);
+        };
+        state.on_top_element = [&](const xmlChar* localname, const xmlChar** attributes, const int nb_attributes){
+            if (bookmarks and 0 == xmlStrcmp(localname, BAD_CAST "bookmarks")) {
+                const Glib::ustring bookmarks_csv = xml_attribute_value(attributes, nb_attributes, "list");
+                for (const gint64 nodeId : CtStrUtil::gstring_split_to_int64(bookmarks_csv.c_str(), ",")) {
+                    bookmarks->push_back(nodeId);
+                }
+            }
+        };
+        const bool parseOk = state.size > 0 and xml_stream_parse(state);
+        if (not parseOk) {
+            error = state.error.empty() ? "xml parse fail" : state.error;
+            return false;
+        }
+        // the sequence of each node among its siblings
+        std::vector<gint64> children_num(node_records.size(), 0);
+        gint64 top_sequence = 0;
+        for (NodeRecord& node_record : node_records) {
+            const int parent_index = node_record.parent_index;
+            node_record.node_data.sequence = parent_index < 0 ? ++top_sequence : ++children_num[parent_index];
+        }
+        return true;
+    };
+
+    std::string codeset = xml_declared_encoding(source->data(), source->size());
+    std::string error;
+    if (not codeset.empty() and CtStrUtil::is_codeset_not_utf8(codeset)) {
+        error = "declared encoding " + codeset;
+    }
+    else if (read_from_source(source, error)) {
+        return true;
+    }
+    spdlog::error("{} {} {}", __FUNCTION__, source_name, error);
+
+    // fallback on a copy converted to UTF-8, sanitised if still not parsed
+    std::string buffer{source->data(), source->size()};
+    source.reset();
+    if (codeset.empty() or not CtStrUtil::is_codeset_not_utf8(codeset)) {
+        codeset = CtStrUtil::get_encoding(buffer.c_str(), buffer.size());
+    }
+    if (CtStrUtil::is_codeset_not_utf8(codeset)) {
+        buffer = Glib::convert_with_fallback(buffer, "UTF-8", codeset);
+    }
+    if (read_from_source(std::make_shared<const CtXmlSource>(buffer), error)) {
+        return false;
+    }
+    spdlog::error("{} {}", __FUNCTION__, error);
+    if (read_from_source(std::make_shared<const CtXmlSource>(str::sanitize_bad_symbols(buffer).raw()), error)) {
+        spdlog::info("{} xml sanitised", __FUNCTION__);
+        return false;
+    }
+    throw std::runtime_error(error);
+}
+
+namespace {
+
+// a document with the node element and its slots only
+std::unique_ptr<xmlpp::DomParser> parse_node_ranges(const CtXmlNodeRanges& node_ranges)
+{
+    std::string xml_content{"<node>"};
+    for (const auto& range : node_ranges.ranges) {
+        xml_content.append(node_ranges.source->data() + range.first, range.second - range.first);
+    }
+    xml_content += "</node>";
+    auto parser = std::make_unique<xmlpp::DomParser>();
+    parser->set_parser_options(xmlParserOption::XML_PARSE_HUGE);
+    parser->parse_memory_raw(reinterpret_cast<const unsigned char*>(xml_content.data()), xml_content.size());
+    if (not parser->get_document() or not parser->get_document()->get_root_node()) {
+        throw std::runtime_error("document is null");
     }
+    return parser;
+}
 
-    return _pCtMainWin->get_tree_store().append_node(&node_data, &parent_iter);
+bool get_stored_text_from_ranges(const CtXmlNodeRanges& node_ranges, CtStoredNodeText& stored_text)
+{
+    try {
+        auto parser = parse_node_ranges(node_ranges);
+        CtStorageXmlHelper::get_stored_text_from_xml(parser->get_document()->get_root_node(), stored_text);
+        return true;
+    }
+    catch (std::exception& e) {
+        spdlog::error("{} {}", __FUNCTION__, e.what());
+        return false;
+    }
+}
+
+bool get_decoded_text_from_ranges(const CtXmlNodeRanges& node_ranges, CtDecodedNodeText& decoded_text)
+{
+    try {
+        auto parser = parse_node_ranges(node_ranges);
+        CtStorageXmlHelper::get_decoded_text_from_xml(parser->get_document()->get_root_node(), decoded_text);
+        return true;
+    }
+    catch (std::exception& e) {
+        spdlog::error("{} {}", __FUNCTION__, e.what());
+        return false;
+    }
+}
+
+} // namespace
+
+Glib::RefPtr<Gsv::Buffer> CtStorageXml::_create_buffer_from_ranges(const CtXmlNodeRanges& node_ranges,
+                                                                   const std::string& syntax,
+                                                                   std::list<CtAnchoredWidget*>& widgets) const
+{
+    try {
+        auto parser = parse_node_ranges(node_ranges);
+        return CtStorageXmlHelper(_pCtMainWin).create_buffer_and_widgets_from_xml(parser->get_document()->get_root_node(), syntax, widgets, nullptr, -1);
+    }
+    catch (std::exception& e) {
+        spdlog::error("{} {}", __FUNCTION__, e.what());
+        return _pCtMainWin->get_new_text_buffer();
+    }
 }
 
 void CtStorageXml::_nodes_to_xml(CtTreeIter* ct_tree_iter,
@@ -255,38 +1353,6 @@ void CtStorageXml::_nodes_to_xml(CtTreeIter* ct_tree_iter,
     }
 }
 
-std::unique_ptr<xmlpp::DomParser> CtStorageXml::_get_parser(const fs::path& file_path)
-{
-    // open file
-    auto parser = std::make_unique<xmlpp::DomParser>();
-    bool parseOk{true};
-    try {
-        parser->set_parser_options(xmlParserOption::XML_PARSE_HUGE);
-        parser->parse_file(file_path.string());
-    }
-    catch (xmlpp::exception& e) {
-        spdlog::error("{} {} {}", __FUNCTION__, file_path.string(), e.what());
-
-        std::string buffer = Glib::file_get_contents(file_path.string());
-        const std::string codeset = CtStrUtil::get_encoding(buffer.c_str(), buffer.size());
-        if (CtStrUtil::is_codeset_not_utf8(codeset)) {
-            buffer = Glib::convert_with_fallback(buffer, "UTF-8", codeset);
-        }
-        parseOk = CtXmlHelper::safe_parse_memory(*parser, buffer);
-    }
-
-    if (not parseOk) {
-        throw std::runtime_error("xml parse fail");
-    }
-    if (not parser->get_document()) {
-        throw std::runtime_error("document is null");
-    }
-    if (parser->get_document()->get_root_node()->get_name() != CtConst::APP_NAME) {
-        throw std::runtime_error("document contains the wrong node root");
-    }
-    return parser;
-}
-
 
 CtStorageXmlHelper::CtStorageXmlHelper(CtMainWin* pCtMainWin) : _pCtMainWin(pCtMainWin)
 {
@@ -300,16 +1366,7 @@ xmlpp::Element* CtStorageXmlHelper::node_to_xml(CtTreeIter* ct_tree_iter,
                                                 const int end_offset/*=-1*/)
 {
     xmlpp::Element* p_node_node = p_node_parent->add_child("node");
-    p_node_node->set_attribute("name", ct_tree_iter->get_node_name());
-    p_node_node->set_attribute("unique_id", std::to_string(ct_tree_iter->get_node_id()));
-    p_node_node->set_attribute("prog_lang", ct_tree_iter->get_node_syntax_highlighting());
-    p_node_node->set_attribute("tags", ct_tree_iter->get_node_tags());
-    p_node_node->set_attribute("readonly", std::to_string(ct_tree_iter->get_node_read_only()));
-    p_node_node->set_attribute("custom_icon_id", std::to_string(ct_tree_iter->get_node_custom_icon_id()));
-    p_node_node->set_attribute("is_bold", std::to_string(ct_tree_iter->get_node_is_bold()));
-    p_node_node->set_attribute("foreground", ct_tree_iter->get_node_foreground());
-    p_node_node->set_attribute("ts_creation", std::to_string(ct_tree_iter->get_node_creating_time()));
-    p_node_node->set_attribute("ts_lastsave", std::to_string(ct_tree_iter->get_node_modification_time()));
+    node_properties_to_xml(ct_tree_iter, p_node_node);
 
     Glib::RefPtr<Gsv::Buffer> buffer = ct_tree_iter->get_node_text_buffer();
     save_buffer_no_widgets_to_xml(p_node_node, buffer, start_offset, end_offset, 'n');
@@ -322,6 +1379,20 @@ xmlpp::Element* CtStorageXmlHelper::node_to_xml(CtTreeIter* ct_tree_iter,
     return p_node_node;
 }
 
+void CtStorageXmlHelper::node_properties_to_xml(CtTreeIter* ct_tree_iter, xmlpp::Element* p_node_node)
+{
+    p_node_node->set_attribute("name", ct_tree_iter->get_node_name());
+    p_node_node->set_attribute("unique_id", std::to_string(ct_tree_iter->get_node_id()));
+    p_node_node->set_attribute("prog_lang", ct_tree_iter->get_node_syntax_highlighting());
+    p_node_node->set_attribute("tags", ct_tree_iter->get_node_tags());
+    p_node_node->set_attribute("readonly", std::to_string(ct_tree_iter->get_node_read_only()));
+    p_node_node->set_attribute("custom_icon_id", std::to_string(ct_tree_iter->get_node_custom_icon_id()));
+    p_node_node->set_attribute("is_bold", std::to_string(ct_tree_iter->get_node_is_bold()));
+    p_node_node->set_attribute("foreground", ct_tree_iter->get_node_foreground());
+    p_node_node->set_attribute("ts_creation", std::to_string(ct_tree_iter->get_node_creating_time()));
+    p_node_node->set_attribute("ts_lastsave", std::to_string(ct_tree_iter->get_node_modification_time()));
+}
+
 Glib::RefPtr<Gsv::Buffer> CtStorageXmlHelper::create_buffer_and_widgets_from_xml(xmlpp::Element* parent_xml_element, const Glib::ustring& /*syntax*/,
                                                                     std::list<CtAnchoredWidget*>& widgets, Gtk::TextIter* text_insert_pos, int force_offset)
 {
@@ -353,7 +1424,11 @@ void CtStorageXmlHelper::get_text_buffer_one_slot_from_xml(Glib::RefPtr<Gsv::Buf
     }
     else if (slot_type != SlotType::None)
     {
-        const int char_offset = force_offset != -1 ? force_offset : std::stoi(slot_element->get_attribute_value("char_offset"));
+        const int char_offset = force_offset != -1 ? force_offset : get_attribute_int(slot_element, "char_offset", -1);
+        if (char_offset < 0) {
+            spdlog::warn("{} skipped {} without char_offset", __FUNCTION__, slot_element_name.raw());
+            return;
+        }
         Glib::ustring justification = slot_element->get_attribute_value(CtConst::TAG_JUSTIFICATION);
         if (justification.empty()) justification = CtConst::TAG_PROP_VAL_LEFT;
 
@@ -393,18 +1468,21 @@ bool CtStorageXmlHelper::populate_table_matrix(CtTableMatrix& tableMatrix,
 
 void CtStorageXmlHelper::populate_table_matrix(CtTableMatrix& tableMatrix, xmlpp::Element* xml_element, CtTableColWidths& tableColWidths)
 {
+    std::vector<std::vector<Glib::ustring>> rows;
     for (xmlpp::Node* pNodeRow : xml_element->get_children("row"))
     {
-        tableMatrix.push_back(CtTableRow{});
+        rows.push_back(std::vector<Glib::ustring>{});
         for (xmlpp::Node* pNodeCell : pNodeRow->get_children("cell"))
         {
             xmlpp::TextNode* pTextNode = static_cast<xmlpp::Element*>(pNodeCell)->get_child_text();
-            const Glib::ustring textContent = pTextNode ? pTextNode->get_content() : "";
-            tableMatrix.back().push_back(new CtTextCell{_pCtMainWin, textContent, CtConst::TABLE_CELL_TEXT_ID});
+            rows.back().push_back(pTextNode ? pTextNode->get_content() : "");
         }
     }
-    tableMatrix.insert(tableMatrix.begin(), tableMatrix.back());
-    tableMatrix.pop_back();
+    if (not rows.empty()) {
+        // the header is the last row
+        std::rotate(rows.begin(), rows.end() - 1, rows.end());
+    }
+    tableMatrix = CtTableMatrix{rows};
     auto colWidthsStr = xml_element->get_attribute_value("col_widths");
     if (not colWidthsStr.empty()) {
         tableColWidths = CtStrUtil::gstring_split_to_int(colWidthsStr.c_str(), ",");
@@ -439,6 +1517,275 @@ void CtStorageXmlHelper::populate_table_matrix(CtTableMatrix& tableMatrix, xmlpp
     CtTextIterUtil::generic_process_slot(start_offset, end_offset, rBuffer, rich_txt_serialize);
 }
 
+/*static*/ void CtStorageXmlHelper::get_stored_text_from_xml(xmlpp::Element* parent_xml_element, CtStoredNodeText& stored_text)
+{
+    for (xmlpp::Node* xml_slot : parent_xml_element->get_children()) {
+        auto slot_element = dynamic_cast<xmlpp::Element*>(xml_slot);
+        if (!slot_element) continue;
+        const Glib::ustring slot_element_name = slot_element->get_name();
+        if (slot_element_name == "rich_text") {
+            if (xmlpp::TextNode* pTextNode = slot_element->get_child_text()) {
+                stored_text.text += pTextNode->get_content();
+            }
+            continue;
+        }
+        CtStoredNodeText::Widget widget;
+        if (slot_element_name == "encoded_png") {
+            const Glib::ustring anchorName = slot_element->get_attribute_value("anchor");
+            const Glib::ustring fileName = slot_element->get_attribute_value("filename");
+            if (!anchorName.empty()) {
+                widget.type = CtAnchWidgType::ImageAnchor;
+                widget.texts.push_back(anchorName);
+            }
+            else if (!fileName.empty()) {
+                widget.type = CtAnchWidgType::ImageEmbFile;
+                widget.texts.push_back(fileName);
+            }
+            else {
+                widget.type = CtAnchWidgType::ImagePng;
+            }
+        }
+        else if (slot_element_name == "table") {
+            widget.type = CtAnchWidgType::Table;
+            widget.texts = get_table_cells_text_from_xml(slot_element);
+        }
+        else if (slot_element_name == "codebox") {
+            widget.type = CtAnchWidgType::CodeBox;
+            xmlpp::TextNode* pTextNode = slot_element->get_child_text();
+            widget.texts.push_back(pTextNode ? pTextNode->get_content() : "");
+        }
+        else {
+            continue;
+        }
+        widget.offset = get_attribute_int(slot_element, "char_offset", -1);
+        if (widget.offset < 0) {
+            spdlog::warn("{} skipped {} without char_offset", __FUNCTION__, slot_element_name.raw());
+            continue;
+        }
+        stored_text.widgets.push_back(std::move(widget));
+    }
+    std::stable_sort(stored_text.widgets.begin(), stored_text.widgets.end(), [](const auto& w1, const auto& w2){
+        return w1.offset < w2.offset;
+    });
+}
+
+/*static*/ std::vector<std::string> CtStorageXmlHelper::get_table_cells_text_from_xml(xmlpp::Element* table_xml_element)
+{
+    std::vector<std::string> cells_text;
+    for (xmlpp::Node* pNodeRow : table_xml_element->get_children("row")) {
+        for (xmlpp::Node* pNodeCell : pNodeRow->get_children("cell")) {
+            xmlpp::TextNode* pTextNode = static_cast<xmlpp::Element*>(pNodeCell)->get_child_text();
+            cells_text.push_back(pTextNode ? pTextNode->get_content() : "");
+        }
+    }
+    return cells_text;
+}
+
+/*static*/ void CtStorageXmlHelper::get_decoded_text_from_xml(xmlpp::Element* parent_xml_element, CtDecodedNodeText& decoded_text)
+{
+    for (xmlpp::Node* xml_slot : parent_xml_element->get_children()) {
+        auto slot_element = dynamic_cast<xmlpp::Element*>(xml_slot);
+        if (!slot_element) continue;
+        const Glib::ustring slot_element_name = slot_element->get_name();
+        if (slot_element_name == "rich_text") {
+            xmlpp::TextNode* pTextNode = slot_element->get_child_text();
+            if (!pTextNode) continue;
+            CtDecodedNodeText::TextRun run;
+            run.text = pTextNode->get_content();
+            if (run.text.empty()) continue;
+            for (const xmlpp::Attribute* pAttribute : slot_element->get_attributes()) {
+                if (CtStrUtil::contains(CtConst::TAG_PROPERTIES, pAttribute->get_name().c_str())) {
+                    run.tag_props.emplace_back(pAttribute->get_name(), pAttribute->get_value());
+                }
+            }
+            decoded_text.runs.push_back(std::move(run));
+            continue;
+        }
+        CtDecodedNodeText::Widget widget;
+        if (slot_element_name == "encoded_png") {
+            const Glib::ustring anchorName = slot_element->get_attribute_value("anchor");
+            if (!anchorName.empty()) {
+                widget.type = CtAnchWidgType::ImageAnchor;
+                widget.text = anchorName;
+            }
+            else {
+                xmlpp::TextNode* pTextNode = slot_element->get_child_text();
+                widget.raw_blob = Glib::Base64::decode(pTextNode ? pTextNode->get_content() : "");
+                widget.text = slot_element->get_attribute_value("filename");
+                if (!widget.text.empty()) {
+                    widget.type = CtAnchWidgType::ImageEmbFile;
+                    const Glib::ustring timeStr = slot_element->get_attribute_value("time");
+                    widget.time = static_cast<time_t>(g_ascii_strtod(timeStr.c_str(), nullptr));
+                }
+                else {
+                    widget.type = CtAnchWidgType::ImagePng;
+                    widget.link = slot_element->get_attribute_value("link");
+                    if (decoded_text.with_pixbufs) {
+                        widget.pixbuf = CtImage::decode_pixbuf(widget.raw_blob, "image/png");
+                    }
+                }
+            }
+        }
+        else if (slot_element_name == "table") {
+            widget.type = CtAnchWidgType::Table;
+            widget.col_width_default = get_attribute_int(slot_element, "col_max", 60/*config default*/);
+            get_decoded_table_from_xml(slot_element, widget);
+        }
+        else if (slot_element_name == "codebox") {
+            widget.type = CtAnchWidgType::CodeBox;
+            xmlpp::TextNode* pTextNode = slot_element->get_child_text();
+            widget.text = pTextNode ? pTextNode->get_content() : "";
+            widget.syntax = slot_element->get_attribute_value("syntax_highlighting");
+            widget.frame_width = get_attribute_int(slot_element, "frame_width", 500/*config default*/);
+            widget.frame_height = get_attribute_int(slot_element, "frame_height", 100/*config default*/);
+            widget.width_in_pixels = CtStrUtil::is_str_true(slot_element->get_attribute_value("width_in_pixels"));
+            widget.highlight_brackets = CtStrUtil::is_str_true(slot_element->get_attribute_value("highlight_brackets"));
+            widget.show_line_numbers = CtStrUtil::is_str_true(slot_element->get_attribute_value("show_line_numbers"));
+        }
+        else {
+            continue;
+        }
+        widget.offset = get_attribute_int(slot_element, "char_offset", -1);
+        if (widget.offset < 0) {
+            spdlog::warn("{} skipped {} without char_offset", __FUNCTION__, slot_element_name.raw());
+            continue;
+        }
+        widget.justification = slot_element->get_attribute_value(CtConst::TAG_JUSTIFICATION);
+        if (widget.justification.empty()) widget.justification = CtConst::TAG_PROP_VAL_LEFT;
+        decoded_text.widgets.push_back(std::move(widget));
+    }
+    std::stable_sort(decoded_text.widgets.begin(), decoded_text.widgets.end(), [](const auto& w1, const auto& w2){
+        return w1.offset < w2.offset;
+    });
+}
+
+/*static*/ void CtStorageXmlHelper::get_decoded_table_from_xml(xmlpp::Element* table_xml_element, CtDecodedNodeText::Widget& widget)
+{
+    for (xmlpp::Node* pNodeRow : table_xml_element->get_children("row")) {
+        widget.table_rows.emplace_back();
+        for (xmlpp::Node* pNodeCell : pNodeRow->get_children("cell")) {
+            xmlpp::TextNode* pTextNode = static_cast<xmlpp::Element*>(pNodeCell)->get_child_text();
+            widget.table_rows.back().push_back(pTextNode ? pTextNode->get_content() : "");
+        }
+    }
+    if (not widget.table_rows.empty()) {
+        std::rotate(widget.table_rows.begin(), widget.table_rows.end() - 1, widget.table_rows.end());
+    }
+    const Glib::ustring colWidthsStr = table_xml_element->get_attribute_value("col_widths");
+    if (not colWidthsStr.empty()) {
+        widget.col_widths = CtStrUtil::gstring_split_to_int(colWidthsStr.c_str(), ",");
+    }
+}
+
+/*static*/ void CtStorageXmlHelper::decoded_text_to_xml(xmlpp::Element* p_node_parent, const CtDecodedNodeText& decoded_text, const bool with_widgets)
+{
+    for (const CtDecodedNodeText::TextRun& run : decoded_text.runs) {
+        xmlpp::Element* p_rich_text_node = p_node_parent->add_child("rich_text");
+        for (const auto& tag_prop : run.tag_props) {
+            p_rich_text_node->set_attribute(tag_prop.first, tag_prop.second);
+        }
+        p_rich_text_node->add_child_text(run.text);
+    }
+    if (not with_widgets) {
+        return;
+    }
+    for (const CtDecodedNodeText::Widget& widget : decoded_text.widgets) {
+        if (CtAnchWidgType::Table == widget.type) {
+            CtXmlHelper::table_to_xml(p_node_parent, CtTableMatrix{widget.table_rows}, widget.offset, widget.justification,
+                                      widget.col_width_default, str::join_numbers(widget.col_widths, ","));
+            continue;
+        }
+        if (CtAnchWidgType::CodeBox == widget.type) {
+            xmlpp::Element* p_codebox_node = p_node_parent->add_child("codebox");
+            p_codebox_node->set_attribute("char_offset", std::to_string(widget.offset));
+            p_codebox_node->set_attribute(CtConst::TAG_JUSTIFICATION, widget.justification);
+            p_codebox_node->set_attribute("frame_width", std::to_string(widget.frame_width));
+            p_codebox_node->set_attribute("frame_height", std::to_string(widget.frame_height));
+            p_codebox_node->set_attribute("width_in_pixels", std::to_string(widget.width_in_pixels));
+            p_codebox_node->set_attribute("syntax_highlighting", widget.syntax);
+            p_codebox_node->set_attribute("highlight_brackets", std::to_string(widget.highlight_brackets));
+            p_codebox_node->set_attribute("show_line_numbers", std::to_string(widget.show_line_numbers));
+            p_codebox_node->add_child_text(widget.text);
+            continue;
+        }
+        xmlpp::Element* p_image_node = p_node_parent->add_child("encoded_png");
+        p_image_node->set_attribute("char_offset", std::to_string(widget.offset));
+        p_image_node->set_attribute(CtConst::TAG_JUSTIFICATION, widget.justification);
+        if (CtAnchWidgType::ImageAnchor == widget.type) {
+            p_image_node->set_attribute("anchor", widget.text);
+            continue;
+        }
+        if (CtAnchWidgType::ImageEmbFile == widget.type) {
+            p_image_node->set_attribute("filename", widget.text);
+            p_image_node->set_attribute("time", std::to_string(widget.time));
+        }
+        else {
+            p_image_node->set_attribute("link", widget.link);
+        }
+        p_image_node->add_child_text(Glib::Base64::encode(widget.raw_blob));
+    }
+}
+
+Glib::RefPtr<Gsv::Buffer> CtStorageXmlHelper::create_buffer_and_widgets_from_decoded(const CtDecodedNodeText& decoded_text,
+                                                                                     std::list<CtAnchoredWidget*>& widgets)
+{
+    Glib::RefPtr<Gsv::Buffer> buffer = _pCtMainWin->get_new_text_buffer();
+    buffer->begin_not_undoable_action();
+    for (const CtDecodedNodeText::TextRun& run : decoded_text.runs) {
+        std::vector<Glib::ustring> tags;
+        for (const auto& tag_prop : run.tag_props) {
+            tags.push_back(_pCtMainWin->get_text_tag_name_exist_or_create(tag_prop.first, tag_prop.second));
+        }
+        if (tags.size() > 0)
+            buffer->insert_with_tags_by_name(buffer->end(), run.text, tags);
+        else
+            buffer->insert(buffer->end(), run.text);
+    }
+    for (const CtDecodedNodeText::Widget& decoded_widget : decoded_text.widgets) {
+        CtAnchoredWidget* widget{nullptr};
+        switch (decoded_widget.type) {
+            case CtAnchWidgType::ImageAnchor: {
+                widget = new CtImageAnchor(_pCtMainWin, decoded_widget.text, decoded_widget.offset, decoded_widget.justification);
+            } break;
+            case CtAnchWidgType::ImageEmbFile: {
+                widget = new CtImageEmbFile(_pCtMainWin, fs::path{decoded_widget.text.raw()}, decoded_widget.raw_blob, decoded_widget.time,
+                                            decoded_widget.offset, decoded_widget.justification, CtImageEmbFile::get_next_unique_id());
+            } break;
+            case CtAnchWidgType::ImagePng: {
+                // the pixbuf is missing if the bytes could not be decoded, the constructor raises the error then
+                auto pImagePng = decoded_widget.pixbuf ?
+                    new CtImagePng(_pCtMainWin, decoded_widget.raw_blob, decoded_widget.pixbuf, decoded_widget.link, decoded_widget.offset, decoded_widget.justification) :
+                    new CtImagePng(_pCtMainWin, decoded_widget.raw_blob, decoded_widget.link, decoded_widget.offset, decoded_widget.justification);
+                if (decoded_text.is_sqlite_rows) {
+                    pImagePng->set_sqlite_row_stored(decoded_widget.offset);
+                }
+                widget = pImagePng;
+            } break;
+            case CtAnchWidgType::CodeBox: {
+                widget = new CtCodebox(_pCtMainWin,
+                                       decoded_widget.text,
+                                       decoded_widget.syntax,
+                                       decoded_widget.frame_width,
+                                       decoded_widget.frame_height,
+                                       decoded_widget.offset,
+                                       decoded_widget.justification,
+                                       decoded_widget.width_in_pixels,
+                                       decoded_widget.highlight_brackets,
+                                       decoded_widget.show_line_numbers);
+            } break;
+            case CtAnchWidgType::Table: {
+                widget = new CtTable(_pCtMainWin, CtTableMatrix{decoded_widget.table_rows}, decoded_widget.col_width_default, decoded_widget.offset,
+                                     decoded_widget.justification, decoded_widget.col_widths);
+            } break;
+        }
+        widget->insertInTextBuffer(buffer);
+        widgets.push_back(widget);
+    }
+    buffer->end_not_undoable_action();
+    buffer->set_modified(false);
+    return buffer;
+}
+
 void CtStorageXmlHelper::_add_rich_text_from_xml(Glib::RefPtr<Gsv::Buffer> buffer, xmlpp::Element* xml_element, Gtk::TextIter* text_insert_pos)
 {
     xmlpp::TextNode* text_node = xml_element->get_child_text();
@@ -521,7 +1868,7 @@ CtAnchoredWidget* CtStorageXmlHelper::_create_table_from_xml(xmlpp::Element* xml
 }
 
 void CtXmlHelper::table_to_xml(xmlpp::Element* p_parent,
-                               const std::vector<std::vector<Glib::ustring>>& rows,
+                               const CtTableMatrix& tableMatrix,
                                int char_offset,
                                Glib::ustring justification,
                                int defaultWidth,
@@ -534,22 +1881,21 @@ void CtXmlHelper::table_to_xml(xmlpp::Element* p_parent,
     p_table_node->set_attribute("col_max", std::to_string(defaultWidth));
     p_table_node->set_attribute("col_widths", colWidths);
 
-    auto row_to_xml = [&](const std::vector<Glib::ustring>& tableRow) {
+    auto row_to_xml = [&](const size_t rowIdx) {
         xmlpp::Element* row_element = p_table_node->add_child("row");
-        for (const auto& cell : tableRow) {
+        for (size_t colIdx = 0; colIdx < tableMatrix.get_cols_num(); ++colIdx) {
             xmlpp::Element* cell_element = row_element->add_child("cell");
-            cell_element->set_child_text(cell);
+            cell_element->set_child_text(tableMatrix.get_cell(rowIdx, colIdx));
         }
     };
 
     // put header at the end
-    bool is_header = true;
-    for (auto& row: rows)
-    {
-        if (is_header) { is_header = false; }
-        else row_to_xml(row);
+    for (size_t rowIdx = 1; rowIdx < tableMatrix.get_rows_num(); ++rowIdx) {
+        row_to_xml(rowIdx);
+    }
+    if (tableMatrix.get_rows_num()) {
+        row_to_xml(0);
     }
-    row_to_xml(rows[0]);
 }
 
 bool CtXmlHelper::safe_parse_memory(xmlpp::DomParser& parser, const Glib::ustring& xml_content)
@@ -39,43 +39,139 @@ class CtAnchoredWidget;
 class CtMainWin;
 class CtTreeIter;
 class CtStorageCache;
+class CtXmlSource;
+class CtChunkedContainer;
+struct CtDocNodes;
+
+/**
+ * @brief Byte ranges of the slots of a node (rich_text, encoded_png, table, codebox) in a .ctd document,
+ * its children nodes excluded, parsed only when the node buffer is requested
+ */
+struct CtXmlNodeRanges
+{
+    std::shared_ptr<const CtXmlSource>     source;
+    std::vector<std::pair<size_t, size_t>> ranges; // start, end
+};
 
 class CtStorageXml : public CtStorageEntity
 {
 public:
-    CtStorageXml(CtMainWin* pCtMainWin);
-    ~CtStorageXml() = default;
+    CtStorageXml(CtMainWin* pCtMainWin, const bool journal_allowed = false);
+    ~CtStorageXml();
+
+    static const char JOURNAL_EXT[];
+    static const char JOURNAL_RECORD_TAG[];
+    static fs::path get_journal_path(const fs::path& file_path);
+
+    /**
+     * @brief Opens a protected document of chunks, populate_treestore reads it and save_treestore appends the changes
+     * @return false if the password is wrong
+     */
+    bool open_chunked(const fs::path& file_path, const Glib::ustring& password);
+    /**
+     * @brief The next save_treestore writes a new protected document of chunks
+     */
+    void create_chunked(const Glib::ustring& password);
 
     void close_connect() override;
     void reopen_connect() override;
     void test_connection() override;
 
     bool populate_treestore(const fs::path& file_path, Glib::ustring& error) override;
+    bool populate_treestore_from_memory(std::string&& data, Glib::ustring& error) override;
+    /**
+     * @brief Reads the nodes properties and hierarchy without a tree store, the content of the nodes
+     * is then read by the stored text readers (headless export and conversion)
+     */
+    bool populate_doc_nodes(const fs::path& file_path, CtDocNodes& doc_nodes, Glib::ustring& error);
+    bool populate_doc_nodes_from_memory(std::string&& data, CtDocNodes& doc_nodes, Glib::ustring& error);
+    bool can_work_in_memory() const override { return true; }
+    bool get_memory_data(std::string& data, Glib::ustring& error) override;
+    /**
+     * @brief Writes the document to file_path, or in memory if file_path is empty
+     */
     bool save_treestore(const fs::path& file_path,
                         const CtStorageSyncPending& syncPending,
                         Glib::ustring& error,
                         const CtExporting exporting = CtExporting::NONE,
                         const int start_offset = 0,
                         const int end_offset = -1) override;
+    /**
+     * @brief Merges the journal into the document, or drops the chunks replaced since the document was written
+     */
     void vacuum() override;
+    bool is_journal_save(const fs::path& file_path, const CtStorageSyncPending& syncPending) const override;
     void import_nodes(const fs::path& path, const Gtk::TreeIter& parent_iter) override;
 
     Glib::RefPtr<Gsv::Buffer> get_delayed_text_buffer(const gint64& node_id,
                                                       const std::string& syntax,
                                                       std::list<CtAnchoredWidget*>& widgets) const override;
+    bool can_reload_text_buffer(const gint64& node_id) const override;
+    std::optional<std::unordered_set<gint64>> get_nodes_maybe_containing(const Glib::ustring& text) const override;
+    bool get_stored_node_text(const gint64& node_id, CtStoredNodeText& stored_text) const override;
+    std::unique_ptr<CtStoredTextReader> create_stored_text_reader() const override;
 private:
-    Gtk::TreeIter _node_from_xml(xmlpp::Element* xml_element, gint64 sequence, Gtk::TreeIter parent_iter, gint64 new_id, bool* has_duplicated_id);
+    struct NodeRecord;
+    /**
+     * @brief Reads the nodes properties and the bookmarks in one pass, the parents before their children
+     * @return false if the document had to be converted or sanitised to be read
+     */
+    bool _read_node_records(const fs::path& file_path, std::vector<NodeRecord>& node_records, std::vector<gint64>* bookmarks);
+    bool _read_node_records(std::shared_ptr<const CtXmlSource> source,
+                            const std::string& source_name,
+                            std::vector<NodeRecord>& node_records,
+                            std::vector<gint64>* bookmarks);
+    /**
+     * @brief Appends the records to the tree store, their buffers are created on demand
+     * @return false if some nodes had a duplicated id, so got a new one
+     */
+    bool _populate_from_records(std::vector<NodeRecord>& node_records, const std::vector<gint64>& bookmarks);
+    void _doc_nodes_from_records(std::vector<NodeRecord>& node_records, const std::vector<gint64>& bookmarks, CtDocNodes& doc_nodes);
+    static void _records_by_sequence(const std::vector<NodeRecord>& node_records,
+                                     std::vector<size_t>& top_indexes,
+                                     std::vector<std::vector<size_t>>& children_indexes);
+    /**
+     * @brief Applies to the records of the document the saves appended to its journal
+     * @return false if the journal is missing or could not be entirely replayed
+     */
+    bool _replay_journal(const fs::path& file_path, std::vector<NodeRecord>& node_records, std::vector<gint64>& bookmarks);
+    void _append_journal(const CtStorageSyncPending& syncPending);
+    /**
+     * @brief Reads the records of the nodes in the chunks, the parents before their children
+     */
+    void _read_chunked_records(std::vector<NodeRecord>& node_records, std::vector<gint64>* bookmarks);
+    /**
+     * @brief Appends to the chunks the changes in syncPending, or writes all the chunks at file_path if none
+     */
+    void _write_chunked(const fs::path& file_path, const CtStorageSyncPending* pSyncPending);
+    /**
+     * @brief Forgets the ranges of the nodes whose content was just saved, no longer the one of their buffers
+     */
+    void _drop_outdated_ranges(const CtStorageSyncPending& syncPending);
+    void _write_document(const fs::path& file_path,
+                         const CtExporting exporting,
+                         const int start_offset,
+                         const int end_offset);
+    Glib::RefPtr<Gsv::Buffer> _create_buffer_from_ranges(const CtXmlNodeRanges& node_ranges,
+                                                         const std::string& syntax,
+                                                         std::list<CtAnchoredWidget*>& widgets) const;
     void _nodes_to_xml(CtTreeIter* ct_tree_iter,
                        xmlpp::Element* p_node_parent,
                        CtStorageCache* storage_cache,
                        const CtExporting exporting = CtExporting::NONE,
                        const int start_offset = 0,
                        const int end_offset =-1);
-    std::unique_ptr<xmlpp::DomParser> _get_parser(const fs::path& file_path);
 
 private:
     CtMainWin* _pCtMainWin{nullptr};
-    mutable std::map<gint64, std::shared_ptr<xmlpp::Document>> _delayed_text_buffers;
+    mutable std::map<gint64, CtXmlNodeRanges> _delayed_text_buffers;
+    const bool _journal_allowed;
+    bool       _journal_usable{false}; // the document on disk and its journal are in sync with the tree
+    fs::path   _file_path;             // the document loaded or entirely saved
+    size_t     _file_size{0};
+    std::string _file_md5;             // of the document, computed when first needed by the journal
+    std::string _memory_data;          // the document saved in memory, until taken by get_memory_data
+    std::unique_ptr<CtChunkedContainer> _chunked_container; // the protected document of chunks, if any
 };
 
 
@@ -84,6 +180,7 @@ class CtStorageXmlHelper
 public:
     CtStorageXmlHelper(CtMainWin* pCtMainWin);
 
+    static void node_properties_to_xml(CtTreeIter* ct_tree_iter, xmlpp::Element* p_node_node);
     xmlpp::Element* node_to_xml(CtTreeIter* ct_tree_iter,
                                 xmlpp::Element* p_node_parent,
                                 bool with_widgets,
@@ -112,6 +209,30 @@ public:
     static void save_buffer_no_widgets_to_xml(xmlpp::Element* p_node_parent, Glib::RefPtr<Gtk::TextBuffer> buffer,
                                               int start_offset, int end_offset, const gchar change_case);
 
+    /**
+     * @brief Collect the text and the widgets searchable text of the slots (rich_text, encoded_png, table, codebox)
+     * without creating the text buffer and the widgets
+     */
+    static void get_stored_text_from_xml(xmlpp::Element* parent_xml_element, CtStoredNodeText& stored_text);
+    static std::vector<std::string> get_table_cells_text_from_xml(xmlpp::Element* table_xml_element);
+    /**
+     * @brief Decode the slots into text runs and widgets data, also from a thread other than the main one
+     */
+    static void get_decoded_text_from_xml(xmlpp::Element* parent_xml_element, CtDecodedNodeText& decoded_text);
+    /**
+     * @brief The table rows with the header row first, as the table element stores it last
+     */
+    static void get_decoded_table_from_xml(xmlpp::Element* table_xml_element, CtDecodedNodeText::Widget& widget);
+    /**
+     * @brief The slots of content decoded by get_decoded_text_from_xml or by a stored text reader, the inverse of it
+     */
+    static void decoded_text_to_xml(xmlpp::Element* p_node_parent, const CtDecodedNodeText& decoded_text, const bool with_widgets);
+    /**
+     * @brief The text buffer and the widgets from content decoded by get_decoded_text_from_xml or by a stored text reader
+     */
+    Glib::RefPtr<Gsv::Buffer> create_buffer_and_widgets_from_decoded(const CtDecodedNodeText& decoded_text,
+                                                                     std::list<CtAnchoredWidget*>& widgets);
+
 private:
     void              _add_rich_text_from_xml(Glib::RefPtr<Gsv::Buffer> buffer, xmlpp::Element* xml_element, Gtk::TextIter* text_insert_pos);
     CtAnchoredWidget* _create_image_from_xml(xmlpp::Element* xml_element, int charOffset, const Glib::ustring& justification);
@@ -125,7 +246,7 @@ private:
 namespace CtXmlHelper {
 
 void table_to_xml(xmlpp::Element* parent,
-                  const std::vector<std::vector<Glib::ustring>>& rows,
+                  const CtTableMatrix& tableMatrix,
                   int char_offset,
                   Glib::ustring justification,
                   int defaultWidth,
@@ -28,7 +28,130 @@
 #include "ct_storage_xml.h"
 #include "ct_logging.h"
 #include "ct_misc_utils.h"
+#include <algorithm>
 #include <fstream>
+#include <numeric>
+
+CtTableMatrix::CtTableMatrix(const std::vector<std::vector<Glib::ustring>>& rows)
+{
+    for (const auto& row : rows) {
+        row_insert(_rowsNum, row);
+    }
+}
+
+Glib::ustring CtTableMatrix::get_cell(const size_t rowIdx, const size_t colIdx) const
+{
+    const Column& column = _columns.at(colIdx);
+    const size_t start = _cell_start(column, rowIdx);
+    return Glib::ustring{column.text.begin() + start, column.text.begin() + column.ends.at(rowIdx)};
+}
+
+std::vector<Glib::ustring> CtTableMatrix::get_row(const size_t rowIdx) const
+{
+    std::vector<Glib::ustring> row;
+    row.reserve(_columns.size());
+    for (size_t colIdx = 0; colIdx < _columns.size(); ++colIdx) {
+        row.push_back(get_cell(rowIdx, colIdx));
+    }
+    return row;
+}
+
+std::vector<std::vector<Glib::ustring>> CtTableMatrix::get_rows() const
+{
+    std::vector<std::vector<Glib::ustring>> rows;
+    rows.reserve(_rowsNum);
+    for (size_t rowIdx = 0; rowIdx < _rowsNum; ++rowIdx) {
+        rows.push_back(get_row(rowIdx));
+    }
+    return rows;
+}
+
+size_t CtTableMatrix::get_memory_size() const
+{
+    size_t memorySize = sizeof(CtTableMatrix);
+    for (const Column& column : _columns) {
+        memorySize += sizeof(Column) + column.text.capacity() + column.ends.capacity() * sizeof(guint32);
+    }
+    return memorySize;
+}
+
+void CtTableMatrix::set_cell(const size_t rowIdx, const size_t colIdx, const Glib::ustring& text)
+{
+    Column& column = _columns.at(colIdx);
+    const size_t start = _cell_start(column, rowIdx);
+    const size_t prevSize = column.ends.at(rowIdx) - start;
+    column.text.replace(start, prevSize, text.raw());
+    for (size_t i = rowIdx; i < column.ends.size(); ++i) {
+        column.ends[i] = column.ends[i] - prevSize + text.bytes();
+    }
+}
+
+void CtTableMatrix::row_insert(const size_t rowIdx, const std::vector<Glib::ustring>& cells/*= {}*/)
+{
+    if (0 == _rowsNum and _columns.empty()) {
+        _columns.resize(cells.size());
+    }
+    const size_t insertIdx = std::min(rowIdx, _rowsNum);
+    for (size_t colIdx = 0; colIdx < _columns.size(); ++colIdx) {
+        Column& column = _columns[colIdx];
+        const size_t start = _cell_start(column, insertIdx);
+        const size_t size = colIdx < cells.size() ? cells[colIdx].bytes() : 0u;
+        if (size) {
+            column.text.insert(start, cells[colIdx].raw());
+        }
+        column.ends.insert(column.ends.begin() + insertIdx, start + size);
+        for (size_t i = insertIdx + 1; i < column.ends.size(); ++i) {
+            column.ends[i] += size;
+        }
+    }
+    ++_rowsNum;
+}
+
+void CtTableMatrix::row_delete(const size_t rowIdx)
+{
+    if (rowIdx >= _rowsNum) {
+        return;
+    }
+    for (Column& column : _columns) {
+        const size_t start = _cell_start(column, rowIdx);
+        const size_t size = column.ends[rowIdx] - start;
+        column.text.erase(start, size);
+        column.ends.erase(column.ends.begin() + rowIdx);
+        for (size_t i = rowIdx; i < column.ends.size(); ++i) {
+            column.ends[i] -= size;
+        }
+    }
+    --_rowsNum;
+}
+
+void CtTableMatrix::rows_reorder(const std::vector<size_t>& newOrder)
+{
+    for (Column& column : _columns) {
+        Column newColumn;
+        newColumn.text.reserve(column.text.size());
+        newColumn.ends.reserve(column.ends.size());
+        for (const size_t rowIdx : newOrder) {
+            const size_t start = _cell_start(column, rowIdx);
+            newColumn.text.append(column.text, start, column.ends.at(rowIdx) - start);
+            newColumn.ends.push_back(newColumn.text.size());
+        }
+        column = std::move(newColumn);
+    }
+}
+
+void CtTableMatrix::col_insert(const size_t colIdx)
+{
+    Column column;
+    column.ends.resize(_rowsNum, 0u);
+    _columns.insert(_columns.begin() + std::min(colIdx, _columns.size()), std::move(column));
+}
+
+void CtTableMatrix::col_delete(const size_t colIdx)
+{
+    if (colIdx < _columns.size()) {
+        _columns.erase(_columns.begin() + colIdx);
+    }
+}
 
 CtTable::CtTable(CtMainWin* pCtMainWin,
                  const CtTableMatrix& tableMatrix,
@@ -47,141 +170,124 @@ CtTable::CtTable(CtMainWin* pCtMainWin,
 {
     // column widths can be empty or wrong, trying to fix it
     // so we don't need to check it again and again
-    while (_colWidths.size() < tableMatrix[0].size())
+    while (_colWidths.size() < _tableMatrix.get_cols_num())
         _colWidths.push_back(0); // 0 means we use default width
 
-    for (size_t rowIdx = 0; rowIdx < _tableMatrix.size(); ++rowIdx) {
-        for (size_t colIdx = 0; colIdx < _tableMatrix[rowIdx].size(); ++colIdx) {
-            _new_text_cell_attach(rowIdx, colIdx, _tableMatrix.at(rowIdx).at(colIdx));
-        }
-    }
+    _drawingArea.add_events(Gdk::BUTTON_PRESS_MASK);
+    _drawingArea.get_style_context()->add_class("ct-table-cells");
+    _drawingArea.signal_draw().connect(sigc::mem_fun(*this, &CtTable::_on_draw_cells));
+    _drawingArea.signal_button_press_event().connect(sigc::mem_fun(*this, &CtTable::_on_button_press_event_cells), false);
 
-    _grid.set_column_spacing(1);
-    _grid.set_row_spacing(1);
-    _grid.signal_button_press_event().connect(sigc::mem_fun(*this, &CtTable::_on_button_press_event_grid), false);
-    _grid.signal_set_focus_child().connect(sigc::mem_fun(*this, &CtTable::_on_set_focus_child_grid));
+    _overlay.add(_drawingArea);
+    _overlay.signal_get_child_position().connect(sigc::mem_fun(*this, &CtTable::_on_get_child_position_overlay));
 
     _frame.get_style_context()->add_class("ct-table");
-    _frame.add(_grid);
+    _frame.add(_overlay);
     _frame.signal_size_allocate().connect(sigc::mem_fun(*this, &CtTable::_on_size_allocate_frame));
+    _invalidate_rows();
     show_all();
 }
 
 CtTable::~CtTable()
 {
-    for (CtTableRow& tableRow : _tableMatrix) {
-        for (CtTextCell* pTextCell : tableRow) {
-            delete pTextCell;
-        }
-    }
+    _measureConnection.disconnect();
 }
 
-void CtTable::_new_text_cell_attach(const size_t rowIdx, const size_t colIdx, CtTextCell* pTextCell)
+CtTextCell& CtTable::_get_edit_cell()
 {
-    CtTextView& textView = pTextCell->get_text_view();
-    const bool is_header = 0 == rowIdx;
-    textView.set_size_request(get_col_width(colIdx), -1);
-    textView.set_highlight_current_line(false);
-    if (is_header) {
-        _apply_remove_header_style(true/*isApply*/, textView);
+    if (not _uEditCell) {
+        _uEditCell = std::make_unique<CtTextCell>(_pCtMainWin, "", CtConst::TABLE_CELL_TEXT_ID);
+        CtTextView& textView = _uEditCell->get_text_view();
+        textView.set_highlight_current_line(false);
+        textView.set_left_margin(CELL_PADDING);
+        textView.set_right_margin(CELL_PADDING);
+        textView.set_top_margin(CELL_PADDING);
+        textView.set_bottom_margin(CELL_PADDING);
+        textView.signal_populate_popup().connect(sigc::mem_fun(*this, &CtTable::_on_populate_popup_cell));
+        textView.signal_key_press_event().connect(sigc::mem_fun(*this, &CtTable::_on_key_press_event_cell), false);
+        _uEditCell->get_buffer()->signal_changed().connect(sigc::mem_fun(*this, &CtTable::_on_changed_edit_cell_buffer));
+        _pCtMainWin->apply_syntax_highlighting(_uEditCell->get_buffer(), _uEditCell->get_syntax_highlighting(), false/*forceReApply*/);
+        _overlay.add_overlay(textView);
+    }
+    return *_uEditCell;
+}
+
+CtTextView& CtTable::get_current_cell_text_view()
+{
+    if (not _uEditCell) {
+        _edit_cell(current_row(), current_column());
     }
-    textView.signal_populate_popup().connect(sigc::mem_fun(*this, &CtTable::_on_populate_popup_cell));
-    textView.signal_key_press_event().connect(sigc::mem_fun(*this, &CtTable::_on_key_press_event_cell), false);
+    return _uEditCell->get_text_view();
+}
 
-    _grid.attach(pTextCell->get_text_view(), colIdx, rowIdx, 1/*# cell horiz*/, 1/*# cell vert*/);
+void CtTable::_edit_cell(const size_t rowIdx, const size_t colIdx)
+{
+    CtTextCell& editCell = _get_edit_cell();
+    CtTextView& textView = editCell.get_text_view();
+    _currentRow = rowIdx;
+    _currentColumn = colIdx;
+    _apply_remove_header_style(0 == rowIdx/*isApply*/, textView);
+
+    // the text is only moved from the matrix, it is not a change of the node
+    bool user_active_restore = _pCtMainWin->user_active();
+    _pCtMainWin->user_active() = false;
+    _loadingEditCell = true;
+    Glib::RefPtr<Gsv::Buffer> rTextBuffer = editCell.get_buffer();
+    rTextBuffer->begin_not_undoable_action();
+    rTextBuffer->set_text(_tableMatrix.get_cell(rowIdx, colIdx));
+    rTextBuffer->end_not_undoable_action();
+    rTextBuffer->place_cursor(rTextBuffer->begin());
+    _loadingEditCell = false;
+    _pCtMainWin->user_active() = user_active_restore;
 
-    _pCtMainWin->apply_syntax_highlighting(pTextCell->get_buffer(), pTextCell->get_syntax_highlighting(), false/*forceReApply*/);
     textView.show();
+    _overlay.queue_resize();
 }
 
-void CtTable::_apply_styles_to_cells(const bool forceReApply)
+void CtTable::_reload_edit_cell()
 {
-    for (CtTableRow& tableRow : _tableMatrix) {
-        for (CtTextCell* pTextCell : tableRow) {
-            _pCtMainWin->apply_syntax_highlighting(pTextCell->get_buffer(), pTextCell->get_syntax_highlighting(), forceReApply);
-        }
+    if (_uEditCell) {
+        _edit_cell(current_row(), current_column());
     }
 }
 
 void CtTable::apply_syntax_highlighting(const bool forceReApply)
 {
-    _apply_styles_to_cells(forceReApply);
+    if (_uEditCell) {
+        _pCtMainWin->apply_syntax_highlighting(_uEditCell->get_buffer(), _uEditCell->get_syntax_highlighting(), forceReApply);
+    }
+    if (forceReApply) {
+        // the font or the wrapping may have changed
+        _invalidate_rows();
+    }
+    else {
+        _drawingArea.queue_draw();
+    }
 }
 
 void CtTable::to_xml(xmlpp::Element* p_node_parent, const int offset_adjustment, CtStorageCache*)
 {
-    std::vector<std::vector<Glib::ustring>> rows;
-    rows.reserve(_tableMatrix.size());
-    for (auto& row: _tableMatrix)
-    {
-        rows.push_back(std::vector<Glib::ustring>());
-        rows.back().reserve(row.size());
-        for (auto& cell : row)  rows.back().push_back(cell->get_text_content());
-    }
-
-    CtXmlHelper::table_to_xml(p_node_parent, rows, _charOffset+offset_adjustment, _justification, _colWidthDefault, str::join_numbers(_colWidths, ","));
+    CtXmlHelper::table_to_xml(p_node_parent, _tableMatrix, _charOffset+offset_adjustment, _justification, _colWidthDefault, str::join_numbers(_colWidths, ","));
 }
 
-void CtTable::_populate_xml_rows_cells(xmlpp::Element* p_table_node)
+bool CtTable::to_sqlite(CtSqliteStmtCache& stmtCache, const gint64 node_id, const int offset_adjustment, CtStorageCache*)
 {
-    auto row_to_xml = [&](const CtTableRow& tableRow) {
-        xmlpp::Element* p_row_node = p_table_node->add_child("row");
-        for (const CtTextCell* pTextCell : tableRow)
-        {
-            xmlpp::Element* p_cell_node = p_row_node->add_child("cell");
-            p_cell_node->add_child_text(pTextCell->get_text_content());
-        }
-    };
-
-    // put header at the end
-    bool is_header = true;
-    for (const CtTableRow& tableRow : _tableMatrix)
-    {
-        if (is_header) { is_header = false; continue; }
-        row_to_xml(tableRow);
-    }
-    row_to_xml(_tableMatrix.front());
-}
-
-bool CtTable::to_sqlite(sqlite3* pDb, const gint64 node_id, const int offset_adjustment, CtStorageCache*)
-{
-    bool retVal{true};
-    sqlite3_stmt *p_stmt;
-    if (sqlite3_prepare_v2(pDb, CtStorageSqlite::TABLE_TABLE_INSERT, -1, &p_stmt, nullptr) != SQLITE_OK)
-    {
-        spdlog::error("{}: {}", CtStorageSqlite::ERR_SQLITE_PREPV2, sqlite3_errmsg(pDb));
-        retVal = false;
-    }
-    else
-    {
-        xmlpp::Document xml_doc;
-        xml_doc.create_root_node("table");
-        xml_doc.get_root_node()->set_attribute("col_widths", str::join_numbers(_colWidths, ","));
-        _populate_xml_rows_cells(xml_doc.get_root_node());
-        const std::string table_txt = xml_doc.write_to_string();
-        sqlite3_bind_int64(p_stmt, 1, node_id);
-        sqlite3_bind_int64(p_stmt, 2, _charOffset+offset_adjustment);
-        sqlite3_bind_text(p_stmt, 3, _justification.c_str(), _justification.size(), SQLITE_STATIC);
-        sqlite3_bind_text(p_stmt, 4, table_txt.c_str(), table_txt.size(), SQLITE_STATIC);
-        sqlite3_bind_int64(p_stmt, 5, _colWidthDefault); // todo get rid of column min
-        sqlite3_bind_int64(p_stmt, 6, _colWidthDefault);
-        if (sqlite3_step(p_stmt) != SQLITE_DONE)
-        {
-            spdlog::error("{}: {}", CtStorageSqlite::ERR_SQLITE_STEP, sqlite3_errmsg(pDb));
-            retVal = false;
-        }
-        sqlite3_finalize(p_stmt);
-    }
-    return retVal;
+    CtDecodedNodeText::Widget widget;
+    widget.type = CtAnchWidgType::Table;
+    widget.offset = _charOffset+offset_adjustment;
+    widget.justification = _justification;
+    widget.table_rows = _tableMatrix.get_rows();
+    widget.col_width_default = _colWidthDefault;
+    widget.col_widths = _colWidths;
+    return CtStorageSqlite::write_widget_row(stmtCache, node_id, widget);
 }
 
 void CtTable::to_csv(std::ostream& output) const {
     CtCSV::CtStringTable tbl;
-    for (const CtTableRow& ct_row : _tableMatrix) {
+    for (size_t rowIdx = 0; rowIdx < _tableMatrix.get_rows_num(); ++rowIdx) {
         std::vector<std::string> row;
-
-        for (const auto* ct_cell : ct_row) {
-            row.emplace_back(ct_cell->get_text_content());
+        for (size_t colIdx = 0; colIdx < _tableMatrix.get_cols_num(); ++colIdx) {
+            row.emplace_back(_tableMatrix.get_cell(rowIdx, colIdx));
         }
         tbl.emplace_back(row);
     }
@@ -199,33 +305,22 @@ std::unique_ptr<CtTable> CtTable::from_csv(const std::string& filepath,
     }
     CtCSV::CtStringTable str_tbl = CtCSV::table_from_csv(input);
 
-    CtTableMatrix tbl_matrix;
+    std::vector<std::vector<Glib::ustring>> rows;
     if (str_tbl.size() and str_tbl.front().size()) {
         const size_t numColumns = str_tbl.front().size();
+        rows.reserve(str_tbl.size());
         size_t currRow{0};
         for (const auto& row : str_tbl) {
             ++currRow;
-            CtTableRow tbl_row;
-            size_t currCol{0};
-            for (const auto& cell : row) {
-                ++currCol;
-                if (currCol > numColumns) {
-                    spdlog::warn("from_csv row {} col {} > {}", currRow, currCol, numColumns);
-                    break;
-                }
-                auto* ct_cell = new CtTextCell{main_win, cell, CtConst::TABLE_CELL_TEXT_ID};
-                tbl_row.emplace_back(ct_cell);
+            if (row.size() > numColumns) {
+                spdlog::warn("from_csv row {} col {} > {}", currRow, row.size(), numColumns);
             }
-            while (currCol < numColumns) {
-                ++currCol;
-                auto* ct_cell = new CtTextCell{main_win, "", CtConst::TABLE_CELL_TEXT_ID};
-                tbl_row.emplace_back(ct_cell);
-            }
-            tbl_matrix.emplace_back(tbl_row);
+            // the missing cells are added empty and the extra ones dropped by the matrix
+            rows.emplace_back(row.begin(), row.end());
         }
     }
 
-    return std::make_unique<CtTable>(main_win, tbl_matrix, 60, offset, justification, CtTableColWidths{});
+    return std::make_unique<CtTable>(main_win, CtTableMatrix{rows}, 60, offset, justification, CtTableColWidths{});
 }
 
 std::shared_ptr<CtAnchoredWidgetState> CtTable::get_state()
@@ -233,38 +328,38 @@ std::shared_ptr<CtAnchoredWidgetState> CtTable::get_state()
     return std::shared_ptr<CtAnchoredWidgetState>(new CtAnchoredWidgetState_Table(this));
 }
 
+size_t CtTable::get_memory_size()
+{
+    size_t memorySize = CtAnchoredWidget::get_memory_size() + _tableMatrix.get_memory_size();
+    if (_uEditCell) {
+        memorySize += WIDGET_MEMORY_SIZE + get_text_buffer_memory_size(_uEditCell->get_buffer());
+    }
+    return memorySize;
+}
+
 void CtTable::set_modified_false()
 {
-    for (CtTableRow& tableRow : _tableMatrix) {
-        for (CtTextCell* pTextCell : tableRow) {
-            pTextCell->set_text_buffer_modified_false();
-        }
+    if (_uEditCell) {
+        _uEditCell->set_text_buffer_modified_false();
     }
 }
 
 void CtTable::column_add(const size_t afterColIdx)
 {
     const size_t newColIdx = afterColIdx + 1;
-    _grid.insert_column(newColIdx);
+    _tableMatrix.col_insert(newColIdx);
     _colWidths.insert(_colWidths.begin()+newColIdx, 0);
-    for (size_t rowIdx = 0; rowIdx < _tableMatrix.size(); ++rowIdx) {
-        auto pTextCell = new CtTextCell{_pCtMainWin, "", CtConst::TABLE_CELL_TEXT_ID};
-        _tableMatrix.at(rowIdx).insert(_tableMatrix.at(rowIdx).begin()+newColIdx, pTextCell);
-        _new_text_cell_attach(rowIdx, newColIdx, pTextCell);
-    }
+    _invalidate_rows();
 }
 
 void CtTable::column_delete(const size_t colIdx)
 {
-    if (1 == _tableMatrix.front().size() or colIdx >= _tableMatrix.front().size()) {
+    if (1 == _tableMatrix.get_cols_num() or colIdx >= _tableMatrix.get_cols_num()) {
         return;
     }
-    _grid.remove_column(colIdx);
+    _tableMatrix.col_delete(colIdx);
     _colWidths.erase(_colWidths.begin()+colIdx);
-    for (CtTableRow& tableRow : _tableMatrix) {
-        delete tableRow.at(colIdx);
-        tableRow.erase(tableRow.begin()+colIdx);
-    }
+    _invalidate_rows();
 }
 
 void CtTable::column_move_left(const size_t colIdx)
@@ -274,19 +369,14 @@ void CtTable::column_move_left(const size_t colIdx)
     }
     const size_t colIdxLeft = colIdx - 1;
     std::swap(_colWidths[colIdxLeft], _colWidths[colIdx]);
-    _grid.remove_column(colIdxLeft);
-    _grid.insert_column(colIdx);
-    for (size_t rowIdx = 0; rowIdx < _tableMatrix.size(); ++rowIdx) {
-        std::swap(_tableMatrix[rowIdx][colIdxLeft], _tableMatrix[rowIdx][colIdx]);
-        CtTextView& textView = _tableMatrix.at(rowIdx).at(colIdx)->get_text_view();
-        _grid.attach(textView, colIdx, rowIdx, 1/*# cell horiz*/, 1/*# cell vert*/);
-    }
+    _tableMatrix.col_swap(colIdxLeft, colIdx);
     _currentColumn = colIdxLeft;
+    _invalidate_rows();
 }
 
 void CtTable::column_move_right(const size_t colIdx)
 {
-    if (colIdx == _tableMatrix.front().size()-1) {
+    if (colIdx == _tableMatrix.get_cols_num()-1) {
         return;
     }
     column_move_left(colIdx+1);
@@ -295,27 +385,28 @@ void CtTable::column_move_right(const size_t colIdx)
 void CtTable::row_add(const size_t afterRowIdx, const std::vector<Glib::ustring>* pNewRow/*= nullptr*/)
 {
     const size_t newRowIdx = afterRowIdx + 1;
-    _tableMatrix.insert(_tableMatrix.begin()+newRowIdx, CtTableRow{});
-    _grid.insert_row(newRowIdx);
-    const Glib::ustring emptyCell;
-    for (size_t colIdx = 0; colIdx < _tableMatrix.front().size(); ++colIdx) {
-        const Glib::ustring* pStr = not pNewRow or pNewRow->size() <= colIdx ? &emptyCell : &pNewRow->at(colIdx);
-        auto pTextCell = new CtTextCell{_pCtMainWin, *pStr, CtConst::TABLE_CELL_TEXT_ID};
-        _tableMatrix.at(newRowIdx).push_back(pTextCell);
-        _new_text_cell_attach(newRowIdx, colIdx, pTextCell);
-    }
+    _tableMatrix.row_insert(newRowIdx, pNewRow ? *pNewRow : std::vector<Glib::ustring>{});
+    _rowHeights.insert(_rowHeights.begin()+newRowIdx, RowHeight{0, false});
+    _measure_row(newRowIdx);
+    if (_currentRow >= newRowIdx) {
+        ++_currentRow;
+    }
+    _update_size();
+    _reload_edit_cell();
 }
 
 void CtTable::row_delete(const size_t rowIdx)
 {
-    if (1 == _tableMatrix.size() or rowIdx >= _tableMatrix.size()) {
+    if (1 == _tableMatrix.get_rows_num() or rowIdx >= _tableMatrix.get_rows_num()) {
         return;
     }
-    _grid.remove_row(rowIdx);
-    for (CtTextCell* pTextCell : _tableMatrix.at(rowIdx)) {
-        delete pTextCell;
+    _tableMatrix.row_delete(rowIdx);
+    _rowHeights.erase(_rowHeights.begin()+rowIdx);
+    if (_currentRow > rowIdx) {
+        --_currentRow;
     }
-    _tableMatrix.erase(_tableMatrix.begin()+rowIdx);
+    _update_size();
+    _reload_edit_cell();
 }
 
 void CtTable::_apply_remove_header_style(const bool isApply, CtTextView& textView)
@@ -331,37 +422,33 @@ void CtTable::_apply_remove_header_style(const bool isApply, CtTextView& textVie
     else {
         if (rStyleContext->has_class(headerStyle)) {
             rStyleContext->remove_class(headerStyle);
-            textView.set_wrap_mode(_pCtMainWin->get_ct_config()->lineWrapping ?
-                                   Gtk::WrapMode::WRAP_WORD_CHAR : Gtk::WrapMode::WRAP_NONE);
         }
+        textView.set_wrap_mode(_pCtMainWin->get_ct_config()->lineWrapping ?
+                               Gtk::WrapMode::WRAP_WORD_CHAR : Gtk::WrapMode::WRAP_NONE);
     }
 }
 
 void CtTable::row_move_up(const size_t rowIdx)
 {
-    if (0 == rowIdx) {
+    if (0 == rowIdx or rowIdx >= _tableMatrix.get_rows_num()) {
         return;
     }
     const size_t rowIdxUp = rowIdx - 1;
-    _grid.remove_row(rowIdxUp);
-    _grid.insert_row(rowIdx);
-    std::swap(_tableMatrix[rowIdxUp], _tableMatrix[rowIdx]);
-    for (size_t colIdx = 0; colIdx < _tableMatrix.front().size(); ++colIdx) {
-        CtTextView& textView = _tableMatrix.at(rowIdx).at(colIdx)->get_text_view();
-        _grid.attach(textView, colIdx, rowIdx, 1/*# cell horiz*/, 1/*# cell vert*/);
-        if (0 == rowIdxUp) {
-            // we swapped header
-            CtTextView& textViewUp = _tableMatrix.at(rowIdxUp).at(colIdx)->get_text_view();
-            _apply_remove_header_style(true/*isApply*/, textViewUp);
-            _apply_remove_header_style(false/*isApply*/, textView);
-        }
-    }
+    std::vector<size_t> newOrder(_tableMatrix.get_rows_num());
+    std::iota(newOrder.begin(), newOrder.end(), 0);
+    std::swap(newOrder[rowIdxUp], newOrder[rowIdx]);
+    _tableMatrix.rows_reorder(newOrder);
+    // the header may have been swapped, it is drawn differently
+    _measure_row(rowIdxUp);
+    _measure_row(rowIdx);
     _currentRow = rowIdxUp;
+    _update_size();
+    _reload_edit_cell();
 }
 
 void CtTable::row_move_down(const size_t rowIdx)
 {
-    if (rowIdx == _tableMatrix.size()-1) {
+    if (rowIdx == _tableMatrix.get_rows_num()-1) {
         return;
     }
     row_move_up(rowIdx+1);
@@ -369,31 +456,40 @@ void CtTable::row_move_down(const size_t rowIdx)
 
 bool CtTable::_row_sort(const bool sortAsc)
 {
-    auto f_tableCompare = [sortAsc](CtTableRow& l, CtTableRow& r)->bool{
-        auto cmpResult = CtStrUtil::natural_compare(l.front()->get_text_content(), r.front()->get_text_content());
-        return sortAsc ? cmpResult < 0 : cmpResult > 0;
-    };
-    auto pPrevState = std::static_pointer_cast<CtAnchoredWidgetState_Table>(get_state());
-    std::sort(_tableMatrix.begin()+1, _tableMatrix.end(), f_tableCompare);
-    auto pCurrState = std::static_pointer_cast<CtAnchoredWidgetState_Table>(get_state());
-    std::list<size_t> changed;
-    for (size_t rowIdx = 1; rowIdx < _tableMatrix.size(); ++rowIdx) {
-        if (pPrevState->rows.at(rowIdx) != pCurrState->rows.at(rowIdx)) {
-            changed.push_back(rowIdx);
-            _grid.remove_row(rowIdx);
-            _grid.insert_row(rowIdx);
+    const size_t rowsNum = _tableMatrix.get_rows_num();
+    // the first column of every row is read once, not at every comparison
+    std::vector<Glib::ustring> sortKeys;
+    sortKeys.reserve(rowsNum);
+    for (size_t rowIdx = 0; rowIdx < rowsNum; ++rowIdx) {
+        sortKeys.push_back(_tableMatrix.get_cell(rowIdx, 0));
+    }
+    std::vector<size_t> newOrder(rowsNum);
+    std::iota(newOrder.begin(), newOrder.end(), 0);
+    if (rowsNum > 2) {
+        std::stable_sort(newOrder.begin()+1, newOrder.end(), [&sortKeys, sortAsc](const size_t l, const size_t r)->bool{
+            auto cmpResult = CtStrUtil::natural_compare(sortKeys[l], sortKeys[r]);
+            return sortAsc ? cmpResult < 0 : cmpResult > 0;
+        });
+    }
+    bool changed{false};
+    for (size_t rowIdx = 1; rowIdx < rowsNum; ++rowIdx) {
+        if (newOrder[rowIdx] != rowIdx) {
+            changed = true;
+            break;
         }
     }
-    if (changed.size()) {
-        for (auto rowIdx : changed) {
-            for (size_t colIdx = 0; colIdx < _tableMatrix.at(rowIdx).size(); ++colIdx) {
-                CtTextView& textView = _tableMatrix.at(rowIdx).at(colIdx)->get_text_view();
-                _grid.attach(textView, colIdx, rowIdx, 1/*# cell horiz*/, 1/*# cell vert*/);
-            }
+    if (changed) {
+        _tableMatrix.rows_reorder(newOrder);
+        std::vector<RowHeight> rowHeights;
+        rowHeights.reserve(rowsNum);
+        for (const size_t rowIdx : newOrder) {
+            rowHeights.push_back(_rowHeights.at(rowIdx));
         }
-        return true;
+        _rowHeights.swap(rowHeights);
+        _update_size();
+        _reload_edit_cell();
     }
-    return false;
+    return changed;
 }
 
 void CtTable::set_col_width_default(const int colWidthDefault)
@@ -401,13 +497,7 @@ void CtTable::set_col_width_default(const int colWidthDefault)
     _colWidthDefault = colWidthDefault;
     bool has_default_widths = vec::exists(_colWidths, 0);
     if (has_default_widths) {
-        for (size_t rowIdx = 0; rowIdx < _tableMatrix.size(); ++rowIdx) {
-            for (size_t colIdx = 0; colIdx < _tableMatrix[rowIdx].size(); ++colIdx) {
-                CtTextCell* pTextCell = _tableMatrix[rowIdx][colIdx];
-                CtTextView& textView = pTextCell->get_text_view();
-                textView.set_size_request(get_col_width(colIdx), -1);
-            }
-        }
+        _invalidate_rows();
     }
 }
 
@@ -415,11 +505,122 @@ void CtTable::set_col_width(const int colWidth, std::optional<size_t> optColIdx/
 {
     const size_t colIdx = optColIdx.value_or(_currentColumn);
     _colWidths[colIdx] = colWidth;
-    for (size_t rowIdx = 0; rowIdx < _tableMatrix.size(); ++rowIdx) {
-        CtTextCell* pTextCell = _tableMatrix[rowIdx][colIdx];
-        CtTextView& textView = pTextCell->get_text_view();
-        textView.set_size_request(get_col_width(colIdx), -1);
+    _invalidate_rows();
+}
+
+Glib::RefPtr<Pango::Layout> CtTable::_get_cell_layout(const size_t rowIdx, const size_t colIdx)
+{
+    const bool isHeader = 0 == rowIdx;
+    Glib::RefPtr<Pango::Layout> rLayout = _drawingArea.create_pango_layout(_tableMatrix.get_cell(rowIdx, colIdx));
+    Pango::AttrList attrList;
+    Pango::Attribute attrWeight = Pango::Attribute::create_attr_weight(isHeader ? Pango::WEIGHT_BOLD : Pango::WEIGHT_NORMAL);
+    attrList.insert(attrWeight);
+    rLayout->set_attributes(attrList);
+    if (not isHeader and _pCtMainWin->get_ct_config()->lineWrapping) {
+        rLayout->set_width(std::max(get_col_width(colIdx) - 2*CELL_PADDING, 1) * PANGO_SCALE);
+        rLayout->set_wrap(Pango::WRAP_WORD_CHAR);
+    }
+    return rLayout;
+}
+
+int CtTable::_get_col_draw_width(const size_t colIdx) const
+{
+    // the cells not wrapped widen the column as the text views did
+    return std::max(get_col_width(colIdx), _colNaturalWidths.at(colIdx) + 2*CELL_PADDING);
+}
+
+int CtTable::_get_col_x(const size_t colIdx) const
+{
+    int x{1};
+    for (size_t i = 0; i < colIdx; ++i) {
+        x += _get_col_draw_width(i) + 1;
+    }
+    return x;
+}
+
+CtTable::RowHeight CtTable::_estimate_row_height(const size_t rowIdx)
+{
+    size_t maxLines{1};
+    for (size_t colIdx = 0; colIdx < _tableMatrix.get_cols_num(); ++colIdx) {
+        const Glib::ustring cellText = _tableMatrix.get_cell(rowIdx, colIdx);
+        maxLines = std::max(maxLines, 1 + (size_t)std::count(cellText.raw().begin(), cellText.raw().end(), '\n'));
+    }
+    return RowHeight{(int)maxLines * _lineHeight + 2*CELL_PADDING, false};
+}
+
+void CtTable::_measure_row(const size_t rowIdx)
+{
+    int maxHeight{0};
+    for (size_t colIdx = 0; colIdx < _tableMatrix.get_cols_num(); ++colIdx) {
+        Glib::RefPtr<Pango::Layout> rLayout = _get_cell_layout(rowIdx, colIdx);
+        int width, height;
+        rLayout->get_pixel_size(width, height);
+        maxHeight = std::max(maxHeight, height);
+        if (rLayout->get_width() < 0) {
+            _colNaturalWidths[colIdx] = std::max(_colNaturalWidths[colIdx], width);
+        }
+    }
+    _rowHeights.at(rowIdx) = RowHeight{maxHeight + 2*CELL_PADDING, true};
+}
+
+void CtTable::_invalidate_rows()
+{
+    int width;
+    _drawingArea.create_pango_layout("X")->get_pixel_size(width, _lineHeight);
+    _colNaturalWidths.assign(_tableMatrix.get_cols_num(), 0);
+    const size_t rowsNum = _tableMatrix.get_rows_num();
+    _rowHeights.clear();
+    _rowHeights.reserve(rowsNum);
+    for (size_t rowIdx = 0; rowIdx < rowsNum; ++rowIdx) {
+        // the first rows are measured now, the others in the idle time
+        _rowHeights.push_back(RowHeight{0, false});
+        if (rowIdx < MEASURE_ROWS_PER_IDLE) _measure_row(rowIdx);
+        else _rowHeights.back() = _estimate_row_height(rowIdx);
+    }
+    _update_size();
+    _reload_edit_cell();
+    if (rowsNum > MEASURE_ROWS_PER_IDLE and not _measureConnection.connected()) {
+        _measureConnection = Glib::signal_idle().connect(sigc::mem_fun(*this, &CtTable::_on_idle_measure_rows));
+    }
+}
+
+void CtTable::_update_size()
+{
+    const size_t rowsNum = _rowHeights.size();
+    _rowsY.resize(rowsNum + 1);
+    int y{1};
+    for (size_t rowIdx = 0; rowIdx < rowsNum; ++rowIdx) {
+        _rowsY[rowIdx] = y;
+        y += _rowHeights[rowIdx].height + 1;
+    }
+    _rowsY[rowsNum] = y;
+    _drawingArea.set_size_request(_get_col_x(_tableMatrix.get_cols_num()), y);
+    _drawingArea.queue_draw();
+    _overlay.queue_resize();
+}
+
+bool CtTable::_find_cell_at(const int x, const int y, size_t& rowIdx, size_t& colIdx) const
+{
+    if (_tableMatrix.empty()) {
+        return false;
+    }
+    auto itRowsY = std::upper_bound(_rowsY.begin(), _rowsY.end(), y);
+    if (itRowsY == _rowsY.begin() or itRowsY == _rowsY.end()) {
+        return false;
     }
+    rowIdx = itRowsY - _rowsY.begin() - 1;
+    if (y >= _rowsY[rowIdx] + _rowHeights[rowIdx].height) {
+        return false; // on the line between the rows
+    }
+    int colX{1};
+    for (colIdx = 0; colIdx < _tableMatrix.get_cols_num(); ++colIdx) {
+        const int colWidth = _get_col_draw_width(colIdx);
+        if (x >= colX and x < colX + colWidth) {
+            return true;
+        }
+        colX += colWidth + 1;
+    }
+    return false;
 }
 
 void CtTable::_on_populate_popup_cell(Gtk::Menu* menu)
@@ -430,31 +631,135 @@ void CtTable::_on_populate_popup_cell(Gtk::Menu* menu)
     _pCtMainWin->get_ct_actions()->curr_table_anchor = this;
     const bool first_row = 0 == rowIdx;
     const bool first_col = 0 == colIdx;
-    const bool last_row = _tableMatrix.size()-1 == rowIdx;
-    const bool last_col = _tableMatrix.size() and _tableMatrix.front().size()-1 == colIdx;
+    const bool last_row = _tableMatrix.get_rows_num()-1 == rowIdx;
+    const bool last_col = _tableMatrix.get_cols_num()-1 == colIdx;
     _pCtMainWin->get_ct_menu().build_popup_menu_table_cell(menu, first_row, first_col, last_row, last_col);
 }
 
-void CtTable::_on_set_focus_child_grid(Gtk::Widget* pWidget)
+void CtTable::_on_changed_edit_cell_buffer()
+{
+    if (_loadingEditCell) return;
+    const size_t rowIdx = current_row();
+    _tableMatrix.set_cell(rowIdx, current_column(), _uEditCell->get_text_content());
+    _measure_row(rowIdx);
+    _update_size();
+}
+
+bool CtTable::_on_button_press_event_cells(GdkEventButton* event)
+{
+    _pCtMainWin->get_ct_actions()->curr_table_anchor = this;
+    size_t rowIdx, colIdx;
+    if (not _find_cell_at((int)event->x, (int)event->y, rowIdx, colIdx)) {
+        if ( event->button != 3/*right button*/ and event->type != GDK_3BUTTON_PRESS) {
+            _pCtMainWin->get_ct_actions()->object_set_selection(this);
+        }
+        return false;
+    }
+    _edit_cell(rowIdx, colIdx);
+    // the cursor goes where the text was clicked in the drawn cell
+    Glib::RefPtr<Pango::Layout> rLayout = _get_cell_layout(rowIdx, colIdx);
+    int index, trailing;
+    rLayout->xy_to_index(((int)event->x - _get_col_x(colIdx) - CELL_PADDING) * PANGO_SCALE,
+                         ((int)event->y - _rowsY[rowIdx] - CELL_PADDING) * PANGO_SCALE,
+                         index,
+                         trailing);
+    const Glib::ustring cellText = rLayout->get_text();
+    const long charOffset = g_utf8_pointer_to_offset(cellText.c_str(), cellText.c_str() + index) + trailing;
+    Glib::RefPtr<Gsv::Buffer> rTextBuffer = _uEditCell->get_buffer();
+    rTextBuffer->place_cursor(rTextBuffer->get_iter_at_offset(charOffset));
+    _uEditCell->get_text_view().grab_focus();
+    if (3 == event->button) {
+        // the text view is in place only after the next allocation
+        Glib::signal_idle().connect_once(sigc::mem_fun(*this, &CtTable::_on_idle_popup_menu_cell));
+    }
+    return true;
+}
+
+void CtTable::_on_idle_popup_menu_cell()
 {
-    for (size_t rowIdx = 0; rowIdx < _tableMatrix.size(); ++rowIdx) {
-        for (size_t colIdx = 0; colIdx < _tableMatrix[rowIdx].size(); ++colIdx) {
-            if (pWidget == &_tableMatrix.at(rowIdx).at(colIdx)->get_text_view()) {
-                _currentRow = rowIdx;
-                _currentColumn = colIdx;
-                return;
+    gboolean handled{FALSE};
+    g_signal_emit_by_name(G_OBJECT(_uEditCell->get_text_view().gobj()), "popup-menu", &handled);
+}
+
+bool CtTable::_on_draw_cells(const Cairo::RefPtr<Cairo::Context>& cr)
+{
+    const int width = _drawingArea.get_allocated_width();
+    const int height = _drawingArea.get_allocated_height();
+    auto rStyleContext = _drawingArea.get_style_context();
+    rStyleContext->render_background(cr, 0, 0, width, height);
+    rStyleContext->render_frame(cr, 0, 0, width, height);
+    if (_tableMatrix.empty() or _rowsY.size() != _tableMatrix.get_rows_num() + 1) {
+        return true;
+    }
+
+    // the cells have the colours of the table style scheme, as the text view editing them
+    Gdk::RGBA colorBg{"white"};
+    Gdk::RGBA colorFg{"black"};
+    if (auto rStyleScheme = _pCtMainWin->get_style_scheme_manager()->get_scheme(_pCtMainWin->get_ct_config()->taStyleScheme)) {
+        if (auto rStyle = rStyleScheme->get_style("text")) {
+            if (rStyle->property_background_set()) colorBg.set(rStyle->property_background().get_value());
+            if (rStyle->property_foreground_set()) colorFg.set(rStyle->property_foreground().get_value());
+        }
+    }
+
+    double clipX1, clipY1, clipX2, clipY2;
+    cr->get_clip_extents(clipX1, clipY1, clipX2, clipY2);
+    const size_t rowsNum = _tableMatrix.get_rows_num();
+    auto itFirstRow = std::upper_bound(_rowsY.begin(), _rowsY.end() - 1, (int)clipY1);
+    size_t rowIdx = itFirstRow == _rowsY.begin() ? 0u : itFirstRow - _rowsY.begin() - 1;
+    for (; rowIdx < rowsNum and _rowsY[rowIdx] < clipY2; ++rowIdx) {
+        const int y = _rowsY[rowIdx];
+        const int rowHeight = _rowHeights[rowIdx].height;
+        int x{1};
+        for (size_t colIdx = 0; colIdx < _tableMatrix.get_cols_num() and x < clipX2; ++colIdx) {
+            const int colWidth = _get_col_draw_width(colIdx);
+            if (x + colWidth >= clipX1) {
+                cr->save();
+                cr->rectangle(x, y, colWidth, rowHeight);
+                cr->clip();
+                Gdk::Cairo::set_source_rgba(cr, colorBg);
+                cr->paint();
+                Gdk::Cairo::set_source_rgba(cr, colorFg);
+                cr->move_to(x + CELL_PADDING, y + CELL_PADDING);
+                _get_cell_layout(rowIdx, colIdx)->show_in_cairo_context(cr);
+                cr->restore();
             }
+            x += colWidth + 1;
         }
     }
+    return true;
 }
 
-bool CtTable::_on_button_press_event_grid(GdkEventButton* event)
+bool CtTable::_on_get_child_position_overlay(Gtk::Widget* pWidget, Gdk::Rectangle& allocation)
 {
-    _pCtMainWin->get_ct_actions()->curr_table_anchor = this;
-    if ( event->button != 3/*right button*/ and event->type != GDK_3BUTTON_PRESS) {
-        _pCtMainWin->get_ct_actions()->object_set_selection(this);
+    if (not _uEditCell or pWidget != &_uEditCell->get_text_view() or _tableMatrix.empty()) {
+        return false;
     }
-    return false;
+    const size_t rowIdx = current_row();
+    const size_t colIdx = current_column();
+    const int colWidth = _get_col_draw_width(colIdx);
+    int minHeight, natHeight;
+    pWidget->get_preferred_height_for_width(colWidth, minHeight, natHeight);
+    allocation.set_x(_get_col_x(colIdx));
+    allocation.set_y(_rowsY.at(rowIdx));
+    allocation.set_width(colWidth);
+    allocation.set_height(std::max(_rowHeights.at(rowIdx).height, minHeight));
+    return true;
+}
+
+bool CtTable::_on_idle_measure_rows()
+{
+    size_t measuredRows{0};
+    for (size_t rowIdx = 0; rowIdx < _rowHeights.size() and measuredRows < MEASURE_ROWS_PER_IDLE; ++rowIdx) {
+        if (not _rowHeights[rowIdx].measured) {
+            _measure_row(rowIdx);
+            ++measuredRows;
+        }
+    }
+    if (measuredRows > 0) {
+        _update_size();
+    }
+    return measuredRows == MEASURE_ROWS_PER_IDLE;
 }
 
 bool CtTable::_on_key_press_event_cell(GdkEventKey* event)
@@ -462,14 +767,15 @@ bool CtTable::_on_key_press_event_cell(GdkEventKey* event)
     if (not _pCtMainWin->user_active()) return false;
     const size_t rowIdx = current_row();
     const size_t colIdx = current_column();
+    const size_t colsNum = _tableMatrix.get_cols_num();
     _pCtMainWin->get_ct_actions()->curr_table_anchor = this;
     int index{-1};
     if (event->keyval == GDK_KEY_Tab or event->keyval == GDK_KEY_ISO_Left_Tab) {
         if (event->state & Gdk::SHIFT_MASK) {
-            index = rowIdx * _tableMatrix.front().size() + colIdx - 1;
+            index = rowIdx * colsNum + colIdx - 1;
         }
         else {
-            index = rowIdx * _tableMatrix.front().size() + colIdx + 1;
+            index = rowIdx * colsNum + colIdx + 1;
         }
     }
     else if (event->state & Gdk::CONTROL_MASK) {
@@ -501,28 +807,29 @@ bool CtTable::_on_key_press_event_cell(GdkEventKey* event)
         }
         if (event->keyval == GDK_KEY_Up) {
             if (rowIdx > 0) {
-                index = (rowIdx-1) * _tableMatrix.front().size() + colIdx;
+                index = (rowIdx-1) * colsNum + colIdx;
             }
         }
         else if (event->keyval == GDK_KEY_Down) {
-            if (rowIdx+1 < _tableMatrix.size()) {
-                index = (rowIdx+1) * _tableMatrix.front().size() + colIdx;
+            if (rowIdx+1 < _tableMatrix.get_rows_num()) {
+                index = (rowIdx+1) * colsNum + colIdx;
             }
         }
         else if (event->keyval == GDK_KEY_Left) {
-            index = rowIdx * _tableMatrix.front().size() + colIdx - 1;
+            index = rowIdx * colsNum + colIdx - 1;
         }
         else if (event->keyval == GDK_KEY_Right) {
-            index = rowIdx * _tableMatrix.front().size() + colIdx + 1;
+            index = rowIdx * colsNum + colIdx + 1;
         }
     }
     if (index >= 0) {
-        const size_t nextRowIdx = index / _tableMatrix.front().size();
-        const size_t nextColIdx = index % _tableMatrix.front().size();
-        if ( nextRowIdx < _tableMatrix.size() and
-             nextColIdx < _tableMatrix.front().size() )
+        const size_t nextRowIdx = index / colsNum;
+        const size_t nextColIdx = index % colsNum;
+        if ( nextRowIdx < _tableMatrix.get_rows_num() and
+             nextColIdx < colsNum )
         {
-            _tableMatrix[nextRowIdx][nextColIdx]->get_text_view().grab_focus();
+            _edit_cell(nextRowIdx, nextColIdx);
+            _uEditCell->get_text_view().grab_focus();
         }
         return true;
     }
@@ -29,6 +29,10 @@
 #include <ostream>
 #include <istream>
 
+/**
+ * @brief A table whose cells text is kept in a CtTableMatrix, only the visible cells are drawn
+ * and a single text view is moved on the cell being edited
+ */
 class CtTable : public CtAnchoredWidget
 {
 public:
@@ -56,7 +60,7 @@ public:
     void apply_width_height(const int /*parentTextWidth*/) override {}
     void apply_syntax_highlighting(const bool forceReApply) override;
     void to_xml(xmlpp::Element* p_node_parent, const int offset_adjustment, CtStorageCache* cache) override;
-    bool to_sqlite(sqlite3* pDb, const gint64 node_id, const int offset_adjustment, CtStorageCache* cache) override;
+    bool to_sqlite(CtSqliteStmtCache& stmtCache, const gint64 node_id, const int offset_adjustment, CtStorageCache* cache) override;
     /**
      * @brief Serialise to csv format
      * The output CSV excel csv with double quotes around cells and newlines for each record
@@ -66,6 +70,7 @@ public:
     void set_modified_false() override;
     CtAnchWidgType get_type() override { return CtAnchWidgType::Table; }
     std::shared_ptr<CtAnchoredWidgetState> get_state() override;
+    size_t get_memory_size() override;
 
     const CtTableMatrix& get_table_matrix() const { return _tableMatrix; }
     const CtTableColWidths& get_col_widths() const { return _colWidths; }
@@ -74,10 +79,14 @@ public:
         const size_t colIdx = optColIdx.value_or(_currentColumn);
         return _colWidths.at(colIdx) != 0 ? _colWidths.at(colIdx) : _colWidthDefault;
     }
+    /**
+     * @brief The text view editing the current cell, created if not yet
+     */
+    CtTextView& get_current_cell_text_view();
 
 public:
-    size_t current_row() { return _currentRow < _tableMatrix.size() ? _currentRow : 0; }
-    size_t current_column() { return _currentColumn < _tableMatrix.front().size() ? _currentColumn : 0; }
+    size_t current_row() { return _currentRow < _tableMatrix.get_rows_num() ? _currentRow : 0; }
+    size_t current_column() { return _currentColumn < _tableMatrix.get_cols_num() ? _currentColumn : 0; }
 
     void column_add(const size_t afterColIdx);
     void column_delete(const size_t colIdx);
@@ -94,25 +103,61 @@ public:
     void set_col_width(const int colWidth, std::optional<size_t> optColIdx = std::nullopt);
 
 private:
-    void _apply_styles_to_cells(const bool forceReApply);
-    void _new_text_cell_attach(const size_t rowIdx, const size_t colIdx, CtTextCell* pTextCell);
-    bool _row_sort(const bool sortAsc);
+    enum { CELL_PADDING = 2, MEASURE_ROWS_PER_IDLE = 100 };
+
+    struct RowHeight
+    {
+        int  height;
+        bool measured; // else estimated from the number of lines
+    };
+
+    CtTextCell& _get_edit_cell();
+    void _edit_cell(const size_t rowIdx, const size_t colIdx);
+    /**
+     * @brief Loads again the current cell in the text view if any, after the cells moved
+     */
+    void _reload_edit_cell();
     void _apply_remove_header_style(const bool isApply, CtTextView& textView);
+    bool _row_sort(const bool sortAsc);
 
-protected:
-    void _populate_xml_rows_cells(xmlpp::Element* p_table_node);
+    Glib::RefPtr<Pango::Layout> _get_cell_layout(const size_t rowIdx, const size_t colIdx);
+    int  _get_col_draw_width(const size_t colIdx) const;
+    int  _get_col_x(const size_t colIdx) const;
+    RowHeight _estimate_row_height(const size_t rowIdx);
+    void _measure_row(const size_t rowIdx);
+    /**
+     * @brief All the rows are estimated again and measured in the idle time, e.g. after a change of the columns
+     */
+    void _invalidate_rows();
+    /**
+     * @brief Updates the rows position and the size of the drawing area after a change of the rows height
+     */
+    void _update_size();
+    bool _find_cell_at(const int x, const int y, size_t& rowIdx, size_t& colIdx) const;
 
 private:
     void _on_populate_popup_cell(Gtk::Menu* menu);
     bool _on_key_press_event_cell(GdkEventKey* event);
-    bool _on_button_press_event_grid(GdkEventButton* event);
-    void _on_set_focus_child_grid(Gtk::Widget* pWidget);
+    void _on_changed_edit_cell_buffer();
+    bool _on_button_press_event_cells(GdkEventButton* event);
+    void _on_idle_popup_menu_cell();
+    bool _on_draw_cells(const Cairo::RefPtr<Cairo::Context>& cr);
+    bool _on_get_child_position_overlay(Gtk::Widget* pWidget, Gdk::Rectangle& allocation);
+    bool _on_idle_measure_rows();
 
 protected:
     CtTableMatrix    _tableMatrix;
-    Gtk::Grid        _grid;
+    Gtk::Overlay     _overlay;
+    Gtk::DrawingArea _drawingArea;
+    std::unique_ptr<CtTextCell> _uEditCell;
+    bool             _loadingEditCell{false};
     int              _colWidthDefault;
     CtTableColWidths _colWidths;
+    std::vector<int> _colNaturalWidths; // the widest line of the cells not wrapped
+    std::vector<RowHeight> _rowHeights;
+    std::vector<int> _rowsY;            // the top of every row and then the bottom of the table
+    int              _lineHeight{0};
+    sigc::connection _measureConnection;
     size_t           _currentRow{0};
     size_t           _currentColumn{0};
 };
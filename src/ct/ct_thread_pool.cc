@@ -0,0 +1,209 @@
+/*
+ * ct_thread_pool.cc
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "ct_thread_pool.h"
+#include <chrono>
+
+namespace {
+
+// the pool and queue of the current thread if it is a worker
+thread_local CtThreadPool* t_pool{nullptr};
+thread_local int t_worker_index{-1};
+
+} // namespace
+
+CtThreadPool::TaskGroup::TaskGroup(CtThreadPool& pool)
+ : _pool{pool}
+ , _state{std::make_shared<State>()}
+{
+}
+
+CtThreadPool::TaskGroup::~TaskGroup()
+{
+    _wait_done();
+}
+
+void CtThreadPool::TaskGroup::run(std::function<void()> task)
+{
+    ++_state->pending;
+    _pool._submit(Task{std::move(task), _state});
+}
+
+void CtThreadPool::TaskGroup::wait()
+{
+    _wait_done();
+    std::exception_ptr exception;
+    {
+        std::lock_guard<std::mutex> lock{_state->mutex};
+        std::swap(exception, _state->exception);
+    }
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+void CtThreadPool::TaskGroup::cancel()
+{
+    _state->cancelled = true;
+}
+
+void CtThreadPool::TaskGroup::_wait_done()
+{
+    while (_state->pending > 0) {
+        if (_pool._try_run_one()) {
+            continue;
+        }
+        // the tasks left are running, still a running task may add more
+        std::unique_lock<std::mutex> lock{_state->mutex};
+        _state->cv_done.wait_for(lock, std::chrono::milliseconds{1}, [this](){ return 0 == _state->pending; });
+    }
+}
+
+CtThreadPool::CtThreadPool(size_t workers_num)
+{
+    for (size_t i = 0; i <= workers_num; ++i) {
+        _queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < workers_num; ++i) {
+        _workers.emplace_back(&CtThreadPool::_worker_loop, this, (int)i);
+    }
+}
+
+CtThreadPool::~CtThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock{_idle_mutex};
+        _stop = true;
+    }
+    _idle_cv.notify_all();
+    for (std::thread& worker : _workers) {
+        worker.join();
+    }
+}
+
+/*static*/ CtThreadPool& CtThreadPool::get_instance()
+{
+    static CtThreadPool pool{[](){
+        const size_t concur_num = std::thread::hardware_concurrency();
+        return concur_num == 0 ? 3u : concur_num - 1;
+    }()};
+    return pool;
+}
+
+void CtThreadPool::_submit(Task task)
+{
+    // a worker keeps the tasks it spawns for itself, the others can steal them
+    const size_t queue_index = t_pool == this ? t_worker_index : _queues.size() - 1;
+    {
+        // counted before it can be popped, so that the count never goes below the tasks in the queues
+        std::lock_guard<std::mutex> lock{_idle_mutex};
+        ++_queued;
+    }
+    {
+        std::lock_guard<std::mutex> lock{_queues[queue_index]->mutex};
+        _queues[queue_index]->tasks.push_back(std::move(task));
+    }
+    _idle_cv.notify_one();
+}
+
+bool CtThreadPool::_try_run_one()
+{
+    Task task;
+    if (not _try_pop(t_pool == this ? t_worker_index : -1, task)) {
+        return false;
+    }
+    _run(task);
+    return true;
+}
+
+bool CtThreadPool::_try_pop(const int worker_index, Task& task)
+{
+    auto pop = [&](WorkerQueue& queue, const bool from_back){
+        std::lock_guard<std::mutex> lock{queue.mutex};
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        if (from_back) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        --_queued;
+        return true;
+    };
+    // own queue last in first out, then the oldest tasks of the others
+    if (worker_index >= 0 and pop(*_queues[worker_index], true/*from_back*/)) {
+        return true;
+    }
+    const size_t queues_num = _queues.size();
+    const size_t first_index = worker_index >= 0 ? worker_index + 1 : 0;
+    for (size_t i = 0; i < queues_num; ++i) {
+        const size_t other_index = (first_index + i) % queues_num;
+        if ((int)other_index != worker_index and pop(*_queues[other_index], false/*from_back*/)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*static*/ void CtThreadPool::_run(Task& task)
+{
+    TaskGroup::State& group = *task.group;
+    if (not group.cancelled) {
+        try {
+            task.func();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock{group.mutex};
+            if (not group.exception) {
+                group.exception = std::current_exception();
+            }
+            group.cancelled = true;
+        }
+    }
+    if (1 == group.pending.fetch_sub(1)) {
+        std::lock_guard<std::mutex> lock{group.mutex};
+        group.cv_done.notify_all();
+    }
+}
+
+void CtThreadPool::_worker_loop(const int worker_index)
+{
+    t_pool = this;
+    t_worker_index = worker_index;
+    while (true) {
+        Task task;
+        if (_try_pop(worker_index, task)) {
+            _run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock{_idle_mutex};
+        _idle_cv.wait(lock, [this](){ return _stop or _queued > 0; });
+        if (_stop and 0 == _queued) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,117 @@
+/*
+ * ct_thread_pool.h
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Pool of worker threads, each with its own queue of tasks and stealing from the others when idle
+ * @class CtThreadPool
+ */
+class CtThreadPool
+{
+public:
+    /**
+     * @brief Tasks run on a pool and waited for together; the first exception thrown by a task
+     * cancels the tasks not started yet and is rethrown by wait()
+     * @class TaskGroup
+     */
+    class TaskGroup
+    {
+    public:
+        explicit TaskGroup(CtThreadPool& pool = CtThreadPool::get_instance());
+        ~TaskGroup();
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        void run(std::function<void()> task);
+        /**
+         * @brief Runs queued tasks while waiting, so that a task can wait for a nested group
+         */
+        void wait();
+        void cancel();
+        bool is_cancelled() const { return _state->cancelled; }
+
+    private:
+        friend class CtThreadPool;
+        void _wait_done();
+
+        struct State
+        {
+            std::atomic<size_t> pending{0};
+            std::atomic<bool>   cancelled{false};
+            std::exception_ptr  exception;
+            std::mutex          mutex;
+            std::condition_variable cv_done;
+        };
+
+        CtThreadPool&          _pool;
+        std::shared_ptr<State> _state;
+    };
+
+    explicit CtThreadPool(size_t workers_num);
+    ~CtThreadPool();
+    CtThreadPool(const CtThreadPool&) = delete;
+    CtThreadPool& operator=(const CtThreadPool&) = delete;
+
+    /**
+     * @brief The process wide pool, one worker per core but the one of the thread waiting for a group
+     */
+    static CtThreadPool& get_instance();
+
+    size_t get_workers_num() const { return _workers.size(); }
+
+private:
+    struct Task
+    {
+        std::function<void()> func;
+        std::shared_ptr<TaskGroup::State> group;
+    };
+    struct WorkerQueue
+    {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    void _submit(Task task);
+    bool _try_run_one();
+    bool _try_pop(const int worker_index, Task& task);
+    static void _run(Task& task);
+    void _worker_loop(const int worker_index);
+
+    std::vector<std::unique_ptr<WorkerQueue>> _queues; // one per worker, then the one of the other threads
+    std::vector<std::thread>    _workers;
+    std::atomic<size_t>         _queued{0}; // counted before pushed, never less than the tasks in the queues
+    std::atomic<bool>           _stop{false};
+    std::mutex                  _idle_mutex;
+    std::condition_variable     _idle_cv;
+};
@@ -26,6 +26,7 @@
 #include "ct_treestore.h"
 #include "ct_misc_utils.h"
 #include "ct_storage_control.h"
+#include "ct_storage_xml.h"
 #include "ct_actions.h"
 #include "ct_logging.h"
 
@@ -65,6 +66,7 @@ void CtTreeIter::set_node_id(const gint64 new_id)
 {
     if (*this) {
         (*this)->set_value(_pColumns->colNodeUniqueId, new_id);
+        _pCtMainWin->get_tree_store().node_index_update(*this);
     }
 }
 
@@ -106,6 +108,7 @@ Glib::ustring CtTreeIter::get_node_name() const
 void CtTreeIter::set_node_name(const Glib::ustring& node_name)
 {
     (*this)->set_value(_pColumns->colNodeName, node_name);
+    _pCtMainWin->get_tree_store().node_index_update(*this);
 }
 
 Glib::ustring CtTreeIter::get_node_tags() const
@@ -175,11 +178,21 @@ Glib::RefPtr<Gsv::Buffer> CtTreeIter::get_node_text_buffer() const
             std::list<CtAnchoredWidget*> anchoredWidgetList{};
             const auto nodeId = get_node_id();
             const auto nodeSyntaxHighl = get_node_syntax_highlighting();
-            rRetTextBuffer = _pCtMainWin->get_ct_storage()->get_delayed_text_buffer(nodeId,
-                                                                                    nodeSyntaxHighl,
-                                                                                    anchoredWidgetList);
+            CtDecodedNodeText decodedText;
+            if (_pCtMainWin->get_tree_store().take_node_cloned_text(nodeId, decodedText) or
+                _pCtMainWin->get_tree_store().get_nodes_prefetcher().take(nodeId, decodedText))
+            {
+                rRetTextBuffer = CtStorageXmlHelper{_pCtMainWin}.create_buffer_and_widgets_from_decoded(decodedText, anchoredWidgetList);
+            }
+            else {
+                rRetTextBuffer = _pCtMainWin->get_ct_storage()->get_delayed_text_buffer(nodeId,
+                                                                                        nodeSyntaxHighl,
+                                                                                        anchoredWidgetList);
+            }
             row.set_value(_pColumns->colAnchoredWidgets, anchoredWidgetList);
             row.set_value(_pColumns->rColTextBuffer, rRetTextBuffer);
+            CtTreeIter treeIter{*this};
+            _pCtMainWin->get_tree_store().get_buffers_cache().touch(treeIter);
         }
     }
     return rRetTextBuffer;
@@ -190,6 +203,27 @@ bool CtTreeIter::get_node_buffer_already_loaded() const
     return static_cast<bool>((*this)->get_value(_pColumns->rColTextBuffer));
 }
 
+void CtTreeIter::release_node_text_buffer()
+{
+    for (CtAnchoredWidget* pAnchoredWidget : (*this)->get_value(_pColumns->colAnchoredWidgets)) {
+        delete pAnchoredWidget;
+    }
+    (*this)->set_value(_pColumns->colAnchoredWidgets, std::list<CtAnchoredWidget*>());
+    (*this)->set_value(_pColumns->rColTextBuffer, Glib::RefPtr<Gsv::Buffer>());
+}
+
+size_t CtTreeIter::get_node_buffer_memory_size()
+{
+    if (not get_node_buffer_already_loaded()) {
+        return 0;
+    }
+    size_t memorySize = CtAnchoredWidget::get_text_buffer_memory_size((*this)->get_value(_pColumns->rColTextBuffer));
+    for (CtAnchoredWidget* pAnchoredWidget : (*this)->get_value(_pColumns->colAnchoredWidgets)) {
+        memorySize += pAnchoredWidget->get_memory_size();
+    }
+    return memorySize;
+}
+
 int CtTreeIter::get_pango_weight_from_is_bold(bool isBold)
 {
     return isBold ? PANGO_WEIGHT_HEAVY : PANGO_WEIGHT_NORMAL;
@@ -315,10 +349,353 @@ void CtTreeIter::pending_new_db_node()
     _pCtMainWin->get_ct_storage()->pending_new_db_node(get_node_id());
 }
 
+CtBuffersCache::CtBuffersCache(CtMainWin* pCtMainWin)
+ : _pCtMainWin{pCtMainWin}
+{
+}
+
+CtBuffersCache::~CtBuffersCache()
+{
+    _releaseConnection.disconnect();
+}
+
+void CtBuffersCache::touch(CtTreeIter& treeIter)
+{
+    if (not treeIter or not treeIter.get_node_buffer_already_loaded()) {
+        return;
+    }
+    const gint64 nodeId = treeIter.get_node_id();
+    const auto iterEntry = _entries.find(nodeId);
+    if (iterEntry != _entries.end()) {
+        _lruNodeIds.splice(_lruNodeIds.end(), _lruNodeIds, iterEntry->second.lruIter);
+        return;
+    }
+    const size_t memorySize = treeIter.get_node_buffer_memory_size();
+    _lruNodeIds.push_back(nodeId);
+    _entries[nodeId] = Entry{memorySize, std::prev(_lruNodeIds.end())};
+    _memorySize += memorySize;
+    if (is_over_budget() and not _releaseConnection.connected()) {
+        // not right now, the caller may be using the buffers of other nodes
+        _releaseConnection = Glib::signal_timeout().connect_seconds([this](){
+            if (not _pCtMainWin->user_active()) {
+                return true; // busy, e.g. searching, try again later
+            }
+            _release();
+            return false;
+        }, 1);
+    }
+}
+
+bool CtBuffersCache::is_over_budget() const
+{
+    const size_t budgetSize = _get_budget_size();
+    return budgetSize != 0 and _memorySize > budgetSize;
+}
+
+void CtBuffersCache::release_over_budget()
+{
+    _releaseConnection.disconnect();
+    _release();
+}
+
+CtBuffersCache::Stats CtBuffersCache::get_stats()
+{
+    _refresh_entries();
+    Stats stats;
+    CtTreeStore& treeStore = _pCtMainWin->get_tree_store();
+    for (const auto& entryPair : _entries) {
+        CtTreeIter treeIter = treeStore.get_node_from_node_id(entryPair.first);
+        if (_can_release(treeIter)) {
+            ++stats.releasable_num;
+            stats.releasable_size += entryPair.second.memorySize;
+        }
+    }
+    stats.resident_num = _entries.size();
+    stats.resident_size = _memorySize;
+    stats.released_num = _releasedNum;
+    stats.budget_size = _get_budget_size();
+    return stats;
+}
+
+size_t CtBuffersCache::_get_budget_size() const
+{
+    return (size_t)std::max(0, _pCtMainWin->get_ct_config()->nodesMemoryBudgetMB) * 1024u * 1024u;
+}
+
+bool CtBuffersCache::_can_release(CtTreeIter& treeIter)
+{
+    if (not treeIter or not treeIter.get_node_buffer_already_loaded() or
+        treeIter.get_node_id() == _pCtMainWin->curr_tree_iter().get_node_id())
+    {
+        return false;
+    }
+    if (not _pCtMainWin->get_ct_storage()->can_reload_text_buffer(treeIter.get_node_id())) {
+        return false;
+    }
+    Glib::RefPtr<Gsv::Buffer> rTextBuffer = treeIter.get_node_text_buffer();
+    // the tree row and rTextBuffer, any other reference is a user of the buffer
+    return not rTextBuffer->get_modified() and G_OBJECT(rTextBuffer->gobj())->ref_count <= 2;
+}
+
+void CtBuffersCache::_refresh_entries()
+{
+    CtTreeStore& treeStore = _pCtMainWin->get_tree_store();
+    _memorySize = 0;
+    for (auto iterNodeId = _lruNodeIds.begin(); iterNodeId != _lruNodeIds.end();) {
+        CtTreeIter treeIter = treeStore.get_node_from_node_id(*iterNodeId);
+        if (not treeIter or not treeIter.get_node_buffer_already_loaded()) {
+            _entries.erase(*iterNodeId);
+            iterNodeId = _lruNodeIds.erase(iterNodeId);
+            continue;
+        }
+        Entry& entry = _entries.at(*iterNodeId);
+        entry.memorySize = treeIter.get_node_buffer_memory_size();
+        _memorySize += entry.memorySize;
+        ++iterNodeId;
+    }
+}
+
+void CtBuffersCache::_release()
+{
+    const size_t budgetSize = _get_budget_size();
+    if (0 == budgetSize) {
+        return;
+    }
+    _refresh_entries();
+    if (_memorySize <= budgetSize) {
+        return;
+    }
+    // down to 3/4 of the budget, not to release again at every node loaded
+    const size_t targetSize = budgetSize / 4u * 3u;
+    const size_t releasedNumBefore = _releasedNum;
+    CtTreeStore& treeStore = _pCtMainWin->get_tree_store();
+    for (auto iterNodeId = _lruNodeIds.begin(); iterNodeId != _lruNodeIds.end() and _memorySize > targetSize;) {
+        CtTreeIter treeIter = treeStore.get_node_from_node_id(*iterNodeId);
+        if (not _can_release(treeIter)) {
+            ++iterNodeId;
+            continue;
+        }
+        _pCtMainWin->get_state_machine().buffer_released(*iterNodeId);
+        treeIter.release_node_text_buffer();
+        _memorySize -= _entries.at(*iterNodeId).memorySize;
+        _entries.erase(*iterNodeId);
+        iterNodeId = _lruNodeIds.erase(iterNodeId);
+        ++_releasedNum;
+    }
+    spdlog::debug("{} node buffers released, {} loaded for {} bytes", _releasedNum - releasedNumBefore, _entries.size(), _memorySize);
+}
+
+CtNodesPrefetcher::CtNodesPrefetcher(CtMainWin* pCtMainWin)
+ : _pCtMainWin{pCtMainWin}
+{
+}
+
+CtNodesPrefetcher::~CtNodesPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _stop = true;
+    }
+    _cvQueued.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void CtNodesPrefetcher::prefetch_around(CtTreeIter& treeIter)
+{
+    if (not treeIter or treeIter.get_node_id() == _aroundNodeId) {
+        return;
+    }
+    _aroundNodeId = treeIter.get_node_id();
+
+    std::vector<gint64> nodeIds;
+    auto add_if_not_loaded = [&](const Gtk::TreeIter& iter) {
+        if (iter) {
+            CtTreeIter ctIter = _pCtMainWin->get_tree_store().to_ct_tree_iter(iter);
+            if (not ctIter.get_node_buffer_already_loaded()) {
+                nodeIds.push_back(ctIter.get_node_id());
+            }
+        }
+    };
+    add_if_not_loaded(treeIter);
+    Gtk::TreeIter nextIter = treeIter;
+    add_if_not_loaded(++nextIter);
+    Gtk::TreePath prevPath = _pCtMainWin->get_tree_store().get_path(treeIter);
+    if (prevPath.prev()) {
+        add_if_not_loaded(_pCtMainWin->get_tree_store().get_store()->get_iter(prevPath));
+    }
+    size_t childrenNum{0};
+    for (Gtk::TreeIter childIter : treeIter->children()) {
+        if (childrenNum++ == MAX_CHILDREN) break;
+        add_if_not_loaded(childIter);
+    }
+    if (nodeIds.empty()) {
+        return;
+    }
+
+    if (not _pReader) {
+        _pReader = _pCtMainWin->get_ct_storage()->create_stored_text_reader();
+        if (not _pReader) {
+            return;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock{_mutex};
+        _queuedNodeIds.clear();
+        for (const gint64 nodeId : nodeIds) {
+            const bool isDecoded = std::any_of(_decodedNodes.begin(), _decodedNodes.end(), [nodeId](const auto& decoded){
+                return decoded.first == nodeId;
+            });
+            if (not isDecoded and nodeId != _decodingNodeId) {
+                _queuedNodeIds.push_back(nodeId);
+            }
+        }
+        if (not _thread.joinable()) {
+            _thread = std::thread{&CtNodesPrefetcher::_decode_loop, this};
+        }
+    }
+    _cvQueued.notify_one();
+}
+
+bool CtNodesPrefetcher::take(const gint64 node_id, CtDecodedNodeText& decoded_text)
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    _queuedNodeIds.erase(std::remove(_queuedNodeIds.begin(), _queuedNodeIds.end(), node_id), _queuedNodeIds.end());
+    // decoding it again here would take longer than waiting
+    _cvDecoded.wait(lock, [&](){ return _decodingNodeId != node_id; });
+    for (auto iter = _decodedNodes.begin(); iter != _decodedNodes.end(); ++iter) {
+        if (iter->first == node_id) {
+            decoded_text = std::move(iter->second);
+            _decodedNodes.erase(iter);
+            return true;
+        }
+    }
+    return false;
+}
+
+void CtNodesPrefetcher::reset()
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    ++_generation;
+    _queuedNodeIds.clear();
+    _decodedNodes.clear();
+    _pReader.reset();
+    _aroundNodeId = -1;
+    // the decoding thread drops its copy of the reader before it is done with the node
+    _cvDecoded.wait(lock, [this](){ return _decodingNodeId == -1; });
+}
+
+void CtNodesPrefetcher::reader_recreate()
+{
+    std::shared_ptr<CtStoredTextReader> pReader = _pCtMainWin->get_ct_storage()->create_stored_text_reader();
+    std::lock_guard<std::mutex> lock{_mutex};
+    _pReader = std::move(pReader);
+}
+
+void CtNodesPrefetcher::_decode_loop()
+{
+    std::unique_lock<std::mutex> lock{_mutex};
+    while (true) {
+        _cvQueued.wait(lock, [this](){ return _stop or not _queuedNodeIds.empty(); });
+        if (_stop) {
+            return;
+        }
+        const gint64 nodeId = _queuedNodeIds.front();
+        _queuedNodeIds.pop_front();
+        std::shared_ptr<CtStoredTextReader> pReader = _pReader;
+        const unsigned generation = _generation;
+        _decodingNodeId = nodeId;
+        lock.unlock();
+
+        CtDecodedNodeText decodedText;
+        bool isDecoded{false};
+        if (pReader) {
+            try {
+                isDecoded = pReader->get_decoded_node_text(nodeId, decodedText);
+            }
+            catch (std::exception& e) {
+                spdlog::error("{} {} {}", __FUNCTION__, nodeId, e.what());
+            }
+        }
+        pReader.reset();
+
+        lock.lock();
+        _decodingNodeId = -1;
+        if (isDecoded and generation == _generation) {
+            _decodedNodes.emplace_back(nodeId, std::move(decodedText));
+            if (_decodedNodes.size() > MAX_DECODED) {
+                _decodedNodes.pop_front();
+            }
+        }
+        _cvDecoded.notify_all();
+    }
+}
+
+void CtTextStatsTracker::track(Glib::RefPtr<Gtk::TextBuffer> rTextBuffer)
+{
+    _rTextBuffer = rTextBuffer;
+    _counted = false;
+}
+
+const CtTextStats& CtTextStatsTracker::get_stats()
+{
+    if (not _counted) {
+        _stats = _rTextBuffer ? CtTextIterUtil::get_text_stats(_rTextBuffer->get_text(true)) : CtTextStats{};
+        _counted = true;
+    }
+    return _stats;
+}
+
+size_t CtTextStatsTracker::_get_lines_words(Gtk::TextIter start, Gtk::TextIter end)
+{
+    start.set_line_offset(0);
+    if (not end.ends_line()) {
+        end.forward_to_line_end();
+    }
+    return CtTextIterUtil::get_words_count(start.get_text(end));
+}
+
+void CtTextStatsTracker::on_insert_before(const Gtk::TextIter& pos, const Glib::ustring& /*text*/)
+{
+    if (not _counted or pos.get_buffer() != _rTextBuffer) return;
+    _wordsBefore = _get_lines_words(pos, pos);
+}
+
+void CtTextStatsTracker::on_insert_after(const Gtk::TextIter& pos, const Glib::ustring& text, int /*bytes*/)
+{
+    if (not _counted or pos.get_buffer() != _rTextBuffer) return;
+    // pos is now at the end of the inserted text
+    Gtk::TextIter start = pos;
+    start.backward_chars(text.size());
+    _stats.words = _stats.words + _get_lines_words(start, pos) - _wordsBefore;
+    _stats.chars += text.size();
+    _stats.lines += std::count(text.raw().begin(), text.raw().end(), '\n');
+}
+
+void CtTextStatsTracker::on_erase_before(const Gtk::TextIter& range_start, const Gtk::TextIter& range_end)
+{
+    if (not _counted or range_start.get_buffer() != _rTextBuffer) return;
+    _wordsBefore = _get_lines_words(range_start, range_end);
+    const Glib::ustring text = range_start.get_text(range_end);
+    _stats.chars -= text.size();
+    _stats.lines -= std::count(text.raw().begin(), text.raw().end(), '\n');
+}
+
+void CtTextStatsTracker::on_erase_after(const Gtk::TextIter& range_start, const Gtk::TextIter& /*range_end*/)
+{
+    if (not _counted or range_start.get_buffer() != _rTextBuffer) return;
+    // range_start and range_end are now both where the text was
+    _stats.words = _stats.words + _get_lines_words(range_start, range_start) - _wordsBefore;
+}
+
 CtTreeStore::CtTreeStore(CtMainWin* pCtMainWin)
  : _pCtMainWin{pCtMainWin}
+ , _buffersCache{pCtMainWin}
+ , _nodesPrefetcher{pCtMainWin}
 {
     _rTreeStore = Gtk::TreeStore::create(_columns);
+    _rTreeStore->signal_row_deleted().connect(sigc::mem_fun(*this, &CtTreeStore::_on_row_deleted));
 }
 
 CtTreeStore::~CtTreeStore()
@@ -331,9 +708,28 @@ CtTreeStore::~CtTreeStore()
 
 void CtTreeStore::pending_rm_db_nodes(const std::vector<gint64>& node_ids)
 {
+    for (const gint64 node_id : node_ids) {
+        _nodes_cloned_texts.erase(node_id);
+    }
     _pCtMainWin->get_ct_storage()->pending_rm_db_nodes(node_ids);
 }
 
+void CtTreeStore::set_node_cloned_text(const gint64 node_id, CtDecodedNodeText&& decoded_text)
+{
+    _nodes_cloned_texts[node_id] = std::move(decoded_text);
+}
+
+bool CtTreeStore::take_node_cloned_text(const gint64 node_id, CtDecodedNodeText& decoded_text)
+{
+    auto iterCloned = _nodes_cloned_texts.find(node_id);
+    if (iterCloned == _nodes_cloned_texts.end()) {
+        return false;
+    }
+    decoded_text = std::move(iterCloned->second);
+    _nodes_cloned_texts.erase(iterCloned);
+    return true;
+}
+
 void CtTreeStore::pending_edit_db_bookmarks()
 {
     _pCtMainWin->get_ct_storage()->pending_edit_db_bookmarks();
@@ -460,6 +856,7 @@ void CtTreeStore::text_view_apply_textbuffer(CtTreeIter& treeIter, CtTextView* p
         pTextView->set_buffer(Glib::RefPtr<Gsv::Buffer>{});
         pTextView->set_spell_check(false);
         pTextView->set_sensitive(false);
+        _textStatsTracker.track(Glib::RefPtr<Gtk::TextBuffer>{});
         return;
     }
 
@@ -518,6 +915,13 @@ void CtTreeStore::text_view_apply_textbuffer(CtTreeIter& treeIter, CtTextView* p
     _curr_node_sigc_conn.push_back(
         rTextBuffer->signal_mark_set().connect(sigc::mem_fun(*this, &CtTreeStore::_on_textbuffer_mark_set), false)
     );
+    _textStatsTracker.track(rTextBuffer);
+    _curr_node_sigc_conn.push_back(
+        rTextBuffer->signal_insert().connect(sigc::mem_fun(_textStatsTracker, &CtTextStatsTracker::on_insert_after), true)
+    );
+    _curr_node_sigc_conn.push_back(
+        rTextBuffer->signal_erase().connect(sigc::mem_fun(_textStatsTracker, &CtTextStatsTracker::on_erase_after), true)
+    );
     if (node_is_rich_text) {
         const auto nodeId = treeIter.get_node_id();
         _curr_node_sigc_conn.push_back(
@@ -559,11 +963,11 @@ Glib::RefPtr<Gdk::Pixbuf> CtTreeStore::_get_node_icon(int nodeDepth, const std::
     return rPixbuf;
 }
 
-void CtTreeStore::get_node_data(const Gtk::TreeIter& treeIter, CtNodeData& nodeData)
+void CtTreeStore::get_node_data(const Gtk::TreeIter& treeIter, CtNodeData& nodeData, const bool loadTextBuffer/*= true*/)
 {
     Gtk::TreeRow row = *treeIter;
 
-    if (!treeIter->get_value(_columns.rColTextBuffer)) {
+    if (loadTextBuffer and !treeIter->get_value(_columns.rColTextBuffer)) {
         to_ct_tree_iter(treeIter).get_node_text_buffer();
     }
 
@@ -604,7 +1008,7 @@ void CtTreeStore::update_node_data(const Gtk::TreeIter& treeIter, const CtNodeDa
 
     update_node_aux_icon(treeIter);
     add_used_tags(nodeData.tags);
-    _nodes_names_dict[nodeData.nodeId] = nodeData.name;
+    node_index_update(treeIter);
 }
 
 void CtTreeStore::update_node_icon(const Gtk::TreeIter& treeIter)
@@ -663,6 +1067,11 @@ Gtk::TreeIter CtTreeStore::insert_node(CtNodeData* pNodeData, const Gtk::TreeIte
     return newIter;
 }
 
+void CtTreeStore::_on_row_deleted(const Gtk::TreeModel::Path& /*path*/)
+{
+    _nodes_index_stale = true;
+}
+
 void CtTreeStore::_on_textbuffer_modified_changed(Glib::RefPtr<Gtk::TextBuffer> rTextBuffer)
 {
     if (_pCtMainWin->user_active() and rTextBuffer->get_modified()) {
@@ -672,6 +1081,7 @@ void CtTreeStore::_on_textbuffer_modified_changed(Glib::RefPtr<Gtk::TextBuffer>
 
 void CtTreeStore::_on_textbuffer_insert(const Gtk::TextBuffer::iterator& pos, const Glib::ustring& text, int /*bytes*/)
 {
+    _textStatsTracker.on_insert_before(pos, text);
     if (_pCtMainWin->user_active() and not _pCtMainWin->get_text_view().own_insert_delete_active()) {
         _pCtMainWin->get_text_view().text_inserted(pos, text);
         CtTreeIter currTreeIter = _pCtMainWin->curr_tree_iter();
@@ -683,6 +1093,7 @@ void CtTreeStore::_on_textbuffer_insert(const Gtk::TextBuffer::iterator& pos, co
 
 void CtTreeStore::_on_textbuffer_erase(const Gtk::TextBuffer::iterator& range_start, const Gtk::TextBuffer::iterator& range_end)
 {
+    _textStatsTracker.on_erase_before(range_start, range_end);
     if (_pCtMainWin->user_active() and not _pCtMainWin->get_text_view().own_insert_delete_active()) {
        _pCtMainWin->get_text_view().text_removed(range_start, range_end);
         CtTreeIter currTreeIter = _pCtMainWin->curr_tree_iter();
@@ -715,6 +1126,10 @@ void CtTreeStore::addAnchoredWidgets(Gtk::TreeIter treeIter,
     }
     treeIter->set_value(_columns.colAnchoredWidgets, widgets);
 
+    if (not pTextView) {
+        // not the node in the text view, the widgets are added to it when the node is selected
+        return;
+    }
     for (CtAnchoredWidget* pCtAnchoredWidget : anchoredWidgetList) {
         Glib::RefPtr<Gtk::TextChildAnchor> rChildAnchor = pCtAnchoredWidget->getTextChildAnchor();
         if (rChildAnchor) {
@@ -743,14 +1158,8 @@ gint64 CtTreeStore::node_id_get(gint64 original_id, std::unordered_map<gint64,gi
 
     // (@txe) this function works differently from python code
     // it's easer to find max than check every id is not used through all tree
-    gint64 max_node_id{0};
-    _rTreeStore->foreach_iter([&max_node_id, this](const Gtk::TreeIter& iter){
-        if (iter->get_value(_columns.colNodeUniqueId) > max_node_id)
-        {
-            max_node_id = iter->get_value(_columns.colNodeUniqueId);
-        }
-        return false; /* continue */
-    });
+    _nodes_index_rebuild_if_stale();
+    gint64 max_node_id = _max_node_id;
     for (const gint64 curr_id : allocated_for_remapping_ids)
     {
         if (curr_id > max_node_id) {
@@ -797,26 +1206,71 @@ std::string CtTreeStore::get_node_name_from_node_id(const gint64 node_id)
 
 CtTreeIter CtTreeStore::get_node_from_node_id(const gint64 node_id)
 {
+    _nodes_index_rebuild_if_stale();
     Gtk::TreeIter find_iter;
-    _rTreeStore->foreach_iter([&node_id, &find_iter, this](const Gtk::TreeIter& iter) {
-        if (iter->get_value(_columns.colNodeUniqueId) != node_id) return false; /* continue */
-        find_iter = iter;
-        return true;
-    });
+    const auto iterFound = _nodes_iters.find(node_id);
+    // the row id may have been changed since indexed
+    if (iterFound != _nodes_iters.end() and iterFound->second->get_value(_columns.colNodeUniqueId) == node_id) {
+        find_iter = iterFound->second;
+    }
     return to_ct_tree_iter(find_iter);
 }
 
 CtTreeIter CtTreeStore::get_node_from_node_name(const Glib::ustring& node_name)
 {
+    _nodes_index_rebuild_if_stale();
     Gtk::TreeIter find_iter;
-    _rTreeStore->foreach_iter([&node_name, &find_iter, this](const Gtk::TreeIter& iter) {
-        if (iter->get_value(_columns.colNodeName) != node_name) return false; /* continue */
-        find_iter = iter;
-        return true;
-    });
+    const auto iterFound = _nodes_ids_by_name.find(node_name.raw());
+    if (iterFound == _nodes_ids_by_name.end()) {
+        return to_ct_tree_iter(find_iter);
+    }
+    std::set<gint64>& node_ids = iterFound->second;
+    for (auto iterId = node_ids.begin(); iterId != node_ids.end(); ) {
+        CtTreeIter tree_iter = get_node_from_node_id(*iterId);
+        if (not tree_iter or tree_iter.get_node_name() != node_name) {
+            iterId = node_ids.erase(iterId); // renamed or removed since indexed
+            continue;
+        }
+        // with more nodes of the same name, the first in the tree wins
+        if (not find_iter or get_path(tree_iter) < get_path(find_iter)) {
+            find_iter = tree_iter;
+        }
+        ++iterId;
+    }
     return to_ct_tree_iter(find_iter);
 }
 
+void CtTreeStore::node_index_update(const Gtk::TreeIter& treeIter)
+{
+    const gint64 node_id = treeIter->get_value(_columns.colNodeUniqueId);
+    const Glib::ustring node_name = treeIter->get_value(_columns.colNodeName);
+    _nodes_names_dict[node_id] = node_name;
+    if (_nodes_index_stale) {
+        return; // the whole index will be rebuilt
+    }
+    const auto iterFound = _nodes_iters.find(node_id);
+    // a duplicated id (to be fixed by the loader) does not take the place of the first node
+    if (iterFound == _nodes_iters.end() or iterFound->second->get_value(_columns.colNodeUniqueId) != node_id) {
+        _nodes_iters[node_id] = treeIter;
+    }
+    _nodes_ids_by_name[node_name.raw()].insert(node_id);
+    _max_node_id = std::max(_max_node_id, node_id);
+}
+
+void CtTreeStore::_nodes_index_rebuild_if_stale()
+{
+    if (not _nodes_index_stale) {
+        return;
+    }
+    _nodes_index_stale = false;
+    _nodes_iters.clear();
+    _nodes_ids_by_name.clear();
+    _rTreeStore->foreach_iter([this](const Gtk::TreeIter& iter){
+        node_index_update(iter);
+        return false; /* continue */
+    });
+}
+
 bool CtTreeStore::bookmarks_add(gint64 nodeId)
 {
     if (vec::exists(_bookmarks, nodeId)) {
@@ -879,6 +1333,16 @@ CtTreeIter CtTreeStore::to_ct_tree_iter(Gtk::TreeIter tree_iter)
 }
 
 void CtTreeStore::nodes_sequences_fix(Gtk::TreeIter father_iter,  bool process_children)
+{
+    std::vector<gint64> node_ids_hier_changed;
+    _nodes_sequences_fix(father_iter, process_children, node_ids_hier_changed);
+    if (not node_ids_hier_changed.empty()) {
+        // one batch, whatever the number of nodes moved
+        _pCtMainWin->get_ct_storage()->pending_edit_db_nodes_hier(node_ids_hier_changed);
+    }
+}
+
+void CtTreeStore::_nodes_sequences_fix(Gtk::TreeIter father_iter, bool process_children, std::vector<gint64>& node_ids_hier_changed)
 {
     auto children = father_iter ? father_iter->children() : _rTreeStore->children();
     gint64 node_sequence = 0;
@@ -887,16 +1351,28 @@ void CtTreeStore::nodes_sequences_fix(Gtk::TreeIter father_iter,  bool process_c
         auto ct_child = to_ct_tree_iter(child);
         if (ct_child.get_node_sequence() != node_sequence) {
             ct_child.set_node_sequence(node_sequence);
-            ct_child.pending_edit_db_node_hier();
+            node_ids_hier_changed.push_back(ct_child.get_node_id());
         }
         if (process_children) {
-            nodes_sequences_fix(child, process_children);
+            _nodes_sequences_fix(child, process_children, node_ids_hier_changed);
         }
     }
 }
 
 void CtTreeStore::populateSummaryInfo(CtSummaryInfo& summaryInfo)
 {
+    auto f_count_widget = [&summaryInfo](const CtAnchWidgType widgetType) {
+        switch (widgetType) {
+            case CtAnchWidgType::CodeBox: ++summaryInfo.codeboxes_num; break;
+            case CtAnchWidgType::ImageAnchor: ++summaryInfo.anchors_num; break;
+            case CtAnchWidgType::ImageEmbFile: ++summaryInfo.embfile_num; break;
+            case CtAnchWidgType::ImagePng: ++summaryInfo.images_num; break;
+            case CtAnchWidgType::Table: ++summaryInfo.tables_num; break;
+        }
+    };
+    // the nodes not loaded are counted from the storage, without building their text buffer
+    std::unique_ptr<CtStoredTextReader> pReader = _pCtMainWin->get_ct_storage()->create_stored_text_reader();
+    const gint64 currNodeId = _pCtMainWin->curr_tree_iter().get_node_id();
     _rTreeStore->foreach(
         [&](const Gtk::TreePath& /*treePath*/, const Gtk::TreeIter& treeIter)->bool{
             auto ctTreeIter = to_ct_tree_iter(treeIter);
@@ -910,17 +1386,38 @@ void CtTreeStore::populateSummaryInfo(CtSummaryInfo& summaryInfo)
             else {
                 ++summaryInfo.nodes_code_num;
             }
-            (void)ctTreeIter.get_node_text_buffer(); // ensure the node content is populated
-            for (CtAnchoredWidget* pAnchoredWidget : ctTreeIter.get_anchored_widgets_fast()) {
-                switch (pAnchoredWidget->get_type()) {
-                    case CtAnchWidgType::CodeBox: ++summaryInfo.codeboxes_num; break;
-                    case CtAnchWidgType::ImageAnchor: ++summaryInfo.anchors_num; break;
-                    case CtAnchWidgType::ImageEmbFile: ++summaryInfo.embfile_num; break;
-                    case CtAnchWidgType::ImagePng: ++summaryInfo.images_num; break;
-                    case CtAnchWidgType::Table: ++summaryInfo.tables_num; break;
+            CtStoredNodeText storedText;
+            if (not ctTreeIter.get_node_buffer_already_loaded() and
+                pReader and pReader->get_stored_node_text(ctTreeIter.get_node_id(), storedText))
+            {
+                for (const CtStoredNodeText::Widget& storedWidget : storedText.widgets) {
+                    f_count_widget(storedWidget.type);
                 }
+                summaryInfo.text_stats += CtTextIterUtil::get_text_stats(storedText.text);
+                return false; /* false for continue */
+            }
+            Glib::RefPtr<Gsv::Buffer> rTextBuffer = ctTreeIter.get_node_text_buffer(); // ensure the node content is populated
+            for (CtAnchoredWidget* pAnchoredWidget : ctTreeIter.get_anchored_widgets_fast()) {
+                f_count_widget(pAnchoredWidget->get_type());
+            }
+            if (ctTreeIter.get_node_id() == currNodeId) {
+                summaryInfo.text_stats += _textStatsTracker.get_stats();
+            }
+            else {
+                summaryInfo.text_stats += CtTextIterUtil::get_text_stats(rTextBuffer->get_text(true));
+            }
+            // not to hold all the nodes at once
+            if (_buffersCache.is_over_budget()) {
+                _buffersCache.release_over_budget();
             }
             return false; /* false for continue */
         }
     );
+    const CtBuffersCache::Stats buffersStats = _buffersCache.get_stats();
+    summaryInfo.loaded_num = buffersStats.resident_num;
+    summaryInfo.loaded_size = buffersStats.resident_size;
+    summaryInfo.releasable_num = buffersStats.releasable_num;
+    summaryInfo.releasable_size = buffersStats.releasable_size;
+    summaryInfo.released_num = buffersStats.released_num;
+    summaryInfo.memory_budget_size = buffersStats.budget_size;
 }
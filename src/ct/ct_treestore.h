@@ -26,7 +26,9 @@
 #include "ct_types.h"
 #include <gtkmm.h>
 #include <gtksourceviewmm.h>
+#include <list>
 #include <set>
+#include <thread>
 #include <unordered_map>
 
 class CtMainWin;
@@ -112,6 +114,14 @@ public:
     void                      set_node_text_buffer(Glib::RefPtr<Gsv::Buffer> new_buffer, const std::string& new_syntax_hilighting);
     Glib::RefPtr<Gsv::Buffer> get_node_text_buffer() const;
     bool                      get_node_buffer_already_loaded() const;
+    /**
+     * @brief Drops the text buffer and the widgets, get_node_text_buffer creates them again from the storage
+     */
+    void                      release_node_text_buffer();
+    /**
+     * @brief Rough count of the bytes held by the loaded text buffer and widgets
+     */
+    size_t                    get_node_buffer_memory_size();
 
     void                         remove_all_embedded_widgets();
     std::list<CtAnchoredWidget*> get_anchored_widgets_fast(const char doSort = 'n');
@@ -131,6 +141,141 @@ private:
     CtMainWin*                _pCtMainWin{nullptr};
 };
 
+/**
+ * @brief The nodes whose text buffer is loaded, least recently used first, with their estimated size.
+ * Beyond the memory budget the buffers that the storage can create again as they are, i.e. not modified
+ * since saved, are released with their widgets, except the one of the selected node
+ */
+class CtBuffersCache
+{
+public:
+    struct Stats
+    {
+        size_t resident_num{0};
+        size_t resident_size{0};
+        size_t releasable_num{0};
+        size_t releasable_size{0};
+        size_t released_num{0};
+        size_t budget_size{0};
+    };
+
+    CtBuffersCache(CtMainWin* pCtMainWin);
+    ~CtBuffersCache();
+
+    /**
+     * @brief The node buffer was loaded or used, so it is the most recently used
+     */
+    void touch(CtTreeIter& treeIter);
+    bool is_over_budget() const;
+    /**
+     * @brief Releases the least recently used buffers until within the budget, with some margin
+     */
+    void release_over_budget();
+    Stats get_stats();
+
+private:
+    struct Entry
+    {
+        size_t                      memorySize;
+        std::list<gint64>::iterator lruIter;
+    };
+    size_t _get_budget_size() const;
+    bool   _can_release(CtTreeIter& treeIter);
+    void   _release();
+    /**
+     * @brief Estimates again the loaded nodes, the buffers vary while edited, and forgets the released or removed ones
+     */
+    void   _refresh_entries();
+
+private:
+    CtMainWin*                        _pCtMainWin;
+    std::list<gint64>                 _lruNodeIds; // least recently used first
+    std::unordered_map<gint64, Entry> _entries;
+    size_t                            _memorySize{0};
+    size_t                            _releasedNum{0};
+    sigc::connection                  _releaseConnection;
+};
+
+/**
+ * @brief Decodes in a background thread the stored content of the not loaded nodes around the selected
+ * or hovered one, i.e. text runs with their tags and images, so that loading one of them in the main thread
+ * is left with the insertion in the text buffer and the creation of the widgets
+ */
+class CtNodesPrefetcher
+{
+public:
+    CtNodesPrefetcher(CtMainWin* pCtMainWin);
+    ~CtNodesPrefetcher();
+
+    /**
+     * @brief Queues the node, its next and previous siblings and its first children, replacing the nodes queued before
+     */
+    void prefetch_around(CtTreeIter& treeIter);
+    /**
+     * @brief Moves out the content decoded for the node, waiting for it if being decoded
+     * @return false if not decoded, the node is then dropped from the queue
+     */
+    bool take(const gint64 node_id, CtDecodedNodeText& decoded_text);
+    /**
+     * @brief Drops the queued and decoded nodes and the reader, waiting for the node being decoded if any,
+     * so that the stored document is no longer read; to be called before the document is saved
+     */
+    void reset();
+    /**
+     * @brief Creates the reader of the document as saved, the content decoded before may be outdated
+     */
+    void reader_recreate();
+
+private:
+    void _decode_loop();
+
+private:
+    static const size_t MAX_CHILDREN{8};
+    static const size_t MAX_DECODED{16};
+
+    CtMainWin*                          _pCtMainWin;
+    std::shared_ptr<CtStoredTextReader> _pReader; // created in the main thread, used by the decoding thread
+    std::thread                         _thread;
+    std::mutex                          _mutex;
+    std::condition_variable             _cvQueued;
+    std::condition_variable             _cvDecoded;
+    std::deque<gint64>                  _queuedNodeIds;
+    gint64                              _decodingNodeId{-1};
+    std::list<std::pair<gint64, CtDecodedNodeText>> _decodedNodes; // oldest first
+    gint64                              _aroundNodeId{-1};
+    unsigned                            _generation{0};  // increased by reset, to drop the decoding in progress
+    bool                                _stop{false};
+};
+
+/**
+ * @brief Words, chars and lines of the text buffer of the selected node, counted once when first asked
+ * and then adjusted at every insert and erase by recounting only the lines that were edited
+ */
+class CtTextStatsTracker
+{
+public:
+    void track(Glib::RefPtr<Gtk::TextBuffer> rTextBuffer);
+    const CtTextStats& get_stats();
+
+    // the *_before are called before the buffer changes, the *_after once changed
+    void on_insert_before(const Gtk::TextIter& pos, const Glib::ustring& text);
+    void on_insert_after(const Gtk::TextIter& pos, const Glib::ustring& text, int bytes);
+    void on_erase_before(const Gtk::TextIter& range_start, const Gtk::TextIter& range_end);
+    void on_erase_after(const Gtk::TextIter& range_start, const Gtk::TextIter& range_end);
+
+private:
+    /**
+     * @brief The words of the whole lines from the line of start to the line of end, words do not span lines
+     */
+    static size_t _get_lines_words(Gtk::TextIter start, Gtk::TextIter end);
+
+private:
+    Glib::RefPtr<Gtk::TextBuffer> _rTextBuffer;
+    CtTextStats                   _stats;
+    bool                          _counted{false};
+    size_t                        _wordsBefore{0};   // of the lines about to change
+};
+
 class CtTextView;
 
 class CtTreeStore : public sigc::trackable
@@ -142,7 +287,7 @@ public:
     void          tree_view_connect(Gtk::TreeView* pTreeView);
     void          text_view_apply_textbuffer(CtTreeIter& treeIter, CtTextView* pTextView);
 
-    void          get_node_data(const Gtk::TreeIter& treeIter, CtNodeData& nodeData);
+    void          get_node_data(const Gtk::TreeIter& treeIter, CtNodeData& nodeData, const bool loadTextBuffer = true);
     void          populateSummaryInfo(CtSummaryInfo& summaryInfo);
 
     void          update_node_data(const Gtk::TreeIter& treeIter, const CtNodeData& nodeData);
@@ -187,14 +332,27 @@ public:
     void nodes_sequences_fix(Gtk::TreeIter father_iter,  bool process_children);
 
     const CtTreeModelColumns& get_columns() { return _columns; }
+    CtBuffersCache&           get_buffers_cache() { return _buffersCache; }
+    CtNodesPrefetcher&        get_nodes_prefetcher() { return _nodesPrefetcher; }
+    CtTextStatsTracker&       get_text_stats_tracker() { return _textStatsTracker; }
 
     void pending_edit_db_bookmarks();
     void pending_rm_db_nodes(const std::vector<gint64>& node_ids);
+    /**
+     * @brief The content of a new node copied from another one, its buffer is created from it only when requested
+     */
+    void set_node_cloned_text(const gint64 node_id, CtDecodedNodeText&& decoded_text);
+    bool take_node_cloned_text(const gint64 node_id, CtDecodedNodeText& decoded_text);
+
+    void node_index_update(const Gtk::TreeIter& treeIter);
 
 protected:
     Glib::RefPtr<Gdk::Pixbuf> _get_node_icon(int nodeDepth, const std::string &syntax, guint32 customIconId);
+    void                      _nodes_index_rebuild_if_stale();
     void                      _iter_delete_anchored_widgets(const Gtk::TreeModel::Children& children);
+    void                      _nodes_sequences_fix(Gtk::TreeIter father_iter, bool process_children, std::vector<gint64>& node_ids_hier_changed);
 
+    void _on_row_deleted(const Gtk::TreeModel::Path& path);
     void _on_textbuffer_modified_changed(Glib::RefPtr<Gtk::TextBuffer> rTextBuffer);
     void _on_textbuffer_insert(const Gtk::TextBuffer::iterator& pos, const Glib::ustring& text, int bytes);
     void _on_textbuffer_erase(const Gtk::TextBuffer::iterator& range_start, const Gtk::TextBuffer::iterator& range_end);
@@ -206,6 +364,15 @@ private:
     std::list<gint64>               _bookmarks;
     std::set<Glib::ustring>         _usedTags;
     std::map<gint64, Glib::ustring> _nodes_names_dict; // for link tooltips
+    // the tree store rows persist until deleted, a deletion makes the whole index stale
+    std::unordered_map<gint64, Gtk::TreeIter>           _nodes_iters;
+    std::unordered_map<std::string, std::set<gint64>>   _nodes_ids_by_name;
+    bool                                                _nodes_index_stale{false};
+    std::unordered_map<gint64, CtDecodedNodeText>       _nodes_cloned_texts; // new nodes whose buffer is not yet created
+    gint64                                              _max_node_id{0};
     std::list<sigc::connection>     _curr_node_sigc_conn;
     CtMainWin*                      _pCtMainWin;
+    CtBuffersCache                  _buffersCache;
+    CtNodesPrefetcher               _nodesPrefetcher;
+    CtTextStatsTracker              _textStatsTracker;
 };
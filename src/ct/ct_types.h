@@ -26,14 +26,18 @@
 #include <string>
 #include <list>
 #include <set>
+#include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <deque>
 #include <mutex>
 #include <optional>
 #include <condition_variable>
+#include <chrono>
 #include <type_traits>
 #include <glibmm/ustring.h>
 #include <gtksourceviewmm/buffer.h>
+#include <gdkmm/pixbuf.h>
 
 namespace fs {
 class path;
@@ -96,9 +100,57 @@ struct CtRecentDocRestore
 };
 using CtRecentDocsRestore = std::unordered_map<std::string, CtRecentDocRestore>;
 
-class CtTextCell;
-using CtTableRow = std::vector<CtTextCell*>;
-using CtTableMatrix = std::vector<CtTableRow>;
+/**
+ * @brief The cells text of a table, the first row being the header. Each column keeps the text of its cells
+ * one after the other in a single string, with the offsets where they end, so that a table takes about
+ * the memory of its text whatever the number of cells
+ */
+class CtTableMatrix
+{
+public:
+    CtTableMatrix() = default;
+    /**
+     * @brief The first row sets the number of columns, the other rows are cut or completed with empty cells
+     */
+    explicit CtTableMatrix(const std::vector<std::vector<Glib::ustring>>& rows);
+
+    size_t get_rows_num() const { return _rowsNum; }
+    size_t get_cols_num() const { return _columns.size(); }
+    bool   empty() const { return 0 == _rowsNum or _columns.empty(); }
+    Glib::ustring get_cell(const size_t rowIdx, const size_t colIdx) const;
+    std::vector<Glib::ustring> get_row(const size_t rowIdx) const;
+    std::vector<std::vector<Glib::ustring>> get_rows() const;
+    size_t get_memory_size() const;
+
+    void set_cell(const size_t rowIdx, const size_t colIdx, const Glib::ustring& text);
+    /**
+     * @brief Inserts a row before rowIdx, with the given cells text if any
+     */
+    void row_insert(const size_t rowIdx, const std::vector<Glib::ustring>& cells = {});
+    void row_delete(const size_t rowIdx);
+    /**
+     * @brief Moves the rows so that the row at newOrder[i] goes at i
+     */
+    void rows_reorder(const std::vector<size_t>& newOrder);
+    void col_insert(const size_t colIdx);
+    void col_delete(const size_t colIdx);
+    void col_swap(const size_t colIdx1, const size_t colIdx2) { std::swap(_columns.at(colIdx1), _columns.at(colIdx2)); }
+
+    bool operator==(const CtTableMatrix& other) const { return _rowsNum == other._rowsNum and _columns == other._columns; }
+    bool operator!=(const CtTableMatrix& other) const { return not (*this == other); }
+
+private:
+    struct Column
+    {
+        std::string          text; // the cells text one after the other
+        std::vector<guint32> ends; // the end of every cell in text
+        bool operator==(const Column& other) const { return ends == other.ends and text == other.text; }
+    };
+    static size_t _cell_start(const Column& column, const size_t rowIdx) { return 0 == rowIdx ? 0u : column.ends[rowIdx-1]; }
+
+    std::vector<Column> _columns;
+    size_t              _rowsNum{0};
+};
 using CtTableColWidths = std::vector<int>;
 
 template<class TYPE>
@@ -219,6 +271,74 @@ private:
     vect_t        _internal_vec;
 };
 
+// node content as stored, to be searched without creating the text buffer and the widgets
+struct CtStoredNodeText
+{
+    struct Widget
+    {
+        int                      offset;  // offset in the text buffer, where each widget takes one character
+        CtAnchWidgType           type;
+        std::vector<std::string> texts;   // codebox text, table cells, anchor or embedded file name
+    };
+    std::string         text;     // text buffer content without the widgets
+    std::vector<Widget> widgets;  // sorted by offset
+};
+
+// node content decoded from the storage by a worker thread, so that the main thread is only left
+// with the insertion of the text in the buffer and the creation of the widgets
+struct CtDecodedNodeText
+{
+    struct TextRun
+    {
+        Glib::ustring text;
+        std::vector<std::pair<Glib::ustring, Glib::ustring>> tag_props;  // rich text tag property name and value
+    };
+    struct Widget
+    {
+        int                       offset{0};
+        CtAnchWidgType            type{CtAnchWidgType::ImagePng};
+        std::string               justification;
+        Glib::ustring             text;               // codebox text, anchor or embedded file name
+        Glib::ustring             link;               // png
+        std::string               raw_blob;           // png or embedded file bytes
+        Glib::RefPtr<Gdk::Pixbuf> pixbuf;             // png decoded from raw_blob
+        time_t                    time{0};            // embedded file
+        Glib::ustring             syntax;             // codebox
+        int                       frame_width{0};
+        int                       frame_height{0};
+        bool                      width_in_pixels{true};
+        bool                      highlight_brackets{true};
+        bool                      show_line_numbers{false};
+        std::vector<std::vector<Glib::ustring>> table_rows; // header row first
+        int                       col_width_default{0};
+        CtTableColWidths          col_widths;
+    };
+    std::vector<TextRun> runs;
+    std::vector<Widget>  widgets;               // sorted by offset, inserted after the text
+    bool                 is_sqlite_rows{false}; // the images are rows of the document database
+    bool                 with_pixbufs{true};    // set by the caller, false if only the png bytes are needed
+};
+
+struct CtStoredMatch
+{
+    int         start_offset;  // offsets in the text buffer
+    int         end_offset;
+    int         line_num;      // 1 based
+    std::string line_content;  // line of the match or widget description
+};
+
+/**
+ * @brief Reads the stored content of the nodes from a worker thread, independently from the storage
+ * used by the main thread; every worker owns its own reader
+ */
+class CtStoredTextReader
+{
+public:
+    virtual ~CtStoredTextReader() = default;
+    virtual bool get_stored_node_text(const gint64& node_id, CtStoredNodeText& stored_text) = 0;
+    virtual bool get_decoded_node_text(const gint64& node_id, CtDecodedNodeText& decoded_text) = 0;
+};
+
 struct CtStorageNodeState
 {
     bool upd{false};
@@ -249,6 +369,19 @@ public:
     virtual void test_connection() = 0;
 
     virtual bool populate_treestore(const fs::path& file_path, Glib::ustring& error) = 0;
+    /**
+     * @brief Load the decrypted content of an encrypted document, which is never written to disk
+     */
+    virtual bool populate_treestore_from_memory(std::string&& data, Glib::ustring& error) = 0;
+    /**
+     * @brief Whether the document can be kept in memory, i.e. loaded by populate_treestore_from_memory
+     * or saved by save_treestore to an empty file_path, then read by get_memory_data
+     */
+    virtual bool can_work_in_memory() const = 0;
+    /**
+     * @brief The whole content of a document kept in memory, as of the last save_treestore
+     */
+    virtual bool get_memory_data(std::string& data, Glib::ustring& error) = 0;
     virtual bool save_treestore(const fs::path& file_path,
                                 const CtStorageSyncPending& syncPending,
                                 Glib::ustring& error,
@@ -256,11 +389,35 @@ public:
                                 const int start_offset = 0,
                                 const int end_offset = -1) = 0;
     virtual void vacuum() = 0;
+    /**
+     * @brief Whether save_treestore to file_path would only append the pending changes, to a journal
+     * next to the file or to the end of the file, leaving what is already written untouched
+     */
+    virtual bool is_journal_save(const fs::path& file_path, const CtStorageSyncPending& syncPending) const = 0;
     virtual void import_nodes(const fs::path& path, const Gtk::TreeIter& parent_iter) = 0;
 
     virtual Glib::RefPtr<Gsv::Buffer> get_delayed_text_buffer(const gint64& node_id,
                                                               const std::string& syntax,
                                                               std::list<CtAnchoredWidget*>& widgets) const = 0;
+    /**
+     * @brief Whether get_delayed_text_buffer can create the buffer of the node as it was last saved
+     */
+    virtual bool can_reload_text_buffer(const gint64& node_id) const = 0;
+    /**
+     * @brief Ids of the stored nodes whose text may contain the given literal text (prefilter for searches)
+     * @return std::nullopt if the storage has no text index able to answer
+     */
+    virtual std::optional<std::unordered_set<gint64>> get_nodes_maybe_containing(const Glib::ustring& text) const = 0;
+    /**
+     * @brief Content of a node whose text buffer was not created yet, read from the storage
+     * @return false if not available (e.g. the node content was saved since loaded)
+     */
+    virtual bool get_stored_node_text(const gint64& node_id, CtStoredNodeText& stored_text) const = 0;
+    /**
+     * @brief Reader of the stored content for another thread, to be created in the main thread
+     * @return nullptr if the storage cannot be read outside of the main thread
+     */
+    virtual std::unique_ptr<CtStoredTextReader> create_stored_text_reader() const = 0;
 };
 
 struct CtExportOptions
@@ -269,6 +426,20 @@ struct CtExportOptions
     bool new_node_page{false};
     bool index_in_page{true};
     bool single_file{false};
+    bool incremental{false}; // multiple files export rewriting only the changed nodes, see CtExportManifest
+};
+
+struct CtTextStats
+{
+    size_t words{0};
+    size_t chars{0};
+    size_t lines{0};
+    CtTextStats& operator+=(const CtTextStats& other) {
+        words += other.words;
+        chars += other.chars;
+        lines += other.lines;
+        return *this;
+    }
 };
 
 struct CtSummaryInfo
@@ -281,6 +452,14 @@ struct CtSummaryInfo
     size_t tables_num{0};
     size_t codeboxes_num{0};
     size_t anchors_num{0};
+    CtTextStats text_stats;
+    // the nodes text buffers in memory
+    size_t loaded_num{0};
+    size_t loaded_size{0};
+    size_t releasable_num{0};
+    size_t releasable_size{0};
+    size_t released_num{0};
+    size_t memory_budget_size{0};
 };
 
 template<class F> auto scope_guard(F&& f) {
@@ -293,7 +472,7 @@ public:
     void push_back(T t) {
         std::lock_guard<std::mutex> lock(m);
         if (q.size() < MAX) {
-            q.push_back(t);
+            q.push_back(std::move(t));
             c.notify_one();
         }
     }
@@ -306,6 +485,15 @@ public:
         q.pop_front();
         return val;
     }
+    std::optional<T> pop_front_for(const std::chrono::milliseconds timeout) {
+        std::optional<T> retVal;
+        std::unique_lock<std::mutex> lock(m);
+        if (c.wait_for(lock, timeout, [this](){ return not q.empty(); })) {
+            retVal = std::move(q.front());
+            q.pop_front();
+        }
+        return retVal;
+    }
     std::optional<T> peek() const {
         std::optional<T> retVal;
         std::lock_guard<std::mutex> lock(m);
@@ -382,4 +570,6 @@ struct CtSearchState {
 
     Glib::RefPtr<CtMatchDialogStore> match_store;
     std::string   match_dialog_title;
+
+    std::optional<std::unordered_set<gint64>> candidate_node_ids; // nodes that may match, if known
 };
@@ -64,21 +64,28 @@ fs::path CtTmp::getHiddenFilePath(const fs::path& visiblePath)
 {
     if (not _mapHiddenFiles.count(visiblePath.string())) {
         fs::path tempDir = getHiddenDirPath(visiblePath);
-        fs::path basename = visiblePath.filename();
-        if (basename.extension() == ".ctx") {
-            basename = basename.stem();
-            basename += ".ctb";
-        }
-        else if (basename.extension() == ".ctz") {
-            basename = basename.stem();
-            basename += ".ctd";
-        }
+        fs::path basename = getHiddenFileName(visiblePath);
         _mapHiddenFiles[visiblePath.string()] = g_build_filename(tempDir.c_str(), basename.c_str(), nullptr);
     }
     return _mapHiddenFiles.at(visiblePath.string());
 }
 
+/*static*/ fs::path CtTmp::getHiddenFileName(const fs::path& visiblePath)
+{
+    fs::path basename = visiblePath.filename();
+    if (basename.extension() == ".ctx") {
+        basename = basename.stem();
+        basename += ".ctb";
+    }
+    else if (basename.extension() == ".ctz") {
+        basename = basename.stem();
+        basename += ".ctd";
+    }
+    return basename;
+}
+
 const double CtTextView::TEXT_SCROLL_MARGIN{0.1}; // margin as a [0.0,0.5] fraction of screen size
+const size_t CtAnchoredWidget::WIDGET_MEMORY_SIZE{4096}; // the gtk widgets of the frame and label
 
 CtAnchoredWidget::CtAnchoredWidget(CtMainWin* pCtMainWin, const int charOffset, const std::string& justification)
  : _pCtMainWin{pCtMainWin}
@@ -110,6 +117,12 @@ void CtAnchoredWidget::insertInTextBuffer(Glib::RefPtr<Gsv::Buffer> rTextBuffer)
     }
 }
 
+/*static*/ size_t CtAnchoredWidget::get_text_buffer_memory_size(Glib::RefPtr<Gtk::TextBuffer> rTextBuffer)
+{
+    // the chars as utf-8 with their segments and tag toggles, plus the btree line of each line
+    return rTextBuffer ? 4u*rTextBuffer->get_char_count() + 128u*rTextBuffer->get_line_count() : 0u;
+}
+
 void CtAnchoredWidget::_on_size_allocate_frame(Gtk::Allocation& allocation)
 {
     if (allocation == _lastAllocation) {
@@ -46,6 +46,10 @@ public:
     virtual ~CtTmp();
     fs::path getHiddenDirPath(const fs::path& visiblePath);
     fs::path getHiddenFilePath(const fs::path& visiblePath);
+    /**
+     * @brief The name of the unencrypted document packaged in the visible one, e.g. doc.ctd for doc.ctz
+     */
+    static fs::path getHiddenFileName(const fs::path& visiblePath);
 
 protected:
     std::unordered_map<std::string, gchar*> _mapHiddenDirs;
@@ -55,6 +59,7 @@ protected:
 class CtMainWin;
 class CtAnchoredWidgetState;
 class CtStorageCache;
+class CtSqliteStmtCache;
 class CtMarkdownFilter;
 
 class CtAnchoredWidget : public Gtk::EventBox
@@ -69,10 +74,19 @@ public:
     virtual void apply_width_height(const int parentTextWidth) = 0;
     virtual void apply_syntax_highlighting(const bool forceReApply) = 0;
     virtual void to_xml(xmlpp::Element* p_node_parent, const int offset_adjustment, CtStorageCache* cache) = 0;
-    virtual bool to_sqlite(sqlite3* pDb, const gint64 node_id, const int offset_adjustment, CtStorageCache* cache) = 0;
+    virtual bool to_sqlite(CtSqliteStmtCache& stmtCache, const gint64 node_id, const int offset_adjustment, CtStorageCache* cache) = 0;
     virtual void set_modified_false() = 0;
     virtual CtAnchWidgType get_type() = 0;
     virtual std::shared_ptr<CtAnchoredWidgetState> get_state() = 0;
+    /**
+     * @brief Rough count of the bytes held by the widget, to weigh the loaded nodes against the memory budget
+     */
+    virtual size_t get_memory_size() { return WIDGET_MEMORY_SIZE; }
+
+    /**
+     * @brief Rough count of the bytes held by a text buffer, from its chars and lines
+     */
+    static size_t get_text_buffer_memory_size(Glib::RefPtr<Gtk::TextBuffer> rTextBuffer);
 
     void updateOffset(int charOffset) { _charOffset = charOffset; }
     void updateJustification(const std::string& justification) { _justification = justification; }
@@ -84,6 +98,9 @@ public:
     bool operator<(const CtAnchoredWidget &other) { return getOffset() < other.getOffset(); }
     bool operator>(const CtAnchoredWidget &other) { return getOffset() > other.getOffset(); }
 
+public:
+    static const size_t WIDGET_MEMORY_SIZE;
+
 protected:
     void _on_size_allocate_frame(Gtk::Allocation& allocation);
 
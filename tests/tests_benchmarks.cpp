@@ -0,0 +1,204 @@
+/*
+ * tests_benchmarks.cpp
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "ct_main_win.h"
+#include "ct_misc_utils.h"
+#include "ct_storage_sqlite.h"
+#include "tests_common.h"
+#include <chrono>
+#include <iostream>
+
+static double elapsed_seconds(const std::function<void()>& func)
+{
+    const auto time_start = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - time_start;
+    return elapsed.count();
+}
+
+// the nodes are grouped under top level folders of 100 children each
+static void generate_ctb(const fs::path& ctb_path, const size_t nodes_num)
+{
+    if (fs::is_regular_file(ctb_path)) {
+        ASSERT_TRUE(fs::remove(ctb_path));
+    }
+    sqlite3* pDb{nullptr};
+    ASSERT_EQ(SQLITE_OK, sqlite3_open(ctb_path.c_str(), &pDb));
+    for (const char* sqlCmd : {CtStorageSqlite::TABLE_NODE_CREATE,
+                               CtStorageSqlite::TABLE_CODEBOX_CREATE,
+                               CtStorageSqlite::TABLE_TABLE_CREATE,
+                               CtStorageSqlite::TABLE_IMAGE_CREATE,
+                               CtStorageSqlite::TABLE_CHILDREN_CREATE,
+                               CtStorageSqlite::TABLE_BOOKMARK_CREATE,
+                               "BEGIN"})
+    {
+        ASSERT_EQ(SQLITE_OK, sqlite3_exec(pDb, sqlCmd, nullptr, nullptr, nullptr));
+    }
+    sqlite3_stmt* pStmtNode{nullptr};
+    sqlite3_stmt* pStmtChildren{nullptr};
+    ASSERT_EQ(SQLITE_OK, sqlite3_prepare_v2(pDb, CtStorageSqlite::TABLE_NODE_INSERT, -1, &pStmtNode, nullptr));
+    ASSERT_EQ(SQLITE_OK, sqlite3_prepare_v2(pDb, CtStorageSqlite::TABLE_CHILDREN_INSERT, -1, &pStmtChildren, nullptr));
+    gint64 folder_id{0};
+    for (size_t i = 0; i < nodes_num; ++i) {
+        const gint64 node_id = i + 1;
+        const bool is_folder = 0 == i % 100;
+        if (is_folder) folder_id = node_id;
+        const std::string node_name = "node " + std::to_string(node_id);
+        const std::string node_txt = "<?xml version=\"1.0\" ?><node><rich_text>" + node_name + "</rich_text></node>";
+        sqlite3_bind_int64(pStmtNode, 1, node_id);
+        sqlite3_bind_text(pStmtNode, 2, node_name.c_str(), node_name.size(), SQLITE_STATIC);
+        sqlite3_bind_text(pStmtNode, 3, node_txt.c_str(), node_txt.size(), SQLITE_STATIC);
+        sqlite3_bind_text(pStmtNode, 4, CtConst::RICH_TEXT_ID, -1, SQLITE_STATIC);
+        sqlite3_bind_text(pStmtNode, 5, "", 0, SQLITE_STATIC);
+        for (int col = 6; col <= 13; ++col) {
+            sqlite3_bind_int64(pStmtNode, col, 6 == col ? 0 : (7 == col ? 1 : 0));
+        }
+        ASSERT_EQ(SQLITE_DONE, sqlite3_step(pStmtNode));
+        sqlite3_reset(pStmtNode);
+        sqlite3_bind_int64(pStmtChildren, 1, node_id);
+        sqlite3_bind_int64(pStmtChildren, 2, is_folder ? 0 : folder_id);
+        sqlite3_bind_int64(pStmtChildren, 3, is_folder ? node_id : node_id - folder_id);
+        ASSERT_EQ(SQLITE_DONE, sqlite3_step(pStmtChildren));
+        sqlite3_reset(pStmtChildren);
+    }
+    sqlite3_finalize(pStmtNode);
+    sqlite3_finalize(pStmtChildren);
+    ASSERT_EQ(SQLITE_OK, sqlite3_exec(pDb, "COMMIT", nullptr, nullptr, nullptr));
+    sqlite3_close(pDb);
+}
+
+// one node with a codebox of lines_num lines and a table of lines_num rows, both spanning many pages
+static void generate_ctd_codebox_table(const fs::path& ctd_path, const size_t lines_num)
+{
+    std::string codebox_txt;
+    std::string table_rows;
+    for (size_t i = 0; i < lines_num; ++i) {
+        codebox_txt += "int line_" + std::to_string(i) + " = " + std::to_string(i) + "; // codebox line\n";
+        table_rows += "<row><cell>row " + std::to_string(i) + "</cell><cell>" + std::to_string(i * 7) + "</cell></row>";
+    }
+    const std::string ctd_txt = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><cherrytree>"
+        "<node name=\"pages\" unique_id=\"1\" prog_lang=\"custom-colors\" tags=\"\" readonly=\"0\" custom_icon_id=\"0\" is_bold=\"0\" foreground=\"\" ts_creation=\"0\" ts_lastsave=\"0\">"
+        "<rich_text>codebox and table\n</rich_text>"
+        "<codebox char_offset=\"18\" justification=\"left\" frame_width=\"500\" frame_height=\"100\" width_in_pixels=\"1\" syntax_highlighting=\"c\" highlight_brackets=\"0\" show_line_numbers=\"0\">" +
+        codebox_txt + "</codebox>"
+        "<table char_offset=\"19\" justification=\"left\" col_min=\"60\" col_max=\"200\">" +
+        table_rows + "<row><cell>name</cell><cell>value</cell></row></table>"
+        "</node></cherrytree>";
+    ASSERT_TRUE(g_file_set_contents(ctd_path.c_str(), ctd_txt.c_str(), (gssize)ctd_txt.size(), nullptr));
+}
+
+TEST(BenchmarksGroup, sqlite_load_time)
+{
+    UT::run_with_main_win([](CtMainWin* pWin){
+        const fs::path tmp_dirpath = pWin->get_ct_tmp()->getHiddenDirPath("UT");
+        std::vector<std::pair<size_t, double>> results;
+        for (const size_t nodes_num : {5000u, 20000u}) {
+            const fs::path ctb_path = tmp_dirpath / ("bench_" + std::to_string(nodes_num) + ".ctb");
+            generate_ctb(ctb_path, nodes_num);
+            const double secs = elapsed_seconds([&](){
+                ASSERT_TRUE(pWin->file_open(ctb_path, ""));
+            });
+            ASSERT_EQ((nodes_num+99)/100, pWin->get_tree_store().get_store()->children().size());
+            std::cout << "[ BENCH    ] load " << nodes_num << " nodes: " << secs << " sec" << std::endl;
+            results.push_back(std::make_pair(nodes_num, secs));
+        }
+        // 4x nodes must stay well below the 16x of a quadratic load
+        ASSERT_LT(results[1].second, 8.0 * results[0].second + 0.5);
+    });
+}
+
+TEST(BenchmarksGroup, sqlite_save_time)
+{
+    UT::run_with_main_win([](CtMainWin* pWin){
+        const fs::path tmp_dirpath = pWin->get_ct_tmp()->getHiddenDirPath("UT");
+        std::vector<std::pair<size_t, double>> results;
+        for (const size_t nodes_num : {5000u, 20000u}) {
+            const fs::path ctb_path = tmp_dirpath / ("bench_" + std::to_string(nodes_num) + ".ctb");
+            const fs::path ctb_saved_path = tmp_dirpath / ("bench_saved_" + std::to_string(nodes_num) + ".ctb");
+            generate_ctb(ctb_path, nodes_num);
+            ASSERT_TRUE(pWin->file_open(ctb_path, ""));
+            if (fs::is_regular_file(ctb_saved_path)) {
+                ASSERT_TRUE(fs::remove(ctb_saved_path));
+            }
+            const double secs = elapsed_seconds([&](){
+                pWin->file_save_as(ctb_saved_path.string(), "");
+            });
+            ASSERT_TRUE(fs::is_regular_file(ctb_saved_path));
+            std::cout << "[ BENCH    ] save " << nodes_num << " nodes: " << secs << " sec" << std::endl;
+            results.push_back(std::make_pair(nodes_num, secs));
+        }
+        // all the rows go in one transaction with the statements prepared once
+        ASSERT_LT(results[1].second, 8.0 * results[0].second + 0.5);
+    });
+}
+
+TEST(BenchmarksGroup, tree_store_lookup_time)
+{
+    UT::run_with_main_win([](CtMainWin* pWin){
+        const fs::path tmp_dirpath = pWin->get_ct_tmp()->getHiddenDirPath("UT");
+        std::vector<std::pair<size_t, double>> results;
+        for (const size_t nodes_num : {5000u, 20000u}) {
+            const fs::path ctb_path = tmp_dirpath / ("bench_" + std::to_string(nodes_num) + ".ctb");
+            generate_ctb(ctb_path, nodes_num);
+            ASSERT_TRUE(pWin->file_open(ctb_path, ""));
+            CtTreeStore& tree_store = pWin->get_tree_store();
+            const size_t lookups_num{2000};
+            const double secs = elapsed_seconds([&](){
+                for (size_t i = 0; i < lookups_num; ++i) {
+                    // spread over the whole tree, the last nodes being the worst for a scan
+                    const gint64 node_id = nodes_num - (i * 7) % nodes_num;
+                    ASSERT_EQ(node_id, tree_store.get_node_from_node_id(node_id).get_node_id());
+                    ASSERT_EQ(node_id, tree_store.get_node_from_node_name("node " + std::to_string(node_id)).get_node_id());
+                    ASSERT_EQ((gint64)nodes_num + 1, tree_store.node_id_get());
+                }
+            });
+            std::cout << "[ BENCH    ] " << lookups_num << " lookups in " << nodes_num << " nodes: " << secs << " sec" << std::endl;
+            results.push_back(std::make_pair(nodes_num, secs));
+        }
+        // 4x nodes must not make the lookups slower, as opposed to a scan of the tree
+        ASSERT_LT(results[1].second, 2.0 * results[0].second + 0.1);
+    });
+}
+
+TEST(BenchmarksGroup, pdf_export_time)
+{
+    UT::run_with_main_win([](CtMainWin* pWin){
+        const fs::path tmp_dirpath = pWin->get_ct_tmp()->getHiddenDirPath("UT");
+        std::vector<std::pair<size_t, double>> results;
+        for (const size_t lines_num : {1000u, 4000u}) {
+            const std::string doc_name = "bench_pdf_" + std::to_string(lines_num) + ".ctd";
+            const fs::path ctd_path = tmp_dirpath / doc_name;
+            const fs::path pdf_path = tmp_dirpath / (doc_name + ".pdf");
+            generate_ctd_codebox_table(ctd_path, lines_num);
+            ASSERT_TRUE(pWin->file_open(ctd_path, ""));
+            const double secs = elapsed_seconds([&](){
+                pWin->get_ct_actions()->export_to_pdf_auto(tmp_dirpath.string(), true/*overwrite*/);
+            });
+            ASSERT_NE(0, fs::file_size(pdf_path));
+            std::cout << "[ BENCH    ] pdf of " << lines_num << " codebox lines and table rows: " << secs << " sec" << std::endl;
+            results.push_back(std::make_pair(lines_num, secs));
+        }
+        // the codebox and the table are laid out once and cut into pages by the heights of their lines and rows
+        ASSERT_LT(results[1].second, 8.0 * results[0].second + 0.5);
+    });
+}
@@ -0,0 +1,83 @@
+/*
+ * tests_common.cpp
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "tests_common.h"
+#include "ct_app.h"
+#include "ct_main_win.h"
+#include "ct_misc_utils.h"
+#include <unistd.h>
+
+class TestCtAppMainWin : public CtApp
+{
+public:
+    // the id unique per process, the test executables can run in parallel
+    TestCtAppMainWin(const std::function<void(CtMainWin*)>& test_func)
+     : CtApp{("com.giuspen.cherrytree_test_" + std::to_string(getpid())).c_str()},
+       _test_func{test_func}
+    {
+        _no_gui = true;
+    }
+
+    CtMainWin* main_win_create() { return _create_window(true/*start_hidden*/); }
+    void main_win_remove(CtMainWin* pWin)
+    {
+        pWin->force_exit() = true;
+        remove_window(*pWin);
+    }
+
+    static TestCtAppMainWin* pRunning;
+
+private:
+    void on_activate() final
+    {
+        _on_startup();
+        CtMainWin* pWin = main_win_create();
+        _test_func(pWin);
+        main_win_remove(pWin);
+    }
+
+    std::function<void(CtMainWin*)> _test_func;
+};
+
+TestCtAppMainWin* TestCtAppMainWin::pRunning{nullptr};
+
+void UT::run_with_main_win(const std::function<void(CtMainWin*)>& func)
+{
+    const std::vector<std::string> vec_args{"cherrytree"};
+    gchar** pp_args = CtStrUtil::vector_to_array(vec_args);
+    TestCtAppMainWin testCtApp{func};
+    TestCtAppMainWin::pRunning = &testCtApp;
+    testCtApp.run(vec_args.size(), pp_args);
+    TestCtAppMainWin::pRunning = nullptr;
+    g_strfreev(pp_args);
+}
+
+CtMainWin* UT::main_win_create()
+{
+    return TestCtAppMainWin::pRunning->main_win_create();
+}
+
+void UT::main_win_remove(CtMainWin* pWin)
+{
+    TestCtAppMainWin::pRunning->main_win_remove(pWin);
+}
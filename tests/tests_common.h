@@ -29,9 +29,12 @@
 
 #include <string>
 #include <list>
+#include <functional>
 #include <glib/gstdio.h>
 #include <glibmm/miscutils.h>
 
+class CtMainWin;
+
 namespace UT {
 
 const std::string unitTestsDataDir{Glib::build_filename(_CMAKE_SOURCE_DIR, "tests", "data")};
@@ -44,4 +47,10 @@ const std::string testCtzDocPath{Glib::build_filename(unitTestsDataDir, "test.ct
 const gchar testPassword[]{"7zr"};
 const gchar testPasswordBis[]{"7zr2"};
 
+// runs func in a started application with a hidden main window, closed when func returns
+void run_with_main_win(const std::function<void(CtMainWin*)>& func);
+// while run_with_main_win runs, further hidden main windows for the tests that reopen documents
+CtMainWin* main_win_create();
+void main_win_remove(CtMainWin* pWin);
+
 } // namespace UT
@@ -22,7 +22,12 @@
  */
 
 #include "ct_app.h"
+#include "ct_main_win.h"
 #include "ct_misc_utils.h"
+#include "ct_export2html.h"
+#include "ct_export_manifest.h"
+#include "ct_document.h"
+#include "ct_document_export.h"
 #include "tests_common.h"
 
 class TestCtApp : public CtApp
@@ -134,3 +139,173 @@ INSTANTIATE_TEST_CASE_P(
                           std::make_tuple(UT::testCtbDocPath, "--export_to_html_dir"),
                           std::make_tuple(UT::testCtdDocPath, "--export_to_html_dir"))
 );
+
+TEST(ExportManifestGroup, incremental_export)
+{
+    CtTmp ctTmp;
+    const fs::path exportDir = ctTmp.getHiddenDirPath("UT");
+    const fs::path pageA = exportDir / "a.html";
+    const fs::path pageB = exportDir / "b.html";
+    const std::string contentA{"page a"};
+    const std::string contentB{"page b"};
+    auto f_write = [](const fs::path& filepath, const std::string& content) {
+        ASSERT_TRUE(g_file_set_contents(filepath.c_str(), content.c_str(), (gssize)content.size(), nullptr));
+    };
+    {
+        // first export, all the nodes and files are new
+        CtExportManifest manifest{exportDir, "layout"};
+        ASSERT_FALSE(manifest.keep_node_if_unchanged(1, 100));
+        ASSERT_TRUE(manifest.add_file(1, pageA, CtExportManifest::get_digest(contentA.c_str(), contentA.size())));
+        f_write(pageA, contentA);
+        ASSERT_FALSE(manifest.keep_node_if_unchanged(2, 100));
+        ASSERT_TRUE(manifest.add_file(2, pageB, CtExportManifest::get_digest(contentB.c_str(), contentB.size())));
+        f_write(pageB, contentB);
+        manifest.commit();
+        ASSERT_TRUE(CtExportManifest::is_in_folder(exportDir));
+    }
+    {
+        // node 1 not modified, node 2 modified but to the same content
+        CtExportManifest manifest{exportDir, "layout"};
+        ASSERT_TRUE(manifest.keep_node_if_unchanged(1, 100));
+        ASSERT_FALSE(manifest.keep_node_if_unchanged(2, 101));
+        ASSERT_FALSE(manifest.add_file(2, pageB, CtExportManifest::get_digest(contentB.c_str(), contentB.size())));
+        manifest.commit();
+    }
+    {
+        // node 2 removed
+        CtExportManifest manifest{exportDir, "layout"};
+        ASSERT_TRUE(manifest.keep_node_if_unchanged(1, 100));
+        manifest.commit();
+        ASSERT_TRUE(fs::is_regular_file(pageA));
+        ASSERT_FALSE(fs::is_regular_file(pageB));
+    }
+    {
+        // the layout changed, node 1 is checked again and its file missing is written
+        ASSERT_TRUE(fs::remove(pageA));
+        CtExportManifest manifest{exportDir, "layout changed"};
+        ASSERT_FALSE(manifest.keep_node_if_unchanged(1, 100));
+        ASSERT_TRUE(manifest.add_file(1, pageA, CtExportManifest::get_digest(contentA.c_str(), contentA.size())));
+    }
+}
+
+TEST(DocumentExportGroup, headless_export_and_convert)
+{
+    CtTmp ctTmp;
+    const fs::path exportDir = ctTmp.getHiddenDirPath("UT");
+    CtExportOptions exportOptions;
+    exportOptions.include_node_name = true;
+    exportOptions.single_file = true;
+    auto f_export_txt = [&](const CtDocument& document) {
+        const fs::path txtFilepath = CtDocumentExport{document, exportOptions, "~~~"}.export_to_txt(exportDir, true/*overwrite*/);
+        EXPECT_TRUE(fs::is_regular_file(txtFilepath));
+        return Glib::file_get_contents(txtFilepath.string());
+    };
+    Glib::ustring error;
+    std::unique_ptr<CtDocument> pDocCtb = CtDocument::load(UT::testCtbDocPath, "", error);
+    ASSERT_TRUE(pDocCtb);
+    std::unique_ptr<CtDocument> pDocCtd = CtDocument::load(UT::testCtdDocPath, "", error);
+    ASSERT_TRUE(pDocCtd);
+    ASSERT_FALSE(pDocCtb->get_nodes().empty());
+    ASSERT_EQ(pDocCtb->get_nodes().size(), pDocCtd->get_nodes().size());
+    for (size_t i = 0; i < pDocCtb->get_nodes().size(); ++i) {
+        ASSERT_EQ(pDocCtb->get_nodes()[i].node_data.name, pDocCtd->get_nodes()[i].node_data.name);
+        ASSERT_EQ(pDocCtb->get_nodes()[i].level, pDocCtd->get_nodes()[i].level);
+    }
+    // the same content from both the storages
+    const std::string txtCtb = f_export_txt(*pDocCtb);
+    ASSERT_NE(std::string::npos, txtCtb.find("# d\nsecond rich"));
+    ASSERT_EQ(txtCtb, f_export_txt(*pDocCtd));
+
+    // converted and read back
+    const fs::path convertedCtb = exportDir / "converted.ctb";
+    pDocCtd->save_as(convertedCtb);
+    std::unique_ptr<CtDocument> pDocConverted = CtDocument::load(convertedCtb, "", error);
+    ASSERT_TRUE(pDocConverted);
+    ASSERT_EQ(pDocCtd->get_nodes().size(), pDocConverted->get_nodes().size());
+    ASSERT_EQ(pDocCtd->get_bookmarks(), pDocConverted->get_bookmarks());
+    ASSERT_EQ(txtCtb, f_export_txt(*pDocConverted));
+}
+
+// the files of an export folder by relative path, the images only by name since their bytes come from the encoder
+static void get_export_files(const fs::path& export_dir, const fs::path& dir, std::map<std::string, std::string>& files)
+{
+    for (const fs::path& filepath : fs::get_dir_entries(dir)) {
+        if (fs::is_directory(filepath)) {
+            get_export_files(export_dir, filepath, files);
+        }
+        else {
+            files[fs::relative(filepath, export_dir).string()] = dir == export_dir / "images" ?
+                "" : Glib::file_get_contents(filepath.string());
+        }
+    }
+}
+
+static std::map<std::string, std::string> get_export_files(const fs::path& export_dir)
+{
+    std::map<std::string, std::string> files;
+    get_export_files(export_dir, export_dir, files);
+    return files;
+}
+
+TEST(ExportHtmlGroup, multiple_html_parallel_as_sequential)
+{
+    for (const std::string& inDocPath : {UT::testCtbDocPath, UT::testCtdDocPath}) {
+        UT::run_with_main_win([&inDocPath](CtMainWin* pWin){
+            ASSERT_TRUE(pWin->file_open(inDocPath, ""));
+            const fs::path tmpDirpath = pWin->get_ct_tmp()->getHiddenDirPath("UT");
+            CtExportOptions exportOptions;
+            exportOptions.include_node_name = true;
+            auto f_export = [&](const std::string& folder, CtThreadPool& thread_pool, const CtExportProgressFunc& progress) {
+                CtExport2Html export2html{pWin};
+                fs::path export_path;
+                EXPECT_TRUE(export2html.prepare_html_folder(tmpDirpath, folder, true/*export_overwrite*/, export_path));
+                const bool completed = export2html.nodes_all_export_to_multiple_html(true/*all_tree*/, exportOptions, progress, thread_pool);
+                return std::make_pair(completed, export_path);
+            };
+
+            // no workers, the pages written one after the other
+            CtThreadPool sequentialPool{0};
+            const auto [sequentialCompleted, sequentialPath] = f_export("sequential", sequentialPool, nullptr);
+            ASSERT_TRUE(sequentialCompleted);
+            const std::map<std::string, std::string> sequentialFiles = get_export_files(sequentialPath);
+            size_t nodesNum{0};
+            for (const auto& file : sequentialFiles) {
+                if (str::endswith(file.first, ".html") and file.first != "index.html") ++nodesNum;
+            }
+            ASSERT_LT(5u, nodesNum);
+
+            // the same files with the workers, the progress up to all the nodes
+            CtThreadPool parallelPool{4};
+            size_t lastDone{0};
+            size_t progressCalls{0};
+            const auto [parallelCompleted, parallelPath] = f_export("parallel", parallelPool, [&](size_t nodes_done, size_t nodes_total) {
+                EXPECT_EQ(nodesNum, nodes_total);
+                EXPECT_LE(lastDone, nodes_done);
+                EXPECT_GE(nodes_total, nodes_done);
+                lastDone = nodes_done;
+                ++progressCalls;
+                return true;
+            });
+            ASSERT_TRUE(parallelCompleted);
+            ASSERT_EQ(nodesNum, lastDone);
+            ASSERT_LE(nodesNum, progressCalls);
+            ASSERT_EQ(sequentialFiles, get_export_files(parallelPath));
+
+            // cancelled at the first progress, at most the page already submitted is written
+            const auto [cancelledCompleted, cancelledPath] = f_export("cancelled", parallelPool, [](size_t, size_t) {
+                return false;
+            });
+            ASSERT_FALSE(cancelledCompleted);
+            const std::map<std::string, std::string> cancelledFiles = get_export_files(cancelledPath);
+            ASSERT_NE(cancelledFiles.end(), cancelledFiles.find("index.html"));
+            size_t cancelledNodesNum{0};
+            for (const auto& file : cancelledFiles) {
+                if (str::endswith(file.first, ".html") and file.first != "index.html") {
+                    ++cancelledNodesNum;
+                    ASSERT_EQ(sequentialFiles.at(file.first), file.second);
+                }
+            }
+            ASSERT_GE(1u, cancelledNodesNum);
+        });
+    }
+}
@@ -24,8 +24,12 @@
 #include "ct_misc_utils.h"
 #include "ct_const.h"
 #include "ct_filesystem.h"
+#include "ct_thread_pool.h"
+#include "ct_treestore.h"
+#include "ct_storage_xml.h"
 #include "tests_common.h"
 #include <thread>
+#include <libxml++/libxml++.h>
 
 TEST(MiscUtilsGroup, files_encodings)
 {
@@ -394,6 +398,61 @@ TEST(MiscUtilsGroup, parallel_for)
         }
 }
 
+TEST(MiscUtilsGroup, parallel_for_exception)
+{
+    ASSERT_THROW(CtMiscUtil::parallel_for(0, 1000, [&](size_t index){
+        if (index == 10) throw std::runtime_error("item failed");
+    }), std::runtime_error);
+
+    // the pool threads are reused, a nested call does not block them all
+    std::vector<int> vec(100, 0);
+    CtMiscUtil::parallel_for(0, 10, [&](size_t outer){
+        CtMiscUtil::parallel_for(0, 10, [&](size_t inner){
+            vec[outer*10 + inner] += 1;
+        });
+    });
+    ASSERT_EQ(100, std::count(vec.begin(), vec.end(), 1));
+}
+
+TEST(MiscUtilsGroup, thread_pool_task_group)
+{
+    CtThreadPool thread_pool{2};
+    {
+        std::atomic<int> done{0};
+        CtThreadPool::TaskGroup task_group{thread_pool};
+        for (int i = 0; i < 50; ++i) {
+            task_group.run([&](){ ++done; });
+        }
+        task_group.wait();
+        ASSERT_EQ(50, done.load());
+    }
+    {
+        std::atomic<int> done{0};
+        CtThreadPool::TaskGroup task_group{thread_pool};
+        task_group.cancel();
+        task_group.run([&](){ ++done; });
+        task_group.wait();
+        ASSERT_TRUE(task_group.is_cancelled());
+        ASSERT_EQ(0, done.load());
+    }
+    {
+        CtThreadPool::TaskGroup task_group{thread_pool};
+        task_group.run([](){ throw std::logic_error("task failed"); });
+        ASSERT_THROW(task_group.wait(), std::logic_error);
+        // the exception is rethrown once
+        task_group.wait();
+    }
+    {
+        // no workers, the waiting thread runs the tasks
+        CtThreadPool no_workers_pool{0};
+        int done{0};
+        CtThreadPool::TaskGroup task_group{no_workers_pool};
+        task_group.run([&](){ ++done; });
+        task_group.wait();
+        ASSERT_EQ(1, done);
+    }
+}
+
 TEST(MiscUtilsGroup, get_link_entry)
 {
     ASSERT_STREQ(CtConst::LINK_TYPE_WEBS, CtMiscUtil::get_link_entry("webs https://example.com").type.c_str());
@@ -411,3 +470,108 @@ TEST(MiscUtilsGroup, get_link_entry)
     ASSERT_STREQ("", CtMiscUtil::get_link_entry("/home/foo/bar").type.c_str());
     ASSERT_STREQ("", CtMiscUtil::get_link_entry("home https://example.com").type.c_str());
 }
+
+TEST(MiscUtilsGroup, find_all_in_stored_text)
+{
+    // text buffer: "ab\n" <codebox> "foo " <anchor> "cd foo"
+    CtStoredNodeText stored_text;
+    stored_text.text = "ab\nfoo cd foo";
+    stored_text.widgets.push_back(CtStoredNodeText::Widget{3, CtAnchWidgType::CodeBox, {"has Foo"}});
+    stored_text.widgets.push_back(CtStoredNodeText::Widget{8, CtAnchWidgType::ImageAnchor, {"nothing"}});
+    Glib::RefPtr<Glib::Regex> re_pattern = Glib::Regex::create("foo", Glib::RegexCompileFlags::REGEX_MULTILINE | Glib::RegexCompileFlags::REGEX_CASELESS);
+
+    const std::vector<CtStoredMatch> matches = CtMiscUtil::find_all_in_stored_text(stored_text, re_pattern);
+    ASSERT_EQ(3, matches.size());
+    ASSERT_EQ(3, matches[0].start_offset);
+    ASSERT_EQ(4, matches[0].end_offset);
+    ASSERT_EQ(2, matches[0].line_num);
+    ASSERT_STREQ("<codebox>", matches[0].line_content.c_str());
+    ASSERT_EQ(4, matches[1].start_offset);
+    ASSERT_EQ(7, matches[1].end_offset);
+    ASSERT_EQ(2, matches[1].line_num);
+    ASSERT_STREQ("foo cd foo", matches[1].line_content.c_str());
+    ASSERT_EQ(12, matches[2].start_offset);
+    ASSERT_EQ(15, matches[2].end_offset);
+    ASSERT_EQ(2, matches[2].line_num);
+
+    // multibyte characters and a text starting with newline
+    stored_text.text = "\nйцу foo";
+    stored_text.widgets.clear();
+    const std::vector<CtStoredMatch> matches2 = CtMiscUtil::find_all_in_stored_text(stored_text, re_pattern);
+    ASSERT_EQ(1, matches2.size());
+    ASSERT_EQ(5, matches2[0].start_offset);
+    ASSERT_EQ(8, matches2[0].end_offset);
+    ASSERT_EQ(2, matches2[0].line_num);
+    ASSERT_STREQ("йцу foo", matches2[0].line_content.c_str());
+}
+
+TEST(MiscUtilsGroup, stored_and_decoded_text_malformed_offset)
+{
+    // the widgets with a missing or malformed char_offset are skipped, not thrown on the reader threads
+    const char xml_content[]{"<node>"
+                             "<rich_text>ab</rich_text>"
+                             "<codebox char_offset=\"2\" frame_width=\"\" frame_height=\"x\">ok</codebox>"
+                             "<codebox frame_width=\"500\" frame_height=\"100\">no offset</codebox>"
+                             "<table char_offset=\"abc\" col_max=\"60\"><row><cell>bad offset</cell></row></table>"
+                             "</node>"};
+    xmlpp::DomParser parser;
+    parser.parse_memory(xml_content);
+    ASSERT_TRUE(parser.get_document());
+
+    CtStoredNodeText stored_text;
+    CtStorageXmlHelper::get_stored_text_from_xml(parser.get_document()->get_root_node(), stored_text);
+    ASSERT_STREQ("ab", stored_text.text.c_str());
+    ASSERT_EQ(1, stored_text.widgets.size());
+    ASSERT_EQ(2, stored_text.widgets[0].offset);
+    ASSERT_STREQ("ok", stored_text.widgets[0].texts.at(0).c_str());
+
+    CtDecodedNodeText decoded_text;
+    CtStorageXmlHelper::get_decoded_text_from_xml(parser.get_document()->get_root_node(), decoded_text);
+    ASSERT_EQ(1, decoded_text.widgets.size());
+    ASSERT_EQ(2, decoded_text.widgets[0].offset);
+    ASSERT_EQ(500, decoded_text.widgets[0].frame_width);
+    ASSERT_EQ(100, decoded_text.widgets[0].frame_height);
+}
+
+TEST(MiscUtilsGroup, get_text_stats)
+{
+    const CtTextStats textStats = CtTextIterUtil::get_text_stats("one two\nйцу\n");
+    ASSERT_EQ(3, textStats.words);
+    ASSERT_EQ(12, textStats.chars);
+    ASSERT_EQ(3, textStats.lines);
+}
+
+TEST(MiscUtilsGroup, text_stats_tracker)
+{
+    Glib::init();
+    auto buffer = Gsv::Buffer::create();
+    buffer->set_text("one two\nthree");
+    CtTextStatsTracker textStatsTracker;
+    textStatsTracker.track(buffer);
+    buffer->signal_insert().connect([&](const Gtk::TextIter& pos, const Glib::ustring& text, int /*bytes*/){
+        textStatsTracker.on_insert_before(pos, text);
+    }, false);
+    buffer->signal_insert().connect(sigc::mem_fun(textStatsTracker, &CtTextStatsTracker::on_insert_after), true);
+    buffer->signal_erase().connect(sigc::mem_fun(textStatsTracker, &CtTextStatsTracker::on_erase_before), false);
+    buffer->signal_erase().connect(sigc::mem_fun(textStatsTracker, &CtTextStatsTracker::on_erase_after), true);
+    ASSERT_EQ(3, textStatsTracker.get_stats().words);
+
+    auto f_assert_as_full_count = [&](){
+        const CtTextStats fullStats = CtTextIterUtil::get_text_stats(buffer->get_text(true));
+        ASSERT_EQ(fullStats.words, textStatsTracker.get_stats().words);
+        ASSERT_EQ(fullStats.chars, textStatsTracker.get_stats().chars);
+        ASSERT_EQ(fullStats.lines, textStatsTracker.get_stats().lines);
+    };
+    // splitting a word, joining words, new lines and a multiline erase
+    buffer->insert(buffer->get_iter_at_offset(1), " ");
+    f_assert_as_full_count();
+    buffer->erase(buffer->get_iter_at_offset(1), buffer->get_iter_at_offset(2));
+    buffer->erase(buffer->get_iter_at_offset(3), buffer->get_iter_at_offset(4));
+    f_assert_as_full_count();
+    buffer->insert(buffer->end(), " four\nfive six\n\nseven");
+    f_assert_as_full_count();
+    buffer->erase(buffer->get_iter_at_offset(4), buffer->get_iter_at_offset(20));
+    f_assert_as_full_count();
+    buffer->insert(buffer->begin(), "йцу кен\n");
+    f_assert_as_full_count();
+}
@@ -23,7 +23,12 @@
 
 #include "ct_app.h"
 #include "ct_misc_utils.h"
+#include "ct_storage_sqlite.h"
+#include "ct_storage_xml.h"
+#include "ct_storage_control.h"
 #include "tests_common.h"
+#include <random>
+#include <thread>
 
 class TestCtApp : public CtApp
 {
@@ -47,6 +52,11 @@ private:
 
     void _run_test(const fs::path doc_filepath_from, const fs::path doc_filepath_to);
     void _assert_tree_data(CtMainWin* pWin);
+    void _assert_sqlite_schema(const fs::path& ctb_filepath);
+    void _assert_text_index(CtMainWin* pWin);
+    void _assert_stored_text_reader(CtMainWin* pWin);
+    void _assert_decoded_node_text(CtMainWin* pWin);
+    void _release_buffers(CtMainWin* pWin);
     void _assert_node_text(CtTreeIter& ctTreeIter, const Glib::ustring& expectedText);
     void _process_rich_text_buffer(std::list<ExpectedTag>& expectedTags, Glib::RefPtr<Gsv::Buffer> rTextBuffer);
 
@@ -91,20 +101,135 @@ void TestCtApp::_run_test(const fs::path doc_filepath_from, const fs::path doc_f
     pWin->force_exit() = true;
     remove_window(*pWin);
 
+    if (CtDocType::SQLite == fs::get_doc_type(tmp_filepath) and docEncrypt_to != CtDocEncrypt::True) {
+        _assert_sqlite_schema(tmp_filepath);
+    }
+
     // new empty window/tree
     CtMainWin* pWin2 = _create_window(true/*start_hidden*/);
     // tree empty
     ASSERT_FALSE(pWin2->get_tree_store().get_iter_first());
     // load file previously saved
     ASSERT_TRUE(pWin2->file_open(tmp_filepath, "", docEncrypt_to != CtDocEncrypt::True ? "" : UT::testPasswordBis));
+    // before the buffers are loaded by the tree check
+    _assert_stored_text_reader(pWin2);
+    _assert_decoded_node_text(pWin2);
     // check tree
     _assert_tree_data(pWin2);
+    if (CtDocType::SQLite == fs::get_doc_type(tmp_filepath)) {
+        _assert_text_index(pWin2);
+    }
+    // check tree again, with the buffers created again from the storage
+    _release_buffers(pWin2);
+    _assert_tree_data(pWin2);
 
     // close this window/tree
     pWin2->force_exit() = true;
     remove_window(*pWin2);
 }
 
+void TestCtApp::_assert_sqlite_schema(const fs::path& ctb_filepath)
+{
+    sqlite3* pDb{nullptr};
+    ASSERT_EQ(SQLITE_OK, sqlite3_open(ctb_filepath.c_str(), &pDb));
+    sqlite3_stmt* pStmt{nullptr};
+    ASSERT_EQ(SQLITE_OK, sqlite3_prepare_v2(pDb, "PRAGMA user_version", -1, &pStmt, nullptr));
+    ASSERT_EQ(SQLITE_ROW, sqlite3_step(pStmt));
+    ASSERT_EQ(CtStorageSqlite::SCHEMA_VERSION, sqlite3_column_int(pStmt, 0));
+    sqlite3_finalize(pStmt);
+    // the lookups of children and widgets must go through an index
+    for (const char* sqlCmd : {"EXPLAIN QUERY PLAN SELECT node_id FROM children WHERE father_id=1 ORDER BY sequence",
+                               "EXPLAIN QUERY PLAN SELECT * FROM image WHERE node_id=1 ORDER BY offset"})
+    {
+        ASSERT_EQ(SQLITE_OK, sqlite3_prepare_v2(pDb, sqlCmd, -1, &pStmt, nullptr));
+        ASSERT_EQ(SQLITE_ROW, sqlite3_step(pStmt));
+        const std::string plan_detail = CtStorageSqlite::safe_sqlite3_column_text(pStmt, 3);
+        ASSERT_NE(std::string::npos, plan_detail.find("USING INDEX")) << plan_detail;
+        sqlite3_finalize(pStmt);
+    }
+    sqlite3_close(pDb);
+}
+
+void TestCtApp::_assert_text_index(CtMainWin* pWin)
+{
+    const std::optional<std::unordered_set<gint64>> node_ids = pWin->get_ct_storage()->get_nodes_maybe_containing("CIAO PLAIN");
+    if (not node_ids) {
+        return; // sqlite without fts5/trigram
+    }
+    ASSERT_EQ(1, node_ids->size());
+    ASSERT_EQ(pWin->get_tree_store().get_node_from_node_name("йцукенгшщз").get_node_id(), *node_ids->begin());
+    // too short for the index
+    ASSERT_FALSE(pWin->get_ct_storage()->get_nodes_maybe_containing("ci"));
+}
+
+void TestCtApp::_assert_stored_text_reader(CtMainWin* pWin)
+{
+    const gint64 node_id = pWin->get_tree_store().get_node_from_node_name("йцукенгшщз").get_node_id();
+    CtStoredNodeText stored_text;
+    ASSERT_TRUE(pWin->get_ct_storage()->get_stored_node_text(node_id, stored_text));
+    std::unique_ptr<CtStoredTextReader> pReader = pWin->get_ct_storage()->create_stored_text_reader();
+    ASSERT_TRUE(pReader);
+    // the reader is used by another thread and gets the same content
+    CtStoredNodeText reader_stored_text;
+    bool is_read{false};
+    std::thread reader_thread([&](){ is_read = pReader->get_stored_node_text(node_id, reader_stored_text); });
+    reader_thread.join();
+    ASSERT_TRUE(is_read);
+    ASSERT_EQ(stored_text.text, reader_stored_text.text);
+    ASSERT_EQ(stored_text.widgets.size(), reader_stored_text.widgets.size());
+    ASSERT_NE(std::string::npos, reader_stored_text.text.find("ciao plain"));
+}
+
+void TestCtApp::_assert_decoded_node_text(CtMainWin* pWin)
+{
+    std::unique_ptr<CtStoredTextReader> pReader = pWin->get_ct_storage()->create_stored_text_reader();
+    ASSERT_TRUE(pReader);
+    size_t decoded_num{0};
+    pWin->get_tree_store().get_store()->foreach([&](const Gtk::TreePath& /*treePath*/, const Gtk::TreeIter& treeIter)->bool{
+        CtTreeIter ctTreeIter = pWin->get_tree_store().to_ct_tree_iter(treeIter);
+        // decoded by another thread, then the buffer and widgets are created here as when loaded from the storage
+        CtDecodedNodeText decoded_text;
+        bool is_decoded{false};
+        std::thread decoder_thread([&](){ is_decoded = pReader->get_decoded_node_text(ctTreeIter.get_node_id(), decoded_text); });
+        decoder_thread.join();
+        EXPECT_TRUE(is_decoded);
+        std::list<CtAnchoredWidget*> widgets;
+        Glib::RefPtr<Gsv::Buffer> rTextBuffer = CtStorageXmlHelper{pWin}.create_buffer_and_widgets_from_decoded(decoded_text, widgets);
+        EXPECT_STREQ(ctTreeIter.get_node_text_buffer()->get_text().c_str(), rTextBuffer->get_text().c_str());
+        std::list<CtAnchoredWidget*> loaded_widgets = ctTreeIter.get_anchored_widgets_fast('a');
+        EXPECT_EQ(loaded_widgets.size(), widgets.size());
+        for (auto it1 = loaded_widgets.begin(), it2 = widgets.begin(); it1 != loaded_widgets.end() and it2 != widgets.end(); ++it1, ++it2) {
+            EXPECT_EQ((*it1)->getOffset(), (*it2)->getOffset());
+            EXPECT_EQ((*it1)->get_type(), (*it2)->get_type());
+        }
+        for (CtAnchoredWidget* pWidget : widgets) {
+            delete pWidget;
+        }
+        ++decoded_num;
+        return false; /* false for continue */
+    });
+    ASSERT_LE(8u, decoded_num);
+}
+
+void TestCtApp::_release_buffers(CtMainWin* pWin)
+{
+    const gint64 curr_node_id = pWin->curr_tree_iter().get_node_id();
+    size_t released_num{0};
+    pWin->get_tree_store().get_store()->foreach([&](const Gtk::TreePath& /*treePath*/, const Gtk::TreeIter& treeIter)->bool{
+        CtTreeIter ctTreeIter = pWin->get_tree_store().to_ct_tree_iter(treeIter);
+        if (ctTreeIter.get_node_id() != curr_node_id) {
+            // not modified since loaded
+            EXPECT_TRUE(pWin->get_ct_storage()->can_reload_text_buffer(ctTreeIter.get_node_id()));
+            EXPECT_GT(ctTreeIter.get_node_buffer_memory_size(), 0u);
+            ctTreeIter.release_node_text_buffer();
+            EXPECT_FALSE(ctTreeIter.get_node_buffer_already_loaded());
+            ++released_num;
+        }
+        return false; /* false for continue */
+    });
+    ASSERT_LE(8u, released_num);
+}
+
 void TestCtApp::_process_rich_text_buffer(std::list<ExpectedTag>& expectedTags, Glib::RefPtr<Gsv::Buffer> rTextBuffer)
 {
     CtTextIterUtil::SerializeFunc test_slot = [&expectedTags](Gtk::TextIter& start_iter,
@@ -473,39 +598,15 @@ void TestCtApp::_assert_tree_data(CtMainWin* pWin)
                     }
                     const CtTableMatrix& tableMatrix = pTable->get_table_matrix();
                     // three rows
-                    ASSERT_EQ(3, tableMatrix.size());
+                    ASSERT_EQ(3, tableMatrix.get_rows_num());
                     // two columns
-                    ASSERT_EQ(2, tableMatrix.at(0).size());
-                    {
-                        CtTextCell* pCell = tableMatrix.at(0).at(0);
-                        ASSERT_STREQ("h1", pCell->get_text_content().c_str());
-                        ASSERT_STREQ(CtConst::TABLE_CELL_TEXT_ID, pCell->get_syntax_highlighting().c_str());
-                    }
-                    {
-                        CtTextCell* pCell = tableMatrix.at(0).at(1);
-                        ASSERT_STREQ("h2", pCell->get_text_content().c_str());
-                        ASSERT_STREQ(CtConst::TABLE_CELL_TEXT_ID, pCell->get_syntax_highlighting().c_str());
-                    }
-                    {
-                        CtTextCell* pCell = tableMatrix.at(1).at(0);
-                        ASSERT_STREQ("йцукенгшщз", pCell->get_text_content().c_str());
-                        ASSERT_STREQ(CtConst::TABLE_CELL_TEXT_ID, pCell->get_syntax_highlighting().c_str());
-                    }
-                    {
-                        CtTextCell* pCell = tableMatrix.at(1).at(1);
-                        ASSERT_STREQ("2", pCell->get_text_content().c_str());
-                        ASSERT_STREQ(CtConst::TABLE_CELL_TEXT_ID, pCell->get_syntax_highlighting().c_str());
-                    }
-                    {
-                        CtTextCell* pCell = tableMatrix.at(2).at(0);
-                        ASSERT_STREQ("3", pCell->get_text_content().c_str());
-                        ASSERT_STREQ(CtConst::TABLE_CELL_TEXT_ID, pCell->get_syntax_highlighting().c_str());
-                    }
-                    {
-                        CtTextCell* pCell = tableMatrix.at(2).at(1);
-                        ASSERT_STREQ("4", pCell->get_text_content().c_str());
-                        ASSERT_STREQ(CtConst::TABLE_CELL_TEXT_ID, pCell->get_syntax_highlighting().c_str());
-                    }
+                    ASSERT_EQ(2, tableMatrix.get_cols_num());
+                    ASSERT_STREQ("h1", tableMatrix.get_cell(0, 0).c_str());
+                    ASSERT_STREQ("h2", tableMatrix.get_cell(0, 1).c_str());
+                    ASSERT_STREQ("йцукенгшщз", tableMatrix.get_cell(1, 0).c_str());
+                    ASSERT_STREQ("2", tableMatrix.get_cell(1, 1).c_str());
+                    ASSERT_STREQ("3", tableMatrix.get_cell(2, 0).c_str());
+                    ASSERT_STREQ("4", tableMatrix.get_cell(2, 1).c_str());
                 } break;
                 case CtAnchWidgType::ImagePng: {
                     ASSERT_EQ(59, pAnchWidget->getOffset());
@@ -514,6 +615,8 @@ void TestCtApp::_assert_tree_data(CtMainWin* pWin)
                     ASSERT_TRUE(pImagePng);
                     ASSERT_STREQ("webs http://www.ansa.it", pImagePng->get_link().c_str());
                     static const std::string embedded_png = Glib::Base64::decode("iVBORw0KGgoAAAANSUhEUgAAADAAAAAwCAYAAABXAvmHAAAABHNCSVQICAgIfAhkiAAACu1JREFUaIHFmn2MVNUZxn/vnTt3PvaDYR0XFhAV6SpUG5ZaPxJsok2QoDY10lLAaKTWNjYYqegfjd82MSaERmuoqGltsUajRhuTkpr4LZIYhGUjUilFbXZhWdbZYXd29s6dO/f0jzNn793Z4WMQ2pOc3Ll3zj3ned7znPe875kRpRSnoigRi6lTv49tr5JkchG+P015Xqs4zjCOc0i57lY8bzNDQx+IUsEpGRSQU0FAZTLzJJ1+g46Odq6/vomuLkvNnIlkMqh8Hunrg507A159tcihQ4dUsXid5PN7TgH+b05AtbXdJlOm/I5HHkmphQuFoGrcIADfB9sGy9LPLAvZsUNx331j6siRtZLLPf0N8Z88AdXaOoV0+nmZP/8qHn44TSyGisWQGTMgnYZEQgMPAiiVoFhEHTiAVCpQqcD99xfVZ5+9TbF4owwPH/nfE5g+/UNZteoStXx5XIaHYe5cmDYtbBCPh5/L5fDzoUOwdy8qk0FefLGsXnjhY+nvX3SS+LFOCnwms0I6O7tYtiwuvb3HBl97P20adHYivb1www1xmTu3S2UyK04GB5zMDMyalVGe94U8+2wGz4OmJrj8ci2XWCzUezweSsjMQBBo+QQBbNsGo6MAqNtvz4vjnEtvb75RAg3PgPK8DXLjjSliMSgWobUVPE/XUkmDNaBrr6VS2La1Vb/vOMiyZSnleRsaxdIwAZXNtktLy0qWLEnQ16cfDg2B6+rq+xpcPfCep783bYeGdJ8HDsDSpQlpalqpstn200oAz+tSF11UplBA+f44INXfr0GZWfA8GBsLa/R5tL3va4Kui5o3z8Pzuk4vAcdZIPPnJxkb04MDlEpIfz8cPowqFEJrl0oavAFeLuvvDx/W7Usl/b7vQ7GInHNOSkqlBY0SsBtpLI6zSM2ebUupBL6Pcl3EsjTAw4eR0VFUWxs4jt60HAfledrKnofkclr3hpCZBd9HzZljSxAsAh47bQSU63bJjBlat7Ydar5YDEkGQbj72jZiZGL0b9qbNWHb2hCzZ1Py/a5EI4AaJSCjo9NIpxHLQtk2eB7K9zXICAksC0RCN6rU+CxQLGqLG2KOg9g2pNMUYdppJaA876Dk82dh23pwy9ILEJBkUoMrlXQYYYiY2KhU0ntAVXq47oSZIpfDg4MN4m+MgAs7k19+eZbMnIn4vp4FGCdhdE+5HG5ooEkEQbgeDHjb1msokYA9e/BgZ6MEGvJCOfhQenrKNDXpwasgSCZDF+m6qGJxcjVW9zzdPvp+KoXq7i4fgA9PK4ECdLN1q0s8HlowmdTWrnqe8Z22WAyreRZpJ1US2LZ+9v77bgG6GyXQkITysPPf+/c75wWBtqLrQhBo2fg+Kqr5esWytGSM9i1L9+P7fDwy4gyfbgldqtRgAZ7j0Udd2trCgK1qRXEcJJlEjDwsa/yzJJOaqOOEBOJxaGmBu+928/Dc9UoNnlYCAL1wz7atW4tq714diabTYRRqgFVBigFr5GW+j8X0e01NqN27+ce+fUUf7mkUC5xkQvOGyLL58Ofz3norTaGg9Q1h8FapTH7JkDS5gWVBczO7r766+Bnc/GOlXjkZAo0nNF1d8WunTCkOQoHVq7WGzUKOx7VLTKcn10QilFwyqe9vvZUCjC6bOtVVIs5pJaBEbNXefps6eLCfJUtevnTz5jPxPA5efTX090Nzs5bK8Woqhertpe/aa1GFApdu2pRl8eKXpKOjX2Uyv6KrK358NGE5voSCQFQ2ey22vUluuWUqd9yRpK0Ncjno6YF77+WdHTu4ctUqWL1axzfl8kQZxWIY16uefpp3X3qJKxcuhAcegPnzIZuFQgE2bnTVs88ewfNul1zuNSzruPo+OoEgEPXUUzYPPviYdHX9ks2bU7S0TDhl4KuvoK8PPvqIPY8/TgB8e8ECuOYamDNHAxschH37YMsWdnd3YwHz1q6Fyy6DmTPh7LO1xGxbEx0agltuGVO7dv1RNmz4NStXlo9FpD6BIBC1YUNSNmx4kzVrvseaNQl8fzyHjSbpqr9fx/f5PLz1FurllzkwNMQBYABoB2YAM6ZMQZYvhx/8ALJZVDaLTJ8+cdxyOTyO2bjRU08+uVOuu+4qNm0aOxqJoxGwVCbzJ1m37qfceaeD6+rOo6cLZiMyJZdDDQ8jw8M6kamVUCqFam1FWluhrS061sRrtP8nnvDU+vWvS6GwAsuqu0PWJXBE5OYpV1zxB155JTXuIkXCBrXHJvWKOYlQSi/e2ufHKkrptWRZsHLl2MjWrWtblNp0QgSUiJWD3jM++KBDNTcjY2OoVGpiaAz1Q4bojNQLK8y97yOVCioW0/e2Pek9MSlnPs/hpUsHs9AhSvm1Q06Khf4JP5rX2dmqmpuRvXvDqLE68ARQ0d3VJDDRs6Fa4OZMqJoXSDXMntBfNa4aP82YPZszOztTn+/d+5Pz4YXjEnDgVm66qUn270cNDk4EHgEsJjwwYM1mZoDUlqjWXTfs12RnEO7oZhyqKeqKFU32Qw/9nBMhUITz6ehADQzoJNx1w1hGBBWPg0nWDRnLCk8pahd3lEBEQsrcG+N4HlIuT0w/k0lNrq2NAnxrcqd1CORgJq2tSE+Pdo2+rwk0N2uwlcr4QlRVl6cMaPsEonMDuFrHtV6VFUHAeHxl24jrwty55KFdRETVLNpJI7qgGB6GgwehUkEVCmHSIhL6aUPGPK8WdQwPJVEPZCwdJVQq6ecDAyjP0y53bAw1YwYuSL0+65lskJ6eWZRKqGIROXIE1dKCNDfrb8vl0NKGEIzLZtyi0dkw8qr1+QawaVNtpwoFfcZU7Ue2byeAXK316xJw4XPefXeWuuACHS6MjkIqFcY3xvUZSxurHk37taVmLUzow/RvZJRIaEN88gku7KvX3aQRB+GFf+3aNQog+Tzjx4hVOamREW05szvXWtcUkbDWEjDgy2XdT6mEGhnRR4/G1ZZKevwg4PN9+0YH4a8nRAD429sQl4EB3ZlSoX8HvSeY2D6S3GPbGmwsFsb7piaT+rnIxPamj0RCu2WYuI+MjSF9fbwP9jC8dkIEfqbU1z48/t477xTVGWfoSDGZhJaWMKc1A5mU0YBOpXQ1SU60Rr+LxcJUM7Ibi+PoHNkYIJXive7uogvP3KVU3UOvuqLth998DF/ktmwJVFsbkk6jpk/XOXAyGV4NuSjoREKDqq1mJqLtzfuRftX06XoGmpr4etu2YDv0tcNd9XDCUYI5EbFWw7nnwHPt0PWLefOaWLcOPv10/FDKWF4ZGZkwYIJ5qvaJrg/jbXxfu1Xj/83h74UXwvr1PLNnz+gAfNoLNz0F+9RRfhyfREBE4mjv5ADZH8LihfD7B55/PkYiEZ5xmmKyrRPxQFEy9bK2RAKCgIeWL690w9rX4e/AIOABvlJqUih7XAJA5l74iwPnL4byJWeeGefii2OSzerfudrbwzi/tVXLoaUFZbIs30eKRRgZ0S55eDjMGwYHIZ/XMdeOHZWPDx0qvwlxD/b/FlYA+YYJVElYgCESB5rbYfZ34LtZuDAJHUnIJKHFhiYbUjYkLEhU37EDXS0LAgv8ACoWlAPwfHB9GPNh1IURF/IeHByE3d2wfQD+AxSAMuAD5ROW0FHI2EAscrWqM+QAKTRwp0rWEI9ukr4BUq0eUALGqp89IAAq1XaVqsWP+6eQk/6lXkSkSiR6jdbooggAVVPNs6BeiHDCOE7V323+X+W/7+DBfu4LqLwAAAAASUVORK5CYII=");
+                    // the png bytes the image was loaded from, no encoding from the pixbuf
+                    ASSERT_FALSE(pImagePng->get_raw_blob_dirty());
                     ASSERT_EQ(embedded_png.size(), pImagePng->get_raw_blob().size());
                     ASSERT_EQ(embedded_png, pImagePng->get_raw_blob());
                 } break;
@@ -576,3 +679,142 @@ INSTANTIATE_TEST_CASE_P(
                 std::make_tuple(UT::testCtzDocPath, UT::testCtxDocPath),
                 std::make_tuple(UT::testCtzDocPath, UT::testCtzDocPath))
 );
+
+// a further hidden main window with the journal on, to reopen the document as a new instance would
+static CtMainWin* open_window(const fs::path& doc_filepath, const Glib::ustring& password = "")
+{
+    CtMainWin* pWin = UT::main_win_create();
+    pWin->get_ct_config()->xmlJournalOn = true;
+    EXPECT_TRUE(pWin->file_open(doc_filepath, "", password));
+    return pWin;
+}
+
+static void close_window(CtMainWin* pWin)
+{
+    pWin->get_ct_config()->xmlJournalOn = false;
+    UT::main_win_remove(pWin);
+}
+
+// the text of node 'd' replaced and saved, appended to the journal
+static void save_node_d_text(CtMainWin* pWin, const Glib::ustring& text)
+{
+    CtTreeIter ctTreeIter = pWin->get_tree_store().get_node_from_node_name("d");
+    ASSERT_TRUE(ctTreeIter);
+    ctTreeIter.get_node_text_buffer()->set_text(text);
+    pWin->update_window_save_needed(CtSaveNeededUpdType::nbuf, false/*new_machine_state*/, &ctTreeIter);
+    pWin->file_save(false/*need_vacuum*/);
+    ASSERT_FALSE(pWin->get_file_save_needed());
+}
+
+static Glib::ustring get_node_d_text(CtMainWin* pWin)
+{
+    return pWin->get_tree_store().get_node_from_node_name("d").get_node_text_buffer()->get_text();
+}
+
+TEST(ReadWriteJournalGroup, append_replay_and_compact)
+{
+    UT::run_with_main_win([](CtMainWin* pMainWin){
+        const fs::path doc_filepath = pMainWin->get_ct_tmp()->getHiddenDirPath("UT") / "journal.ctd";
+        ASSERT_TRUE(fs::copy_file(UT::testCtdDocPath, doc_filepath));
+        const fs::path journal_filepath = CtStorageXml::get_journal_path(doc_filepath);
+        const std::string doc_content = Glib::file_get_contents(doc_filepath.string());
+
+        // two saves appended, the document untouched
+        CtMainWin* pWin = open_window(doc_filepath);
+        save_node_d_text(pWin, "first save");
+        save_node_d_text(pWin, "second save");
+        close_window(pWin);
+        ASSERT_TRUE(fs::is_regular_file(journal_filepath));
+        ASSERT_EQ(doc_content, Glib::file_get_contents(doc_filepath.string()));
+
+        // replayed on load
+        pWin = open_window(doc_filepath);
+        ASSERT_STREQ("second save", get_node_d_text(pWin).c_str());
+        close_window(pWin);
+
+        // a torn final record is dropped, the previous ones replayed
+        const std::string journal_content = Glib::file_get_contents(journal_filepath.string());
+        Glib::file_set_contents(journal_filepath.string(), journal_content.substr(0, journal_content.size() - 5));
+        pWin = open_window(doc_filepath);
+        ASSERT_STREQ("first save", get_node_d_text(pWin).c_str());
+        close_window(pWin);
+        Glib::file_set_contents(journal_filepath.string(), journal_content);
+
+        // merged into the document on close, nothing left to save
+        pWin = open_window(doc_filepath);
+        pWin->get_ct_storage()->compact_on_close();
+        ASSERT_FALSE(fs::is_regular_file(journal_filepath));
+        close_window(pWin);
+        pWin = open_window(doc_filepath);
+        ASSERT_STREQ("second save", get_node_d_text(pWin).c_str());
+        close_window(pWin);
+    });
+}
+
+TEST(ReadWriteJournalGroup, stale_journal_not_replayed)
+{
+    UT::run_with_main_win([](CtMainWin* pMainWin){
+        const fs::path doc_filepath = pMainWin->get_ct_tmp()->getHiddenDirPath("UT") / "journal_stale.ctd";
+        ASSERT_TRUE(fs::copy_file(UT::testCtdDocPath, doc_filepath));
+        const fs::path journal_filepath = CtStorageXml::get_journal_path(doc_filepath);
+
+        CtMainWin* pWin = open_window(doc_filepath);
+        save_node_d_text(pWin, "journal save");
+        close_window(pWin);
+        ASSERT_TRUE(fs::is_regular_file(journal_filepath));
+
+        // edited by someone not aware of the journal, the size unchanged
+        std::string doc_content = Glib::file_get_contents(doc_filepath.string());
+        const size_t text_pos = doc_content.find("second rich");
+        ASSERT_NE(std::string::npos, text_pos);
+        doc_content.replace(text_pos, 11, "second RICH");
+        Glib::file_set_contents(doc_filepath.string(), doc_content);
+        ASSERT_EQ(doc_content.size(), fs::file_size(doc_filepath));
+
+        pWin = open_window(doc_filepath);
+        ASSERT_STREQ("second RICH" _NL, get_node_d_text(pWin).c_str());
+        // the next save rewrites the document and drops the journal
+        save_node_d_text(pWin, "rewritten");
+        ASSERT_FALSE(fs::is_regular_file(journal_filepath));
+        close_window(pWin);
+
+        // a document of a different size
+        pWin = open_window(doc_filepath);
+        save_node_d_text(pWin, "journal save");
+        close_window(pWin);
+        ASSERT_TRUE(fs::is_regular_file(journal_filepath));
+        Glib::file_set_contents(doc_filepath.string(), Glib::file_get_contents(doc_filepath.string()) + "\n");
+        pWin = open_window(doc_filepath);
+        ASSERT_STREQ("rewritten", get_node_d_text(pWin).c_str());
+        close_window(pWin);
+    });
+}
+
+TEST(ReadWriteInMemoryGroup, deserialized_db_grows)
+{
+    UT::run_with_main_win([](CtMainWin* pMainWin){
+        const fs::path doc_filepath = pMainWin->get_ct_tmp()->getHiddenDirPath("UT") / "in_memory.ctx";
+        ASSERT_TRUE(fs::copy_file(UT::testCtxDocPath, doc_filepath));
+        const auto doc_size = fs::file_size(doc_filepath);
+
+        // several MiB of text that do not compress away, the database grown well past its loaded size
+        std::mt19937 rand_gen{7};
+        std::uniform_int_distribution<int> rand_char{'!', '~'};
+        std::string big_text;
+        for (int line = 0; line < 50000; ++line) {
+            for (int i = 0; i < 80; ++i) {
+                big_text += (char)rand_char(rand_gen);
+            }
+            big_text += '\n';
+        }
+        CtMainWin* pWin = open_window(doc_filepath, UT::testPassword);
+        save_node_d_text(pWin, big_text);
+        save_node_d_text(pWin, big_text + "again");
+        close_window(pWin);
+        ASSERT_GT(fs::file_size(doc_filepath), doc_size + 1024*1024);
+
+        pWin = open_window(doc_filepath, UT::testPassword);
+        ASSERT_TRUE(get_node_d_text(pWin).raw() == big_text + "again");
+        close_window(pWin);
+    });
+}
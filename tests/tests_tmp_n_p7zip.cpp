@@ -23,6 +23,7 @@
 
 #include "ct_app.h"
 #include "ct_p7za_iface.h"
+#include "ct_storage_chunked.h"
 #include "config.h"
 #include "ct_filesystem.h"
 #include "tests_common.h"
@@ -117,3 +118,93 @@ TEST(TmpP7zipGroup, P7zaExtravtWrongPasswd)
     ASSERT_TRUE(Glib::file_test(ctdTmpPath, Glib::FILE_TEST_EXISTS));
     g_remove(ctTmp.getHiddenFilePath(UT::ctzInputPath).string().c_str());
 }
+
+TEST(TmpP7zipGroup, P7zaMemoryRoundTrip)
+{
+    // extract in memory the same content extracted on disk
+    CtTmp ctTmp;
+    ASSERT_EQ(0, CtP7zaIface::p7za_extract(UT::ctzInputPath.c_str(), ctTmp.getHiddenDirPath(UT::ctzInputPath).c_str(), UT::testPassword, false));
+    const std::string xml_txt = Glib::file_get_contents(ctTmp.getHiddenFilePath(UT::ctzInputPath).string());
+    std::string xml_txt_mem;
+    ASSERT_EQ(0, CtP7zaIface::p7za_extract_to_memory(UT::ctzInputPath.c_str(), UT::testPassword, xml_txt_mem));
+    ASSERT_STREQ(xml_txt.c_str(), xml_txt_mem.c_str());
+
+    // wrong password
+    std::string xml_txt_wrong;
+    ASSERT_TRUE(0 != CtP7zaIface::p7za_extract_to_memory(UT::ctzInputPath.c_str(), "wrongpassword", xml_txt_wrong));
+    ASSERT_TRUE(xml_txt_wrong.empty());
+
+    // archive from memory, readable by the command line extraction
+    const std::string ctzTmpPathBis{Glib::build_filename(ctTmp.getHiddenDirPath(UT::ctzInputPath).string(), "7zr2.ctz")};
+    ASSERT_EQ(0, CtP7zaIface::p7za_archive_from_memory(xml_txt_mem, "7zr.ctd", ctzTmpPathBis.c_str(), UT::testPasswordBis));
+    ASSERT_FALSE(Glib::file_test(ctzTmpPathBis + ".tmp", Glib::FILE_TEST_EXISTS));
+    ASSERT_EQ(0, g_remove(ctTmp.getHiddenFilePath(UT::ctzInputPath).c_str()));
+    ASSERT_EQ(0, CtP7zaIface::p7za_extract(ctzTmpPathBis.c_str(), ctTmp.getHiddenDirPath(UT::ctzInputPath).c_str(), UT::testPasswordBis, false));
+    ASSERT_STREQ(xml_txt.c_str(), Glib::file_get_contents(ctTmp.getHiddenFilePath(UT::ctzInputPath).string()).c_str());
+
+    // and by the extraction in memory
+    std::string xml_txt_bis;
+    ASSERT_EQ(0, CtP7zaIface::p7za_extract_to_memory(ctzTmpPathBis.c_str(), UT::testPasswordBis, xml_txt_bis));
+    ASSERT_STREQ(xml_txt.c_str(), xml_txt_bis.c_str());
+
+    for (auto tmpFilepath : std::list<std::string>{ctzTmpPathBis, ctTmp.getHiddenFilePath(UT::ctzInputPath).string()})
+    {
+        if (Glib::file_test(tmpFilepath, Glib::FILE_TEST_EXISTS))
+        {
+            ASSERT_EQ(0, g_remove(tmpFilepath.c_str()));
+        }
+    }
+}
+
+TEST(TmpP7zipGroup, ChunkedContainer)
+{
+    CtTmp ctTmp;
+    const fs::path ctzTmpPath{Glib::build_filename(ctTmp.getHiddenDirPath(UT::ctzInputPath).string(), "chunked.ctz")};
+    std::map<gint64, std::string> chunks;
+    for (gint64 id = 1; id <= 10; ++id) {
+        chunks[id] = "<node name=\"" + std::to_string(id) + "\"/>";
+        chunks[-id] = std::string(10000, (char)('a' + id));
+    }
+    {
+        CtChunkedContainer chunkedContainer;
+        chunkedContainer.create(UT::testPassword);
+        chunkedContainer.write_all(ctzTmpPath, chunks);
+        ASSERT_TRUE(CtChunkedContainer::is_container(ctzTmpPath));
+        ASSERT_FALSE(CtChunkedContainer::is_container(UT::ctzInputPath));
+        ASSERT_EQ(0u, chunkedContainer.get_dead_size());
+
+        // a save appends the changed chunks only, past the full index chain length too
+        for (int i = 0; i < 40; ++i) {
+            chunkedContainer.append({{1, "changed " + std::to_string(i)}}, {});
+        }
+        chunkedContainer.append({}, {2, -2});
+        ASSERT_TRUE(chunkedContainer.get_dead_size() > 0);
+    }
+    // a torn save is discarded
+    FILE* pFile = g_fopen(ctzTmpPath.c_str(), "ab");
+    ASSERT_TRUE(pFile);
+    fwrite("torn", 4, 1, pFile);
+    fclose(pFile);
+
+    CtChunkedContainer chunkedContainerWrong;
+    ASSERT_FALSE(chunkedContainerWrong.open(ctzTmpPath, "wrongpassword"));
+
+    CtChunkedContainer chunkedContainer;
+    ASSERT_TRUE(chunkedContainer.open(ctzTmpPath, UT::testPassword));
+    ASSERT_EQ(18u, chunkedContainer.get_ids().size());
+    std::vector<std::string> readChunks = chunkedContainer.read_chunks({1, 2, -3, 10});
+    ASSERT_STREQ("changed 39", readChunks[0].c_str());
+    ASSERT_TRUE(readChunks[1].empty());
+    ASSERT_EQ(chunks[-3], readChunks[2]);
+    ASSERT_EQ(chunks[10], readChunks[3]);
+
+    // the live chunks are copied as they are
+    chunkedContainer.compact();
+    ASSERT_EQ(0u, chunkedContainer.get_dead_size());
+    ASSERT_EQ(chunkedContainer.get_live_size(), fs::file_size(ctzTmpPath));
+    CtChunkedContainer chunkedContainerCompact;
+    ASSERT_TRUE(chunkedContainerCompact.open(ctzTmpPath, UT::testPassword));
+    ASSERT_EQ(chunks[-10], chunkedContainerCompact.read_chunks({-10}).front());
+
+    ASSERT_EQ(0, g_remove(ctzTmpPath.c_str()));
+}
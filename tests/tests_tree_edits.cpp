@@ -0,0 +1,492 @@
+/*
+ * tests_tree_edits.cpp
+ *
+ * Copyright 2009-2021
+ * Giuseppe Penone <giuspen@gmail.com>
+ * Evgenii Gurianov <https://github.com/txe>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "ct_actions.h"
+#include "ct_document.h"
+#include "ct_logging.h"
+#include "ct_main_win.h"
+#include "ct_misc_utils.h"
+#include "ct_state_machine.h"
+#include "ct_storage_control.h"
+#include "ct_storage_xml.h"
+#include "tests_common.h"
+
+// the text and tags of the buffer, without the widgets
+static std::string get_buffer_xml(Glib::RefPtr<Gtk::TextBuffer> rBuffer)
+{
+    xmlpp::Document xml_doc;
+    CtStorageXmlHelper::save_buffer_no_widgets_to_xml(xml_doc.create_root_node("buffer"), rBuffer, 0, -1, 'n');
+    return xml_doc.write_to_string();
+}
+
+// in buffer order, with the offsets updated from the anchors
+static std::vector<int> get_widgets_offsets(CtTreeIter& ctTreeIter)
+{
+    std::vector<int> offsets;
+    for (CtAnchoredWidget* pWidget : ctTreeIter.get_anchored_widgets()) {
+        offsets.push_back(pWidget->getOffset());
+    }
+    return offsets;
+}
+
+static std::vector<int> get_widgets_offsets(const CtNodeState& node_state)
+{
+    std::vector<int> offsets;
+    for (const auto& widgetState : node_state.widgetStates) {
+        offsets.push_back(widgetState->charOffset);
+    }
+    return offsets;
+}
+
+static std::vector<CtAnchWidgType> get_widgets_types(CtTreeIter& ctTreeIter)
+{
+    std::vector<CtAnchWidgType> types;
+    for (CtAnchoredWidget* pWidget : ctTreeIter.get_anchored_widgets()) {
+        types.push_back(pWidget->get_type());
+    }
+    return types;
+}
+
+TEST(TreeEditsGroup, undo_redo_deltas)
+{
+    UT::run_with_main_win([](CtMainWin* pWin){
+        ASSERT_TRUE(pWin->file_open(UT::testCtdDocPath, "", ""));
+        const int limit = 10;
+        pWin->get_ct_config()->limitUndoableSteps = limit;
+        CtStateMachine& stateMachine = pWin->get_state_machine();
+
+        // the rich text node with a codebox, an anchor, a table, an image and an embedded file
+        CtTreeIter ctTreeIter = pWin->get_tree_store().get_node_from_node_name("e");
+        ASSERT_TRUE(ctTreeIter);
+        pWin->get_tree_view().set_cursor_safe(ctTreeIter);
+        ASSERT_EQ(ctTreeIter.get_node_id(), pWin->curr_tree_iter().get_node_id());
+        const gint64 node_id = ctTreeIter.get_node_id();
+        ASSERT_EQ(1u, stateMachine.get_node_steps_num(node_id)); // first state on selection
+        Glib::RefPtr<Gsv::Buffer> rBuffer = ctTreeIter.get_node_text_buffer();
+
+        // the steps are pushed here rather than on the text variations of the user
+        pWin->user_active() = false;
+        std::vector<std::string> step_xmls{get_buffer_xml(rBuffer)};
+        std::vector<std::vector<int>> step_offsets{get_widgets_offsets(ctTreeIter)};
+        const std::string bold_tag = pWin->get_text_tag_name_exist_or_create(CtConst::TAG_WEIGHT, CtConst::TAG_PROP_VAL_HEAVY);
+        const int steps_num = 3 * limit;
+        for (int i = 1; i <= steps_num; ++i) {
+            switch (i % 4) {
+                case 0: rBuffer->insert(rBuffer->begin(), "w" + std::to_string(i) + " "); break; // widgets shifted
+                case 1: rBuffer->insert(rBuffer->end(), "end" + std::to_string(i)); break;
+                case 2: rBuffer->erase(rBuffer->begin(), rBuffer->get_iter_at_offset(2)); break;
+                case 3: rBuffer->apply_tag_by_name(bold_tag, rBuffer->begin(), rBuffer->get_iter_at_offset(3)); break;
+            }
+            stateMachine.update_state(ctTreeIter);
+            step_xmls.push_back(get_buffer_xml(rBuffer));
+            step_offsets.push_back(get_widgets_offsets(ctTreeIter));
+        }
+        // the oldest steps are dropped at the checkpoints once past the limit
+        ASSERT_GE(stateMachine.get_node_steps_num(node_id), (size_t)limit);
+        ASSERT_LE(stateMachine.get_node_steps_num(node_id), (size_t)(2 * limit));
+
+        // the embedded file bytes are shared by the widget and its state, not copied
+        {
+            std::shared_ptr<CtNodeState> curr_state = stateMachine.requested_state_current(node_id);
+            ASSERT_TRUE(curr_state);
+            size_t embfile_states{0};
+            for (CtAnchoredWidget* pWidget : ctTreeIter.get_anchored_widgets_fast()) {
+                auto pEmbFile = dynamic_cast<CtImageEmbFile*>(pWidget);
+                if (not pEmbFile) continue;
+                for (const auto& widgetState : curr_state->widgetStates) {
+                    if (auto pEmbFileState = std::dynamic_pointer_cast<CtAnchoredWidgetState_EmbFile>(widgetState)) {
+                        ASSERT_EQ(pEmbFile->get_raw_blob_shared().get(), pEmbFileState->rRawBlob.get());
+                        ++embfile_states;
+                    }
+                }
+            }
+            ASSERT_EQ(1u, embfile_states);
+        }
+
+        auto assert_state = [&](std::shared_ptr<CtNodeState> node_state, const int step_index){
+            ASSERT_TRUE(node_state);
+            ASSERT_EQ(step_xmls.at(step_index), node_state->buffer_xml.write_to_string());
+            ASSERT_EQ(step_offsets.at(step_index), get_widgets_offsets(*node_state));
+            pWin->load_buffer_from_state(node_state, ctTreeIter);
+            ASSERT_EQ(step_xmls.at(step_index), get_buffer_xml(ctTreeIter.get_node_text_buffer()));
+            ASSERT_EQ(step_offsets.at(step_index), get_widgets_offsets(ctTreeIter));
+        };
+
+        // undo back to the limit, across the checkpoints
+        int step_index = steps_num;
+        while (std::shared_ptr<CtNodeState> node_state = stateMachine.requested_state_previous(node_id)) {
+            --step_index;
+            assert_state(node_state, step_index);
+        }
+        ASSERT_EQ(steps_num - (limit - 1), step_index);
+
+        // redo, then undo after redo
+        assert_state(stateMachine.requested_state_subsequent(node_id), ++step_index);
+        assert_state(stateMachine.requested_state_subsequent(node_id), ++step_index);
+        assert_state(stateMachine.requested_state_previous(node_id), --step_index);
+
+        // a new step drops the redo tail
+        rBuffer = ctTreeIter.get_node_text_buffer();
+        rBuffer->insert(rBuffer->begin(), "new ");
+        const std::string new_step_xml = get_buffer_xml(rBuffer);
+        stateMachine.update_state(ctTreeIter);
+        ASSERT_TRUE(stateMachine.curr_index_is_last_index(node_id));
+        ASSERT_FALSE(stateMachine.requested_state_subsequent(node_id));
+        ASSERT_EQ(new_step_xml, stateMachine.requested_state_current(node_id)->buffer_xml.write_to_string());
+        assert_state(stateMachine.requested_state_previous(node_id), step_index);
+    });
+}
+
+TEST(TreeEditsGroup, siblings_sort_duplicate_names)
+{
+    UT::run_with_main_win([](CtMainWin* pWin){
+        const fs::path doc_filepath = pWin->get_ct_tmp()->getHiddenDirPath("UT") / "siblings_sort.ctb";
+        ASSERT_TRUE(fs::copy_file(UT::testCtbDocPath, doc_filepath));
+        ASSERT_TRUE(pWin->file_open(doc_filepath, ""));
+        CtTreeStore& treeStore = pWin->get_tree_store();
+        CtStorageControl* pStorage = pWin->get_ct_storage();
+
+        // the duplicate names, also in a different case, told apart by the node id
+        auto f_add_node = [&](const Glib::ustring& name, const Gtk::TreeIter* pParentIter) {
+            CtNodeData nodeData;
+            nodeData.nodeId = treeStore.node_id_get();
+            nodeData.name = name;
+            nodeData.syntax = CtConst::RICH_TEXT_ID;
+            nodeData.rTextBuffer = pWin->get_new_text_buffer();
+            Gtk::TreeIter nodeIter = treeStore.append_node(&nodeData, pParentIter);
+            treeStore.to_ct_tree_iter(nodeIter).pending_new_db_node();
+            return nodeIter;
+        };
+        const std::vector<Glib::ustring> names{"b10", "a", "B2", "A", "b2", "a"};
+        Gtk::TreeIter parentIter = f_add_node("siblings", nullptr);
+        std::vector<gint64> node_ids;
+        for (const Glib::ustring& name : names) {
+            node_ids.push_back(treeStore.to_ct_tree_iter(f_add_node(name, &parentIter)).get_node_id());
+        }
+        treeStore.nodes_sequences_fix(Gtk::TreeIter{}, true);
+        pWin->update_window_save_needed();
+        pWin->file_save(false/*need_vacuum*/);
+        ASSERT_FALSE(pWin->get_file_save_needed());
+        ASSERT_TRUE(pStorage->get_nodes_pending_write().empty());
+
+        auto f_get_children_ids = [&]() {
+            std::vector<gint64> children_ids;
+            for (const auto& child : parentIter->children()) {
+                children_ids.push_back(treeStore.to_ct_tree_iter(child).get_node_id());
+            }
+            return children_ids;
+        };
+        auto f_sort = [&](const bool ascending, const std::vector<size_t>& expected_indexes) {
+            const std::vector<gint64> ids_before = f_get_children_ids();
+            std::vector<gint64> expected_ids;
+            for (const size_t index : expected_indexes) {
+                expected_ids.push_back(node_ids.at(index));
+            }
+            pWin->get_tree_view().set_cursor_safe(treeStore.get_node_from_node_id(node_ids.front()));
+            if (ascending) pWin->get_ct_actions()->node_siblings_sort_ascending();
+            else pWin->get_ct_actions()->node_siblings_sort_descending();
+            ASSERT_EQ(expected_ids, f_get_children_ids());
+
+            // the sequences follow the new order, only the siblings that moved are pending and as hierarchy changes
+            const auto& nodes_pending_write = pStorage->get_nodes_pending_write();
+            size_t moved_num{0};
+            for (size_t i = 0; i < expected_ids.size(); ++i) {
+                ASSERT_EQ((gint64)(i + 1), treeStore.get_node_from_node_id(expected_ids[i]).get_node_sequence());
+                const auto it = nodes_pending_write.find(expected_ids[i]);
+                if (ids_before[i] != expected_ids[i]) {
+                    ASSERT_NE(nodes_pending_write.end(), it);
+                    ASSERT_TRUE(it->second.hier);
+                    ++moved_num;
+                }
+                else {
+                    ASSERT_EQ(nodes_pending_write.end(), it);
+                }
+            }
+            ASSERT_EQ(moved_num, nodes_pending_write.size());
+            ASSERT_EQ(moved_num > 0, pWin->get_file_save_needed());
+            if (moved_num > 0) {
+                pWin->file_save(false/*need_vacuum*/);
+            }
+
+            // the order read back from the file
+            Glib::ustring error;
+            std::unique_ptr<CtDocument> pDocument = CtDocument::load(doc_filepath, "", error);
+            ASSERT_TRUE(pDocument);
+            const int parent_index = pDocument->get_node_index(treeStore.to_ct_tree_iter(parentIter).get_node_id());
+            ASSERT_LE(0, parent_index);
+            std::vector<gint64> stored_ids;
+            for (const CtDocNode& docNode : pDocument->get_nodes()) {
+                if (docNode.parent_index == parent_index) {
+                    stored_ids.push_back(docNode.node_data.nodeId);
+                }
+            }
+            ASSERT_EQ(expected_ids, stored_ids);
+        };
+        // natural order of the lowercase names, the equal ones in the order they were
+        f_sort(true/*ascending*/, {1, 3, 5, 2, 4, 0});
+        f_sort(false/*ascending*/, {0, 2, 4, 1, 3, 5});
+        f_sort(true/*ascending*/, {1, 3, 5, 2, 4, 0});
+        // already in order, nothing to save
+        f_sort(true/*ascending*/, {1, 3, 5, 2, 4, 0});
+    });
+}
+
+// the duplicate of a node and its sub nodes against the original ones, with ids never used before
+static void assert_subnodes_duplicated(CtMainWin* pWin, CtTreeIter oldIter, CtTreeIter newIter,
+                                       const gint64 max_node_id_before, std::set<gint64>& new_node_ids)
+{
+    ASSERT_STREQ(oldIter.get_node_name().c_str(), newIter.get_node_name().c_str());
+    ASSERT_EQ(oldIter.get_node_syntax_highlighting(), newIter.get_node_syntax_highlighting());
+    ASSERT_LT(max_node_id_before, newIter.get_node_id());
+    ASSERT_TRUE(new_node_ids.insert(newIter.get_node_id()).second);
+
+    Glib::RefPtr<Gsv::Buffer> rOldBuffer = oldIter.get_node_text_buffer();
+    Glib::RefPtr<Gsv::Buffer> rNewBuffer = newIter.get_node_text_buffer();
+    ASSERT_TRUE(rOldBuffer and rNewBuffer);
+    if (oldIter.get_node_is_rich_text()) {
+        ASSERT_EQ(get_buffer_xml(rOldBuffer), get_buffer_xml(rNewBuffer));
+    }
+    else {
+        ASSERT_STREQ(rOldBuffer->get_text().c_str(), rNewBuffer->get_text().c_str());
+    }
+    ASSERT_EQ(get_widgets_offsets(oldIter), get_widgets_offsets(newIter));
+    ASSERT_EQ(get_widgets_types(oldIter), get_widgets_types(newIter));
+
+    CtTreeStore& treeStore = pWin->get_tree_store();
+    const auto oldChildren = oldIter->children();
+    const auto newChildren = newIter->children();
+    ASSERT_EQ(oldChildren.size(), newChildren.size());
+    auto newChild = newChildren.begin();
+    for (auto oldChild = oldChildren.begin(); oldChild != oldChildren.end(); ++oldChild, ++newChild) {
+        ASSERT_NO_FATAL_FAILURE(assert_subnodes_duplicated(pWin, treeStore.to_ct_tree_iter(oldChild), treeStore.to_ct_tree_iter(newChild),
+                                                           max_node_id_before, new_node_ids));
+    }
+}
+
+TEST(TreeEditsGroup, subnodes_duplicate_loaded_and_not)
+{
+    for (const std::string& inDocPath : {UT::testCtbDocPath, UT::testCtdDocPath}) {
+        UT::run_with_main_win([&inDocPath](CtMainWin* pWin){
+            const fs::path doc_filepath = pWin->get_ct_tmp()->getHiddenDirPath("UT") / ("subnodes_duplicate" + fs::path{inDocPath}.extension().string());
+            ASSERT_TRUE(fs::copy_file(inDocPath, doc_filepath));
+            ASSERT_TRUE(pWin->file_open(doc_filepath, ""));
+            CtTreeStore& treeStore = pWin->get_tree_store();
+            pWin->user_active() = false;
+
+            // the rich text node with the widgets moved under 'b', with its code sub nodes, then saved and
+            // reopened with the cursor elsewhere so that none of them is loaded
+            pWin->get_ct_actions()->node_move_after(treeStore.get_node_from_node_name("e"), treeStore.get_node_from_node_name("b"));
+            pWin->file_save(false/*need_vacuum*/);
+            ASSERT_FALSE(pWin->get_file_save_needed());
+            pWin->get_tree_view().set_cursor_safe(treeStore.get_node_from_node_name("d"));
+            ASSERT_TRUE(pWin->file_open(doc_filepath, ""));
+            // the names are duplicated from here on
+            std::map<std::string, gint64> node_ids;
+            for (const char* node_name : {"b", "c", "sh", "html", "xml", "py", "e"}) {
+                node_ids[node_name] = treeStore.get_node_from_node_name(node_name).get_node_id();
+            }
+            ASSERT_EQ(node_ids.at("b"), treeStore.to_ct_tree_iter(treeStore.get_node_from_node_id(node_ids.at("e"))->parent()).get_node_id());
+            auto f_is_loaded = [&](const char* node_name) {
+                return treeStore.get_node_from_node_id(node_ids.at(node_name)).get_node_buffer_already_loaded();
+            };
+            for (const auto& node_pair : node_ids) {
+                ASSERT_FALSE(f_is_loaded(node_pair.first.c_str())) << node_pair.first;
+            }
+
+            // the buffer in memory, not the stored content, is copied for the nodes loaded
+            auto f_edit_node = [&](const char* node_name) {
+                CtTreeIter ctTreeIter = treeStore.get_node_from_node_id(node_ids.at(node_name));
+                pWin->get_tree_view().set_cursor_safe(ctTreeIter);
+                Glib::RefPtr<Gsv::Buffer> rBuffer = ctTreeIter.get_node_text_buffer();
+                rBuffer->insert(rBuffer->begin(), "edited in memory\n"); // the widgets shifted
+                pWin->update_window_save_needed(CtSaveNeededUpdType::nbuf, false/*new_machine_state*/, &ctTreeIter);
+            };
+            gint64 last_new_top_id{0};
+            auto f_duplicate_b = [&]() {
+                const gint64 max_node_id_before = treeStore.node_id_get() - 1;
+                pWin->get_tree_view().set_cursor_safe(treeStore.get_node_from_node_id(node_ids.at("b")));
+                pWin->get_ct_actions()->node_subnodes_duplicate();
+
+                // the duplicate is the next sibling, selected, its nodes all pending as new
+                CtTreeIter newTopIter = pWin->curr_tree_iter();
+                Gtk::TreeIter nextIter = treeStore.get_node_from_node_id(node_ids.at("b"));
+                ++nextIter;
+                ASSERT_EQ(newTopIter.get_node_id(), treeStore.to_ct_tree_iter(nextIter).get_node_id());
+                std::set<gint64> new_node_ids;
+                ASSERT_NO_FATAL_FAILURE(assert_subnodes_duplicated(pWin, treeStore.get_node_from_node_id(node_ids.at("b")), newTopIter,
+                                                                   max_node_id_before, new_node_ids));
+                ASSERT_EQ(node_ids.size(), new_node_ids.size());
+                for (const gint64 new_node_id : new_node_ids) {
+                    ASSERT_EQ(1u, pWin->get_ct_storage()->get_nodes_pending_write().count(new_node_id));
+                }
+                last_new_top_id = newTopIter.get_node_id();
+            };
+
+            // 'c' loaded and edited, 'e' with the widgets and the other code nodes not loaded
+            f_edit_node("c");
+            for (const char* node_name : {"sh", "html", "xml", "py", "e"}) {
+                ASSERT_FALSE(f_is_loaded(node_name)) << node_name;
+            }
+            ASSERT_NO_FATAL_FAILURE(f_duplicate_b());
+
+            // 'e' loaded and edited
+            f_edit_node("e");
+            ASSERT_NO_FATAL_FAILURE(f_duplicate_b());
+
+            // the last duplicate saved and read back as the original
+            pWin->file_save(false/*need_vacuum*/);
+            ASSERT_FALSE(pWin->get_file_save_needed());
+            pWin->get_tree_view().set_cursor_safe(treeStore.get_node_from_node_id(node_ids.at("py")));
+            ASSERT_TRUE(pWin->file_open(doc_filepath, ""));
+            std::set<gint64> reopened_ids;
+            ASSERT_NO_FATAL_FAILURE(assert_subnodes_duplicated(pWin, treeStore.get_node_from_node_id(node_ids.at("b")),
+                                                               treeStore.get_node_from_node_id(last_new_top_id), 0, reopened_ids));
+        });
+    }
+}
+
+static void assert_toc_entries_eq(const TocEntry& expected, const TocEntry& result)
+{
+    ASSERT_EQ(expected.anchor_link, result.anchor_link);
+    ASSERT_EQ(expected.text, result.text);
+    ASSERT_EQ(expected.is_node, result.is_node);
+    ASSERT_EQ(expected.depth, result.depth);
+    ASSERT_EQ(expected.h_level, result.h_level);
+    ASSERT_EQ(expected.children.size(), result.children.size());
+    auto resultChild = result.children.begin();
+    for (const TocEntry& expectedChild : expected.children) {
+        ASSERT_NO_FATAL_FAILURE(assert_toc_entries_eq(expectedChild, *resultChild++));
+    }
+}
+
+TEST(TreeEditsGroup, toc_entries_stored_as_buffer)
+{
+    UT::run_with_main_win([](CtMainWin* pWin){
+        const fs::path doc_filepath = pWin->get_ct_tmp()->getHiddenDirPath("UT") / "toc_entries.ctb";
+        ASSERT_TRUE(fs::copy_file(UT::testCtbDocPath, doc_filepath));
+        ASSERT_TRUE(pWin->file_open(doc_filepath, ""));
+        CtTreeStore& treeStore = pWin->get_tree_store();
+        pWin->user_active() = false;
+
+        CtNodeData nodeData;
+        nodeData.nodeId = treeStore.node_id_get();
+        nodeData.name = "toc";
+        nodeData.syntax = CtConst::RICH_TEXT_ID;
+        nodeData.rTextBuffer = pWin->get_new_text_buffer();
+        CtTreeIter ctTreeIter = treeStore.to_ct_tree_iter(treeStore.append_node(&nodeData));
+        const gint64 node_id = ctTreeIter.get_node_id();
+        ctTreeIter.pending_new_db_node();
+        treeStore.nodes_sequences_fix(Gtk::TreeIter{}, false);
+        Glib::RefPtr<Gsv::Buffer> rBuffer = ctTreeIter.get_node_text_buffer();
+        auto f_insert = [&](const int offset, const Glib::ustring& text, const char* scale) {
+            rBuffer->insert(rBuffer->get_iter_at_offset(offset), text);
+            if (scale) {
+                rBuffer->apply_tag_by_name(pWin->get_text_tag_name_exist_or_create(CtConst::TAG_SCALE, scale),
+                                           rBuffer->get_iter_at_offset(offset), rBuffer->get_iter_at_offset(offset + text.size()));
+            }
+        };
+        auto f_append = [&](const Glib::ustring& text, const char* scale = nullptr) {
+            f_insert(rBuffer->end().get_offset(), text, scale);
+        };
+        auto f_append_anchor = [&](const Glib::ustring& anchor_name) {
+            CtAnchoredWidget* pAnchoredWidget = new CtImageAnchor{pWin, anchor_name, rBuffer->end().get_offset(), "right"};
+            pAnchoredWidget->insertInTextBuffer(rBuffer);
+            treeStore.addAnchoredWidgets(ctTreeIter, {pAnchoredWidget}, nullptr/*pTextView*/);
+        };
+        f_append("H1 title", "h1");
+        f_append_anchor("h1-1");
+        f_append("\n");
+        f_append_anchor("other"); // a widget at the line start, the line is not a header
+        f_append("after a widget\n", "h2");
+        f_append("body text\n");
+        f_append("H2 header", "h2");
+        f_append_anchor("h2-1"); // the header ends at the first widget
+        f_append_anchor("after");
+        f_append(" tail\n");
+        f_append("H1 second", "h1");
+        f_append_anchor("h1-2"); // at the end of the text
+        pWin->update_window_save_needed(CtSaveNeededUpdType::nbuf, false/*new_machine_state*/, &ctTreeIter);
+
+        auto f_save_and_reopen = [&]() {
+            pWin->file_save(false/*need_vacuum*/);
+            ASSERT_FALSE(pWin->get_file_save_needed());
+            pWin->get_tree_view().set_cursor_safe(treeStore.get_node_from_node_name("d"));
+            ASSERT_TRUE(pWin->file_open(doc_filepath, ""));
+            ctTreeIter = treeStore.get_node_from_node_id(node_id);
+            ASSERT_TRUE(ctTreeIter);
+            ASSERT_FALSE(ctTreeIter.get_node_buffer_already_loaded());
+        };
+        auto f_get_anchors_names = [&]() {
+            std::vector<Glib::ustring> anchors_names;
+            for (CtAnchoredWidget* pWidget : ctTreeIter.get_anchored_widgets()) {
+                if (auto pImageAnchor = dynamic_cast<CtImageAnchor*>(pWidget)) {
+                    anchors_names.push_back(pImageAnchor->get_anchor_name());
+                }
+            }
+            return anchors_names;
+        };
+        auto f_expected_entry = [&](const std::vector<std::tuple<const char*, const char*, unsigned>>& headers) {
+            TocEntry entry{fmt::format("node {}", node_id), true, "toc", 0};
+            for (const auto& header : headers) {
+                entry.children.emplace_back(fmt::format("node {} {}", node_id, std::get<0>(header)), false, std::get<1>(header), 1, std::get<2>(header));
+            }
+            return entry;
+        };
+
+        // all the anchors in place, the stored content is enough and gives the same as the buffer
+        ASSERT_NO_FATAL_FAILURE(f_save_and_reopen());
+        std::unique_ptr<CtStoredTextReader> pReader = pWin->get_ct_storage()->create_stored_text_reader();
+        ASSERT_TRUE(pReader);
+        const TocEntry expected = f_expected_entry({{"h1-1", "H1 title", 1}, {"h2-1", "H2 header", 2}, {"h1-2", "H1 second", 1}});
+        ASSERT_NO_FATAL_FAILURE(assert_toc_entries_eq(expected, find_toc_entries(pWin, pReader.get(), ctTreeIter, 0)));
+        ASSERT_FALSE(ctTreeIter.get_node_buffer_already_loaded());
+        ASSERT_NO_FATAL_FAILURE(assert_toc_entries_eq(expected, find_toc_entries(pWin, nullptr/*pReader*/, ctTreeIter, 0)));
+        ASSERT_TRUE(ctTreeIter.get_node_buffer_already_loaded());
+        ASSERT_FALSE(pWin->get_file_save_needed());
+
+        // a header without anchor added at the start, the following anchors of the same level are renumbered
+        rBuffer = ctTreeIter.get_node_text_buffer();
+        f_insert(0, "\n", nullptr);
+        f_insert(0, "H1 new", "h1");
+        pWin->update_window_save_needed(CtSaveNeededUpdType::nbuf, false/*new_machine_state*/, &ctTreeIter);
+        ASSERT_NO_FATAL_FAILURE(f_save_and_reopen());
+        pReader = pWin->get_ct_storage()->create_stored_text_reader();
+        const TocEntry expected_renumbered = f_expected_entry({{"h1-1", "H1 new", 1}, {"h1-2", "H1 title", 1},
+                                                               {"h2-1", "H2 header", 2}, {"h1-3", "H1 second", 1}});
+        ASSERT_NO_FATAL_FAILURE(assert_toc_entries_eq(expected_renumbered, find_toc_entries(pWin, pReader.get(), ctTreeIter, 0)));
+        // loaded to insert the missing anchor, the outdated ones replaced
+        ASSERT_TRUE(ctTreeIter.get_node_buffer_already_loaded());
+        ASSERT_TRUE(pWin->get_file_save_needed());
+        const std::vector<Glib::ustring> expected_anchors{"h1-1", "h1-2", "other", "h2-1", "after", "h1-3"};
+        ASSERT_EQ(expected_anchors, f_get_anchors_names());
+
+        // read back from the storage as from the buffer
+        ASSERT_NO_FATAL_FAILURE(f_save_and_reopen());
+        pReader = pWin->get_ct_storage()->create_stored_text_reader();
+        ASSERT_NO_FATAL_FAILURE(assert_toc_entries_eq(expected_renumbered, find_toc_entries(pWin, pReader.get(), ctTreeIter, 0)));
+        ASSERT_FALSE(ctTreeIter.get_node_buffer_already_loaded());
+        ASSERT_NO_FATAL_FAILURE(assert_toc_entries_eq(expected_renumbered, find_toc_entries(pWin, nullptr/*pReader*/, ctTreeIter, 0)));
+        ASSERT_FALSE(pWin->get_file_save_needed());
+        ASSERT_EQ(expected_anchors, f_get_anchors_names());
+    });
+}
@@ -126,6 +126,21 @@ TEST(TestTypesGroup, ThreadSafeDEQueue_MaxElements)
     ASSERT_EQ(3, threadSafeDEQueue.size());
 }
 
+TEST(TestTypesGroup, ThreadSafeDEQueue_PopFrontFor)
+{
+    ThreadSafeDEQueue<int,500> threadSafeDEQueue;
+    ASSERT_FALSE(threadSafeDEQueue.pop_front_for(std::chrono::milliseconds{10}).has_value());
+    std::thread thread_push([&threadSafeDEQueue](){
+        g_usleep(1000);
+        threadSafeDEQueue.push_back(1);
+    });
+    std::optional<int> popped = threadSafeDEQueue.pop_front_for(std::chrono::milliseconds{10000});
+    thread_push.join();
+    ASSERT_TRUE(popped.has_value());
+    ASSERT_EQ(1, popped.value());
+    ASSERT_TRUE(threadSafeDEQueue.empty());
+}
+
 TEST(TestTypesGroup, ctScalableTag)
 {
     {
@@ -167,3 +182,44 @@ TEST(TestTypesGroup, ctScalableTag)
         ASSERT_FALSE(scalableTag.underline);
     }
 }
+
+TEST(TestTypesGroup, ctTableMatrix)
+{
+    CtTableMatrix tableMatrix{{{"h1", "h2"}, {"йцукенгшщз", "2"}, {"3"}}};
+    ASSERT_EQ(3, tableMatrix.get_rows_num());
+    ASSERT_EQ(2, tableMatrix.get_cols_num());
+    ASSERT_STREQ("йцукенгшщз", tableMatrix.get_cell(1, 0).c_str());
+    ASSERT_STREQ("", tableMatrix.get_cell(2, 1).c_str());
+
+    tableMatrix.set_cell(1, 0, "1");
+    ASSERT_STREQ("1", tableMatrix.get_cell(1, 0).c_str());
+    ASSERT_STREQ("3", tableMatrix.get_cell(2, 0).c_str());
+
+    tableMatrix.row_insert(1, {"a", "b"});
+    ASSERT_EQ(4, tableMatrix.get_rows_num());
+    ASSERT_STREQ("b", tableMatrix.get_cell(1, 1).c_str());
+    ASSERT_STREQ("2", tableMatrix.get_cell(2, 1).c_str());
+    tableMatrix.row_delete(2);
+    ASSERT_EQ(3, tableMatrix.get_rows_num());
+    ASSERT_STREQ("3", tableMatrix.get_cell(2, 0).c_str());
+
+    tableMatrix.rows_reorder({0, 2, 1});
+    ASSERT_STREQ("h1", tableMatrix.get_cell(0, 0).c_str());
+    ASSERT_STREQ("3", tableMatrix.get_cell(1, 0).c_str());
+    ASSERT_STREQ("b", tableMatrix.get_cell(2, 1).c_str());
+
+    tableMatrix.col_insert(1);
+    ASSERT_EQ(3, tableMatrix.get_cols_num());
+    ASSERT_STREQ("", tableMatrix.get_cell(0, 1).c_str());
+    ASSERT_STREQ("h2", tableMatrix.get_cell(0, 2).c_str());
+    tableMatrix.col_swap(0, 2);
+    ASSERT_STREQ("h2", tableMatrix.get_cell(0, 0).c_str());
+    tableMatrix.col_delete(1);
+    ASSERT_EQ(2, tableMatrix.get_cols_num());
+    ASSERT_STREQ("h1", tableMatrix.get_cell(0, 1).c_str());
+
+    const CtTableMatrix tableMatrixCopy{tableMatrix.get_rows()};
+    ASSERT_TRUE(tableMatrixCopy == tableMatrix);
+    tableMatrix.set_cell(2, 1, "c");
+    ASSERT_TRUE(tableMatrixCopy != tableMatrix);
+}